@@ -0,0 +1,100 @@
+#ifndef BLOCK_MATCH_H
+#define BLOCK_MATCH_H
+
+/**
+ * \file BlockMatch.h
+ *
+ * \brief This file embodies the comparison of blocks of RGB24 pixels used when searching for motion.
+ *
+ * This file embodies the comparison of blocks of RGB24 pixels used when searching for motion. A block is a number
+ * of rows of packed RGB bytes at some stride, and two blocks are compared by the sum of the absolute differences
+ * (SAD) of their bytes. The SSE2 PSADBW instruction sums the differences of sixteen bytes at a time, so it's used
+ * wherever the build targets SSE2, which every x86-64 build does. The search gives up on a candidate as soon as its
+ * running sum passes the best found so far, so the sum is checked against a limit after every row.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace nddi {
+
+    /**
+     * \brief Sums the absolute differences of the bytes of two blocks, stopping early once the sum passes a limit.
+     *
+     * Sums the absolute differences of the bytes of two blocks, stopping early once the sum passes a limit.
+     * @param a The first byte of the first block.
+     * @param a_stride The bytes from one row of the first block to the next.
+     * @param b The first byte of the second block.
+     * @param b_stride The bytes from one row of the second block to the next.
+     * @param row_bytes The bytes in each row of the blocks.
+     * @param rows The number of rows in the blocks.
+     * @param limit The sum beyond which the blocks are no longer of interest.
+     * @return The sum, or some value greater than limit if the sum passed it.
+     */
+    static inline unsigned long blockSad(const uint8_t* a, size_t a_stride,
+                                         const uint8_t* b, size_t b_stride,
+                                         size_t row_bytes, size_t rows,
+                                         unsigned long limit) {
+        unsigned long sad = 0;
+
+        for (size_t y = 0; y < rows; y++, a += a_stride, b += b_stride) {
+            size_t x = 0;
+#if defined(__SSE2__)
+            __m128i sum = _mm_setzero_si128();
+            for (; x + 16 <= row_bytes; x += 16) {
+                __m128i va = _mm_loadu_si128((const __m128i*)(a + x));
+                __m128i vb = _mm_loadu_si128((const __m128i*)(b + x));
+                sum = _mm_add_epi64(sum, _mm_sad_epu8(va, vb));
+            }
+            if (x + 8 <= row_bytes) {
+                __m128i va = _mm_loadl_epi64((const __m128i*)(a + x));
+                __m128i vb = _mm_loadl_epi64((const __m128i*)(b + x));
+                sum = _mm_add_epi64(sum, _mm_sad_epu8(va, vb));
+                x += 8;
+            }
+            sad += (unsigned long)_mm_cvtsi128_si32(sum) + (unsigned long)_mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+#endif
+            for (; x < row_bytes; x++) {
+                sad += (a[x] > b[x]) ? (a[x] - b[x]) : (b[x] - a[x]);
+            }
+            if (sad > limit) {
+                break;
+            }
+        }
+
+        return sad;
+    }
+
+    /**
+     * \brief Sums the squared differences of the bytes of two blocks.
+     *
+     * Sums the squared differences of the bytes of two blocks. This is used for the PSNR of what's on the display.
+     * @param a The first byte of the first block.
+     * @param a_stride The bytes from one row of the first block to the next.
+     * @param b The first byte of the second block.
+     * @param b_stride The bytes from one row of the second block to the next.
+     * @param row_bytes The bytes in each row of the blocks.
+     * @param rows The number of rows in the blocks.
+     * @return The sum.
+     */
+    static inline uint64_t blockSse(const uint8_t* a, size_t a_stride,
+                                    const uint8_t* b, size_t b_stride,
+                                    size_t row_bytes, size_t rows) {
+        uint64_t sse = 0;
+
+        for (size_t y = 0; y < rows; y++, a += a_stride, b += b_stride) {
+            for (size_t x = 0; x < row_bytes; x++) {
+                int d = (int)a[x] - (int)b[x];
+                sse += d * d;
+            }
+        }
+
+        return sse;
+    }
+
+} // namespace nddi
+
+#endif // BLOCK_MATCH_H
@@ -8,9 +8,9 @@
  */
 
 #include <iostream>
-#include <zlib.h>
 
 #include "CachedTiler.h"
+#include "PixelConvert.h"
 
 
 /**
@@ -25,7 +25,10 @@ CachedTiler::CachedTiler (size_t display_width, size_t display_height,
   tile_width_(tile_width),
   tile_height_(tile_height),
   max_tiles_(max_tiles),
-  bits_(bits)
+  bits_(bits),
+  cache_(max_tiles, evictionByName(globalConfiguration.eviction)),
+  fingerprinter_(fingerprintByName(globalConfiguration.fingerprint), bits,
+                 tile_width, tile_height, display_width, display_height, true)
 {
     quiet_ = !globalConfiguration.verbose;
 
@@ -54,6 +57,7 @@ CachedTiler::CachedTiler (size_t display_width, size_t display_height,
             display_ = new GrpcNddiDisplay();
         }
     }
+    handoff_.Attach(display_);
 
     // Compute tile_map width
     tile_map_width_ = display_width / tile_width;
@@ -93,10 +97,12 @@ CachedTiler::CachedTiler (size_t display_width, size_t display_height,
 
 CachedTiler::~CachedTiler()
 {
-    // Free all of the allocated tile_t structs
-    map<unsigned long, tile_t*>::iterator it;
-    for (it = cache_map_.begin(); it != cache_map_.end(); it++) {
-        free(it->second);
+    cerr << "Tile Cache (" << evictionName(cache_.Policy()) << ") Hits: " << cache_hits_ << " Misses: " << cache_misses_
+         << " Evictions: " << cache_.Evictions() << endl;
+    fingerprint_stats_t &stats = fingerprinter_.Stats();
+    if (stats.usecs) {
+        cerr << "Tile Fingerprint (" << fingerprintName(fingerprinter_.Mode()) << ") Throughput (MB/s): "
+             << (double)stats.bytes / (double)stats.usecs << endl;
     }
 }
 
@@ -126,17 +132,11 @@ void CachedTiler::InitializeCoefficientPlanes() {
     start.push_back(0); start.push_back(0); start.push_back(0);
     end.push_back(0); end.push_back(0); end.push_back(0);
 
-    for (int j = 0; j < tile_map_height_; j++) {
-        for (int i = 0; i < tile_map_width_; i++) {
-            coeffs[2][0] = -i * tile_width_;
-            coeffs[2][1] = -j * tile_height_;
-            start[0] = i * tile_width_; start[1] = j * tile_height_;
-            end[0] = (i + 1) * tile_width_ - 1; end[1] = (j + 1) * tile_height_ - 1;
-            if (end[0] >= display_width_) { end[0] = display_width_ - 1; }
-            if (end[1] >= display_height_) { end[1] = display_height_ - 1; }
-            display_->FillCoefficientMatrix(coeffs, start, end);
-        }
-    }
+    // Each tile's matrix picks its tile out of the frame volume, which the display derives from the tile size
+    vector<unsigned int> size;
+    size.push_back(tile_width_); size.push_back(tile_height_);
+    end[0] = display_width_ - 1; end[1] = display_height_ - 1;
+    fillCoefficientMatrixTiled(display_, coeffs, start, end, size);
 
     // Turn off all planes and then set the 0 plane to full on.
     start[0] = 0; start[1] = 0; start[2] = 0;
@@ -163,87 +163,40 @@ void CachedTiler::InitializeCoefficientPlanes() {
 void CachedTiler::UpdateDisplay(uint8_t* buffer, size_t width, size_t height)
 {
     int                            unchanged = 0, hits = 0, misses = 0;
-    unsigned char                  mask = 0xff << (8 - bits_);
+    size_t                         updates = 0;
     tile_t                        *tile;
-    Pixel                         *tile_pixels = NULL;
-    Pixel                         *tile_pixels_sig_bits = NULL;
 
     assert(width >= display_width_);
     assert(height >= display_height_);
 
-    // Break up the passed in buffer into one tile at a time
+    // Fingerprint every tile up front. Pixels are only copied out of the buffer for tiles that miss the cache.
+    fingerprinter_.FingerprintFrame(buffer, width, fingerprints_);
+
+    // Decide what each tile needs in order, since every decision depends on the state of the cache left by the
+    // ones before it. The updates are only recorded here. Their entries are reused from frame to frame, along
+    // with the pixel arrays the display hands back.
     for (size_t j_tile_map = 0; j_tile_map < tile_map_height_; j_tile_map++) {
         for (size_t i_tile_map = 0; i_tile_map < tile_map_width_; i_tile_map++) {
 
             // Increment age counter
             age_counter_++;
 
-            // Allocate tile pixel arrays if necessary. Sometimes they're re-used.
-            if (!tile_pixels)
-                tile_pixels = (Pixel*)malloc(tile_width_ * tile_height_ * sizeof(Pixel));
-            if (!tile_pixels_sig_bits)
-                tile_pixels_sig_bits = (Pixel*)malloc(tile_width_ * tile_height_ * sizeof(Pixel));
+            // The fingerprint computed for this tile
+            unsigned long  checksum = fingerprints_[j_tile_map * tile_map_width_ + i_tile_map];
 
-#ifdef USE_OMP
-#pragma omp parallel for ordered
-#endif
-            for (size_t j_tile = 0; j_tile < tile_height_; j_tile++) {
-#ifdef USE_OMP
-#pragma omp ordered
-#endif
-                {
-                    // Compute the offset into the RGB buffer for this row in this tile
-                    int bufferOffset = 3 * ((j_tile_map * tile_height_ + j_tile) * width + (i_tile_map * tile_width_));
-
-                    for (size_t i_tile = 0; i_tile < tile_width_; i_tile++) {
-
-                        Pixel p, psb;
-
-                        // Just use a black pixel if our tile is hanging off the edge of the buffer
-                        if ((j_tile_map * tile_height_ + j_tile >= display_height_) ||
-                            (i_tile_map * tile_width_ + i_tile >= display_width_) ) {
-                            p.r = p.g = p.b = 0; p.a = 255;
-                        } else {
-                            p.r = buffer[bufferOffset++];
-                            p.g = buffer[bufferOffset++];
-                            p.b = buffer[bufferOffset++];
-                            p.a = 0xff;
-                        }
-                        tile_pixels[j_tile * tile_width_ + i_tile].packed = p.packed;
-
-                        psb.r = p.r & mask;
-                        psb.g = p.g & mask;
-                        psb.b = p.b & mask;
-                        psb.a = p.a & mask;
-
-                        tile_pixels_sig_bits[j_tile * tile_width_ + i_tile].packed = psb.packed;
-                    }
-                }
+            if (updates == updates_.size()) {
+                updates_.push_back(tile_update_t());
             }
-
-            // Calculate the checksum
-            unsigned long  checksum;
-#if (CHECKSUM_CALCULATOR == TRIVIAL)
-            checksum  = (unsigned long)tile_pixels_sig_bits[0].packed << 32;
-            checksum |= (unsigned long)tile_pixels_sig_bits[tile_width_ * tile_height_ - 1].packed;
-#else
-            unsigned long crc = crc32(0L, Z_NULL, 0);
-#if (CHECKSUM_CALCULATOR == CRC)
-            checksum = crc32(crc, (unsigned char*)tile_pixels_sig_bits, tile_width_ * tile_height_ * sizeof(Pixel));
-#elif (CHECKSUM_CALCULATOR == ADLER)
-            checksum = adler32(crc, (unsigned char*)tile_pixels_sig_bits, tile_width_ * tile_height_ * sizeof(Pixel));
-#endif
-#endif
+            tile_update_t &update = updates_[updates];
+            update.i = i_tile_map;
+            update.j = j_tile_map;
+            update.sendPixels = update.sendCoefficients = false;
 
             // If the tile is already in the tile cache
             tile = IsTileInCache(checksum);
             if (tile) {
-                // Remove the old age mapping
-                age_map_.erase(tile->age);
-
-                // Update the age and map it
-                tile->age = age_counter_;
-                age_map_.insert(pair<unsigned long, tile_t*>(tile->age, tile));
+                // Update the age
+                cache_.Touch(tile, age_counter_);
 
                 // If the display doesn't already contain this tile
                 if (display_map_[i_tile_map][j_tile_map] != tile) {
@@ -252,13 +205,8 @@ void CachedTiler::UpdateDisplay(uint8_t* buffer, size_t width, size_t height)
                     // Update the display map
                     display_map_[i_tile_map][j_tile_map] = tile;
 
-#ifdef USE_COPY_PIXEL_TILES
-                    // Push tile, updating coefficient plane only
-                    PushTile(tile, i_tile_map, j_tile_map);
-#else
-                    // Update Coefficient Matrices
-                    UpdateCoefficientMatrices(i_tile_map, j_tile_map, tile);
-#endif
+                    // Update the coefficient plane only
+                    update.sendCoefficients = true;
                 } else {
                     // Update the unchanged counter
                     unchanged++;
@@ -269,96 +217,90 @@ void CachedTiler::UpdateDisplay(uint8_t* buffer, size_t width, size_t height)
                 // Cache miss
                 misses++;
 
-                // If we have room in the tile cache
-                if (cache_map_.size() < max_tiles_) {
+                // Whichever tile it ends up in, the pixels go to the frame volume
+                update.sendPixels = true;
 
-                    // Allocate a new tile
-                    tile = (tile_t*)malloc(sizeof(tile_t));
-                    tile->checksum = checksum;
+                // If we have room in the tile cache
+                if (cache_.Size() < max_tiles_) {
 
-                    // This will be pushed at the end with this new "index". Since we're growing the cache still,
-                    // we can use the cache index of this new element as the zIndex
-                    tile->zIndex = cache_map_.size();
+                    // Add a new tile. Since we're growing the cache still, it gets the next zIndex.
+                    tile = cache_.Add(checksum, age_counter_);
 
                     // Update the display map with the new tile
                     display_map_[i_tile_map][j_tile_map] = tile;
 
-                    // Map the checksum to this tile
-                    cache_map_.insert(pair<unsigned long, tile_t*>(tile->checksum, tile));
-
-                    // Update the age and map it
-                    tile->age = age_counter_;
-                    age_map_.insert(pair<unsigned long, tile_t*>(tile->age, tile));
-
-#ifdef USE_COPY_PIXEL_TILES
-                    // Push tile
-                    PushTile(tile, tile_pixels, i_tile_map, j_tile_map);
-
-                    // Force new tile to be allocated. This one will be freed after it's copied
-                    tile_pixels = NULL;
-#else
-                    // Push the pixels to the frame volume.
-                    UpdateFrameVolume(tile_pixels, tile);
-
-                    // Update Coefficient Matrices
-                    UpdateCoefficientMatrices(i_tile_map, j_tile_map, tile);
-#endif
+                    update.sendCoefficients = true;
 
                 // We didn't have room in the tile cache, so update an existing tile
                 } else {
 
-                    bool needToUpdateCoefficients = false;
-
                     // Determine if we can re-use the zIndex from the previous tile, saving coefficient matrix updates
                     tile = display_map_[i_tile_map][j_tile_map];
                     if (IsTileInUse(tile)) {
                         // It was in use, so try to find an expired one.
-                        tile = GetExpiredCacheTile();
+                        tile = GetExpiredCacheTile(checksum);
 
                         // If we couldn't, then we're in trouble
                         assert(tile);
 
-                        needToUpdateCoefficients = true;
+                        update.sendCoefficients = true;
 
                         // Update the tile map with the new tile
                         display_map_[i_tile_map][j_tile_map] = tile;
                     }
 
-                    // Remove the old checksum and age mappings
-                    cache_map_.erase(tile->checksum);
-                    age_map_.erase(tile->age);
-
                     // Set the new checksum and age
-                    tile->checksum = checksum;
-                    tile->age = age_counter_;
+                    cache_.Replace(tile, checksum, age_counter_);
+                }
+            }
 
-                    // Add the new checksum and age mappings
-                    cache_map_.insert(pair<unsigned long, tile_t*>(tile->checksum, tile));
-                    age_map_.insert(pair<unsigned long, tile_t*>(tile->age, tile));
+            if (update.sendPixels || update.sendCoefficients) {
+                update.tile = tile;
+                updates++;
+            }
+        } // for (int i_tile_map = 0; i_tile_map < tile_map_width_; i_tile_map++) {
+    } // for (int j_tile_map = 0; j_tile_map < tile_map_height_; j_tile_map++) {
 
+    // Copy the pixels of the tiles which missed out of the buffer. Tiles are independent, so they're split between threads.
 #ifdef USE_COPY_PIXEL_TILES
-                    if (!needToUpdateCoefficients) {
-                        // Push tile, updating FrameVolume only
-                        PushTile(tile, tile_pixels);
-                    } else {
-                        // Push tile, FrameVolume and CoeffientPlane
-                        PushTile(tile, tile_pixels, i_tile_map, j_tile_map);
-                    }
+    for (size_t u = 0; u < updates; u++) {
+        if (updates_[u].sendPixels && updates_[u].pixels.empty() && !tile_pixels_spare_.empty()) {
+            updates_[u].pixels.swap(tile_pixels_spare_.back());
+            tile_pixels_spare_.pop_back();
+        }
+    }
+#endif
+#ifdef USE_OMP
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+    for (long u = 0; u < (long)updates; u++) {
+        if (updates_[u].sendPixels) {
+            ExtractTile(buffer, width, updates_[u].i, updates_[u].j, updates_[u].pixels);
+        }
+    }
 
-                    // Force new tile to be allocated. This one will be freed after it's copied
-                    tile_pixels = NULL;
+    // Send the updates in the order they were decided, so the commands are the same however many threads there are
+    for (size_t u = 0; u < updates; u++) {
+        tile_update_t &update = updates_[u];
+#ifdef USE_COPY_PIXEL_TILES
+        if (update.sendPixels) {
+            // Push tile, updating FrameVolume. The tile is moved into the list.
+            PushTile(update.tile, update.pixels);
+        }
+        if (update.sendCoefficients) {
+            // Push tile, updating CoeffientPlane
+            PushTile(update.tile, update.i, update.j);
+        }
 #else
-                    // Push the pixels to the frame volume.
-                    UpdateFrameVolume(tile_pixels, tile);
-
-                    // Update Coefficient Matrices if needed
-                    if (needToUpdateCoefficients) {
-                        UpdateCoefficientMatrices(i_tile_map, j_tile_map, tile);
-                    }
+        if (update.sendPixels) {
+            // Push the pixels to the frame volume.
+            UpdateFrameVolume(update.pixels, update.tile);
+        }
+        if (update.sendCoefficients) {
+            // Update Coefficient Matrices
+            UpdateCoefficientMatrices(update.i, update.j, update.tile);
+        }
 #endif
-                }
-            } // for (int i_tile_map = 0; i_tile_map < tile_map_width_; i_tile_map++) {
-        } // for (int j_tile_map = 0; j_tile_map < tile_map_height_; j_tile_map++) {
     }
 
 #ifdef USE_COPY_PIXEL_TILES
@@ -371,14 +313,14 @@ void CachedTiler::UpdateDisplay(uint8_t* buffer, size_t width, size_t height)
 
         // Update the Frame Volume by copying the tiles over
         if (tile_pixels_list.size() > 0) {
-            display_->CopyPixelTiles(tile_pixels_list, tile_starts_list, size);
+            handoff_.CopyPixelTiles(std::move(tile_pixels_list), tile_starts_list, size);
         }
 
-        // Free the tile memory and empty the vector
-        while (!tile_pixels_list.empty()) {
-            free(tile_pixels_list.back());
-            tile_pixels_list.pop_back();
+        // Keep whatever tiles the display handed back for the next frame and empty the vector
+        for (size_t i = 0; i < tile_pixels_list.size(); i++) {
+            tile_pixels_spare_.push_back(std::move(tile_pixels_list[i]));
         }
+        tile_pixels_list.clear();
         tile_starts_list.clear();
 
         // Update the coefficient plane
@@ -396,21 +338,37 @@ void CachedTiler::UpdateDisplay(uint8_t* buffer, size_t width, size_t height)
     }
 #endif
 
-    // Free alloc'd memory
-    if (tile_pixels)
-        free(tile_pixels);
-    if (tile_pixels_sig_bits)
-        free(tile_pixels_sig_bits);
-
     // Report cache statistics
     unchanged_tiles_ += unchanged;
     cache_hits_ += hits;
     cache_misses_ += misses;
     if (!quiet_) {
-        cout << "Cached Tiling Statistics:" << endl << "  unchanged: " << unchanged_tiles_ << " cache hits: " << cache_hits_ << " cache misses: " << cache_misses_ << " cache size: " << cache_map_.size() << endl;
+        cout << "Cached Tiling Statistics:" << endl << "  unchanged: " << unchanged_tiles_ << " cache hits: " << cache_hits_ << " cache misses: " << cache_misses_ << " cache size: " << cache_.Size() << endl;
     }
 }
 
+/**
+ * Copies one tile out of the RGB buffer into an array of pixels. Pixels hanging off the edge of the
+ * display are black. This is called from several threads at once, so it only touches the array passed in.
+ *
+ * @param buffer Pointer to an RGB buffer
+ * @param width The width of the RGB buffer
+ * @param i_tile_map The column of the tile
+ * @param j_tile_map The row of the tile
+ * @param pixels Receives the tile's pixels
+ */
+void CachedTiler::ExtractTile(uint8_t* buffer, size_t width, size_t i_tile_map, size_t j_tile_map, vector<Pixel> &pixels) {
+
+    // The part of the tile which isn't hanging off the edge of the display
+    size_t x = i_tile_map * tile_width_, y = j_tile_map * tile_height_;
+    size_t tw = (x + tile_width_ <= display_width_) ? tile_width_ : display_width_ - x;
+    size_t th = (y + tile_height_ <= display_height_) ? tile_height_ : display_height_ - y;
+
+    pixels.resize(tile_width_ * tile_height_);
+    gatherTile(buffer + 3 * (y * width + x), 3 * width, tw, th, tile_width_, tile_height_, &pixels[0]);
+}
+
+
 /**
  * Checks to see if the tile is already in the tile cache based solely on the
  * checksum.
@@ -419,15 +377,7 @@ void CachedTiler::UpdateDisplay(uint8_t* buffer, size_t width, size_t height)
  * @return The pointer to the tile_t.
  */
 tile_t* CachedTiler::IsTileInCache(unsigned long checksum) {
-
-    map<unsigned long, tile_t*>::iterator it;
-
-    it = cache_map_.find(checksum);
-    if (it != cache_map_.end()) {
-        return it->second;
-    } else {
-        return NULL;
-    }
+    return cache_.Find(checksum);
 }
 
 /**
@@ -446,35 +396,33 @@ bool CachedTiler::IsTileInUse(tile_t* tile) {
 }
 
 /**
- * Finds a candidate to be ejected from the cache.
+ * Finds a candidate to be ejected from the cache. The cache's eviction policy chooses it, avoiding tiles
+ * which are still in use while there are others.
  *
+ * @param checksum The checksum of the tile which will take the candidate's place.
  * @return The tile to be ejected
  */
-tile_t* CachedTiler::GetExpiredCacheTile() {
-    pair<map<unsigned long, tile_t*>::iterator, map<unsigned long, tile_t*>::iterator> its;
-
-    its = age_map_.equal_range(0);
-
-    return its.first->second;
+tile_t* CachedTiler::GetExpiredCacheTile(unsigned long checksum) {
+    return cache_.Victim(checksum, age_counter_ - tile_map_width_ * tile_map_height_);
 }
 
 /**
  * Updates region of the Frame Volume corresponding to the tile's
  * zIndex.
  *
- * @param pixels The array of pixels to use in the update.
+ * @param pixels The pixels to use in the update, which are handed to the display and left unspecified.
  * @param tile The zIndex of the tile will be used to choose the region in the frame volume.
  * @return The cost of the NDDI operations.
  */
 #ifndef USE_COPY_PIXEL_TILES
-void CachedTiler::UpdateFrameVolume(Pixel* pixels, tile_t *tile) {
+void CachedTiler::UpdateFrameVolume(vector<Pixel> &pixels, tile_t *tile) {
 
     // Setup start and end points
     vector<unsigned int> start, end;
     start.push_back(0); start.push_back(0); start.push_back(tile->zIndex);
     end.push_back(tile_width_ - 1); end.push_back(tile_height_ - 1); end.push_back(tile->zIndex);
 
-    display_->CopyPixels(pixels, start, end);
+    handoff_.CopyPixels(std::move(pixels), start, end);
 }
 
 
@@ -506,11 +454,11 @@ void CachedTiler::UpdateCoefficientMatrices(size_t x, size_t y, tile_t *tile) {
  * The lists will later be sent in two bulk "packets" to the NDDI display.
  *
  * @param tile The zIndex of the tile will be used to choose the region in the frame volume.
- * @param pixels The array of pixels to use in the update.
+ * @param pixels The pixels to use in the update, which are moved into the list.
  * @param i The new X coordinate of the tile in the tile map.
  * @param i The new Y coordinate of the tile in the tile map.
  */
-void CachedTiler::PushTile(tile_t* tile, Pixel* pixels, size_t i, size_t j) {
+void CachedTiler::PushTile(tile_t* tile, vector<Pixel> &pixels, size_t i, size_t j) {
     PushTile(tile, pixels);
     PushTile(tile, i, j);
 }
@@ -520,9 +468,9 @@ void CachedTiler::PushTile(tile_t* tile, Pixel* pixels, size_t i, size_t j) {
  * The lists will later be sent in two bulk "packets" to the NDDI display.
  *
  * @param tile The zIndex of the tile will be used to choose the region in the frame volume.
- * @param pixels The array of pixels to use in the update.
+ * @param pixels The pixels to use in the update, which are moved into the list.
  */
-void CachedTiler::PushTile(tile_t* tile, Pixel* pixels) {
+void CachedTiler::PushTile(tile_t* tile, vector<Pixel> &pixels) {
     // Create and push the start coordinates
     vector<unsigned int> start;
     start.push_back(0); start.push_back(0); start.push_back(tile->zIndex);
@@ -532,7 +480,7 @@ void CachedTiler::PushTile(tile_t* tile, Pixel* pixels) {
 #endif
     {
         // Push the tile and starts
-        tile_pixels_list.push_back(pixels);
+        tile_pixels_list.push_back(std::move(pixels));
         tile_starts_list.push_back(start);
     }
 }
@@ -9,27 +9,16 @@
  *
  */
 
-#include <map>
-
 #include "PixelBridgeFeatures.h"
 #include "Configuration.h"
+#include "TileCache.h"
+#include "TileFingerprint.h"
 #include "Tiler.h"
 
 
 using namespace std;
 using namespace nddi;
 
-/**
- * This struct holds the checksum of a tile as well as the zIndex into the frame volume
- * when the tile is used in a caching configuration.
- */
-typedef struct {
-    unsigned long  checksum;
-    unsigned long  age;
-    size_t         zIndex;
-} tile_t;
-
-
 /**
  * This tiler will split provided frames into tiles and update the NDDI display. It organizes the
  * display into dimensions matching the tile size in the x and y directions and then the cache size
@@ -74,38 +63,49 @@ public:
 private:
 
     void InitializeCoefficientPlanes();
+    void ExtractTile(uint8_t* buffer, size_t width, size_t i_tile_map, size_t j_tile_map, vector<Pixel> &pixels);
     tile_t* IsTileInCache(unsigned long checksum);
     bool IsTileInUse(tile_t *);
-    tile_t* GetExpiredCacheTile();
+    tile_t* GetExpiredCacheTile(unsigned long checksum);
 #ifndef USE_COPY_PIXEL_TILES
-    void UpdateFrameVolume(Pixel* pixels, tile_t* tile);
+    void UpdateFrameVolume(vector<Pixel> &pixels, tile_t* tile);
     void UpdateCoefficientMatrices(size_t x, size_t y, tile_t* tile);
 #else
-    void PushTile(tile_t* tile, Pixel* pixels, size_t i, size_t j);
-    void PushTile(tile_t* tile, Pixel* pixels);
+    void PushTile(tile_t* tile, vector<Pixel> &pixels, size_t i, size_t j);
+    void PushTile(tile_t* tile, vector<Pixel> &pixels);
     void PushTile(tile_t* tile, size_t i, size_t j);
 #endif
 
     NDimensionalDisplayInterface*               display_;
+    PayloadHandoff                 handoff_;
     size_t                         display_width_, display_height_;
     size_t                         tile_width_, tile_height_, max_tiles_;
     size_t                         tile_map_width_, tile_map_height_;
     size_t                         bits_;
     bool                           quiet_;
 
-    // Maps checksums to tiles. This map is non-decreasing until max_tiles. When a tile is ejected,
-    // the tile_t struct is not freed, it's simply update. The old checksum mapping is removed and a new one
-    // is added.
-    map<unsigned long, tile_t*>    cache_map_;
+    // Maps checksums to tiles. The cache grows until max_tiles. When a tile is ejected, its tile_t is simply
+    // given the new checksum.
+    TileCache                      cache_;
 
-    // Maps age counter to tiles. This map is non-decreasing until max_tiles. When a tile is ejected,
-    // we find the oldest one here and remove the mapping. Once the cache_map_ is updated, it's likely
-    // that the same tile_t will be mapped in here with a new age.
-    map<unsigned long, tile_t*>    age_map_;
+    // Fingerprints every tile of a frame before the tiles are looked up in the cache
+    TileFingerprinter              fingerprinter_;
+    vector<unsigned long>          fingerprints_;
 
     // Age counter increments for every tile processed
     unsigned long                  age_counter_;
 
+    // A tile of the frame which needs its pixels or coefficients sent to the display
+    typedef struct {
+        size_t          i, j;
+        tile_t         *tile;
+        bool            sendPixels, sendCoefficients;
+        vector<Pixel>   pixels;
+    } tile_update_t;
+
+    // The updates decided for the current frame, in the order they're sent. Entries past the current frame's are spares.
+    vector<tile_update_t>          updates_;
+
     // Maps display regions to tiles.
     vector<vector<tile_t*> >       display_map_;
 
@@ -113,7 +113,8 @@ private:
     int                            unchanged_tiles_, cache_hits_, cache_misses_;
 
 #ifdef USE_COPY_PIXEL_TILES
-    vector<Pixel *>                tile_pixels_list;
+    vector<vector<Pixel> >         tile_pixels_list;
+    vector<vector<Pixel> >         tile_pixels_spare_;
     vector<vector<unsigned int> >  tile_starts_list;
 
     vector<int>                    coefficients_list;
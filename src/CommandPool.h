@@ -0,0 +1,175 @@
+#ifndef COMMAND_POOL_H
+#define COMMAND_POOL_H
+
+/**
+ * \file CommandPool.h
+ *
+ * \brief This file embodies per-type pools of command messages shared by a producer and a consumer thread.
+ *
+ * This file embodies per-type pools of command messages shared by a producer and a consumer thread.
+ * The recorder and player each hand messages from one thread to another, which used to mean one
+ * allocation and one free per command plus reallocating every payload vector. Messages are now handed
+ * back once they've been written or played and reused for the next command of the same type, so their
+ * payload vectors keep their capacity and only need reallocating when a payload outgrows them.
+ */
+
+#include <iostream>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include "NddiCommands.h"
+#include "SpscRing.h"
+
+namespace nddi {
+
+    /**
+     * \brief Deletes a command through its own type so its payload vectors are freed too.
+     */
+    static inline void deleteCommand(NddiCommandMessage* msg) {
+        switch (msg->id) {
+        #define GENERATE_DELETE_CASE(m) \
+        case id ## m : \
+            delete (m ## CommandMessage*)msg; \
+            break;
+        NDDI_COMMAND_LIST(GENERATE_DELETE_CASE)
+        case idEOT:
+        default:
+            delete msg;
+            break;
+        }
+    }
+
+    ///\cond
+    template <class T> struct CommandTraits;
+    #define GENERATE_TRAITS(m) \
+    template <> struct CommandTraits<m ## CommandMessage> { static const CommandID id = id ## m; };
+    NDDI_COMMAND_LIST(GENERATE_TRAITS)
+    ///\endcond
+
+    /**
+     * \brief Per-type pools of command messages.
+     *
+     * Per-type pools of command messages. The producer thread creates messages with Create() or Acquire()
+     * and the consumer thread hands them back with Release() once it's done with them. Released messages
+     * travel back through a ring, so the per-type free lists are only ever touched by the producer.
+     */
+    class CommandPool {
+    public:
+        /**
+         * \brief Creates a pool.
+         *
+         * Creates a pool.
+         * @param capacity The maximum number of messages waiting to be recycled, and kept on each free list.
+         *                 Messages beyond that are deleted instead.
+         */
+        CommandPool(size_t capacity)
+        : returned_(capacity),
+          capacity_(capacity),
+          acquired_(0),
+          allocated_(0),
+          frames_(0) {
+        }
+
+        ~CommandPool() {
+            drain();
+            for (size_t i = 0; i < idCommandCount; i++) {
+                for (size_t j = 0; j < free_[i].size(); j++) {
+                    deleteCommand(free_[i][j]);
+                }
+            }
+        }
+
+        /**
+         * \brief Takes a recycled message of the given type, or allocates one. Called by the producer.
+         *
+         * Takes a recycled message of the given type, or allocates one. Called by the producer. The
+         * message's fields hold whatever they held when it was released.
+         */
+        template <class T>
+        T* Acquire() {
+            const CommandID id = CommandTraits<T>::id;
+            acquired_++;
+            if (id == idLatch) {
+                frames_++;
+            }
+
+            if (free_[id].empty()) {
+                drain();
+            }
+            if (free_[id].empty()) {
+                allocated_++;
+                return new T();
+            }
+
+            T* msg = (T*)free_[id].back();
+            free_[id].pop_back();
+            msg->timestamp = 0;
+            return msg;
+        }
+
+        /**
+         * \brief Takes a recycled message of the given type and assigns it the given arguments. Called by the producer.
+         */
+        template <class T, class... Args>
+        T* Create(Args&&... args) {
+            T* msg = Acquire<T>();
+            msg->assign(std::forward<Args>(args)...);
+            return msg;
+        }
+
+        /**
+         * \brief Makes a message the producer didn't hand off available to it again. Called by the producer.
+         */
+        void Recycle(NddiCommandMessage* msg) {
+            if (free_[msg->id].size() < capacity_) {
+                free_[msg->id].push_back(msg);
+            } else {
+                deleteCommand(msg);
+            }
+        }
+
+        /**
+         * \brief Hands a message back once it's been written or played. Called by the consumer.
+         */
+        void Release(NddiCommandMessage* msg) {
+            if (!returned_.TryPush(msg)) {
+                deleteCommand(msg);
+            }
+        }
+
+        /**
+         * \brief Prints the number of messages allocated per frame with and without pooling.
+         *
+         * Prints the number of messages allocated per frame with and without pooling. Without pooling,
+         * every command acquired was an allocation.
+         * @param name The name of the thread the pool is serving, e.g. "Recorder".
+         */
+        void Report(const char* name) {
+            if (!frames_) {
+                return;
+            }
+            std::cout << name << " allocated " << (double)acquired_ / frames_ << " messages per frame before pooling and "
+                      << (double)allocated_ / frames_ << " after, over " << frames_ << " frames." << std::endl;
+        }
+
+    private:
+        // Moves released messages onto the free lists.
+        void drain() {
+            NddiCommandMessage* msg;
+            while (returned_.TryPop(msg)) {
+                Recycle(msg);
+            }
+        }
+
+        SpscRing<NddiCommandMessage*>  returned_;
+        std::vector<NddiCommandMessage*> free_[idCommandCount];
+        size_t                         capacity_;
+        uint64_t                       acquired_;
+        uint64_t                       allocated_;
+        uint64_t                       frames_;
+    };
+
+}
+
+#endif // COMMAND_POOL_H
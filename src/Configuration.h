@@ -23,7 +23,8 @@ typedef enum {
     FLAT,   // Tiled, but not cached
     CACHE,  // Tiled and cached
     DCT,    // 8x8 Macroblocks and DCT coefficients
-    IT      // 4x4 Macroblocks and integer transform coefficients
+    IT,     // 4x4 Macroblocks and integer transform coefficients
+    MOTION  // Tiled, with tiles moved to matching blocks already in the frame volume
 } tiler_t;
 
 typedef enum {
@@ -77,9 +78,25 @@ public:
     bool dctSnap;
     bool dctTrim;
     string recordFile = {};
+    string recordCompression;
+    size_t recordBlockSize;
     bool isSlave;
     size_t sub_x, sub_y, sub_w, sub_h;
     size_t scale;
+    size_t shmSize;
+    string compression;
+    vector< pair<string, size_t> > compressionThresholds;
+    size_t wireFormat;
+    bool scalerQuantization;
+    string fingerprint;
+    size_t threads;
+    string eviction;
+    size_t motionSearch;
+    size_t motionThreshold;
+    size_t motionSlices;
+    size_t scrollSearch;
+    bool dirtyRects;
+    size_t dirtyMergeCost;
 
 
 public:
@@ -113,6 +130,21 @@ public:
         isSlave = false;
         sub_x = sub_y = sub_w = sub_h = 0;
         scale = 1;
+        shmSize = 0;
+        compression = "none";
+        wireFormat = 1;
+        scalerQuantization = false;
+        fingerprint = "xxh64";
+        threads = 0;
+        eviction = "lru";
+        motionSearch = 8;
+        motionThreshold = 2;
+        motionSlices = 4;
+        scrollSearch = 0;
+        dirtyRects = false;
+        dirtyMergeCost = 0;
+        recordCompression = "none";
+        recordBlockSize = 1024;
     }
 
     void clearDctScales() {
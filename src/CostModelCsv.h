@@ -0,0 +1,61 @@
+#ifndef COST_MODEL_CSV_H
+#define COST_MODEL_CSV_H
+
+/**
+ * \file CostModelCsv.h
+ *
+ * \brief This file embodies the CSV summary of a display's cost model.
+ *
+ * This file embodies the CSV summary of a display's cost model. The NDDI Wall Server prints it when it
+ * shuts down and the headless replay prints it for each recording, so both produce the same columns.
+ */
+
+#include <ostream>
+
+#include "nddi/CostModel.h"
+
+namespace nddi {
+
+    /**
+     * \brief Writes the CSV headings.
+     */
+    static inline void outputCostCsvHeadings(std::ostream &os) {
+        os << "Frames,Commands Sent,Bytes Transmitted,IV Num Reads,IV Bytes Read,IV Num Writes,IV Bytes Written,CP Num Reads,CP Bytes Read,CP Num Writes,CP Bytes Written,FV Num Reads,FV Bytes Read,FV Num Writes,FV Bytes Written,FV Time,Pixels Mapped,Pixels Blended";
+    }
+
+    /**
+     * \brief Writes a CSV row summarizing the cost model.
+     *
+     * Writes a CSV row summarizing the cost model.
+     * @param os The stream to write to.
+     * @param costModel The display's cost model.
+     * @param frames The number of frames rendered.
+     * @param linkSavings Bytes the link didn't carry which the display charged for, e.g. scalers sent as quantized levels.
+     * @param commandSavings Commands the link didn't carry which the display charged for, e.g. the tiles of a tiled matrix.
+     */
+    static inline void outputCostCsv(std::ostream &os, CostModel* costModel, long frames, long linkSavings = 0,
+                                     long commandSavings = 0) {
+        os
+        << frames << " , "
+        << costModel->getLinkCommandsSent() - commandSavings << " , "
+        << costModel->getLinkBytesTransmitted() - linkSavings << " , "
+        << costModel->getReadAccessCount(INPUT_VECTOR_COMPONENT) << " , "
+        << costModel->getBytesRead(INPUT_VECTOR_COMPONENT) << " , "
+        << costModel->getWriteAccessCount(INPUT_VECTOR_COMPONENT) << " , "
+        << costModel->getBytesWritten(INPUT_VECTOR_COMPONENT) << " , "
+        << costModel->getReadAccessCount(COEFFICIENT_PLANE_COMPONENT) << " , "
+        << costModel->getBytesRead(COEFFICIENT_PLANE_COMPONENT) << " , "
+        << costModel->getWriteAccessCount(COEFFICIENT_PLANE_COMPONENT) << " , "
+        << costModel->getBytesWritten(COEFFICIENT_PLANE_COMPONENT) << " , "
+        << costModel->getReadAccessCount(FRAME_VOLUME_COMPONENT) << " , "
+        << costModel->getBytesRead(FRAME_VOLUME_COMPONENT) << " , "
+        << costModel->getWriteAccessCount(FRAME_VOLUME_COMPONENT) << " , "
+        << costModel->getBytesWritten(FRAME_VOLUME_COMPONENT) << " , "
+        << costModel->getTime(FRAME_VOLUME_COMPONENT) << " , "
+        << costModel->getPixelsMapped() << " , "
+        << costModel->getPixelsBlended() << " , ";
+    }
+
+}
+
+#endif // COST_MODEL_CSV_H
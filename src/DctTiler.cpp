@@ -131,6 +131,7 @@ DctTiler::DctTiler (size_t display_width, size_t display_height,
             display_ = new GrpcNddiDisplay();
         }
     }
+    handoff_.Attach(display_);
 
     /* Set the full scaler value and the sign mode */
     display_->SetFullScaler(MAX_DCT_COEFF);
@@ -142,6 +143,7 @@ DctTiler::DctTiler (size_t display_width, size_t display_height,
      */
     initZigZag();
     initQuantizationMatrix(quality);
+    registerScalerQuantizer(file);
 
     /* Initialize Input Vector */
     vector<int> iv;
@@ -246,6 +248,22 @@ void DctTiler::initQuantizationMatrix(size_t quality) {
     }
 }
 
+/*
+ * Registers the quantization matrix in zig-zag order with the display, so that a stack of de-quantized
+ * coefficients can be sent as the quantized levels. Only the GrpcNddiDisplay sends stacks that way.
+ */
+void DctTiler::registerScalerQuantizer(string file) {
+    if (file.length() || !globalConfiguration.scalerQuantization) {
+        return;
+    }
+
+    vector<uint32_t> divisors(BLOCK_SIZE, 1);
+    for (size_t matPos = 0; matPos < BLOCK_SIZE; matPos++) {
+        divisors[zigZag_[matPos]] = quantizationMatrix_[matPos];
+    }
+    ((GrpcNddiDisplay*)display_)->RegisterScalerQuantizer(divisors);
+}
+
 /**
  * Initializes the Coefficient Planes for this tiler. The coefficient matrices
  * for each plane will pick a plane from the frame volume.
@@ -266,27 +284,23 @@ void DctTiler::InitializeCoefficientPlanes() {
     start.push_back(0); start.push_back(0); start.push_back(0);
     end.push_back(0); end.push_back(0); end.push_back(0);
 
-    // Break the display into macroblocks and initialize each cube of coefficients to pick out the proper block from the frame volume
-    for (int j = 0; j < displayTilesHigh_; j++) {
-        for (int i = 0; i < displayTilesWide_; i++) {
-            coeffs[2][0] = -i * scaled_block_width_ + fv_tx_offset_;
-            coeffs[2][1] = -j * scaled_block_height_;
-            start[0] = i * scaled_block_width_; start[1] = j * scaled_block_height_; start[2] = 0;
-            end[0] = (i + 1) * scaled_block_width_ - 1; end[1] = (j + 1) * scaled_block_height_ - 1; end[2] = FRAMEVOLUME_DEPTH - 1;
-            end[2] = FRAMEVOLUME_DEPTH - 1;
-            if (end[0] >= display_width_) { end[0] = display_width_ - 1; }
-            if (end[1] >= display_height_) { end[1] = display_height_ - 1; }
-            if (globalConfiguration.isSlave) {
-                start[0] += globalConfiguration.sub_x;
-                start[1] += globalConfiguration.sub_y;
-                end[0] += globalConfiguration.sub_x;
-                end[1] += globalConfiguration.sub_y;
-                coeffs[2][0] -= globalConfiguration.sub_x;
-                coeffs[2][1] -= globalConfiguration.sub_y;
-            }
-            display_->FillCoefficientMatrix(coeffs, start, end);
-        }
+    // Break the display into macroblocks and initialize each cube of coefficients to pick out the proper block from the frame volume.
+    // The display derives each macroblock's translation from the first one's.
+    vector<unsigned int> size;
+    size.push_back(scaled_block_width_); size.push_back(scaled_block_height_);
+    coeffs[2][0] = fv_tx_offset_;
+    coeffs[2][1] = 0;
+    end[0] = display_width_ - 1; end[1] = display_height_ - 1; end[2] = FRAMEVOLUME_DEPTH - 1;
+    if (globalConfiguration.isSlave) {
+        start[0] += globalConfiguration.sub_x;
+        start[1] += globalConfiguration.sub_y;
+        end[0] += globalConfiguration.sub_x;
+        end[1] += globalConfiguration.sub_y;
+        coeffs[2][0] -= globalConfiguration.sub_x;
+        coeffs[2][1] -= globalConfiguration.sub_y;
     }
+    fillCoefficientMatrixTiled(display_, coeffs, start, end, size);
+
     // Finish up by setting the proper k for every plane
     start[0] = 0; start[1] = 0;
     end[0] = display_width_ - 1; end[1] = display_height_ - 1;
@@ -536,7 +550,7 @@ void DctTiler::UpdateDisplay(uint8_t* buffer, size_t width, size_t height)
                 start[1] += globalConfiguration.sub_y;
             }
 #pragma omp critical
-            display_->FillScalerTileStack(coefficients, start, size);
+            handoff_.FillScalerTileStack(std::move(coefficients), start, size);
         }
     }
 }
@@ -65,11 +65,13 @@ protected:
     void InitializeFrameVolume();
     void initZigZag();
     void initQuantizationMatrix(size_t quality);
+    void registerScalerQuantizer(string file);
 
 protected:
     static const size_t  MAX_DCT_COEFF = 256;
 
     NDimensionalDisplayInterface     *display_;
+    PayloadHandoff       handoff_;
     size_t               display_width_, display_height_;
     size_t               scale_;
     bool                 quiet_;
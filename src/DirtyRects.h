@@ -0,0 +1,236 @@
+#ifndef DIRTY_RECTS_H
+#define DIRTY_RECTS_H
+
+/**
+ * \file DirtyRects.h
+ *
+ * \brief This file embodies the merging of the changed cells of a frame into a few rectangles.
+ *
+ * This file embodies the merging of the changed cells of a frame into a few rectangles. The frame is divided
+ * into a grid of cells (the tiles of the FlatTiler, for instance), and a mask marks the cells which changed.
+ * Each rectangle is then sent with one CopyPixels command. Every command has a fixed cost beyond its pixels,
+ * so two rectangles are merged whenever the unchanged cells their bounding box would add cost less to send
+ * than the extra command. That cost is given as a number of pixels. Zero only merges rectangles which touch
+ * exactly, and a cost as large as the frame sends the bounding box of all the changes.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+namespace nddi {
+
+    /**
+     * \brief A rectangle of cells, from (x0, y0) to (x1, y1) inclusive.
+     */
+    typedef struct {
+        size_t      x0, y0;
+        size_t      x1, y1;
+    } dirty_rect_t;
+
+    /**
+     * \brief Tracks the rectangles and pixels sent versus the time spent finding and extracting them.
+     */
+    typedef struct {
+        long        frames;
+        long        rects;
+        long        pixels;
+        long        usecs;
+    } dirty_stats_t;
+
+    /**
+     * \brief Marks the cells of a frame which differ from the last one.
+     *
+     * Marks the cells of a frame which differ from the last one. The frames are walked a row at a time so that
+     * they're read sequentially, and once a cell is marked its remaining rows aren't compared.
+     * @param before The RGB24 frame which was last sent.
+     * @param before_width The width of that frame in pixels.
+     * @param after The new RGB24 frame.
+     * @param after_width The width of the new frame in pixels, which may be wider than the region compared.
+     * @param width The width of the region compared.
+     * @param height The height of the region compared.
+     * @param cell_width The width of each cell.
+     * @param cell_height The height of each cell.
+     * @param mask Receives a byte per cell, in rows, which is set if the cell changed.
+     * @return The number of cells which changed.
+     */
+    static inline size_t changedCells(const uint8_t* before, size_t before_width,
+                                      const uint8_t* after, size_t after_width,
+                                      size_t width, size_t height,
+                                      size_t cell_width, size_t cell_height,
+                                      std::vector<uint8_t> &mask) {
+        size_t columns = (width + cell_width - 1) / cell_width;
+        size_t rows = (height + cell_height - 1) / cell_height;
+        size_t changed = 0;
+
+        mask.assign(columns * rows, 0);
+        for (size_t y = 0; y < height; y++) {
+            const uint8_t* b = before + 3 * y * before_width;
+            const uint8_t* a = after + 3 * y * after_width;
+            uint8_t* m = &mask[(y / cell_height) * columns];
+            for (size_t i = 0; i < columns; i++) {
+                size_t x = i * cell_width;
+                size_t w = (x + cell_width <= width) ? cell_width : width - x;
+                if (!m[i] && memcmp(b + 3 * x, a + 3 * x, 3 * w)) {
+                    m[i] = 1;
+                    changed++;
+                }
+            }
+        }
+
+        return changed;
+    }
+
+    /**
+     * \brief Merges a mask of changed cells into rectangles.
+     */
+    class DirtyRectMerger {
+
+    public:
+        /** The most rectangles the rows are merged into for which any two are still compared. */
+        static const size_t MAX_PAIRWISE_RECTS = 256;
+
+        /**
+         * \brief Creates a merger for the given cost of a command.
+         *
+         * Creates a merger for the given cost of a command.
+         * @param merge_cost The number of unchanged pixels which cost as much to send as one more command.
+         * @param cell_pixels The number of pixels in each cell.
+         */
+        DirtyRectMerger(size_t merge_cost, size_t cell_pixels)
+        : merge_cost_(merge_cost),
+          cell_pixels_(cell_pixels ? cell_pixels : 1) {
+        }
+
+        /**
+         * \brief Merges the changed cells into rectangles.
+         *
+         * Merges the changed cells into rectangles. Each row is first split into runs of changed cells, with gaps
+         * that are cheaper to send than a command closed up. Each run is then added to the rectangle above it
+         * which it wastes the fewest cells on, if that's cheaper than starting a new rectangle. Finally, any two
+         * rectangles which are cheaper to send as their bounding box are merged, which also merges rectangles
+         * that overlap. That step compares every pair, so it's skipped when there are more than MAX_PAIRWISE_RECTS
+         * rectangles. Every changed cell is covered by at least one rectangle.
+         * @param mask A byte per cell, in rows, which is set if the cell changed.
+         * @param columns The number of cells in each row.
+         * @param rows The number of rows of cells.
+         * @param rects Receives the rectangles.
+         */
+        void Merge(const std::vector<uint8_t> &mask, size_t columns, size_t rows, std::vector<dirty_rect_t> &rects) {
+            rects.clear();
+            open_.clear();
+
+            for (size_t y = 0; y < rows; y++) {
+                const uint8_t* m = &mask[y * columns];
+
+                // Split the row into runs, closing up cheap gaps
+                runs_.clear();
+                for (size_t x = 0; x < columns; x++) {
+                    if (!m[x]) {
+                        continue;
+                    }
+                    if (!runs_.empty() && (Waste(x - runs_.back().x1 - 1) <= (long)merge_cost_)) {
+                        runs_.back().x1 = x;
+                    } else {
+                        dirty_rect_t run = {x, y, x, y};
+                        runs_.push_back(run);
+                    }
+                }
+
+                // Add each run to the rectangle above which it wastes the fewest cells on, or start a new one
+                next_open_.clear();
+                for (size_t r = 0; r < runs_.size(); r++) {
+                    size_t best = rects.size();
+                    long best_waste = 0;
+                    for (size_t k = 0; k < open_.size(); k++) {
+                        long waste = Waste(Union(rects[open_[k]], runs_[r]), rects[open_[k]], runs_[r]);
+                        if ((waste <= (long)merge_cost_) && ((best == rects.size()) || (waste < best_waste))) {
+                            best = open_[k];
+                            best_waste = waste;
+                        }
+                    }
+                    if (best < rects.size()) {
+                        rects[best] = Union(rects[best], runs_[r]);
+                    } else {
+                        rects.push_back(runs_[r]);
+                    }
+                    if (std::find(next_open_.begin(), next_open_.end(), best) == next_open_.end()) {
+                        next_open_.push_back(best);
+                    }
+                }
+                open_.swap(next_open_);
+            }
+
+            // A frame scattered with that many rectangles gains little from merging them, so they're sent as they are
+            if (rects.size() > MAX_PAIRWISE_RECTS) {
+                return;
+            }
+
+            // Merge any two rectangles which are cheaper to send as one, until none are. Each rectangle absorbs all
+            // it can, and only the one which grew needs comparing with the rest again, so each merge costs a scan.
+            merged_.assign(rects.size(), 0);
+            for (size_t i = 0; i < rects.size(); i++) {
+                if (merged_[i]) {
+                    continue;
+                }
+                for (size_t j = 0; j < rects.size(); j++) {
+                    if ((j == i) || merged_[j]) {
+                        continue;
+                    }
+                    dirty_rect_t u = Union(rects[i], rects[j]);
+                    if (Waste(u, rects[i], rects[j]) <= (long)merge_cost_) {
+                        rects[i] = u;
+                        merged_[j] = 1;
+                        j = (size_t)-1;
+                    }
+                }
+            }
+            size_t kept = 0;
+            for (size_t i = 0; i < rects.size(); i++) {
+                if (!merged_[i]) {
+                    rects[kept++] = rects[i];
+                }
+            }
+            rects.resize(kept);
+        }
+
+    private:
+        static dirty_rect_t Union(const dirty_rect_t &a, const dirty_rect_t &b) {
+            dirty_rect_t u;
+            u.x0 = (a.x0 < b.x0) ? a.x0 : b.x0;
+            u.y0 = (a.y0 < b.y0) ? a.y0 : b.y0;
+            u.x1 = (a.x1 > b.x1) ? a.x1 : b.x1;
+            u.y1 = (a.y1 > b.y1) ? a.y1 : b.y1;
+            return u;
+        }
+
+        static long Area(const dirty_rect_t &r) {
+            return (long)((r.x1 - r.x0 + 1) * (r.y1 - r.y0 + 1));
+        }
+
+        // The pixels of the given number of cells
+        long Waste(size_t cells) {
+            return (long)(cells * cell_pixels_);
+        }
+
+        // The pixels sending u costs beyond sending a and b, which is negative when they overlap
+        long Waste(const dirty_rect_t &u, const dirty_rect_t &a, const dirty_rect_t &b) {
+            return (Area(u) - Area(a) - Area(b)) * (long)cell_pixels_;
+        }
+
+        size_t                     merge_cost_;
+        size_t                     cell_pixels_;
+
+        // The runs of the current row, and the rectangles which reach the previous and current rows
+        std::vector<dirty_rect_t>  runs_;
+        std::vector<size_t>        open_, next_open_;
+
+        // Whether each rectangle has been merged into another
+        std::vector<uint8_t>       merged_;
+    };
+
+} // namespace nddi
+
+#endif // DIRTY_RECTS_H
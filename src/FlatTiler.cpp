@@ -8,11 +8,13 @@
  */
 
 #include <iostream>
-#include <zlib.h>
+#include <string.h>
+#include <sys/time.h>
 
 #include "PixelBridgeFeatures.h"
 #include "Configuration.h"
 #include "FlatTiler.h"
+#include "PixelConvert.h"
 
 
 /**
@@ -27,7 +29,12 @@ FlatTiler::FlatTiler (size_t display_width, size_t display_height,
   display_height_(display_height),
   tile_width_(tile_width),
   tile_height_(tile_height),
-  bits_(bits)
+  bits_(bits),
+  fingerprinter_(fingerprintByName(globalConfiguration.fingerprint), bits,
+                 tile_width, tile_height, display_width, display_height, false),
+  scroll_(globalConfiguration.scrollSearch, 2 * tile_width),
+  send_rects_(globalConfiguration.dirtyRects),
+  dirty_(globalConfiguration.dirtyMergeCost, tile_width * tile_height)
 {
     quiet_ = !globalConfiguration.verbose;
 
@@ -55,6 +62,7 @@ FlatTiler::FlatTiler (size_t display_width, size_t display_height,
             display_ = new GrpcNddiDisplay();
         }
    }
+    handoff_.Attach(display_);
 
     // Compute tile_map width
     tile_map_width_ = display_width_ / tile_width;
@@ -74,6 +82,13 @@ FlatTiler::FlatTiler (size_t display_width, size_t display_height,
 
     // Set tile update count to zero
     unchanged_tiles_ = tile_updates_ = 0;
+    scrolled_tiles_ = scroll_copies_ = 0;
+    dirty_stats_.frames = dirty_stats_.rects = dirty_stats_.pixels = dirty_stats_.usecs = 0;
+
+    // Scrolling is found by comparing frames with a copy of the frame volume, which starts out white
+    if (globalConfiguration.scrollSearch) {
+        mirror_.assign(display_width_ * display_height_ * 3, 0xff);
+    }
 
     // Not Input Vector Initialization required
 
@@ -134,141 +149,334 @@ void FlatTiler::UpdateDisplay(uint8_t* buffer, size_t width, size_t height)
 {
     int                            unchanged = 0;
     int                            updates = 0;
-    unsigned char                  mask = 0xff << (8 - bits_);
-    Pixel                         *tile_pixels = NULL;
-    Pixel                         *tile_pixels_sig_bits = NULL;
 #ifdef USE_COPY_PIXEL_TILES
-    vector<Pixel *>                tiles;
+    vector<vector<Pixel> >         tiles;
     vector<vector<unsigned int> >  starts;
+#else
+    vector<vector<Pixel> >        &tiles = tile_pixels_;
 #endif
 
     assert(width >= display_width_);
     assert(height >= display_height_);
 
-    // Break up the passed in buffer into one tile at a time
+    // Fingerprint every tile up front. Pixels are only copied out of the buffer for tiles that changed.
+    fingerprinter_.FingerprintFrame(buffer, width, fingerprints_);
+
+    // Shift the regions which scrolled within the frame volume, which updates the tile map for them
+    if (!mirror_.empty()) {
+        ScrollRegions(buffer, width);
+    }
+
+    // Compare each tile with the tile map, noting the ones that changed in order
+    changed_.clear();
     for (int j_tile_map = 0; j_tile_map < tile_map_height_; j_tile_map++) {
         for (int i_tile_map = 0; i_tile_map < tile_map_width_; i_tile_map++) {
-            // Initialize a tile's checksum
-            unsigned long tile_checksum = 0L;
+            // The fingerprint computed for this tile
+            unsigned long tile_checksum = fingerprints_[j_tile_map * tile_map_width_ + i_tile_map];
 
-            // Use locals for this tile's width and height in case they need to be adjust at the edges
-            int tw = tile_width_, th = tile_height_;
-            if (i_tile_map == (tile_map_width_ - 1)) {
-                tw -= tile_map_width_ * tile_width_ - display_width_;
-            }
-            if (j_tile_map == (tile_map_height_ - 1)) {
-                th -= tile_map_height_ * tile_height_ - display_height_;
+            // If the checksum in the tile map doesn't match, then update the frame volume
+            if (tile_map_[i_tile_map][j_tile_map] != tile_checksum) {
+                tile_map_[i_tile_map][j_tile_map] = tile_checksum;
+                changed_.push_back(j_tile_map * tile_map_width_ + i_tile_map);
+                updates++;
+            } else {
+                unchanged++;
             }
+        }
+    }
 
-            // Allocate tiles is necessary. Sometimes they're re-used.
-            if (!tile_pixels)
-                tile_pixels = (Pixel*)malloc(tw * th * sizeof(Pixel));
-            if (!tile_pixels_sig_bits)
-                tile_pixels_sig_bits = (Pixel*)malloc(tw * th * sizeof(Pixel));
+    // Send the changed tiles as a few rectangles, or each on its own
+    if (send_rects_) {
+        SendRects(buffer, width);
+    } else {
+        // Allocate tiles is necessary. Sometimes they're re-used.
+#ifdef USE_COPY_PIXEL_TILES
+        tiles.resize(changed_.size());
+        for (size_t k = 0; k < changed_.size() && !tile_pixels_spare_.empty(); k++) {
+            tiles[k].swap(tile_pixels_spare_.back());
+            tile_pixels_spare_.pop_back();
+        }
+#else
+        if (tiles.size() < changed_.size()) {
+            tiles.resize(changed_.size());
+        }
+#endif
 
-            // Build the tile's pixel array while computing the checksum in an alternative tile which only
-            // holds the significant bits
+        // Copy the changed tiles out of the buffer. Tiles are independent, so they're split between threads.
 #ifdef USE_OMP
-#pragma omp parallel for ordered
+#pragma omp parallel for schedule(dynamic, 64)
 #endif
-            for (int j_tile = 0; j_tile < th; j_tile++) {
-                // Compute the offset into the RGB buffer for this row in this tile
-                int bufferOffset = 3 * ((j_tile_map * tile_height_ + j_tile) * width + (i_tile_map * tile_width_));
-
-                for (int i_tile = 0; i_tile < tw; i_tile++) {
-                    Pixel p, psb;
-
-                    p.r = buffer[bufferOffset++];
-                    p.g = buffer[bufferOffset++];
-                    p.b = buffer[bufferOffset++];
-                    p.a = 0xff;
-                    tile_pixels[j_tile * tw + i_tile].packed = p.packed;
-
-                    psb.r = p.r & mask;
-                    psb.g = p.g & mask;
-                    psb.b = p.b & mask;
-                    psb.a = p.a & mask;
-                    tile_pixels_sig_bits[j_tile * tw + i_tile].packed = psb.packed;
-                }
+        for (long k = 0; k < (long)changed_.size(); k++) {
+            ExtractTile(buffer, width, changed_[k] % tile_map_width_, changed_[k] / tile_map_width_, tiles[k]);
+        }
+
+#ifdef USE_COPY_PIXEL_TILES
+        // If any tiles were updated
+        if (updates > 0) {
+
+            // Create the start coordinates
+            for (size_t k = 0; k < changed_.size(); k++) {
+                vector<unsigned int> start;
+                start.push_back((changed_[k] % tile_map_width_) * tile_width_);
+                start.push_back((changed_[k] / tile_map_width_) * tile_height_);
+                starts.push_back(start);
             }
 
-#if (CHECKSUM_CALCULATOR == TRIVIAL)
-            tile_checksum  = (unsigned long)tile_pixels_sig_bits[0].packed << 32;
-            tile_checksum |= (unsigned long)tile_pixels_sig_bits[tw * th - 1].packed;
+            // Update the Frame Volume by copying the tiles over
+            vector<unsigned int> size;
+            size.push_back(tile_width_); size.push_back(tile_height_);
+            handoff_.CopyPixelTiles(std::move(tiles), starts, size);
+
+            // Keep whatever tiles the display handed back for the next frame
+            for (size_t i = 0; i < tiles.size(); i++) {
+                tile_pixels_spare_.push_back(std::move(tiles[i]));
+            }
+            tiles.clear();
+        }
 #else
-            unsigned long crc = crc32(0L, Z_NULL, 0);
-#if (CHECKSUM_CALCULATOR == CRC)
-            tile_checksum = crc32(crc, (unsigned char*)tile_pixels_sig_bits, tw * th * sizeof(Pixel));
-#elif (CHECKSUM_CALCULATOR == ADLER)
-            tile_checksum = adler32(crc, (unsigned char*)tile_pixels_sig_bits, tw * th * sizeof(Pixel));
-#endif
+        // Send the tiles in order, so the commands are the same however many threads there are
+        for (size_t k = 0; k < changed_.size(); k++) {
+            UpdateFrameVolume(tiles[k], changed_[k] % tile_map_width_, changed_[k] / tile_map_width_);
+        }
 #endif
+    }
 
-            // If the checksum in the tile map doesn't match, then update the frame volume
-            if (tile_map_[i_tile_map][j_tile_map] != tile_checksum) {
+    // Report update statistics
+    unchanged_tiles_ += unchanged;
+    tile_updates_ += updates;
 
-                tile_map_[i_tile_map][j_tile_map] = tile_checksum;
-#ifdef USE_COPY_PIXEL_TILES
-                // Push the tile
-                tiles.push_back(tile_pixels);
+    if (!quiet_) {
+        cout << "Flat Tiling Statistics:" << endl << "  unchanged tiles: " << unchanged_tiles_ << " tiles updated: " << tile_updates_ << endl;
+    }
+}
 
-                // Force new tile to be allocated. This one will be freed after it's copied
-                tile_pixels = NULL;
+/**
+ * Copies one tile out of the RGB buffer into an array of pixels. The tiles in the last column and row
+ * are cut short at the edge of the display. This is called from several threads at once, so it only
+ * touches the array passed in.
+ *
+ * @param buffer Pointer to an RGB buffer
+ * @param width The width of the RGB buffer
+ * @param i_tile_map The column of the tile
+ * @param j_tile_map The row of the tile
+ * @param pixels Receives the tile's pixels
+ */
+void FlatTiler::ExtractTile(uint8_t* buffer, size_t width, size_t i_tile_map, size_t j_tile_map, vector<Pixel> &pixels) {
 
-                // Create and push the start coordinates
-                vector<unsigned int> start;
-                start.push_back(i_tile_map * tile_width_); start.push_back(j_tile_map * tile_height_);
-                starts.push_back(start);
+    // Use locals for this tile's width and height in case they need to be adjust at the edges
+    size_t tw = tile_width_, th = tile_height_;
+    if (i_tile_map == (tile_map_width_ - 1)) {
+        tw -= tile_map_width_ * tile_width_ - display_width_;
+    }
+    if (j_tile_map == (tile_map_height_ - 1)) {
+        th -= tile_map_height_ * tile_height_ - display_height_;
+    }
 
-#else
-                UpdateFrameVolume(tile_pixels, i_tile_map, j_tile_map);
-#endif
+    ExtractRegion(buffer, width, i_tile_map * tile_width_, j_tile_map * tile_height_, tw, th, pixels);
+}
 
-                updates++;
-            } else {
-                unchanged++;
-            }
+/**
+ * Copies a region of the RGB buffer into an array of pixels, and into the copy of the frame volume if
+ * one's kept. This is called from several threads at once, so it only touches the array passed in and
+ * the region's part of the copy.
+ *
+ * @param buffer Pointer to an RGB buffer
+ * @param width The width of the RGB buffer
+ * @param x The first column of the region
+ * @param y The first row of the region
+ * @param w The width of the region
+ * @param h The height of the region
+ * @param pixels Receives the region's pixels
+ */
+void FlatTiler::ExtractRegion(uint8_t* buffer, size_t width, size_t x, size_t y, size_t w, size_t h, vector<Pixel> &pixels) {
+
+    pixels.resize(w * h);
+
+    // Build the region's pixel array
+    for (size_t j = 0; j < h; j++) {
+        // Compute the offset into the RGB buffer for this row of the region
+        size_t bufferOffset = 3 * ((y + j) * width + x);
+
+        // Keep the copy of the frame volume up to date
+        if (!mirror_.empty()) {
+            memcpy(&mirror_[3 * ((y + j) * display_width_ + x)], buffer + bufferOffset, w * 3);
         }
+
+        rgbToPixels(buffer + bufferOffset, &pixels[j * w], w);
     }
+}
 
-#ifdef USE_COPY_PIXEL_TILES
-    // If any tiles were updated
-    if (updates > 0) {
+/**
+ * Merges the tiles which changed into a few rectangles, and sends each rectangle with one CopyPixels. The
+ * unchanged tiles a rectangle takes in are sent again as they are, so the tile map doesn't change.
+ *
+ * @param buffer Pointer to an RGB buffer
+ * @param width The width of the RGB buffer
+ */
+void FlatTiler::SendRects(uint8_t* buffer, size_t width) {
+    timeval startTime, endTime;
 
-        // Update the Frame Volume by copying the tiles over
-        vector<unsigned int> size;
-        size.push_back(tile_width_); size.push_back(tile_height_);
-        display_->CopyPixelTiles(tiles, starts, size);
+    gettimeofday(&startTime, NULL);
 
-        while (!tiles.empty()) {
-            free(tiles.back());
-            tiles.pop_back();
-        }
+    // Mark the changed tiles and merge them
+    dirty_mask_.assign(tile_map_width_ * tile_map_height_, 0);
+    for (size_t k = 0; k < changed_.size(); k++) {
+        dirty_mask_[changed_[k]] = 1;
+    }
+    dirty_.Merge(dirty_mask_, tile_map_width_, tile_map_height_, dirty_rects_);
+
+    // Send each rectangle, cut short at the edges of the display
+    vector<unsigned int> start(2), end(2);
+    for (size_t k = 0; k < dirty_rects_.size(); k++) {
+        start[0] = dirty_rects_[k].x0 * tile_width_;
+        start[1] = dirty_rects_[k].y0 * tile_height_;
+        end[0] = (dirty_rects_[k].x1 + 1) * tile_width_ - 1;
+        end[1] = (dirty_rects_[k].y1 + 1) * tile_height_ - 1;
+        if (end[0] >= display_width_) { end[0] = display_width_ - 1; }
+        if (end[1] >= display_height_) { end[1] = display_height_ - 1; }
+
+        ExtractRegion(buffer, width, start[0], start[1], end[0] - start[0] + 1, end[1] - start[1] + 1, rect_pixels_);
+        dirty_stats_.pixels += rect_pixels_.size();
+        handoff_.CopyPixels(std::move(rect_pixels_), start, end);
     }
-#endif
 
-    // Free alloc'd memory
-    if (tile_pixels)
-        free(tile_pixels);
-    if (tile_pixels_sig_bits)
-        free(tile_pixels_sig_bits);
+    gettimeofday(&endTime, NULL);
 
-    // Report update statistics
-    unchanged_tiles_ += unchanged;
-    tile_updates_ += updates;
+    dirty_stats_.frames++;
+    dirty_stats_.rects += dirty_rects_.size();
+    dirty_stats_.usecs += (endTime.tv_sec - startTime.tv_sec) * 1000000 + endTime.tv_usec - startTime.tv_usec;
+}
 
-    if (!quiet_) {
-        cout << "Flat Tiling Statistics:" << endl << "  unchanged tiles: " << unchanged_tiles_ << " tiles updated: " << tile_updates_ << endl;
+/**
+ * Finds the regions of each band of tile rows which scrolled horizontally since the last frame and shifts
+ * them within the frame volume. Bands which scrolled the same way are shifted together. The tile map is
+ * updated for the tiles which were shifted, so only the newly exposed ones are sent.
+ *
+ * @param buffer Pointer to an RGB buffer
+ * @param width The width of the RGB buffer
+ */
+void FlatTiler::ScrollRegions(uint8_t* buffer, size_t width) {
+    size_t  x0 = 0, x1 = 0, y0 = 0, y1 = 0;
+    int     shift = 0;
+
+    for (size_t j_tile_map = 0; j_tile_map < tile_map_height_; j_tile_map++) {
+        size_t top = j_tile_map * tile_height_;
+        size_t rows = (top + tile_height_ <= display_height_) ? tile_height_ : display_height_ - top;
+
+        // Only look at bands with some tile that changed
+        bool changed = false;
+        for (size_t i_tile_map = 0; (i_tile_map < tile_map_width_) && !changed; i_tile_map++) {
+            changed = tile_map_[i_tile_map][j_tile_map] != fingerprints_[j_tile_map * tile_map_width_ + i_tile_map];
+        }
+
+        // Find the run of columns which scrolled, cut down to whole tiles
+        scroll_t scroll;
+        size_t first = 0, last = 0;
+        bool found = false;
+        if (changed) {
+            columnHashes(&mirror_[3 * top * display_width_], display_width_ * 3, display_width_, rows, before_hashes_);
+            columnHashes(buffer + 3 * top * width, width * 3, display_width_, rows, after_hashes_);
+            if (scroll_.Find(before_hashes_, after_hashes_, scroll)) {
+                first = (scroll.first + tile_width_ - 1) / tile_width_ * tile_width_;
+                last = (scroll.last + 1 == display_width_) ? display_width_ : (scroll.last + 1) / tile_width_ * tile_width_;
+                found = last > first;
+            }
+        }
+
+        // Add the band to the region being shifted if it scrolled the same way, otherwise shift that region
+        if (found && (y1 == top) && (shift == scroll.shift) && (x0 == first) && (x1 == last)) {
+            y1 = top + rows;
+            continue;
+        }
+        if (y1 > y0) {
+            ShiftRegion(buffer, width, x0, x1, y0, y1, shift);
+        }
+        if (found) {
+            x0 = first; x1 = last; y0 = top; y1 = top + rows; shift = scroll.shift;
+        } else {
+            y0 = y1 = 0;
+        }
+    }
+    if (y1 > y0) {
+        ShiftRegion(buffer, width, x0, x1, y0, y1, shift);
+    }
+}
+
+/**
+ * Shifts a region of the frame volume horizontally, so that each column shows what was shift columns to its
+ * right. The display isn't required to copy overlapping ranges in any order, so the region is copied in
+ * strips no wider than the shift, starting with the strip whose source will be overwritten first. The tiles
+ * in the region which then match the frame are marked as unchanged in the tile map, and the rest are marked
+ * as changed so they're sent.
+ *
+ * @param buffer Pointer to an RGB buffer
+ * @param width The width of the RGB buffer
+ * @param x0 The first column of the region, which is at the edge of a tile
+ * @param x1 The column after the region, which is at the edge of a tile or the display
+ * @param y0 The first row of the region
+ * @param y1 The row after the region
+ * @param shift The number of columns the region's content moved to the left
+ */
+void FlatTiler::ShiftRegion(uint8_t* buffer, size_t width, size_t x0, size_t x1, size_t y0, size_t y1, int shift) {
+    size_t strip = (shift > 0) ? shift : -shift;
+
+    // Copy the region in strips
+    vector<unsigned int> start(2), end(2), dest(2);
+    start[1] = y0; end[1] = y1 - 1; dest[1] = y0;
+    for (size_t k = 0; k * strip < x1 - x0; k++) {
+        size_t left, right;
+        if (shift > 0) {
+            left = x0 + k * strip;
+            right = (left + strip < x1) ? left + strip : x1;
+        } else {
+            right = x1 - k * strip;
+            left = (right > x0 + strip) ? right - strip : x0;
+        }
+        start[0] = left + shift; end[0] = right - 1 + shift; dest[0] = left;
+        display_->CopyFrameVolume(start, end, dest);
+        scroll_copies_++;
+    }
+    for (size_t y = y0; y < y1; y++) {
+        uint8_t* row = &mirror_[3 * y * display_width_];
+        memmove(row + 3 * x0, row + 3 * (x0 + shift), (x1 - x0) * 3);
+    }
+
+    // Compare the shifted tiles with the frame
+    uint8_t mask = (uint8_t)(0xff << (8 - bits_));
+    for (size_t j_tile_map = y0 / tile_height_; j_tile_map * tile_height_ < y1; j_tile_map++) {
+        for (size_t i_tile_map = x0 / tile_width_; i_tile_map * tile_width_ < x1; i_tile_map++) {
+            size_t tw = (i_tile_map * tile_width_ + tile_width_ <= display_width_) ? tile_width_ : display_width_ - i_tile_map * tile_width_;
+            size_t th = (j_tile_map * tile_height_ + tile_height_ <= display_height_) ? tile_height_ : display_height_ - j_tile_map * tile_height_;
+            bool matches = true;
+            for (size_t j_tile = 0; (j_tile < th) && matches; j_tile++) {
+                size_t y = j_tile_map * tile_height_ + j_tile;
+                const uint8_t* a = buffer + 3 * (y * width + i_tile_map * tile_width_);
+                const uint8_t* b = &mirror_[3 * (y * display_width_ + i_tile_map * tile_width_)];
+                for (size_t c = 0; c < tw * 3; c++) {
+                    if ((a[c] ^ b[c]) & mask) {
+                        matches = false;
+                        break;
+                    }
+                }
+            }
+            unsigned long fingerprint = fingerprints_[j_tile_map * tile_map_width_ + i_tile_map];
+            if (matches) {
+                tile_map_[i_tile_map][j_tile_map] = fingerprint;
+                scrolled_tiles_++;
+            } else {
+                tile_map_[i_tile_map][j_tile_map] = ~fingerprint;
+            }
+        }
     }
 }
 
 /**
  * Updates region of the Frame Volume corresponding to the tile's i and j location.
  *
- * @param pixels The array of pixels to use in the update.
+ * @param pixels The pixels to use in the update, which are handed to the display and left unspecified.
  */
 #ifndef USE_COPY_PIXEL_TILES
-void FlatTiler::UpdateFrameVolume(Pixel* pixels, int i_map, int j_map) {
+void FlatTiler::UpdateFrameVolume(vector<Pixel> &pixels, int i_map, int j_map) {
 
     // Setup start and end points
     vector<unsigned int> start, end;
@@ -277,6 +485,6 @@ void FlatTiler::UpdateFrameVolume(Pixel* pixels, int i_map, int j_map) {
     if (end[0] >= display_width_) { end[0] = display_width_ - 1; }
     if (end[1] >= display_height_) { end[1] = display_height_ - 1; }
 
-    display_->CopyPixels(pixels, start, end);
+    handoff_.CopyPixels(std::move(pixels), start, end);
 }
 #endif
@@ -9,6 +9,9 @@
  *
  */
 
+#include "DirtyRects.h"
+#include "ScrollDetector.h"
+#include "TileFingerprint.h"
 #include "Tiler.h"
 
 using namespace nddi;
@@ -38,6 +41,19 @@ public:
               string file = "");
 
     ~FlatTiler() {
+        fingerprint_stats_t &stats = fingerprinter_.Stats();
+        if (stats.usecs) {
+            cerr << "Tile Fingerprint (" << fingerprintName(fingerprinter_.Mode()) << ") Throughput (MB/s): "
+                 << (double)stats.bytes / (double)stats.usecs << endl;
+        }
+        if (!mirror_.empty()) {
+            cerr << "Scrolled Tiles: " << scrolled_tiles_ << " Frame Volume Copies: " << scroll_copies_ << endl;
+        }
+        if (send_rects_ && dirty_stats_.frames) {
+            cerr << "Dirty Rectangles Per Frame: " << (double)dirty_stats_.rects / (double)dirty_stats_.frames
+                 << " Pixel Bytes Per Frame: " << (double)dirty_stats_.pixels * sizeof(Pixel) / (double)dirty_stats_.frames
+                 << " Usecs Per Frame: " << (double)dirty_stats_.usecs / (double)dirty_stats_.frames << endl;
+        }
         tile_map_.clear();
     }
 
@@ -57,11 +73,17 @@ public:
 
 private:
     void InitializeCoefficientPlanes();
+    void ExtractTile(uint8_t* buffer, size_t width, size_t i_tile_map, size_t j_tile_map, vector<Pixel> &pixels);
+    void ExtractRegion(uint8_t* buffer, size_t width, size_t x, size_t y, size_t w, size_t h, vector<Pixel> &pixels);
+    void SendRects(uint8_t* buffer, size_t width);
+    void ScrollRegions(uint8_t* buffer, size_t width);
+    void ShiftRegion(uint8_t* buffer, size_t width, size_t x0, size_t x1, size_t y0, size_t y1, int shift);
 #ifndef USE_COPY_PIXEL_TILES
-    void UpdateFrameVolume(Pixel* pixels, int i_map, int j_map);
+    void UpdateFrameVolume(vector<Pixel> &pixels, int i_map, int j_map);
 #endif
 
     NDimensionalDisplayInterface*  display_;
+    PayloadHandoff    handoff_;
     size_t            display_width_, display_height_;
     size_t            tile_width_, tile_height_;
     size_t            tile_map_width_, tile_map_height_;
@@ -70,6 +92,33 @@ private:
 
     vector< vector<unsigned long> > tile_map_;
 
+    // Fingerprints every tile of a frame before the tiles are compared with the tile map
+    TileFingerprinter      fingerprinter_;
+    vector<unsigned long>  fingerprints_;
+
+    // The tiles which changed in the current frame, as indexes into fingerprints_
+    vector<size_t>         changed_;
+
+    // When looking for scrolling, a copy of the frame volume as RGB24 and the column hashes of a band of it
+    // and of the frame
+    ScrollDetector         scroll_;
+    vector<uint8_t>        mirror_;
+    vector<uint64_t>       before_hashes_, after_hashes_;
+    long                   scrolled_tiles_, scroll_copies_;
+
+    // When sending dirty rectangles, the mask of changed tiles, the rectangles which cover them and their pixels
+    bool                   send_rects_;
+    DirtyRectMerger        dirty_;
+    vector<uint8_t>        dirty_mask_;
+    vector<dirty_rect_t>   dirty_rects_;
+    vector<Pixel>          rect_pixels_;
+    dirty_stats_t          dirty_stats_;
+#ifdef USE_COPY_PIXEL_TILES
+    vector< vector<Pixel> > tile_pixels_spare_;
+#else
+    vector< vector<Pixel> > tile_pixels_;
+#endif
+
     int unchanged_tiles_, tile_updates_;
 };
 #endif // FLAT_TILER_H
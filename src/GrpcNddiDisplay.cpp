@@ -1,8 +1,13 @@
 #include "GrpcNddiDisplay.h"
+#include "NddiTransport.h"
+#include "PayloadCompression.h"
+#include "SharedMemoryRing.h"
+#include "WireFormat.h"
 
 using namespace nddi;
 
 using nddiwall::InitializeRequest;
+using nddiwall::InitializeReply;
 using nddiwall::StatusReply;
 using nddiwall::DisplayWidthRequest;
 using nddiwall::DisplayHeightRequest;
@@ -23,6 +28,12 @@ using nddiwall::FillCoefficientTilesRequest;
 using nddiwall::FillScalerRequest;
 using nddiwall::FillScalerTilesRequest;
 using nddiwall::FillScalerTileStackRequest;
+using nddiwall::FillCoefficientTilesV2Request;
+using nddiwall::FillScalerTilesV2Request;
+using nddiwall::FillScalerTileStackV2Request;
+using nddiwall::QuantizedScalers;
+using nddiwall::RegisterScalerQuantizerRequest;
+using nddiwall::RegisterScalerQuantizerReply;
 using nddiwall::SetPixelByteSignModeRequest;
 using nddiwall::GetFullScalerRequest;
 using nddiwall::GetFullScalerReply;
@@ -31,12 +42,44 @@ using nddiwall::UpdateInputVectorRequest;
 using nddiwall::ClearCostModelRequest;
 using nddiwall::LatchRequest;
 using nddiwall::ShutdownRequest;
+using nddiwall::SharedMemoryPayload;
+using nddiwall::RegisterSharedMemoryRequest;
+using nddiwall::RegisterSharedMemoryReply;
+using nddiwall::UnregisterSharedMemoryRequest;
+using nddiwall::CompressedPayload;
+
+NddiTransport* GrpcNddiDisplay::defaultTransport_ = NULL;
+size_t GrpcNddiDisplay::sharedMemorySize_ = 0;
+Compression GrpcNddiDisplay::requestedCompression_ = nddiwall::COMPRESSION_NONE;
+unsigned int GrpcNddiDisplay::wireFormat_ = 1;
+bool GrpcNddiDisplay::scalerQuantization_ = false;
+size_t GrpcNddiDisplay::channelPoolSize_ = 0;
+vector< shared_ptr<Channel> > GrpcNddiDisplay::channelPool_;
+size_t GrpcNddiDisplay::nextChannel_ = 0;
+pthread_mutex_t GrpcNddiDisplay::channelPoolMutex_ = PTHREAD_MUTEX_INITIALIZER;
+map<unsigned int, size_t> GrpcNddiDisplay::compressionThresholds_ = {
+    { idCopyPixels,          1024 },
+    { idCopyPixelTiles,      1024 },
+    { idFillScalerTiles,     1024 },
+    { idFillScalerTileStack, 1024 }
+};
+
+static void setSharedMemoryPayload(SharedMemoryPayload* payload, uint32_t id, uint64_t offset, uint64_t length) {
+    payload->set_id(id);
+    payload->set_offset(offset);
+    payload->set_length(length);
+}
 
 // public
 
 // Simple constructor used by slaves when the master has already initialized the NDDI Display
 GrpcNddiDisplay::GrpcNddiDisplay()
-: stub_(NddiWall::NewStub(grpc::CreateChannel("localhost:50051", grpc::InsecureChannelCredentials()))) {}
+: transport_(defaultTransport_) {
+    if (!transport_) {
+        stub_ = NddiWall::NewStub(CreateChannel());
+        RegisterSharedMemory();
+    }
+}
 
 GrpcNddiDisplay::GrpcNddiDisplay(vector<unsigned int> &frameVolumeDimensionalSizes,
                                  unsigned int numCoefficientPlanes, unsigned int inputVectorSize,
@@ -49,7 +92,16 @@ GrpcNddiDisplay::GrpcNddiDisplay(vector<unsigned int> &frameVolumeDimensionalSiz
                                  unsigned int displayWidth, unsigned int displayHeight,
                                  unsigned int numCoefficientPlanes, unsigned int inputVectorSize,
                                  bool fixed8x8Macroblocks, bool useSingleCoeffcientPlane)
-: stub_(NddiWall::NewStub(grpc::CreateChannel("localhost:50051", grpc::InsecureChannelCredentials()))) {
+: transport_(defaultTransport_) {
+    if (transport_) {
+        transport_->Send(new InitCommandMessage(frameVolumeDimensionalSizes,
+                                                displayWidth, displayHeight,
+                                                numCoefficientPlanes, inputVectorSize,
+                                                fixed8x8Macroblocks, useSingleCoeffcientPlane));
+        return;
+    }
+
+    stub_ = NddiWall::NewStub(CreateChannel());
 
     // Data we are sending to the server.
     InitializeRequest request;
@@ -62,9 +114,10 @@ GrpcNddiDisplay::GrpcNddiDisplay(vector<unsigned int> &frameVolumeDimensionalSiz
     request.set_inputvectorsize(inputVectorSize);
     request.set_fixed8x8macroblocks(fixed8x8Macroblocks);
     request.set_usesinglecoeffcientplane(useSingleCoeffcientPlane);
+    request.set_compression(requestedCompression_);
 
     // Container for the data we expect from the server.
-    StatusReply reply;
+    InitializeReply reply;
 
     // Context for the client. It could be used to convey extra information to
     // the server and/or tweak certain RPC behaviors.
@@ -77,12 +130,23 @@ GrpcNddiDisplay::GrpcNddiDisplay(vector<unsigned int> &frameVolumeDimensionalSiz
     if (!status.ok()) {
       std::cout << status.error_code() << ": " << status.error_message()
                 << std::endl;
+    } else if (reply.status() == StatusReply::OK) {
+        // The server may have settled on a different mode than the one requested.
+        compression_ = reply.compression();
     }
+
+    RegisterSharedMemory();
 }
 
-GrpcNddiDisplay::~GrpcNddiDisplay() {}
+GrpcNddiDisplay::~GrpcNddiDisplay() {
+    UnregisterSharedMemory();
+}
 
 unsigned int GrpcNddiDisplay::DisplayWidth() {
+    if (transport_) {
+        return transport_->DisplayWidth();
+    }
+
     DisplayWidthRequest request;
     DisplayWidthReply reply;
     ClientContext context;
@@ -97,6 +161,10 @@ unsigned int GrpcNddiDisplay::DisplayWidth() {
 }
 
 unsigned int GrpcNddiDisplay::DisplayHeight() {
+    if (transport_) {
+        return transport_->DisplayHeight();
+    }
+
     DisplayHeightRequest request;
     DisplayHeightReply reply;
     ClientContext context;
@@ -111,6 +179,10 @@ unsigned int GrpcNddiDisplay::DisplayHeight() {
 }
 
 unsigned int GrpcNddiDisplay::NumCoefficientPlanes() {
+    if (transport_) {
+        return transport_->NumCoefficientPlanes();
+    }
+
     NumCoefficientPlanesRequest request;
     NumCoefficientPlanesReply reply;
     ClientContext context;
@@ -125,6 +197,11 @@ unsigned int GrpcNddiDisplay::NumCoefficientPlanes() {
 }
 
 void GrpcNddiDisplay::PutPixel(Pixel p, vector<unsigned int> &location) {
+    if (transport_) {
+        transport_->Send(new PutPixelCommandMessage(p, location));
+        return;
+    }
+
     PutPixelRequest request;
     request.set_pixel(p.packed);
     for (size_t i = 0; i < location.size(); i++) {
@@ -145,6 +222,11 @@ void GrpcNddiDisplay::PutPixel(Pixel p, vector<unsigned int> &location) {
 void GrpcNddiDisplay::CopyPixelStrip(Pixel* p, vector<unsigned int> &start, vector<unsigned int> &end) {
     assert(start.size() == end.size());
 
+    if (transport_) {
+        transport_->Send(new CopyPixelStripCommandMessage(p, start, end));
+        return;
+    }
+
     CopyPixelStripRequest request;
     size_t count = 1;
     for (size_t i = 0; i < start.size(); i++) {
@@ -168,6 +250,11 @@ void GrpcNddiDisplay::CopyPixelStrip(Pixel* p, vector<unsigned int> &start, vect
 void GrpcNddiDisplay::CopyPixels(Pixel* p, vector<unsigned int> &start, vector<unsigned int> &end) {
     assert(start.size() == end.size());
 
+    if (transport_) {
+        transport_->Send(new CopyPixelsCommandMessage(p, start, end));
+        return;
+    }
+
     CopyPixelsRequest request;
     size_t count = 1;
     for (size_t i = 0; i < start.size(); i++) {
@@ -175,7 +262,14 @@ void GrpcNddiDisplay::CopyPixels(Pixel* p, vector<unsigned int> &start, vector<u
       request.add_end(end[i]);
       count *= end[i] - start[i] + 1;
     }
-    request.set_pixels((void*)p, sizeof(Pixel) * count);
+    uint64_t offset;
+    uint8_t* shm = ReserveSharedMemory(sizeof(Pixel) * count, offset);
+    if (shm) {
+        memcpy(shm, (void*)p, sizeof(Pixel) * count);
+        setSharedMemoryPayload(request.mutable_shm(), ringId_, offset, sizeof(Pixel) * count);
+    } else if (!CompressPayload(idCopyPixels, (uint8_t*)p, sizeof(Pixel) * count, request)) {
+        request.set_pixels((void*)p, sizeof(Pixel) * count);
+    }
 
     StatusReply reply;
 
@@ -188,10 +282,25 @@ void GrpcNddiDisplay::CopyPixels(Pixel* p, vector<unsigned int> &start, vector<u
     }
 }
 
+void GrpcNddiDisplay::CopyPixels(vector<Pixel> &&p, vector<unsigned int> &start, vector<unsigned int> &end) {
+    if (transport_) {
+        transport_->Send(new CopyPixelsCommandMessage(std::move(p), start, end));
+        return;
+    }
+
+    // The pixels are serialized into the request either way
+    CopyPixels(p.data(), start, end);
+}
+
 void GrpcNddiDisplay::CopyPixelTiles(vector<Pixel*> &p, vector<vector<unsigned int> > &starts, vector<unsigned int> &size) {
     assert(p.size() == starts.size());
     assert(size.size() == 2);
 
+    if (transport_) {
+        transport_->Send(new CopyPixelTilesCommandMessage(p, starts, size));
+        return;
+    }
+
     CopyPixelTilesRequest request;
     for (size_t i = 0; i < starts.size(); i++) {
         for (size_t j = 0; j < starts[i].size(); j++) {
@@ -202,11 +311,24 @@ void GrpcNddiDisplay::CopyPixelTiles(vector<Pixel*> &p, vector<vector<unsigned i
     request.add_size(size[1]);
     size_t tile_count = starts.size();
     size_t tile_size = size[0] * size[1];
-    Pixel p_arr[tile_count * tile_size];
-    for (size_t i = 0; i < tile_count; i++) {
-        memcpy(&p_arr[i * tile_size], p[i], sizeof(Pixel) * tile_size);
+    uint64_t offset;
+    uint8_t* shm = ReserveSharedMemory(sizeof(Pixel) * tile_count * tile_size, offset);
+    if (shm) {
+        // Gather the tiles straight into the ring
+        for (size_t i = 0; i < tile_count; i++) {
+            memcpy(shm + sizeof(Pixel) * i * tile_size, p[i], sizeof(Pixel) * tile_size);
+        }
+        setSharedMemoryPayload(request.mutable_shm(), ringId_, offset, sizeof(Pixel) * tile_count * tile_size);
+    } else {
+        // Gather the tiles into a string the request can take over, so they're only copied once
+        std::string pixels(sizeof(Pixel) * tile_count * tile_size, '\0');
+        for (size_t i = 0; i < tile_count; i++) {
+            memcpy(&pixels[sizeof(Pixel) * i * tile_size], p[i], sizeof(Pixel) * tile_size);
+        }
+        if (!CompressPayload(idCopyPixelTiles, (uint8_t*)&pixels[0], pixels.size(), request)) {
+            request.set_pixels(std::move(pixels));
+        }
     }
-    request.set_pixels((void*)p_arr, sizeof(Pixel) * tile_count * tile_size);
 
     StatusReply reply;
 
@@ -219,9 +341,28 @@ void GrpcNddiDisplay::CopyPixelTiles(vector<Pixel*> &p, vector<vector<unsigned i
     }
 }
 
+void GrpcNddiDisplay::CopyPixelTiles(vector<vector<Pixel> > &&p, vector<vector<unsigned int> > &starts, vector<unsigned int> &size) {
+    if (transport_) {
+        transport_->Send(new CopyPixelTilesCommandMessage(std::move(p), starts, size));
+        return;
+    }
+
+    // The tiles are gathered into the request either way
+    vector<Pixel*> tiles(p.size());
+    for (size_t i = 0; i < p.size(); i++) {
+        tiles[i] = p[i].data();
+    }
+    CopyPixelTiles(tiles, starts, size);
+}
+
 void GrpcNddiDisplay::FillPixel(Pixel p, vector<unsigned int> &start, vector<unsigned int> &end) {
     assert(start.size() == end.size());
 
+    if (transport_) {
+        transport_->Send(new FillPixelCommandMessage(p, start, end));
+        return;
+    }
+
     FillPixelRequest request;
     request.set_pixel(p.packed);
     for (size_t i = 0; i < start.size(); i++) {
@@ -244,6 +385,11 @@ void GrpcNddiDisplay::CopyFrameVolume(vector<unsigned int> &start, vector<unsign
     assert(start.size() == end.size());
     assert(start.size() == dest.size());
 
+    if (transport_) {
+        transport_->Send(new CopyFrameVolumeCommandMessage(start, end, dest));
+        return;
+    }
+
     CopyFrameVolumeRequest request;
     for (size_t i = 0; i < start.size(); i++) {
       request.add_start(start[i]);
@@ -263,6 +409,11 @@ void GrpcNddiDisplay::CopyFrameVolume(vector<unsigned int> &start, vector<unsign
 }
 
 void GrpcNddiDisplay::UpdateInputVector(vector<int> &input) {
+    if (transport_) {
+        transport_->Send(new UpdateInputVectorCommandMessage(input));
+        return;
+    }
+
     UpdateInputVectorRequest request;
     for (size_t i = 0; i < input.size(); i++) {
       request.add_input(input[i]);
@@ -281,6 +432,11 @@ void GrpcNddiDisplay::UpdateInputVector(vector<int> &input) {
 
 void GrpcNddiDisplay::PutCoefficientMatrix(vector< vector<int> > &coefficientMatrix,
                                            vector<unsigned int> &location) {
+    if (transport_) {
+        transport_->Send(new PutCoefficientMatrixCommandMessage(coefficientMatrix, location));
+        return;
+    }
+
     PutCoefficientMatrixRequest request;
     for (size_t j = 0; j < coefficientMatrix.size(); j++) {
         for (size_t i = 0; i < coefficientMatrix[j].size(); i++) {
@@ -307,6 +463,11 @@ void GrpcNddiDisplay::FillCoefficientMatrix(vector< vector<int> > &coefficientMa
                                             vector<unsigned int> &end) {
     assert(start.size() == end.size());
 
+    if (transport_) {
+        transport_->Send(new FillCoefficientMatrixCommandMessage(coefficientMatrix, start, end));
+        return;
+    }
+
     FillCoefficientMatrixRequest request;
     for (size_t j = 0; j < coefficientMatrix.size(); j++) {
         for (size_t i = 0; i < coefficientMatrix[j].size(); i++) {
@@ -329,12 +490,54 @@ void GrpcNddiDisplay::FillCoefficientMatrix(vector< vector<int> > &coefficientMa
     }
 }
 
+void GrpcNddiDisplay::FillCoefficientMatrixTiled(vector< vector<int> > &coefficientMatrix,
+                                                 vector<unsigned int> &start,
+                                                 vector<unsigned int> &end,
+                                                 vector<unsigned int> &size) {
+    assert(start.size() == end.size());
+    assert(size.size() == 2);
+
+    if (transport_) {
+        transport_->Send(new FillCoefficientMatrixTiledCommandMessage(coefficientMatrix, start, end, size));
+        return;
+    }
+
+    FillCoefficientMatrixTiledRequest request;
+    for (size_t j = 0; j < coefficientMatrix.size(); j++) {
+        for (size_t i = 0; i < coefficientMatrix[j].size(); i++) {
+            request.add_coefficientmatrix(coefficientMatrix[j][i]);
+        }
+    }
+    for (size_t i = 0; i < start.size(); i++) {
+      request.add_start(start[i]);
+      request.add_end(end[i]);
+    }
+    for (size_t i = 0; i < size.size(); i++) {
+      request.add_size(size[i]);
+    }
+
+    StatusReply reply;
+
+    ClientContext context;
+    Status status = stub_->FillCoefficientMatrixTiled(&context, request, &reply);
+
+    if (!status.ok()) {
+      std::cout << status.error_code() << ": " << status.error_message()
+                << std::endl;
+    }
+}
+
 void GrpcNddiDisplay::FillCoefficient(int coefficient,
                                       unsigned int row, unsigned int col,
                                       vector<unsigned int> &start,
                                       vector<unsigned int> &end) {
     assert(start.size() == end.size());
 
+    if (transport_) {
+        transport_->Send(new FillCoefficientCommandMessage(coefficient, row, col, start, end));
+        return;
+    }
+
     FillCoefficientRequest request;
     request.set_coefficient(coefficient);
     request.set_row(row);
@@ -363,6 +566,17 @@ void GrpcNddiDisplay::FillCoefficientTiles(vector<int> &coefficients,
     assert(coefficients.size() == starts.size());
     assert(size.size() == 2);
 
+    if (transport_) {
+        transport_->Send(new FillCoefficientTilesCommandMessage(coefficients, positions, starts, size));
+        return;
+    }
+
+    if (wireFormat_ == 2) {
+        FillCoefficientTilesV2(coefficients, positions, starts, size);
+        return;
+    }
+
+    uint64_t encodeStart = wireNanos();
     FillCoefficientTilesRequest request;
     for (size_t i = 0; i < coefficients.size(); i++) {
         request.add_coefficients(coefficients[i]);
@@ -379,6 +593,7 @@ void GrpcNddiDisplay::FillCoefficientTiles(vector<int> &coefficients,
     }
     request.add_size(size[0]);
     request.add_size(size[1]);
+    request.set_encodenanos(wireNanos() - encodeStart);
 
     StatusReply reply;
 
@@ -396,6 +611,11 @@ void GrpcNddiDisplay::FillScaler(Scaler scaler,
                                  vector<unsigned int> &end) {
     assert(start.size() == end.size());
 
+    if (transport_) {
+        transport_->Send(new FillScalerCommandMessage(scaler, start, end));
+        return;
+    }
+
     FillScalerRequest request;
     request.set_scaler(scaler.packed);
     for (size_t i = 0; i < start.size(); i++) {
@@ -420,9 +640,21 @@ void GrpcNddiDisplay::FillScalerTiles(vector<uint64_t> &scalers,
     assert(scalers.size() == starts.size());
     assert(size.size() == 2);
 
+    if (transport_) {
+        transport_->Send(new FillScalerTilesCommandMessage(scalers, starts, size));
+        return;
+    }
+
+    if ((wireFormat_ == 2) && FillScalerTilesV2(scalers, starts, size)) {
+        return;
+    }
+
+    uint64_t encodeStart = wireNanos();
     FillScalerTilesRequest request;
-    for (size_t i = 0; i < scalers.size(); i++) {
-        request.add_scalers(scalers[i]);
+    if (!CompressPayload(idFillScalerTiles, (uint8_t*)scalers.data(), sizeof(uint64_t) * scalers.size(), request)) {
+        for (size_t i = 0; i < scalers.size(); i++) {
+            request.add_scalers(scalers[i]);
+        }
     }
     for (size_t i = 0; i < starts.size(); i++) {
         for (size_t j = 0; j < starts[i].size(); j++) {
@@ -431,6 +663,7 @@ void GrpcNddiDisplay::FillScalerTiles(vector<uint64_t> &scalers,
     }
     request.add_size(size[0]);
     request.add_size(size[1]);
+    request.set_encodenanos(wireNanos() - encodeStart);
 
     StatusReply reply;
 
@@ -449,9 +682,27 @@ void GrpcNddiDisplay::FillScalerTileStack(vector<uint64_t> &scalers,
     assert(start.size() == 3);
     assert(size.size() == 2);
 
+    if (transport_) {
+        transport_->Send(new FillScalerTileStackCommandMessage(scalers, start, size));
+        return;
+    }
+
+    // Payloads going through shared memory never touch the wire, so they stay in the v1 format.
+    uint64_t offset;
+    uint8_t* shm = ReserveSharedMemory(sizeof(uint64_t) * scalers.size(), offset);
+    if (!shm && (wireFormat_ == 2) && FillScalerTileStackV2(scalers, start, size)) {
+        return;
+    }
+
+    uint64_t encodeStart = wireNanos();
     FillScalerTileStackRequest request;
-    for (size_t i = 0; i < scalers.size(); i++) {
-      request.add_scalers(scalers[i]);
+    if (shm) {
+        memcpy(shm, scalers.data(), sizeof(uint64_t) * scalers.size());
+        setSharedMemoryPayload(request.mutable_shm(), ringId_, offset, sizeof(uint64_t) * scalers.size());
+    } else if (!CompressPayload(idFillScalerTileStack, (uint8_t*)scalers.data(), sizeof(uint64_t) * scalers.size(), request)) {
+        for (size_t i = 0; i < scalers.size(); i++) {
+          request.add_scalers(scalers[i]);
+        }
     }
     for (size_t i = 0; i < start.size(); i++) {
       request.add_start(start[i]);
@@ -459,6 +710,7 @@ void GrpcNddiDisplay::FillScalerTileStack(vector<uint64_t> &scalers,
     for (size_t i = 0; i < size.size(); i++) {
       request.add_size(size[i]);
     }
+    request.set_encodenanos(wireNanos() - encodeStart);
 
     StatusReply reply;
 
@@ -471,7 +723,24 @@ void GrpcNddiDisplay::FillScalerTileStack(vector<uint64_t> &scalers,
     }
 }
 
+void GrpcNddiDisplay::FillScalerTileStack(vector<uint64_t> &&scalers,
+                                          vector<unsigned int> &start,
+                                          vector<unsigned int> &size) {
+    if (transport_) {
+        transport_->Send(new FillScalerTileStackCommandMessage(std::move(scalers), start, size));
+        return;
+    }
+
+    // The scalers are serialized into the request either way
+    FillScalerTileStack(scalers, start, size);
+}
+
 void GrpcNddiDisplay::SetPixelByteSignMode(SignMode mode) {
+    if (transport_) {
+        transport_->Send(new SetPixelByteSignModeCommandMessage(mode));
+        return;
+    }
+
     SetPixelByteSignModeRequest request;
     request.set_mode(mode);
 
@@ -487,6 +756,11 @@ void GrpcNddiDisplay::SetPixelByteSignMode(SignMode mode) {
 }
 
 void GrpcNddiDisplay::SetFullScaler(uint16_t fullScaler) {
+    if (transport_) {
+        transport_->Send(new SetFullScalerCommandMessage(fullScaler));
+        return;
+    }
+
     SetFullScalerRequest request;
     request.set_fullscaler(fullScaler);
 
@@ -502,6 +776,10 @@ void GrpcNddiDisplay::SetFullScaler(uint16_t fullScaler) {
 }
 
 uint16_t GrpcNddiDisplay::GetFullScaler() {
+    if (transport_) {
+        return transport_->GetFullScaler();
+    }
+
     GetFullScalerRequest request;
     GetFullScalerReply reply;
     ClientContext context;
@@ -522,6 +800,11 @@ CostModel* GrpcNddiDisplay::GetCostModel() {
 }
 
 void GrpcNddiDisplay::ClearCostModel() {
+    if (transport_) {
+        transport_->Send(new ClearCostModelCommandMessage());
+        return;
+    }
+
     ClearCostModelRequest request;
     StatusReply reply;
     ClientContext context;
@@ -533,12 +816,20 @@ void GrpcNddiDisplay::ClearCostModel() {
 }
 
 void GrpcNddiDisplay::Latch(uint32_t sub_x, uint32_t sub_y, uint32_t sub_w, uint32_t sub_h) {
+    if (transport_) {
+        transport_->Send(new LatchCommandMessage(sub_x, sub_y, sub_w, sub_h));
+        return;
+    }
+
     LatchRequest request;
     request.set_sub_x(sub_x);
     request.set_sub_y(sub_y);
     request.set_sub_w(sub_w);
     request.set_sub_h(sub_h);
 
+    // Every payload written to the ring so far belongs to this latch.
+    if (ring_) { ring_->Latch(latchSequence_); }
+
     StatusReply reply;
 
     ClientContext context;
@@ -547,10 +838,22 @@ void GrpcNddiDisplay::Latch(uint32_t sub_x, uint32_t sub_y, uint32_t sub_w, uint
     if (!status.ok()) {
       std::cout << status.error_code() << ": " << status.error_message()
                 << std::endl;
+    } else if (ring_) {
+        // The server has acknowledged the latch, so it's done with the payloads that belong to it.
+        ring_->Release(latchSequence_);
     }
+    latchSequence_++;
 }
 
 void GrpcNddiDisplay::Shutdown() {
+    if (transport_) {
+        transport_->Send(new ShutdownCommandMessage());
+        return;
+    }
+
+    // Let go of the ring while the server is still around to hear about it.
+    UnregisterSharedMemory();
+
     ShutdownRequest request;
     StatusReply reply;
     ClientContext context;
@@ -560,3 +863,282 @@ void GrpcNddiDisplay::Shutdown() {
                 << std::endl;
     }
 }
+
+void GrpcNddiDisplay::SetTransport(NddiTransport* transport) {
+    defaultTransport_ = transport;
+}
+
+void GrpcNddiDisplay::SetSharedMemorySize(size_t bytes) {
+    sharedMemorySize_ = bytes;
+}
+
+void GrpcNddiDisplay::SetCompression(Compression mode) {
+    requestedCompression_ = mode;
+}
+
+void GrpcNddiDisplay::SetCompressionThreshold(CommandID command, size_t bytes) {
+    if (compressionThresholds_.count(command)) {
+        compressionThresholds_[command] = bytes;
+    }
+}
+
+void GrpcNddiDisplay::SetWireFormat(unsigned int version) {
+    wireFormat_ = version;
+}
+
+void GrpcNddiDisplay::SetScalerQuantization(bool enable) {
+    scalerQuantization_ = enable;
+}
+
+void GrpcNddiDisplay::SetChannelPoolSize(size_t channels) {
+    pthread_mutex_lock(&channelPoolMutex_);
+    channelPoolSize_ = channels;
+    channelPool_.clear();
+    nextChannel_ = 0;
+    pthread_mutex_unlock(&channelPoolMutex_);
+}
+
+void GrpcNddiDisplay::RegisterScalerQuantizer(vector<uint32_t> &divisors, unsigned int firstPlane) {
+    if (transport_) {
+        return;
+    }
+
+    RegisterScalerQuantizerRequest request;
+    for (size_t i = 0; i < divisors.size(); i++) {
+        request.add_divisors(divisors[i]);
+    }
+    request.set_firstplane(firstPlane);
+
+    RegisterScalerQuantizerReply reply;
+
+    ClientContext context;
+    Status status = stub_->RegisterScalerQuantizer(&context, request, &reply);
+
+    if (!status.ok()) {
+      std::cout << status.error_code() << ": " << status.error_message()
+                << std::endl;
+    } else if (reply.status() == StatusReply::OK) {
+        scaler_quantizer_t quantizer = { reply.id(), firstPlane, divisors };
+        quantizers_.push_back(quantizer);
+    }
+}
+
+// private
+
+shared_ptr<Channel> GrpcNddiDisplay::CreateChannel() {
+    if (!channelPoolSize_) {
+        return grpc::CreateChannel("localhost:50051", grpc::InsecureChannelCredentials());
+    }
+
+    pthread_mutex_lock(&channelPoolMutex_);
+    if (channelPool_.size() < channelPoolSize_) {
+        // Channels with identical arguments would share one connection, so each pooled channel gets its own index
+        grpc::ChannelArguments args;
+        args.SetInt("nddiwall.channel_index", channelPool_.size());
+        channelPool_.push_back(grpc::CreateCustomChannel("localhost:50051", grpc::InsecureChannelCredentials(), args));
+    }
+    shared_ptr<Channel> channel = channelPool_[nextChannel_++ % channelPool_.size()];
+    pthread_mutex_unlock(&channelPoolMutex_);
+
+    return channel;
+}
+
+void GrpcNddiDisplay::RegisterSharedMemory() {
+    if (!sharedMemorySize_) {
+        return;
+    }
+
+    ring_ = new SharedMemoryRing(sharedMemorySize_);
+    if (!ring_->IsMapped()) {
+        std::cout << "Failed to create the shared memory ring. Sending payloads inline." << std::endl;
+        delete ring_;
+        ring_ = NULL;
+        return;
+    }
+
+    RegisterSharedMemoryRequest request;
+    request.set_name(ring_->Name());
+    request.set_size(ring_->Size());
+
+    RegisterSharedMemoryReply reply;
+
+    ClientContext context;
+    Status status = stub_->RegisterSharedMemory(&context, request, &reply);
+
+    if (!status.ok() || (reply.status() != StatusReply::OK)) {
+        // Most likely the server is on another host. Either way, fall back to sending payloads inline.
+        if (!status.ok()) {
+            std::cout << status.error_code() << ": " << status.error_message()
+                      << std::endl;
+        }
+        delete ring_;
+        ring_ = NULL;
+        return;
+    }
+    ringId_ = reply.id();
+}
+
+void GrpcNddiDisplay::UnregisterSharedMemory() {
+    if (!ring_) {
+        return;
+    }
+
+    UnregisterSharedMemoryRequest request;
+    request.set_id(ringId_);
+
+    StatusReply reply;
+
+    ClientContext context;
+    Status status = stub_->UnregisterSharedMemory(&context, request, &reply);
+
+    if (!status.ok()) {
+      std::cout << status.error_code() << ": " << status.error_message()
+                << std::endl;
+    }
+
+    delete ring_;
+    ring_ = NULL;
+}
+
+uint8_t* GrpcNddiDisplay::ReserveSharedMemory(uint64_t length, uint64_t &offset) {
+    if (ring_ && ring_->Reserve(length, offset)) {
+        return ring_->At(offset, length);
+    }
+    return NULL;
+}
+
+template <class T>
+bool GrpcNddiDisplay::CompressPayload(CommandID command, const uint8_t* src, size_t length, T &request) {
+    if ((compression_ == nddiwall::COMPRESSION_NONE) ||
+        !compressionThresholds_.count(command) || (length < compressionThresholds_[command])) {
+        return false;
+    }
+
+    compression_stats_t stats = { 0, 0, 0, 0 };
+    std::string data;
+    if (!compressPayload(compression_, src, length, data, &stats)) {
+        return false;
+    }
+
+    CompressedPayload* payload = request.mutable_compressed();
+    payload->set_compression(compression_);
+    payload->set_length(length);
+    payload->mutable_data()->swap(data);
+    payload->set_compressusecs(stats.usecs);
+
+    return true;
+}
+
+void GrpcNddiDisplay::FillCoefficientTilesV2(vector<int> &coefficients,
+                                             vector<vector<unsigned int> > &positions,
+                                             vector<vector<unsigned int> > &starts,
+                                             vector<unsigned int> &size) {
+    uint64_t encodeStart = wireNanos();
+    FillCoefficientTilesV2Request request;
+    request.set_coefficients((void*)coefficients.data(), sizeof(int32_t) * coefficients.size());
+    request.set_positionwidth(packCoordinates(positions, *request.mutable_positions()));
+    request.set_startwidth(packCoordinates(starts, *request.mutable_starts()));
+    request.set_width(size[0]);
+    request.set_height(size[1]);
+    request.set_encodenanos(wireNanos() - encodeStart);
+
+    StatusReply reply;
+
+    ClientContext context;
+    Status status = stub_->FillCoefficientTilesV2(&context, request, &reply);
+
+    if (!status.ok()) {
+      std::cout << status.error_code() << ": " << status.error_message()
+                << std::endl;
+    }
+}
+
+bool GrpcNddiDisplay::FillScalerTilesV2(vector<uint64_t> &scalers,
+                                        vector<vector<unsigned int> > &starts,
+                                        vector<unsigned int> &size) {
+    uint64_t encodeStart = wireNanos();
+    std::string packed;
+    if (!packScalers(scalers, packed)) {
+        return false;
+    }
+
+    FillScalerTilesV2Request request;
+    if (!CompressPayload(idFillScalerTiles, (uint8_t*)packed.data(), packed.size(), request)) {
+        request.mutable_scalers()->swap(packed);
+    }
+    request.set_startwidth(packCoordinates(starts, *request.mutable_starts()));
+    request.set_width(size[0]);
+    request.set_height(size[1]);
+    request.set_encodenanos(wireNanos() - encodeStart);
+
+    StatusReply reply;
+
+    ClientContext context;
+    Status status = stub_->FillScalerTilesV2(&context, request, &reply);
+
+    if (!status.ok()) {
+      std::cout << status.error_code() << ": " << status.error_message()
+                << std::endl;
+    }
+    return true;
+}
+
+bool GrpcNddiDisplay::FillScalerTileStackV2(vector<uint64_t> &scalers,
+                                            vector<unsigned int> &start,
+                                            vector<unsigned int> &size) {
+    uint64_t encodeStart = wireNanos();
+    FillScalerTileStackV2Request request;
+    QuantizedScalers quantized;
+    if (scalerQuantization_ && QuantizeScalers(scalers, start[2], &quantized)) {
+        request.mutable_quantized()->Swap(&quantized);
+    } else {
+        std::string packed;
+        if (!packScalers(scalers, packed)) {
+            return false;
+        }
+        if (!CompressPayload(idFillScalerTileStack, (uint8_t*)packed.data(), packed.size(), request)) {
+            request.mutable_scalers()->swap(packed);
+        }
+    }
+    request.set_x(start[0]);
+    request.set_y(start[1]);
+    request.set_plane(start[2]);
+    request.set_width(size[0]);
+    request.set_height(size[1]);
+    request.set_encodenanos(wireNanos() - encodeStart);
+
+    StatusReply reply;
+
+    ClientContext context;
+    Status status = stub_->FillScalerTileStackV2(&context, request, &reply);
+
+    if (!status.ok()) {
+      std::cout << status.error_code() << ": " << status.error_message()
+                << std::endl;
+    }
+    return true;
+}
+
+bool GrpcNddiDisplay::QuantizeScalers(vector<uint64_t> &scalers, unsigned int plane, QuantizedScalers* quantized) {
+    std::string levels;
+    uint32_t width;
+
+    // Use the first registered quantizer whose planes hold the stack and divide it exactly, falling back to the identity.
+    for (size_t i = 0; i < quantizers_.size(); i++) {
+        if ((plane >= quantizers_[i].firstPlane) &&
+            quantizeScalers(scalers, quantizers_[i].divisors, plane - quantizers_[i].firstPlane, levels, width)) {
+            quantized->set_quantizer(quantizers_[i].id);
+            quantized->set_width(width);
+            quantized->mutable_levels()->swap(levels);
+            return true;
+        }
+    }
+    if (quantizeScalers(scalers, vector<uint32_t>(), 0, levels, width)) {
+        quantized->set_quantizer(0);
+        quantized->set_width(width);
+        quantized->mutable_levels()->swap(levels);
+        return true;
+    }
+
+    return false;
+}
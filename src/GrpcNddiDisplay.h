@@ -10,11 +10,15 @@
  */
 
 #include <grpc++/grpc++.h>
+#include <map>
+#include <pthread.h>
 
 #include "nddi/Features.h"
 #include "nddi/NDimensionalDisplayInterface.h"
 
 #include "nddiwall.grpc.pb.h"
+#include "PayloadHandoff.h"
+#include "TiledCoefficients.h"
 
 using grpc::Channel;
 using grpc::ClientContext;
@@ -25,12 +29,16 @@ using namespace std;
 
 namespace nddi {
 
+    class NddiTransport;
+    class SharedMemoryRing;
+    enum CommandID : unsigned int;
+
     /**
      * \brief Implements and NDDI display where each interface is a GRPC call to the NDDI Wall Server.
      *
      * Implements and NDDI display where each interface is a GRPC call to the NDDI Wall Server.
      */
-    class GrpcNddiDisplay : public NDimensionalDisplayInterface {
+    class GrpcNddiDisplay : public NDimensionalDisplayInterface, public PayloadHandoffDisplay, public TiledCoefficientDisplay {
 
     public:
         /**
@@ -164,6 +172,14 @@ namespace nddi {
          */
         void CopyPixels(Pixel* p, vector<unsigned int> &start, vector<unsigned int> &end);
 
+        /**
+         * \brief Copies the pixels into the designated region of the frame volume, taking ownership of them.
+         *
+         * Copies the pixels into the designated region of the frame volume, taking ownership of them. With an
+         * in-process transport the pixels are moved into the command instead of being copied.
+         */
+        void CopyPixels(vector<Pixel> &&p, vector<unsigned int> &start, vector<unsigned int> &end);
+
         /**
          * \brief Copies the array of pixels into the designated tile regions of the frame volume.
          *
@@ -176,6 +192,14 @@ namespace nddi {
          */
         void CopyPixelTiles(vector<Pixel*> &p, vector<vector<unsigned int> > &starts, vector<unsigned int> &size);
 
+        /**
+         * \brief Copies the tiles into the designated tile regions of the frame volume, taking ownership of them.
+         *
+         * Copies the tiles into the designated tile regions of the frame volume, taking ownership of them. With an
+         * in-process transport the tiles are moved into the command instead of being copied.
+         */
+        void CopyPixelTiles(vector<vector<Pixel> > &&p, vector<vector<unsigned int> > &starts, vector<unsigned int> &size);
+
         /**
          * \brief Fills the frame volume with the specified pixel.
          *
@@ -240,6 +264,20 @@ namespace nddi {
          */
         void FillCoefficientMatrix(vector< vector<int> > &coefficientMatrix, vector<unsigned int> &start, vector<unsigned int> &end);
 
+        /**
+         * \brief Fills a range of the coefficient planes with a coefficient matrix translated for each tile.
+         *
+         * Fills a range of the coefficient planes with a coefficient matrix translated for each tile.
+	 * Builds a FillCoefficientMatrixTiled command and sends it to the server, which derives each tile's
+         * translation from its position.
+         * @param coefficientMatrix The matrix used for the first tile. Its third row holds the translation terms.
+         * @param start This three-element vector specifies the first location of the range in the coefficient planes.
+         * @param end This three-element vector specifies the last location of the range in the coefficient planes.
+         * @param size This two-element vector specifies the width and height of each tile.
+         */
+        void FillCoefficientMatrixTiled(vector< vector<int> > &coefficientMatrix, vector<unsigned int> &start,
+                                        vector<unsigned int> &end, vector<unsigned int> &size);
+
         /**
          * \brief Used to copy the specified single coefficient value from a matrix into a range of locations in the coefficient planes.
          *
@@ -309,6 +347,14 @@ namespace nddi {
          */
         void FillScalerTileStack(vector<uint64_t> &scalers, vector<unsigned int> &start, vector<unsigned int> &size);
 
+        /**
+         * \brief Fills a stack of tiles in the coefficient planes with the scalers, taking ownership of them.
+         *
+         * Fills a stack of tiles in the coefficient planes with the scalers, taking ownership of them. With an
+         * in-process transport the scalers are moved into the command instead of being copied.
+         */
+        void FillScalerTileStack(vector<uint64_t> &&scalers, vector<unsigned int> &start, vector<unsigned int> &size);
+
         /**
          * \brief Allows the bytes of pixel values to be interpretted as signed values when scaling, accumulating, and clamping
          * in the pixel blending pipeline.
@@ -375,8 +421,137 @@ namespace nddi {
          */
         void Shutdown();
 
+        /**
+         * \brief Installs the transport used by every GrpcNddiDisplay created afterwards.
+         *
+         * Installs the transport used by every GrpcNddiDisplay created afterwards. By default no transport
+         * is installed and the commands are sent to the NDDI Wall Server over gRPC. nddiwall_standalone
+         * installs an InProcessNddiTransport so that the commands go straight to the display in the same process.
+         * @param transport The transport to use or NULL to go back to gRPC.
+         */
+        static void SetTransport(NddiTransport* transport);
+
+        /**
+         * \brief Sets the size of the shared memory ring created by every GrpcNddiDisplay created afterwards.
+         *
+         * Sets the size of the shared memory ring created by every GrpcNddiDisplay created afterwards. When
+         * non-zero, each display creates a POSIX shared memory ring of this size and registers it with the
+         * server. The bulk payloads of CopyPixels, CopyPixelTiles, and FillScalerTileStack are then written
+         * into the ring and only their offset and length are sent over gRPC. If the server can't map the
+         * ring (e.g. it's on another host), the payloads are sent inline as usual.
+         * @param bytes The size of the ring in bytes or zero to disable shared memory, which is the default.
+         */
+        static void SetSharedMemorySize(size_t bytes);
+
+        /**
+         * \brief Sets the payload compression requested by every GrpcNddiDisplay created afterwards.
+         *
+         * Sets the payload compression requested by every GrpcNddiDisplay created afterwards. The mode is
+         * negotiated with the server when the display is initialized, and the server falls back to zlib if
+         * it wasn't built with the requested mode. Slaves don't initialize the display and never compress.
+         * @param mode The requested mode. Defaults to COMPRESSION_NONE.
+         */
+        static void SetCompression(nddiwall::Compression mode);
+
+        /**
+         * \brief Sets the minimum payload size at which a command's payload is compressed.
+         *
+         * Sets the minimum payload size at which a command's payload is compressed. Only the bulk payloads of
+         * CopyPixels, CopyPixelTiles, FillScalerTiles, and FillScalerTileStack are ever compressed, and each
+         * defaults to 1024 bytes. Payloads which don't shrink are always sent uncompressed.
+         * @param command The command whose threshold is set.
+         * @param bytes The minimum uncompressed payload size in bytes.
+         */
+        static void SetCompressionThreshold(CommandID command, size_t bytes);
+
+        /**
+         * \brief Selects the wire format used for the tile and stack commands.
+         *
+         * Selects the wire format used for the tile and stack commands. Version 1, the default, sends
+         * scalers and coordinates as repeated varints. Version 2 sends FillCoefficientTiles, FillScalerTiles,
+         * and FillScalerTileStack as little-endian packed blobs with int16 r, g, b scalers and uint16 or uint32
+         * coordinates. Scalers which use their alpha channel can't be packed and are sent in version 1.
+         * @param version The wire format version, either 1 or 2.
+         */
+        static void SetWireFormat(unsigned int version);
+
+        /**
+         * \brief Enables sending stacks of scalers as quantized levels.
+         *
+         * Enables sending stacks of scalers as quantized levels. Only applies to FillScalerTileStack with the
+         * version 2 wire format. Each stack is sent as int8 or int16 levels along with the index of the quantizer
+         * that divides every plane exactly, and the server multiplies the levels back. Stacks no quantizer divides
+         * exactly are still sent with the identity quantizer, which only narrows them. This is lossless.
+         * @param enable True to send quantized levels.
+         */
+        static void SetScalerQuantization(bool enable);
+
+        /**
+         * \brief Registers a table of per-plane divisors with the server.
+         *
+         * Registers a table of per-plane divisors with the server. The DCT tilers register their quantization
+         * matrix in zig-zag order so that their dequantized coefficients can be sent as quantized levels. A stack
+         * which starts part way into the planes is divided by the divisors of the planes it covers.
+         * @param divisors The divisor for each plane, starting with the first plane.
+         * @param firstPlane The plane the first divisor is for. Tilers with several scales register one
+         *                   quantizer for the planes of each scale.
+         */
+        void RegisterScalerQuantizer(vector<uint32_t> &divisors, unsigned int firstPlane = 0);
+
+        /**
+         * \brief Sets the number of gRPC channels shared by every GrpcNddiDisplay created afterwards.
+         *
+         * Sets the number of gRPC channels shared by every GrpcNddiDisplay created afterwards. By default each
+         * display opens its own channel. When non-zero, displays instead take channels from a pool of this many
+         * connections to the server in turn, which lets a player replaying many recordings in one process
+         * spread them over a fixed number of connections.
+         * @param channels The number of pooled channels or zero for one channel per display, which is the default.
+         */
+        static void SetChannelPoolSize(size_t channels);
+
     private:
+        static shared_ptr<Channel> CreateChannel();
+        void RegisterSharedMemory();
+        void UnregisterSharedMemory();
+        uint8_t* ReserveSharedMemory(uint64_t length, uint64_t &offset);
+        template <class T> bool CompressPayload(CommandID command, const uint8_t* src, size_t length, T &request);
+        void FillCoefficientTilesV2(vector<int> &coefficients,
+                                    vector<vector<unsigned int> > &positions,
+                                    vector<vector<unsigned int> > &starts,
+                                    vector<unsigned int> &size);
+        bool FillScalerTilesV2(vector<uint64_t> &scalers,
+                               vector<vector<unsigned int> > &starts,
+                               vector<unsigned int> &size);
+        bool FillScalerTileStackV2(vector<uint64_t> &scalers,
+                                   vector<unsigned int> &start,
+                                   vector<unsigned int> &size);
+        bool QuantizeScalers(vector<uint64_t> &scalers, unsigned int plane, nddiwall::QuantizedScalers* quantized);
+
+        // The divisors registered for the planes from firstPlane on
+        typedef struct {
+            uint32_t          id;
+            unsigned int      firstPlane;
+            vector<uint32_t>  divisors;
+        } scaler_quantizer_t;
+
+        NddiTransport*             transport_;
         unique_ptr<NddiWall::Stub> stub_;
+        SharedMemoryRing*          ring_ = NULL;
+        uint32_t                   ringId_ = 0;
+        uint64_t                   latchSequence_ = 0;
+        nddiwall::Compression      compression_ = nddiwall::COMPRESSION_NONE;
+        vector<scaler_quantizer_t> quantizers_;
+
+        static NddiTransport*      defaultTransport_;
+        static size_t              sharedMemorySize_;
+        static nddiwall::Compression requestedCompression_;
+        static map<unsigned int, size_t> compressionThresholds_;
+        static unsigned int        wireFormat_;
+        static bool                scalerQuantization_;
+        static size_t              channelPoolSize_;
+        static vector< shared_ptr<Channel> > channelPool_;
+        static size_t              nextChannel_;
+        static pthread_mutex_t     channelPoolMutex_;
 
     };
 
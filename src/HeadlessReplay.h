@@ -0,0 +1,255 @@
+#ifndef HEADLESS_REPLAY_H
+#define HEADLESS_REPLAY_H
+
+/**
+ * \file HeadlessReplay.h
+ *
+ * \brief This file embodies the replay of a recording straight into a headless display in the same process.
+ *
+ * This file embodies the replay of a recording straight into a headless display in the same process.
+ * Evaluating a recording's cost-model numbers doesn't need the NDDI Wall Server or the gRPC path, so the
+ * recorded commands are decoded and played directly into a headless SimpleNddiDisplay which is configured
+ * from the recording's Init command. Each latch renders the display the way a server built without OpenGL
+ * does, so the cost model ends up with the same numbers.
+ */
+
+#include <iostream>
+#include <stdint.h>
+#include <string>
+
+#include "nddi/SimpleNddiDisplay.h"
+
+#include "CostModelCsv.h"
+#include "NddiCommands.h"
+#include "RecordingFormat.h"
+
+namespace nddi {
+
+    /** Number of decoded messages kept for reuse per command type. */
+    #define HEADLESS_POOL_CAPACITY 1024
+
+    /**
+     * \brief Notified of every command a HeadlessReplay plays.
+     */
+    class HeadlessReplayObserver {
+    public:
+        virtual ~HeadlessReplayObserver() {}
+
+        /**
+         * \brief Called once a command has been played.
+         *
+         * Called once a command has been played.
+         * @param msg The command.
+         * @param linkBytes The link bytes the display's cost model charged for the command.
+         */
+        virtual void Played(NddiCommandMessage* msg, long linkBytes) = 0;
+    };
+
+    /**
+     * \brief Plays a v2 recording frame by frame into a headless display.
+     */
+    class HeadlessReplay {
+    public:
+        /**
+         * \brief Opens a recording for replay.
+         *
+         * Opens a recording for replay.
+         * @param file The v2 recording.
+         * @param rendering Whether each latch renders the display. Tools which only need the link charges
+         *                  can skip rendering.
+         */
+        HeadlessReplay(std::string file, bool rendering = true)
+        : file_(file),
+          reader_(file),
+          rendering_(rendering),
+          observer_(NULL),
+          display_(NULL),
+          pool_(HEADLESS_POOL_CAPACITY),
+          frame_(0),
+          latches_(0),
+          linkSavings_(0),
+          commandSavings_(0),
+          nanos_(0) {
+        }
+
+        ~HeadlessReplay() {
+            if (display_) {
+                delete display_;
+            }
+        }
+
+        bool IsOpen() { return reader_.IsOpen(); }
+        std::string Error() { return reader_.Error(); }
+        std::string File() { return file_; }
+        const recording_header_t& Header() { return reader_.Header(); }
+
+        /** Sets the observer notified of every command played, or NULL for none. */
+        void SetObserver(HeadlessReplayObserver* observer) { observer_ = observer; }
+
+        /** Number of frames in the recording. */
+        uint64_t FrameCount() { return reader_.FrameCount(); }
+
+        /** Number of frames played so far. */
+        uint64_t Frame() { return frame_; }
+
+        /** Number of latches rendered so far. */
+        long Latches() { return latches_; }
+
+        /** Time spent playing, in seconds. */
+        double Seconds() { return nanos_ / 1000000000.0; }
+
+        /** The display, which is NULL until the recording's Init command is played. */
+        SimpleNddiDisplay* Display() { return display_; }
+
+        /**
+         * \brief Plays the next frame.
+         *
+         * Plays the next frame.
+         * @return False once every frame has been played or if a record is corrupt.
+         */
+        bool NextFrame() {
+            if (frame_ >= reader_.FrameCount()) {
+                return false;
+            }
+            uint64_t start = recordingNanos();
+            uint64_t offset = reader_.FrameOffset(frame_);
+            uint64_t end = reader_.FrameOffset(frame_ + 1);
+            NddiCommandMessage* msg;
+            while ((offset < end) && reader_.Next(offset, msg, &pool_)) {
+                if (observer_) {
+                    long before = display_ ? display_->GetCostModel()->getLinkBytesTransmitted() - linkSavings_ : 0;
+                    play(msg);
+                    long after = display_ ? display_->GetCostModel()->getLinkBytesTransmitted() - linkSavings_ : 0;
+                    // Clearing the cost model charges nothing, it just forgets the earlier charges
+                    observer_->Played(msg, (after > before) ? after - before : 0);
+                } else {
+                    play(msg);
+                }
+                pool_.Recycle(msg);
+            }
+            frame_++;
+            nanos_ += recordingNanos() - start;
+            return offset >= end;
+        }
+
+        /**
+         * \brief Skips ahead to a frame, the way nddiwall_player --from-frame does.
+         *
+         * Skips ahead to a frame, the way nddiwall_player --from-frame does. The Init command and frame 0 are
+         * played first if they haven't been, since they set up the display, and the frames between are skipped.
+         * @param frame The next frame to play.
+         * @return False if frame 0 has a corrupt record.
+         */
+        bool Seek(uint64_t frame) {
+            if ((frame_ == 0) && !NextFrame()) {
+                return false;
+            }
+            if (frame > frame_) {
+                frame_ = frame;
+            }
+            return true;
+        }
+
+        /**
+         * \brief Plays every remaining frame.
+         *
+         * Plays every remaining frame.
+         * @return False if a record is corrupt.
+         */
+        bool Run() {
+            while (NextFrame()) {}
+            return frame_ >= reader_.FrameCount();
+        }
+
+        /**
+         * \brief Writes the CSV row which the NDDI Wall Server prints for the same commands.
+         */
+        void OutputCsv(std::ostream &os) {
+            if (display_) {
+                outputCostCsv(os, display_->GetCostModel(), latches_, linkSavings_, commandSavings_);
+            }
+        }
+
+    private:
+        void play(NddiCommandMessage* msg) {
+            if (msg->id == idInit) {
+                InitCommandMessage* init = (InitCommandMessage*)msg;
+                if (!display_) {
+                    display_ = new SimpleNddiDisplay(init->frameVolumeDimensionalSizes,
+                                                     init->displayWidth, init->displayHeight,
+                                                     init->numCoefficientPlanes,
+                                                     init->inputVectorSize,
+                                                     true,                            // Is headless
+                                                     init->fixed8x8Macroblocks,
+                                                     init->useSingleCoeffcientPlane);
+                }
+                return;
+            }
+            if (!display_) {
+                return;
+            }
+
+            switch (msg->id) {
+            #define HEADLESS_PLAY_CASE(m) \
+            case id ## m : \
+                ((m ## CommandMessage*)msg)->play(display_); \
+                break;
+            HEADLESS_PLAY_CASE(DisplayWidth)
+            HEADLESS_PLAY_CASE(DisplayHeight)
+            HEADLESS_PLAY_CASE(NumCoefficientPlanes)
+            HEADLESS_PLAY_CASE(PutPixel)
+            HEADLESS_PLAY_CASE(CopyPixelStrip)
+            HEADLESS_PLAY_CASE(CopyPixels)
+            HEADLESS_PLAY_CASE(CopyPixelTiles)
+            HEADLESS_PLAY_CASE(FillPixel)
+            HEADLESS_PLAY_CASE(CopyFrameVolume)
+            HEADLESS_PLAY_CASE(UpdateInputVector)
+            HEADLESS_PLAY_CASE(PutCoefficientMatrix)
+            HEADLESS_PLAY_CASE(FillCoefficientMatrix)
+            HEADLESS_PLAY_CASE(FillCoefficient)
+            HEADLESS_PLAY_CASE(FillCoefficientTiles)
+            HEADLESS_PLAY_CASE(FillScaler)
+            HEADLESS_PLAY_CASE(FillScalerTiles)
+            HEADLESS_PLAY_CASE(FillScalerTileStack)
+            HEADLESS_PLAY_CASE(SetPixelByteSignMode)
+            HEADLESS_PLAY_CASE(SetFullScaler)
+            HEADLESS_PLAY_CASE(GetFullScaler)
+            case idFillCoefficientMatrixTiled:
+                // Charged like the NDDI Wall Server charges it, which expands it the same way
+                linkSavings_ += ((FillCoefficientMatrixTiledCommandMessage*)msg)->play(display_, &commandSavings_);
+                break;
+            case idClearCostModel:
+                display_->GetCostModel()->clearCosts();
+                linkSavings_ = 0;
+                commandSavings_ = 0;
+                break;
+            case idLatch: {
+                LatchCommandMessage* latch = (LatchCommandMessage*)msg;
+                if (rendering_) {
+                    display_->SimulateRender(latch->sub_x, latch->sub_y, latch->sub_w, latch->sub_h);
+                }
+                latches_++;
+            }
+            break;
+            case idShutdown:
+            default:
+                break;
+            }
+        }
+
+        std::string              file_;
+        RecordingReader          reader_;
+        bool                     rendering_;
+        HeadlessReplayObserver*  observer_;
+        SimpleNddiDisplay*       display_;
+        CommandPool              pool_;
+        uint64_t                 frame_;
+        long                     latches_;
+        long                     linkSavings_;
+        long                     commandSavings_;
+        uint64_t                 nanos_;
+    };
+
+}
+
+#endif // HEADLESS_REPLAY_H
@@ -12,6 +12,7 @@
 #include "PixelBridgeFeatures.h"
 #include "Configuration.h"
 #include "ItTiler.h"
+#include "PixelConvert.h"
 
 /**
  * Using a #define because it's used for floats and ints.
@@ -51,7 +52,12 @@ ItTiler::ItTiler(size_t display_width, size_t display_height,
 
 : qp(0),
   display_width_(display_width),
-  display_height_(display_height)
+  display_height_(display_height),
+  frames_(0),
+  link_bytes_(0),
+  scaler_writes_(0),
+  full_link_bytes_(0),
+  full_scaler_writes_(0)
 {
     quiet_ = !globalConfiguration.verbose;
 
@@ -80,6 +86,7 @@ ItTiler::ItTiler(size_t display_width, size_t display_height,
             display_ = new GrpcNddiDisplay();
         }
     }
+    handoff_.Attach(display_);
 
     // Set the full scaler value
     display_->SetFullScaler(MAX_IT_COEFF);
@@ -300,19 +307,18 @@ void ItTiler::InitializeCoefficientPlanes() {
     start.push_back(0); start.push_back(0); start.push_back(0);
     end.push_back(0); end.push_back(0); end.push_back(0);
 
-    // Break the display into macroblocks and initialize each 4x4x48 cube of coefficients to pick out the proper block from the frame volume
-    for (int k = 0; k < FRAMEVOLUME_DEPTH; k++) {
-        for (int j = 0; j < (display_height_ / BLOCK_HEIGHT); j++) {
-            for (int i = 0; i < (display_width_ / BLOCK_WIDTH); i++) {
-                coeffs[2][0] = -i * BLOCK_WIDTH;
-                coeffs[2][1] = -j * BLOCK_HEIGHT;
-                coeffs[2][2] = k;
-                start[0] = i * BLOCK_WIDTH; start[1] = j * BLOCK_HEIGHT; start[2] = k;
-                end[0] = (i + 1) * BLOCK_WIDTH - 1; end[1] = (j + 1) * BLOCK_HEIGHT - 1; end[2] = k;
-                if (end[0] >= display_width_) { end[0] = display_width_ - 1; }
-                if (end[1] >= display_height_) { end[1] = display_height_ - 1; }
-                display_->FillCoefficientMatrix(coeffs, start, end);
-            }
+    // Break the display into macroblocks and initialize each 4x4x48 cube of coefficients to pick out the proper block from the frame volume.
+    // The display derives each macroblock's translation from the first one's, and then each plane gets its k.
+    vector<unsigned int> size;
+    size.push_back(BLOCK_WIDTH); size.push_back(BLOCK_HEIGHT);
+    if ((display_width_ >= BLOCK_WIDTH) && (display_height_ >= BLOCK_HEIGHT)) {
+        end[0] = (display_width_ / BLOCK_WIDTH) * BLOCK_WIDTH - 1;
+        end[1] = (display_height_ / BLOCK_HEIGHT) * BLOCK_HEIGHT - 1;
+        end[2] = FRAMEVOLUME_DEPTH - 1;
+        fillCoefficientMatrixTiled(display_, coeffs, start, end, size);
+        for (int k = 1; k < FRAMEVOLUME_DEPTH; k++) {
+            start[2] = k; end[2] = k;
+            display_->FillCoefficient(k, 2, 2, start, end);
         }
     }
 
@@ -391,7 +397,7 @@ void ItTiler::InitializeFrameVolume() {
 }
 
 void ItTiler::UpdateDisplay(uint8_t* buffer, size_t width, size_t height) {
-    vector<unsigned int> start(3, 0), end(3, 0);
+    vector<unsigned int> start(3, 0);
     vector<unsigned int> size(2, 0);
     size_t lastNonZeroPlane;
     static size_t largestNonZeroPlaneSeen = 0;
@@ -403,14 +409,26 @@ void ItTiler::UpdateDisplay(uint8_t* buffer, size_t width, size_t height) {
     size[0] = BLOCK_WIDTH;
     size[1] = BLOCK_HEIGHT;
 
-    /* Clear all scalers */
-    // TODO(CDE): Don't do this in the future. Just write enough planes to overwrite the last known non-zero plane.
-    start[0] = 0; start[1] = 0; start[2] = 0;
-    end[0] = display_width_ - 1;
-    end[1] = display_height_ - 1;
-    end[2] = FRAMEVOLUME_DEPTH - 1;
-    s.packed = 0;
-    display_->FillScaler(s, start, end);
+    /*
+     * The scalers aren't cleared. Each block's stack is instead compared with what it last left on the
+     * display, and only the planes which differ are sent, which includes zeroing the planes a stack shrank from.
+     * Clearing every plane would have cost one FillScaler over the whole display and then every whole stack.
+     */
+    frames_++;
+    full_link_bytes_ += BYTES_PER_SCALER + CALC_BYTES_FOR_CP_COORD_TRIPLES(2);
+    full_scaler_writes_ += display_width_ * display_height_ * FRAMEVOLUME_DEPTH;
+    sentCoefficients_.resize(CEIL(display_width_, BLOCK_WIDTH) * CEIL(display_height_, BLOCK_HEIGHT));
+
+    /* Split the frame into a plane per color channel, which the blocks are then copied out of. */
+    red_.resize(width * height);
+    green_.resize(width * height);
+    blue_.resize(width * height);
+#ifdef USE_OMP
+#pragma omp parallel for
+#endif
+    for (size_t y = 0; y < height; y++) {
+        rgbToPlanar(buffer + y * width * 3, &red_[y * width], &green_[y * width], &blue_[y * width], width);
+    }
 
     /*
      * Produces the coefficients for the input buffer using a forward 4x4 integer transform
@@ -440,10 +458,9 @@ void ItTiler::UpdateDisplay(uint8_t* buffer, size_t width, size_t height) {
                         greenImgBlock[v * BLOCK_WIDTH + u] = 0;
                         blueImgBlock[v * BLOCK_WIDTH + u] = 0;
                     } else {
-                        offset *= 3;
-                        redImgBlock[v * BLOCK_WIDTH + u] = buffer[offset++];
-                        greenImgBlock[v * BLOCK_WIDTH + u] = buffer[offset++];
-                        blueImgBlock[v * BLOCK_WIDTH + u] = buffer[offset++];
+                        redImgBlock[v * BLOCK_WIDTH + u] = red_[offset];
+                        greenImgBlock[v * BLOCK_WIDTH + u] = green_[offset];
+                        blueImgBlock[v * BLOCK_WIDTH + u] = blue_[offset];
                     }
                 }
             }
@@ -453,7 +470,8 @@ void ItTiler::UpdateDisplay(uint8_t* buffer, size_t width, size_t height) {
             forwardIntegerTransform(greenCoeffsBlock, greenImgBlock);
             forwardIntegerTransform(blueCoeffsBlock, blueImgBlock);
 
-            /* Then update the coefficients */
+            /* Then update the coefficients, with the scaler's unused alpha zeroed */
+            s.packed = 0;
             for (int v = 0; v < BLOCK_HEIGHT; v++) {
                 for (int u = 0; u < BLOCK_WIDTH; u++) {
                     size_t p = zigZag_[v * BLOCK_WIDTH + u];
@@ -471,10 +489,47 @@ void ItTiler::UpdateDisplay(uint8_t* buffer, size_t width, size_t height) {
                 largestNonZeroPlaneSeen = lastNonZeroPlane;
             }
 
-            /* Send the NDDI command to update this macroblock's coefficients, one plane at a time. */
+            /* Find the first and last planes which differ from what this macroblock last left on the display */
+            vector<uint64_t> &sent = sentCoefficients_[j * CEIL(display_width_, BLOCK_WIDTH) + i];
+            size_t planes = MAX(coefficients.size(), sent.size());
+            size_t first = planes, last = 0;
+            for (size_t k = 0; k < planes; k++) {
+                uint64_t c = (k < coefficients.size()) ? coefficients[k] : 0;
+                uint64_t o = (k < sent.size()) ? sent[k] : 0;
+                if (c != o) {
+                    if (first == planes) {
+                        first = k;
+                    }
+                    last = k;
+                }
+            }
+
+            size_t pixels = MIN((size_t)BLOCK_WIDTH, display_width_ - i * BLOCK_WIDTH) * MIN((size_t)BLOCK_HEIGHT, display_height_ - j * BLOCK_HEIGHT);
+            full_link_bytes_ += BYTES_PER_SCALER * coefficients.size()
+                              + CALC_BYTES_FOR_CP_COORD_TRIPLES(1) + CALC_BYTES_FOR_TILE_COORD_DOUBLES(1);
+            full_scaler_writes_ += pixels * coefficients.size();
+
+            /* Nothing to send if every plane is unchanged */
+            if (first == planes) {
+                continue;
+            }
+
+            /* The planes the stack shrank from are overwritten with zeros */
+            vector<uint64_t> stack(last - first + 1, 0);
+            for (size_t k = first; (k <= last) && (k < coefficients.size()); k++) {
+                stack[k - first] = coefficients[k];
+            }
+            sent.swap(coefficients);
+
+            link_bytes_ += BYTES_PER_SCALER * stack.size()
+                         + CALC_BYTES_FOR_CP_COORD_TRIPLES(1) + CALC_BYTES_FOR_TILE_COORD_DOUBLES(1);
+            scaler_writes_ += pixels * stack.size();
+
+            /* Send the NDDI command to update this macroblock's changed coefficients, one plane at a time. */
             start[0] = i * BLOCK_WIDTH;
             start[1] = j * BLOCK_HEIGHT;
-            display_->FillScalerTileStack(coefficients, start, size);
+            start[2] = first;
+            handoff_.FillScalerTileStack(std::move(stack), start, size);
         }
     }
 }
@@ -35,6 +35,12 @@ public:
     ItTiler(size_t display_width, size_t display_height, size_t quality, string file = "");
 
     ~ItTiler() {
+        if (frames_) {
+            cerr << "IT Link Bytes Per Frame: " << (double)link_bytes_ / (double)frames_
+                 << " (" << (double)full_link_bytes_ / (double)frames_ << " clearing every plane)"
+                 << " Scaler Writes Per Frame: " << (double)scaler_writes_ / (double)frames_
+                 << " (" << (double)full_scaler_writes_ / (double)frames_ << " clearing every plane)" << endl;
+        }
     }
 
     /**
@@ -82,9 +88,21 @@ private:
     uint32_t qp6;
 
     NDimensionalDisplayInterface  *display_;
+    PayloadHandoff                handoff_;
     size_t            display_width_, display_height_;
     bool              quiet_;
     int               zigZag_[BLOCK_SIZE];
+
+    // The frame split into a plane per color channel
+    vector<int16_t>   red_, green_, blue_;
+
+    // The coefficients each block last left on the display, which holds zeros above them
+    vector< vector<uint64_t> >  sentCoefficients_;
+
+    // What was sent versus what clearing every plane and sending every whole stack would have cost
+    size_t            frames_;
+    uint64_t          link_bytes_, scaler_writes_;
+    uint64_t          full_link_bytes_, full_scaler_writes_;
 };
 
 #endif /* defined(__pixelbridge__ItTiler__) */
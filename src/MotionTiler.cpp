@@ -0,0 +1,648 @@
+/*
+ *  MotionTiler.cpp
+ *  pixelbridge
+ *
+ */
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+
+#include "PixelBridgeFeatures.h"
+#include "Configuration.h"
+#include "MotionTiler.h"
+#include "PixelConvert.h"
+
+
+/**
+ * The MotionTiler is created based on the dimensions of the NDDI display that's passed in. If those
+ * dimensions change, then the MotionTiler should be destroyed and re-created.
+ */
+MotionTiler::MotionTiler (size_t display_width, size_t display_height,
+                          size_t tile_width, size_t tile_height,
+                          size_t search, size_t threshold, size_t slices,
+                          string file)
+: display_width_(display_width),
+  display_height_(display_height),
+  tile_width_(tile_width),
+  tile_height_(tile_height),
+  search_((int)search),
+  threshold_(threshold),
+  slices_(slices ? slices : 1)
+{
+    quiet_ = !globalConfiguration.verbose;
+
+    assert(!globalConfiguration.isSlave && "Slave support not implemented for this mode!");
+    assert(globalConfiguration.scale == 1 && "Scaling not supported for this mode!");
+
+    // 3 dimensional matching the Video Width x Height x slices
+    vector<unsigned int> fvDimensions;
+    fvDimensions.push_back(display_width);
+    fvDimensions.push_back(display_height);
+    fvDimensions.push_back(slices_);
+
+    if (file.length()) {
+        display_ = new RecorderNddiDisplay(fvDimensions,
+                    display_width, display_height,
+                    (unsigned int)1,
+                    (unsigned int)3,
+                    file);
+    } else {
+        if (!globalConfiguration.isSlave) {
+            display_ = new GrpcNddiDisplay(fvDimensions,
+                        display_width, display_height,
+                        (unsigned int)1,
+                        (unsigned int)3);
+        } else {
+            display_ = new GrpcNddiDisplay();
+        }
+    }
+    handoff_.Attach(display_);
+
+    // Compute tile_map width
+    tile_map_width_ = display_width_ / tile_width;
+    if ((tile_map_width_ * tile_width) < display_width_) { tile_map_width_++; }
+
+    // Compute tile_map height
+    tile_map_height_ = display_height_ / tile_height;
+    if ((tile_map_height_ * tile_height) < display_height_) { tile_map_height_++; }
+
+    // Every tile starts out showing its own region of the first slice
+    size_t tiles = tile_map_width_ * tile_map_height_;
+    sources_.resize(tiles);
+    for (size_t t = 0; t < tiles; t++) {
+        sources_[t].x = (t % tile_map_width_) * tile_width_;
+        sources_[t].y = (t / tile_map_width_) * tile_height_;
+        sources_[t].z = 0;
+    }
+    next_sources_ = sources_;
+    actions_.resize(tiles, TILE_KEEP);
+    occupants_.resize(tiles * slices_);
+
+    // Set statistics to zero
+    unchanged_tiles_ = moved_tiles_ = uploaded_tiles_ = displaced_tiles_ = frames_ = 0;
+    squared_error_ = samples_ = 0.0;
+
+    // Initialize Input Vector
+    vector<int> iv;
+    iv.push_back(1);
+    display_->UpdateInputVector(iv);
+
+    // Initialize Frame Volume and the copy of it
+    nddi::Pixel p;
+    p.r = p.g = p.b = p.a = 0xff;
+    vector<unsigned int> start, end;
+    start.push_back(0); start.push_back(0); start.push_back(0);
+    end.push_back(display_width - 1); end.push_back(display_height - 1); end.push_back(slices_ - 1);
+    display_->FillPixel(p, start, end);
+    mirror_.assign(display_width_ * display_height_ * slices_ * 3, 0xff);
+
+    // Initialize Coefficient Planes
+    InitializeCoefficientPlanes();
+}
+
+MotionTiler::~MotionTiler()
+{
+    cerr << "Motion Tiles Unchanged: " << unchanged_tiles_ << " Moved: " << moved_tiles_
+         << " Uploaded: " << uploaded_tiles_ << " Displaced: " << displaced_tiles_ << endl;
+    if (globalConfiguration.PSNR && samples_ > 0.0) {
+        if (squared_error_ > 0.0) {
+            cerr << "Motion Tiler PSNR (dB): " << 10.0 * log10(255.0 * 255.0 * samples_ / squared_error_) << endl;
+        } else {
+            cerr << "Motion Tiler PSNR (dB): inf" << endl;
+        }
+    }
+}
+
+/**
+ * Returns the Display created and initialized by the tiler.
+ */
+NDimensionalDisplayInterface* MotionTiler::GetDisplay() {
+    return display_;
+}
+
+/**
+ * Initializes the Coefficient Planes for this tiler. Every tile starts out with the identity matrix, so
+ * it shows its own region of the first slice.
+ */
+void MotionTiler::InitializeCoefficientPlanes() {
+
+    vector< vector<int> > coeffs;
+    coeffs.resize(3);
+    coeffs[0].push_back(1); coeffs[0].push_back(0); coeffs[0].push_back(0);
+    coeffs[1].push_back(0); coeffs[1].push_back(1); coeffs[1].push_back(0);
+    coeffs[2].push_back(0); coeffs[2].push_back(0); coeffs[2].push_back(0);
+
+    vector<unsigned int> start, end;
+    start.push_back(0); start.push_back(0); start.push_back(0);
+    end.push_back(display_width_ - 1); end.push_back(display_height_ - 1); end.push_back(0);
+
+    display_->FillCoefficientMatrix(coeffs, start, end);
+
+    // Turn off all planes and then set the 0 plane to full on.
+    end[2] = display_->NumCoefficientPlanes() - 1;
+    Scaler s;
+    s.packed = 0;
+    display_->FillScaler(s, start, end);
+    end[2] = 0;
+    s.r = s.g = s.b = display_->GetFullScaler();
+    display_->FillScaler(s, start, end);
+}
+
+/**
+ * Update the tile sources, the frame volume, and then the NDDI display based on the frame that's passed in.
+ * The frame is returned from the ffmpeg player as an RGB buffer. There is not Alpha channel.
+ *
+ * @param buffer Pointer to an RGB buffer
+ * @param width The width of the RGB buffer
+ * @param height The height of the RGB buffer
+ */
+void MotionTiler::UpdateDisplay(uint8_t* buffer, size_t width, size_t height)
+{
+    long    tiles = (long)(tile_map_width_ * tile_map_height_);
+    int     unchanged = 0, moved = 0, uploaded = 0;
+
+    assert(width >= display_width_);
+    assert(height >= display_height_);
+
+    // Search for a source for every tile. The frame volume isn't touched until every tile has been searched,
+    // so the tiles are independent and split between threads.
+#ifdef USE_OMP
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+    for (long t = 0; t < tiles; t++) {
+        SearchTile(buffer, width, t);
+    }
+
+    // Pick where the uploaded tiles are copied into the frame volume, which may mean uploading more tiles
+    uploads_.clear();
+    for (long t = 0; t < tiles; t++) {
+        if (actions_[t] == TILE_UPLOAD) {
+            uploads_.push_back(t);
+        }
+    }
+    PlaceUploads();
+
+    // Add up the error of the tiles which aren't uploaded, before the frame volume changes under them
+    if (globalConfiguration.PSNR) {
+        double squared_error = 0.0;
+#ifdef USE_OMP
+#pragma omp parallel for schedule(dynamic, 64) reduction(+:squared_error)
+#endif
+        for (long t = 0; t < tiles; t++) {
+            if (actions_[t] != TILE_UPLOAD) {
+                size_t tw, th;
+                TileSize(t, tw, th);
+                size_t offset = 3 * ((t / tile_map_width_) * tile_height_ * width + (t % tile_map_width_) * tile_width_);
+                squared_error += blockSse(buffer + offset, width * 3,
+                                          Mirror(next_sources_[t]), display_width_ * 3,
+                                          tw * 3, th);
+            }
+        }
+        squared_error_ += squared_error;
+        samples_ += display_width_ * display_height_ * 3;
+    }
+
+    // Copy the uploaded tiles out of the buffer and into the copy of the frame volume
+    if (tile_pixels_.size() < uploads_.size()) {
+        tile_pixels_.resize(uploads_.size());
+    }
+#ifdef USE_OMP
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+    for (long k = 0; k < (long)uploads_.size(); k++) {
+        ExtractTile(buffer, width, uploads_[k], tile_pixels_[k]);
+    }
+
+    // Send the pixels of the uploaded tiles in order. Tiles in the last column and row are sent on their own
+    // in copy mode, because the display only cuts tiles short at the edge of the frame volume.
+    vector<unsigned int> size;
+    size.push_back(tile_width_); size.push_back(tile_height_);
+#ifdef USE_COPY_PIXEL_TILES
+    vector<vector<Pixel> > tiles_list;
+    vector<vector<unsigned int> > starts;
+#endif
+    for (size_t k = 0; k < uploads_.size(); k++) {
+        size_t tw, th;
+        TileSize(uploads_[k], tw, th);
+        const source_t &source = next_sources_[uploads_[k]];
+
+        vector<unsigned int> start, end;
+        start.push_back(source.x); start.push_back(source.y); start.push_back(source.z);
+#ifdef USE_COPY_PIXEL_TILES
+        if ((tw == tile_width_) && (th == tile_height_)) {
+            starts.push_back(start);
+            tiles_list.push_back(std::move(tile_pixels_[k]));
+            continue;
+        }
+#endif
+        end.push_back(source.x + tw - 1); end.push_back(source.y + th - 1); end.push_back(source.z);
+
+        handoff_.CopyPixels(std::move(tile_pixels_[k]), start, end);
+    }
+#ifdef USE_COPY_PIXEL_TILES
+    if (tiles_list.size() > 0) {
+        handoff_.CopyPixelTiles(std::move(tiles_list), starts, size);
+    }
+#endif
+
+    // Point the coefficient matrices of the tiles whose sources changed at their new sources
+    for (long t = 0; t < tiles; t++) {
+        const source_t &from = sources_[t], &to = next_sources_[t];
+        int home_x = (t % tile_map_width_) * tile_width_, home_y = (t / tile_map_width_) * tile_height_;
+
+        vector<unsigned int> start;
+        start.push_back(home_x); start.push_back(home_y); start.push_back(0);
+
+        if (to.x != from.x) {
+            vector<unsigned int> position;
+            position.push_back(2); position.push_back(0);
+            coefficients_list.push_back(to.x - home_x);
+            coefficient_positions_list.push_back(position);
+            coefficient_plane_starts_list.push_back(start);
+        }
+        if (to.y != from.y) {
+            vector<unsigned int> position;
+            position.push_back(2); position.push_back(1);
+            coefficients_list.push_back(to.y - home_y);
+            coefficient_positions_list.push_back(position);
+            coefficient_plane_starts_list.push_back(start);
+        }
+        if (to.z != from.z) {
+            vector<unsigned int> position;
+            position.push_back(2); position.push_back(2);
+            coefficients_list.push_back(to.z);
+            coefficient_positions_list.push_back(position);
+            coefficient_plane_starts_list.push_back(start);
+        }
+
+        switch (actions_[t]) {
+            case TILE_KEEP:   unchanged++; break;
+            case TILE_MOVE:   moved++; break;
+            case TILE_UPLOAD: uploaded++; break;
+        }
+    }
+    if (coefficients_list.size() > 0) {
+        display_->FillCoefficientTiles(coefficients_list,
+                                       coefficient_positions_list,
+                                       coefficient_plane_starts_list,
+                                       size);
+    }
+    coefficients_list.clear();
+    coefficient_positions_list.clear();
+    coefficient_plane_starts_list.clear();
+
+    sources_.swap(next_sources_);
+
+    // Report update statistics
+    unchanged_tiles_ += unchanged;
+    moved_tiles_ += moved;
+    uploaded_tiles_ += uploaded;
+    frames_++;
+
+    if (!quiet_) {
+        cout << "Motion Tiling Statistics:" << endl << "  unchanged tiles: " << unchanged_tiles_ << " tiles moved: " << moved_tiles_
+             << " tiles uploaded: " << uploaded_tiles_ << " tiles displaced: " << displaced_tiles_ << endl;
+    }
+}
+
+/**
+ * Chooses the action and source of one tile for the current frame. The tile is kept if its current source
+ * still matches. Otherwise the tile's home in each slice and the sources predicted by its neighbors' motion
+ * are tried, and then every offset within the search window around the best of them. The tile is uploaded
+ * if none of them match. This is called from several threads at once, so it only writes the tile's own
+ * action and next source.
+ *
+ * @param buffer Pointer to an RGB buffer
+ * @param width The width of the RGB buffer
+ * @param t The index of the tile in the tile map
+ */
+void MotionTiler::SearchTile(uint8_t* buffer, size_t width, size_t t) {
+
+    size_t          tw, th;
+    TileSize(t, tw, th);
+    unsigned long   limit = threshold_ * tw * th * 3;
+    const source_t &current = sources_[t];
+
+    // Keep the current source if it still matches
+    if (MatchBlock(buffer, width, t, current, limit) <= limit) {
+        actions_[t] = TILE_KEEP;
+        next_sources_[t] = current;
+        return;
+    }
+
+    int             home_x = (t % tile_map_width_) * tile_width_, home_y = (t / tile_map_width_) * tile_height_;
+    source_t        best = current;
+    unsigned long   best_sad = ~0UL;
+
+    // Gather the predicted sources. The neighbors' motion is from the last frame, since the tiles are searched in parallel.
+    vector<source_t> candidates;
+    candidates.reserve(slices_ + 4);
+    for (size_t z = 0; z < slices_; z++) {
+        source_t home = { home_x, home_y, (unsigned int)z };
+        candidates.push_back(home);
+    }
+    size_t neighbors[4];
+    size_t count = 0;
+    if (t % tile_map_width_ > 0)                      { neighbors[count++] = t - 1; }
+    if (t % tile_map_width_ < tile_map_width_ - 1)    { neighbors[count++] = t + 1; }
+    if (t >= tile_map_width_)                         { neighbors[count++] = t - tile_map_width_; }
+    if (t + tile_map_width_ < sources_.size())        { neighbors[count++] = t + tile_map_width_; }
+    for (size_t k = 0; k < count; k++) {
+        const source_t &neighbor = sources_[neighbors[k]];
+        source_t moved = { home_x + neighbor.x - (int)((neighbors[k] % tile_map_width_) * tile_width_),
+                           home_y + neighbor.y - (int)((neighbors[k] / tile_map_width_) * tile_height_),
+                           neighbor.z };
+        candidates.push_back(moved);
+    }
+
+    // The best prediction is the center of the search
+    for (size_t k = 0; k < candidates.size(); k++) {
+        if (SourceInBounds(t, candidates[k])) {
+            unsigned long sad = MatchBlock(buffer, width, t, candidates[k], best_sad);
+            if (sad < best_sad) {
+                best = candidates[k];
+                best_sad = sad;
+            }
+        }
+    }
+
+    // Search every offset in the window unless a prediction already matched
+    if (best_sad > limit) {
+        source_t center = best;
+        for (int dy = -search_; dy <= search_; dy++) {
+            for (int dx = -search_; dx <= search_; dx++) {
+                source_t candidate = { center.x + dx, center.y + dy, center.z };
+                if ((dx || dy) && SourceInBounds(t, candidate)) {
+                    unsigned long sad = MatchBlock(buffer, width, t, candidate, best_sad);
+                    if (sad < best_sad) {
+                        best = candidate;
+                        best_sad = sad;
+                    }
+                }
+            }
+        }
+    }
+
+    if (best_sad <= limit) {
+        actions_[t] = TILE_MOVE;
+        next_sources_[t] = best;
+    } else {
+        actions_[t] = TILE_UPLOAD;
+        next_sources_[t] = current;
+    }
+}
+
+/**
+ * Compares a tile of the frame with a block of the copy of the frame volume.
+ *
+ * @param buffer Pointer to an RGB buffer
+ * @param width The width of the RGB buffer
+ * @param t The index of the tile in the tile map
+ * @param source The top left corner of the block in the frame volume
+ * @param limit The difference beyond which the block is of no interest
+ * @return The sum of absolute differences, or some value greater than limit
+ */
+unsigned long MotionTiler::MatchBlock(uint8_t* buffer, size_t width, size_t t, const source_t &source, unsigned long limit) {
+    size_t tw, th;
+    TileSize(t, tw, th);
+    size_t offset = 3 * ((t / tile_map_width_) * tile_height_ * width + (t % tile_map_width_) * tile_width_);
+
+    return blockSad(buffer + offset, width * 3, Mirror(source), display_width_ * 3, tw * 3, th, limit);
+}
+
+/**
+ * Determines whether a tile's source lies within the frame volume.
+ */
+bool MotionTiler::SourceInBounds(size_t t, const source_t &source) {
+    size_t tw, th;
+    TileSize(t, tw, th);
+
+    return (source.x >= 0) && (source.y >= 0) && (source.z < slices_) &&
+           (source.x + tw <= display_width_) && (source.y + th <= display_height_);
+}
+
+/**
+ * Adds a tile to or removes it from the lists of tiles whose sources overlap each tile-sized region of the
+ * slice its next source is in.
+ *
+ * @param t The index of the tile in the tile map
+ * @param occupy Whether to add the tile to the lists or remove it
+ */
+void MotionTiler::OccupySource(size_t t, bool occupy) {
+    size_t          tw, th;
+    TileSize(t, tw, th);
+    const source_t &source = next_sources_[t];
+
+    for (size_t j = source.y / tile_height_; j <= (source.y + th - 1) / tile_height_; j++) {
+        for (size_t i = source.x / tile_width_; i <= (source.x + tw - 1) / tile_width_; i++) {
+            vector<size_t> &occupants = occupants_[(source.z * tile_map_height_ + j) * tile_map_width_ + i];
+            if (occupy) {
+                occupants.push_back(t);
+            } else {
+                occupants.erase(std::find(occupants.begin(), occupants.end(), t));
+            }
+        }
+    }
+}
+
+/**
+ * Finds the other tiles whose next sources overlap the block a tile would have at the given source.
+ *
+ * @param t The index of the tile in the tile map
+ * @param source The source the tile would have
+ * @param overlapping Receives the overlapping tiles if not NULL, otherwise the search stops at the first one
+ * @return The number of overlapping tiles found
+ */
+size_t MotionTiler::OverlappingSources(size_t t, const source_t &source, vector<size_t> *overlapping) {
+    size_t tw, th;
+    TileSize(t, tw, th);
+    size_t count = 0;
+
+    for (size_t j = source.y / tile_height_; j <= (source.y + th - 1) / tile_height_; j++) {
+        for (size_t i = source.x / tile_width_; i <= (source.x + tw - 1) / tile_width_; i++) {
+            vector<size_t> &occupants = occupants_[(source.z * tile_map_height_ + j) * tile_map_width_ + i];
+            for (size_t k = 0; k < occupants.size(); k++) {
+                size_t          o = occupants[k];
+                const source_t &other = next_sources_[o];
+                size_t          ow, oh;
+                TileSize(o, ow, oh);
+                if ((o != t) &&
+                    (other.x < source.x + (int)tw) && (source.x < other.x + (int)ow) &&
+                    (other.y < source.y + (int)th) && (source.y < other.y + (int)oh)) {
+                    if (!overlapping) {
+                        return 1;
+                    }
+                    if (std::find(overlapping->begin(), overlapping->end(), o) == overlapping->end()) {
+                        overlapping->push_back(o);
+                        count++;
+                    }
+                }
+            }
+        }
+    }
+
+    return count;
+}
+
+/**
+ * Picks where each uploaded tile is copied into the frame volume. Its block there mustn't overlap the source of
+ * any other tile. First every uploaded tile is given its own region of some slice. If that region is some other
+ * tile's source in every slice, then those tiles are displaced, which is to say they're uploaded as well. Then
+ * each uploaded tile is moved next to the source of a neighbor where there's room, so that tiles which keep
+ * moving together can be found as one block in the next frame.
+ */
+void MotionTiler::PlaceUploads() {
+    size_t tiles = tile_map_width_ * tile_map_height_;
+
+    // Note the sources which stay in the frame volume
+    for (size_t c = 0; c < occupants_.size(); c++) {
+        occupants_[c].clear();
+    }
+    for (size_t t = 0; t < tiles; t++) {
+        if (actions_[t] != TILE_UPLOAD) {
+            OccupySource(t, true);
+        }
+    }
+
+    // Uploads go to the least used slice where they can, which keeps the tiles uploaded in one frame together
+    size_t preferred = 0, least = ~(size_t)0;
+    for (size_t z = 0; z < slices_; z++) {
+        size_t used = 0;
+        for (size_t c = 0; c < tiles; c++) {
+            used += occupants_[z * tiles + c].size();
+        }
+        if (used < least) {
+            preferred = z;
+            least = used;
+        }
+    }
+
+    // Give each uploaded tile its own region of a slice. The list grows as tiles are displaced.
+    vector<size_t> overlapping;
+    for (size_t k = 0; k < uploads_.size(); k++) {
+        size_t          u = uploads_[k];
+        int             home_x = (u % tile_map_width_) * tile_width_, home_y = (u / tile_map_width_) * tile_height_;
+        const source_t &current = sources_[u];
+        source_t        home = { home_x, home_y, (unsigned int)preferred };
+
+        // Otherwise prefer the slice the tile already shows its own region of, since its coefficient matrix stays the same
+        if (OverlappingSources(u, home, NULL)) {
+            home.z = current.z;
+            if ((current.x != home_x) || (current.y != home_y) || OverlappingSources(u, home, NULL)) {
+                home.z = slices_;
+                for (unsigned int z = 0; (z < slices_) && (home.z == slices_); z++) {
+                    source_t other = { home_x, home_y, z };
+                    if (!OverlappingSources(u, other, NULL)) {
+                        home.z = z;
+                    }
+                }
+            }
+        }
+
+        // Otherwise displace the tiles showing the slice with the fewest of them
+        if (home.z == slices_) {
+            size_t fewest = ~(size_t)0;
+            for (unsigned int z = 0; z < slices_; z++) {
+                source_t other = { home_x, home_y, z };
+                overlapping.clear();
+                size_t count = OverlappingSources(u, other, &overlapping);
+                if (count < fewest) {
+                    home.z = z;
+                    fewest = count;
+                }
+            }
+            overlapping.clear();
+            OverlappingSources(u, home, &overlapping);
+            for (size_t o = 0; o < overlapping.size(); o++) {
+                OccupySource(overlapping[o], false);
+                actions_[overlapping[o]] = TILE_UPLOAD;
+                uploads_.push_back(overlapping[o]);
+                displaced_tiles_++;
+            }
+        }
+
+        next_sources_[u] = home;
+        OccupySource(u, true);
+    }
+
+    // Send the uploads in the order of the tile map
+    std::sort(uploads_.begin(), uploads_.end());
+
+    // Move each uploaded tile next to a neighbor's source if there's room
+    for (size_t k = 0; k < uploads_.size(); k++) {
+        size_t  u = uploads_[k];
+        int     home_x = (u % tile_map_width_) * tile_width_, home_y = (u / tile_map_width_) * tile_height_;
+        size_t  neighbors[4];
+        size_t  count = 0;
+
+        if (u % tile_map_width_ > 0)                  { neighbors[count++] = u - 1; }
+        if (u >= tile_map_width_)                     { neighbors[count++] = u - tile_map_width_; }
+        if (u % tile_map_width_ < tile_map_width_ - 1) { neighbors[count++] = u + 1; }
+        if (u + tile_map_width_ < tiles)              { neighbors[count++] = u + tile_map_width_; }
+        for (size_t n = 0; n < count; n++) {
+            const source_t &neighbor = next_sources_[neighbors[n]];
+            source_t        beside = { home_x + neighbor.x - (int)((neighbors[n] % tile_map_width_) * tile_width_),
+                                       home_y + neighbor.y - (int)((neighbors[n] / tile_map_width_) * tile_height_),
+                                       neighbor.z };
+            const source_t &placed = next_sources_[u];
+            if ((beside.x == placed.x) && (beside.y == placed.y) && (beside.z == placed.z)) {
+                break;
+            }
+            if (SourceInBounds(u, beside) && !OverlappingSources(u, beside, NULL)) {
+                OccupySource(u, false);
+                next_sources_[u] = beside;
+                OccupySource(u, true);
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * Copies one uploaded tile out of the RGB buffer into an array of pixels and into the copy of the frame
+ * volume at its next source. The tiles in the last column and row are cut short at the edge of the display.
+ * This is called from several threads at once, so it only touches the array passed in and the tile's own
+ * region of the copy of the frame volume.
+ *
+ * @param buffer Pointer to an RGB buffer
+ * @param width The width of the RGB buffer
+ * @param t The index of the tile in the tile map
+ * @param pixels Receives the tile's pixels
+ */
+void MotionTiler::ExtractTile(uint8_t* buffer, size_t width, size_t t, vector<Pixel> &pixels) {
+    size_t tw, th;
+    TileSize(t, tw, th);
+    pixels.resize(tw * th);
+
+    uint8_t* mirror = Mirror(next_sources_[t]);
+    for (size_t j_tile = 0; j_tile < th; j_tile++) {
+        // Compute the offset into the RGB buffer for this row in this tile
+        size_t bufferOffset = 3 * (((t / tile_map_width_) * tile_height_ + j_tile) * width + (t % tile_map_width_) * tile_width_);
+
+        memcpy(mirror + j_tile * display_width_ * 3, buffer + bufferOffset, tw * 3);
+        rgbToPixels(buffer + bufferOffset, &pixels[j_tile * tw], tw);
+    }
+}
+
+/**
+ * Computes the width and height of a tile, which are cut short in the last column and row.
+ */
+void MotionTiler::TileSize(size_t t, size_t &tw, size_t &th) {
+    tw = tile_width_;
+    th = tile_height_;
+    if ((t % tile_map_width_) == (tile_map_width_ - 1)) {
+        tw -= tile_map_width_ * tile_width_ - display_width_;
+    }
+    if ((t / tile_map_width_) == (tile_map_height_ - 1)) {
+        th -= tile_map_height_ * tile_height_ - display_height_;
+    }
+}
+
+/**
+ * Returns the byte in the copy of the frame volume at the top left corner of a source.
+ */
+uint8_t* MotionTiler::Mirror(const source_t &source) {
+    return &mirror_[3 * ((source.z * display_height_ + source.y) * display_width_ + source.x)];
+}
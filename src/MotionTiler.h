@@ -0,0 +1,120 @@
+#ifndef MOTION_TILER_H
+#define MOTION_TILER_H
+/*
+ *  MotionTiler.h
+ *  pixelbridge
+ *
+ */
+
+#include "PixelBridgeFeatures.h"
+#include "Configuration.h"
+#include "BlockMatch.h"
+#include "Tiler.h"
+
+using namespace nddi;
+using namespace std;
+
+/**
+ * This tiler will split provided frames into tiles and update the NDDI display. The frame volume holds
+ * a few slices the size of the display, and each tile's coefficient matrix translates it to a source
+ * region in one of those slices. When a tile changes, the region of the frame volume around its source
+ * is searched for a block which matches it, and if one is found only the translation in the tile's
+ * coefficient matrix is changed. Otherwise the tile's pixels are copied into its own region of a slice
+ * which no other tile is showing.
+ */
+class MotionTiler : public Tiler {
+
+public:
+    /**
+     * The MotionTiler is created based on the dimensions of the NDDI display that's passed in. If those
+     * dimensions change, then the MotionTiler should be destroyed and re-created.
+     *
+     * @param display_width The width of the display
+     * @param display_height The height of the display
+     * @param tile_width The width of the tiles
+     * @param tile_height The height of the tiles
+     * @param search The number of pixels in each direction around a tile's source to search for a match
+     * @param threshold The mean absolute difference of each channel allowed for a block to match a tile
+     * @param slices The number of display-sized slices in the frame volume
+     */
+    MotionTiler(size_t display_width, size_t display_height,
+                size_t tile_width, size_t tile_height,
+                size_t search, size_t threshold, size_t slices,
+                string file = "");
+
+    ~MotionTiler();
+
+    /**
+     * Returns the Display created and initialized by the tiler.
+     */
+    virtual NDimensionalDisplayInterface* GetDisplay();
+
+    /**
+     * Update the tile sources and then the NDDI display based on the frame that's passed in.
+     *
+     * @param buffer Pointer to the return frame buffer
+     * @param width The width of that frame buffer
+     * @param height The height of that frame buffer
+     */
+    void UpdateDisplay(uint8_t* buffer, size_t width, size_t height);
+
+private:
+
+    // Where in the frame volume a tile's coefficient matrix points
+    typedef struct {
+        int             x, y;
+        unsigned int    z;
+    } source_t;
+
+    // What happens to a tile this frame
+    typedef enum {
+        TILE_KEEP,      // The tile's source still matches
+        TILE_MOVE,      // The tile's source is moved to a matching block
+        TILE_UPLOAD     // The tile's pixels are copied into the frame volume
+    } action_t;
+
+    void InitializeCoefficientPlanes();
+    void SearchTile(uint8_t* buffer, size_t width, size_t t);
+    unsigned long MatchBlock(uint8_t* buffer, size_t width, size_t t, const source_t &source, unsigned long limit);
+    bool SourceInBounds(size_t t, const source_t &source);
+    void OccupySource(size_t t, bool occupy);
+    size_t OverlappingSources(size_t t, const source_t &source, vector<size_t> *overlapping);
+    void PlaceUploads();
+    void ExtractTile(uint8_t* buffer, size_t width, size_t t, vector<Pixel> &pixels);
+    void TileSize(size_t t, size_t &tw, size_t &th);
+    uint8_t* Mirror(const source_t &source);
+
+    NDimensionalDisplayInterface*  display_;
+    PayloadHandoff                 handoff_;
+    size_t                         display_width_, display_height_;
+    size_t                         tile_width_, tile_height_;
+    size_t                         tile_map_width_, tile_map_height_;
+    int                            search_;
+    unsigned long                  threshold_;
+    size_t                         slices_;
+    bool                           quiet_;
+
+    // A copy of the frame volume as RGB24, one display-sized slice after another
+    vector<uint8_t>                mirror_;
+
+    // The source of each tile, in rows of the tile map, and the source and action chosen for the current frame
+    vector<source_t>               sources_, next_sources_;
+    vector<action_t>               actions_;
+
+    // The tiles whose next sources overlap each tile-sized region of each slice
+    vector<vector<size_t> >        occupants_;
+
+    // The tiles being uploaded this frame, in order, with their pixels
+    vector<size_t>                 uploads_;
+    vector<vector<Pixel> >         tile_pixels_;
+
+    // The coefficient matrix updates for the current frame
+    vector<int>                    coefficients_list;
+    vector<vector<unsigned int> >  coefficient_positions_list;
+    vector<vector<unsigned int> >  coefficient_plane_starts_list;
+
+    long                           unchanged_tiles_, moved_tiles_, uploaded_tiles_, displaced_tiles_;
+    long                           frames_;
+    double                         squared_error_, samples_;
+};
+#endif // MOTION_TILER_H
@@ -104,6 +104,7 @@ MultiDctTiler::MultiDctTiler(size_t display_width, size_t display_height, size_t
             display_ = new GrpcNddiDisplay();
         }
    }
+    handoff_.Attach(display_);
 
     /* Set the full scaler value and the sign mode */
     display_->SetFullScaler(MAX_DCT_COEFF);
@@ -115,6 +116,7 @@ MultiDctTiler::MultiDctTiler(size_t display_width, size_t display_height, size_t
      */
     initZigZag();
     initQuantizationMatrix(quality);
+    registerScalerQuantizer(file);
 
     /* Initialize Input Vector */
     vector<int> iv;
@@ -152,6 +154,19 @@ void MultiDctTiler::initQuantizationMatrix(size_t quality) {
     }
 }
 
+/*
+ * Registers a quantizer for the planes of each scale with that scale's quantization matrix.
+ */
+void MultiDctTiler::registerScalerQuantizer(string file) {
+    if (file.length() || !globalConfiguration.scalerQuantization) {
+        return;
+    }
+
+    for (size_t c = 0; c < globalConfiguration.dctScales.size(); c++) {
+        registerScaleQuantizer(quantizationMatrix_[c].data(), c);
+    }
+}
+
 /**
  * Initializes the Coefficient Planes for this tiler. The coefficient matrices
  * for each plane will pick a plane from the frame volume.
@@ -182,35 +197,21 @@ void MultiDctTiler::InitializeCoefficientPlanes() {
 
             size_t scaledBlockWidth = UNSCALED_BASIC_BLOCK_WIDTH * sm;
             size_t scaledBlockHeight = UNSCALED_BASIC_BLOCK_HEIGHT * sm;
-            size_t scaledTilesWide = CEIL(display_width_, scaledBlockWidth);
-            size_t scaledTilesHigh = CEIL(display_height_, scaledBlockHeight);
 
-#ifdef USE_OMP
-#pragma omp parallel for
-#endif
-            // Break up the display into supermacroblocks at this current scale
-            for (int j = 0; j < scaledTilesHigh; j++) {
-                for (int i = 0; i < scaledTilesWide; i++) {
-                    for (int y = 0; y < scaledBlockHeight && j * scaledBlockHeight + y < display_height_; y++) {
-                        for (int x = 0; x < scaledBlockWidth && i * scaledBlockWidth + x < display_width_; x++) {
-                            vector<unsigned int> start(3), end(3);
-
-                            start[0] = i * scaledBlockWidth + x;
-                            start[1] = j * scaledBlockHeight + y;
-                            start[2] = config.first_plane_idx;
-
-                            end[0] = i * scaledBlockWidth + x;
-                            end[1] = j * scaledBlockHeight + y;
-                            end[2] = config.first_plane_idx + config.plane_count - 1;
-
-                            int tx = -i * scaledBlockWidth;
-                            int ty = -j * scaledBlockHeight;
-
-                            display_->FillCoefficient(tx, 0, 2, start, end);
-                            display_->FillCoefficient(ty, 1, 2, start, end);
-                        }
-                    }
-                }
+            // Break up the display into supermacroblocks at this current scale. The display derives each
+            // supermacroblock's translation from the tile size, while each plane keeps the k the basic
+            // initialization gave it.
+            vector< vector<int> > coeffs(3, vector<int>(3, 0));
+            coeffs[0][0] = 1; coeffs[1][1] = 1;
+            vector<unsigned int> size;
+            size.push_back(scaledBlockWidth); size.push_back(scaledBlockHeight);
+            start[0] = 0; start[1] = 0;
+            end[0] = display_width_ - 1; end[1] = display_height_ - 1;
+            for (size_t p = 0; p < config.plane_count; p++) {
+                size_t k = config.first_plane_idx + p;
+                start[2] = k; end[2] = k;
+                coeffs[2][2] = saveRam_ ? COEFFICIENT_MATRIX_P : (int)k;
+                fillCoefficientMatrixTiled(display_, coeffs, start, end, size);
             }
         }
 
@@ -504,7 +505,7 @@ void MultiDctTiler::SelectCoefficientsForScale(vector<uint64_t> &coefficients, s
  * the display. e.g. Given an 8x8 macroblock, a macroblock location (i, j) of (2, 1) and a factor of
  * 4: the region of the display that will be updated is from (64, 32) to (95, 63) inclusive.
  *
- * @param coefficients The vector (in zig-zag order) of coefficients for the macroblock
+ * @param coefficients The vector (in zig-zag order) of coefficients for the macroblock, which is handed to the display
  * @param i The column component of the macroblock
  * @param j The row component of the macroblock
  * @param c Index into globalConfiguration.dctScales for information about the factor by
@@ -528,7 +529,7 @@ void MultiDctTiler::FillCoefficients(vector<uint64_t> &coefficients, size_t i, s
 
     /* If any any coefficients have changed, send the NDDI command to update them */
     if (start[2] < display_->NumCoefficientPlanes()) {
-        display_->FillScalerTileStack(coefficients, start, size);
+        handoff_.FillScalerTileStack(std::move(coefficients), start, size);
     }
 }
 
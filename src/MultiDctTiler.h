@@ -48,6 +48,7 @@ public:
 
 private:
     void initQuantizationMatrix(size_t quality);
+    void registerScalerQuantizer(string file);
     void InitializeCoefficientPlanes();
     void InitializeFrameVolume();
     vector<uint64_t> BuildCoefficients(size_t i, size_t j, int16_t* buffer, size_t width, size_t height, size_t c, bool adjustPixels);
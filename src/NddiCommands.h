@@ -2,6 +2,7 @@
 #define NDDI_COMMANDS_H
 
 #include "GrpcNddiDisplay.h"
+#include "TiledCoefficients.h"
 #include "nddi/Features.h"
 #include "nddi/NDimensionalDisplayInterface.h"
 
@@ -34,7 +35,8 @@
   /* 21 */  m(GetFullScaler) \
   /* 22 */  m(ClearCostModel) \
   /* 23 */  m(Latch) \
-  /* 24 */  m(Shutdown)
+  /* 24 */  m(Shutdown) \
+  /* 25 */  m(FillCoefficientMatrixTiled)
 
 namespace nddi {
 
@@ -42,6 +44,8 @@ namespace nddi {
         idEOT,
         #define GENERATE_ENUM(m) id ## m ,
         NDDI_COMMAND_LIST(GENERATE_ENUM)
+        // Commands are only ever appended to the list, so this stays one past the last command ID.
+        idCommandCount
     };
 
     static const string CommandNames[] = {
@@ -54,17 +58,23 @@ namespace nddi {
     class NddiCommandMessage {
     public:
         NddiCommandMessage(CommandID id)
-        : id(id) {
+        : id(id),
+          timestamp(0) {
         }
 
         void play(GrpcNddiDisplay* &display) {
             std::cout << "Can\'t do anything!" << std::endl;
         }
 
+        // Commands without arguments have nothing to reassign when they're recycled.
+        void assign() {}
+
         template <class Archive>
         void serialize(Archive& ar) {}
 
         CommandID id;
+        // Nanoseconds since the recording started. Kept in the record prefix rather than serialized.
+        uint64_t  timestamp;
     };
 
     class InitCommandMessage : public NddiCommandMessage {
@@ -78,14 +88,26 @@ namespace nddi {
                            unsigned int inputVectorSize,
                            bool fixed8x8Macroblocks,
                            bool useSingleCoeffcientPlane)
-        : NddiCommandMessage(idInit),
-          frameVolumeDimensionalSizes(frameVolumeDimensionalSizes),
-          displayWidth(displayWidth),
-          displayHeight(displayHeight),
-          numCoefficientPlanes(numCoefficientPlanes),
-          inputVectorSize(inputVectorSize),
-          fixed8x8Macroblocks(fixed8x8Macroblocks),
-          useSingleCoeffcientPlane(useSingleCoeffcientPlane) {}
+        : NddiCommandMessage(idInit) {
+            assign(frameVolumeDimensionalSizes, displayWidth, displayHeight, numCoefficientPlanes,
+                   inputVectorSize, fixed8x8Macroblocks, useSingleCoeffcientPlane);
+        }
+
+        void assign(vector<unsigned int> &frameVolumeDimensionalSizes,
+                    unsigned int displayWidth,
+                    unsigned int displayHeight,
+                    unsigned int numCoefficientPlanes,
+                    unsigned int inputVectorSize,
+                    bool fixed8x8Macroblocks,
+                    bool useSingleCoeffcientPlane) {
+            this->frameVolumeDimensionalSizes = frameVolumeDimensionalSizes;
+            this->displayWidth = displayWidth;
+            this->displayHeight = displayHeight;
+            this->numCoefficientPlanes = numCoefficientPlanes;
+            this->inputVectorSize = inputVectorSize;
+            this->fixed8x8Macroblocks = fixed8x8Macroblocks;
+            this->useSingleCoeffcientPlane = useSingleCoeffcientPlane;
+        }
 
         void play(GrpcNddiDisplay* &display) {
             display = new GrpcNddiDisplay(frameVolumeDimensionalSizes,
@@ -104,7 +126,7 @@ namespace nddi {
              CEREAL_NVP(fixed8x8Macroblocks), CEREAL_NVP(useSingleCoeffcientPlane));
         }
 
-    private:
+        // Public so that the in-process dispatcher can initialize the server's own display type.
         unsigned int  frameVolumeDimensionality;
         vector<unsigned int> frameVolumeDimensionalSizes;
         unsigned int  displayWidth;
@@ -119,7 +141,7 @@ namespace nddi {
     public:
         DisplayWidthCommandMessage() : NddiCommandMessage(idDisplayWidth) {}
 
-        void play(GrpcNddiDisplay* display) {
+        void play(NDimensionalDisplayInterface* display) {
             display->DisplayWidth();
         }
     };
@@ -128,7 +150,7 @@ namespace nddi {
     public:
         DisplayHeightCommandMessage() : NddiCommandMessage(idDisplayHeight) {}
 
-        void play(GrpcNddiDisplay* display) {
+        void play(NDimensionalDisplayInterface* display) {
             display->DisplayHeight();
         }
     };
@@ -137,7 +159,7 @@ namespace nddi {
     public:
         NumCoefficientPlanesCommandMessage() : NddiCommandMessage(idNumCoefficientPlanes) {}
 
-        void play(GrpcNddiDisplay* display) {
+        void play(NDimensionalDisplayInterface* display) {
             display->NumCoefficientPlanes();
         }
     };
@@ -147,12 +169,16 @@ namespace nddi {
         PutPixelCommandMessage() : NddiCommandMessage(idPutPixel) {}
 
         PutPixelCommandMessage(Pixel p, vector<unsigned int> &location)
-        : NddiCommandMessage(idPutPixel),
-          p(p),
-          location(location) {
+        : NddiCommandMessage(idPutPixel) {
+            assign(p, location);
         }
 
-        void play(GrpcNddiDisplay* display) {
+        void assign(Pixel p, vector<unsigned int> &location) {
+            this->p = p;
+            this->location = location;
+        }
+
+        void play(NDimensionalDisplayInterface* display) {
             display->PutPixel(p, location);
         }
 
@@ -171,9 +197,14 @@ namespace nddi {
         CopyPixelStripCommandMessage() : NddiCommandMessage(idCopyPixelStrip) {}
 
         CopyPixelStripCommandMessage(Pixel* p, vector<unsigned int> &start, vector<unsigned int> &end)
-        : NddiCommandMessage(idCopyPixelStrip),
-          start(start),
-          end(end) {
+        : NddiCommandMessage(idCopyPixelStrip) {
+            assign(p, start, end);
+        }
+
+        void assign(Pixel* p, vector<unsigned int> &start, vector<unsigned int> &end) {
+            this->start = start;
+            this->end = end;
+
             int dimensionToCopyAlong;
             bool dimensionFound = false;
 
@@ -190,7 +221,7 @@ namespace nddi {
             memcpy(this->p.data(), p, sizeof(Pixel) * pixelsToCopy);
         }
 
-        void play(GrpcNddiDisplay* display) {
+        void play(NDimensionalDisplayInterface* display) {
             display->CopyPixelStrip(p.data(), start, end);
         }
 
@@ -210,9 +241,19 @@ namespace nddi {
         CopyPixelsCommandMessage() : NddiCommandMessage(idCopyPixels) {}
 
         CopyPixelsCommandMessage(Pixel* p, vector<unsigned int> &start, vector<unsigned int> &end)
-        : NddiCommandMessage(idCopyPixels),
-          start(start),
-          end(end) {
+        : NddiCommandMessage(idCopyPixels) {
+            assign(p, start, end);
+        }
+
+        CopyPixelsCommandMessage(vector<Pixel> &&p, vector<unsigned int> &start, vector<unsigned int> &end)
+        : NddiCommandMessage(idCopyPixels) {
+            assign(std::move(p), start, end);
+        }
+
+        void assign(Pixel* p, vector<unsigned int> &start, vector<unsigned int> &end) {
+            this->start = start;
+            this->end = end;
+
             size_t pixelsToCopy = 1;
             for (int i = 0; i < start.size(); i++) {
                 pixelsToCopy *= end[i] - start[i] + 1;
@@ -222,7 +263,14 @@ namespace nddi {
             memcpy(this->p.data(), p, sizeof(Pixel) * pixelsToCopy);
         }
 
-        void play(GrpcNddiDisplay* display) {
+        // Takes the caller's pixels, handing back the buffer this message held.
+        void assign(vector<Pixel> &&p, vector<unsigned int> &start, vector<unsigned int> &end) {
+            this->start = start;
+            this->end = end;
+            this->p.swap(p);
+        }
+
+        void play(NDimensionalDisplayInterface* display) {
             display->CopyPixels(p.data(), start, end);
         }
 
@@ -242,9 +290,18 @@ namespace nddi {
         CopyPixelTilesCommandMessage() : NddiCommandMessage(idCopyPixelTiles) {}
 
         CopyPixelTilesCommandMessage(vector<Pixel*> &p, vector<vector<unsigned int> > &starts, vector<unsigned int> &size)
-        : NddiCommandMessage(idCopyPixelTiles),
-          starts(starts),
-          size(size) {
+        : NddiCommandMessage(idCopyPixelTiles) {
+            assign(p, starts, size);
+        }
+
+        CopyPixelTilesCommandMessage(vector<vector<Pixel> > &&p, vector<vector<unsigned int> > &starts, vector<unsigned int> &size)
+        : NddiCommandMessage(idCopyPixelTiles) {
+            assign(std::move(p), starts, size);
+        }
+
+        void assign(vector<Pixel*> &p, vector<vector<unsigned int> > &starts, vector<unsigned int> &size) {
+            this->starts = starts;
+            this->size = size;
 
             this->p.resize(p.size());
 
@@ -258,7 +315,14 @@ namespace nddi {
             }
         }
 
-        void play(GrpcNddiDisplay* display) {
+        // Takes the caller's tiles, handing back the tiles this message held.
+        void assign(vector<vector<Pixel> > &&p, vector<vector<unsigned int> > &starts, vector<unsigned int> &size) {
+            this->starts = starts;
+            this->size = size;
+            this->p.swap(p);
+        }
+
+        void play(NDimensionalDisplayInterface* display) {
             vector<Pixel*> tmp;
 
             tmp.resize(p.size());
@@ -284,13 +348,17 @@ namespace nddi {
         FillPixelCommandMessage() : NddiCommandMessage(idFillPixel) {}
 
         FillPixelCommandMessage(Pixel p, vector<unsigned int> &start, vector<unsigned int> &end)
-        : NddiCommandMessage(idFillPixel),
-          p(p),
-          start(start),
-          end(end) {
+        : NddiCommandMessage(idFillPixel) {
+            assign(p, start, end);
         }
 
-        void play(GrpcNddiDisplay* display) {
+        void assign(Pixel p, vector<unsigned int> &start, vector<unsigned int> &end) {
+            this->p = p;
+            this->start = start;
+            this->end = end;
+        }
+
+        void play(NDimensionalDisplayInterface* display) {
             display->FillPixel(p, start, end);
         }
 
@@ -309,12 +377,17 @@ namespace nddi {
     public:
         CopyFrameVolumeCommandMessage() : NddiCommandMessage(idCopyFrameVolume) {}
         CopyFrameVolumeCommandMessage(vector<unsigned int> &start, vector<unsigned int> &end, vector<unsigned int> &dest)
-        : NddiCommandMessage(idCopyFrameVolume),
-          start(start),
-          end(end),
-          dest(dest) {}
+        : NddiCommandMessage(idCopyFrameVolume) {
+            assign(start, end, dest);
+        }
 
-        void play(GrpcNddiDisplay* display) {
+        void assign(vector<unsigned int> &start, vector<unsigned int> &end, vector<unsigned int> &dest) {
+            this->start = start;
+            this->end = end;
+            this->dest = dest;
+        }
+
+        void play(NDimensionalDisplayInterface* display) {
             display->CopyFrameVolume(start, end, dest);
         }
 
@@ -334,10 +407,15 @@ namespace nddi {
         UpdateInputVectorCommandMessage() : NddiCommandMessage(idUpdateInputVector) {}
 
         UpdateInputVectorCommandMessage(vector<int> &input)
-        : NddiCommandMessage(idUpdateInputVector),
-          input(input) {}
+        : NddiCommandMessage(idUpdateInputVector) {
+            assign(input);
+        }
 
-        void play(GrpcNddiDisplay* display) {
+        void assign(vector<int> &input) {
+            this->input = input;
+        }
+
+        void play(NDimensionalDisplayInterface* display) {
             display->UpdateInputVector(input);
         }
 
@@ -355,11 +433,16 @@ namespace nddi {
         PutCoefficientMatrixCommandMessage() : NddiCommandMessage(idPutCoefficientMatrix) {}
 
         PutCoefficientMatrixCommandMessage(vector< vector<int> > &coefficientMatrix, vector<unsigned int> &location)
-        : NddiCommandMessage(idPutCoefficientMatrix),
-          coefficientMatrix(coefficientMatrix),
-          location(location) {}
+        : NddiCommandMessage(idPutCoefficientMatrix) {
+            assign(coefficientMatrix, location);
+        }
 
-        void play(GrpcNddiDisplay* display) {
+        void assign(vector< vector<int> > &coefficientMatrix, vector<unsigned int> &location) {
+            this->coefficientMatrix = coefficientMatrix;
+            this->location = location;
+        }
+
+        void play(NDimensionalDisplayInterface* display) {
             display->PutCoefficientMatrix(coefficientMatrix, location);
         }
 
@@ -368,7 +451,7 @@ namespace nddi {
             ar(CEREAL_NVP(coefficientMatrix), CEREAL_NVP(location));
         }
 
-    private:
+        // Public so that the recording analyzer can read them.
         vector< vector<int> > coefficientMatrix;
         vector<unsigned int> location;
     };
@@ -378,12 +461,17 @@ namespace nddi {
         FillCoefficientMatrixCommandMessage() : NddiCommandMessage(idFillCoefficientMatrix) {}
 
         FillCoefficientMatrixCommandMessage(vector< vector<int> > &coefficientMatrix, vector<unsigned int> &start, vector<unsigned int> &end)
-        : NddiCommandMessage(idFillCoefficientMatrix),
-          coefficientMatrix(coefficientMatrix),
-          start(start),
-          end(end) {}
+        : NddiCommandMessage(idFillCoefficientMatrix) {
+            assign(coefficientMatrix, start, end);
+        }
 
-        void play(GrpcNddiDisplay* display) {
+        void assign(vector< vector<int> > &coefficientMatrix, vector<unsigned int> &start, vector<unsigned int> &end) {
+            this->coefficientMatrix = coefficientMatrix;
+            this->start = start;
+            this->end = end;
+        }
+
+        void play(NDimensionalDisplayInterface* display) {
             display->FillCoefficientMatrix(coefficientMatrix, start, end);
         }
 
@@ -392,25 +480,65 @@ namespace nddi {
             ar(CEREAL_NVP(coefficientMatrix), CEREAL_NVP(start), CEREAL_NVP(end));
         }
 
-    private:
+        // Public so that the recording optimizer can rewrite them.
         vector< vector<int> > coefficientMatrix;
         vector<unsigned int> start;
         vector<unsigned int> end;
     };
 
+    class FillCoefficientMatrixTiledCommandMessage : public NddiCommandMessage {
+    public:
+        FillCoefficientMatrixTiledCommandMessage() : NddiCommandMessage(idFillCoefficientMatrixTiled) {}
+
+        FillCoefficientMatrixTiledCommandMessage(vector< vector<int> > &coefficientMatrix, vector<unsigned int> &start,
+                                                 vector<unsigned int> &end, vector<unsigned int> &size)
+        : NddiCommandMessage(idFillCoefficientMatrixTiled) {
+            assign(coefficientMatrix, start, end, size);
+        }
+
+        void assign(vector< vector<int> > &coefficientMatrix, vector<unsigned int> &start, vector<unsigned int> &end,
+                    vector<unsigned int> &size) {
+            this->coefficientMatrix = coefficientMatrix;
+            this->start = start;
+            this->end = end;
+            this->size = size;
+        }
+
+        // Displays which can't take the tiled command get one FillCoefficientMatrix per tile.
+        long play(NDimensionalDisplayInterface* display, long* extraCommands = NULL) {
+            return fillCoefficientMatrixTiled(display, coefficientMatrix, start, end, size, extraCommands);
+        }
+
+        template <class Archive>
+        void serialize(Archive& ar) {
+            ar(CEREAL_NVP(coefficientMatrix), CEREAL_NVP(start), CEREAL_NVP(end), CEREAL_NVP(size));
+        }
+
+        // Public so that the recording analyzer can read them.
+        vector< vector<int> > coefficientMatrix;
+        vector<unsigned int> start;
+        vector<unsigned int> end;
+        vector<unsigned int> size;
+    };
+
     class FillCoefficientCommandMessage : public NddiCommandMessage {
     public:
         FillCoefficientCommandMessage() : NddiCommandMessage(idFillCoefficient) {}
 
         FillCoefficientCommandMessage(int coefficient, unsigned int row, unsigned int col, vector<unsigned int> &start, vector<unsigned int> &end)
-        : NddiCommandMessage(idFillCoefficient),
-          coefficient(coefficient),
-          row(row),
-          col(col),
-          start(start),
-          end(end) {}
+        : NddiCommandMessage(idFillCoefficient) {
+            assign(coefficient, row, col, start, end);
+        }
 
-        void play(GrpcNddiDisplay* display) {
+        void assign(int coefficient, unsigned int row, unsigned int col, vector<unsigned int> &start, vector<unsigned int> &end) {
+            this->coefficient = coefficient;
+            this->row = row;
+            this->col = col;
+            this->start = start;
+            this->end = end;
+        }
+
+        void play(NDimensionalDisplayInterface* display) {
             display->FillCoefficient(coefficient, row, col, start, end);
         }
 
@@ -419,7 +547,7 @@ namespace nddi {
             ar(CEREAL_NVP(coefficient), CEREAL_NVP(row), CEREAL_NVP(col), CEREAL_NVP(start), CEREAL_NVP(end));
         }
 
-    private:
+        // Public so that the recording analyzer can read them.
         int coefficient;
         unsigned int row, col;
         vector<unsigned int> start;
@@ -431,13 +559,18 @@ namespace nddi {
         FillCoefficientTilesCommandMessage() : NddiCommandMessage(idFillCoefficientTiles) {}
 
         FillCoefficientTilesCommandMessage(vector<int> &coefficients, vector<vector<unsigned int> > &positions, vector<vector<unsigned int> > &starts, vector<unsigned int> &size)
-        : NddiCommandMessage(idFillCoefficientTiles),
-          coefficients(coefficients),
-          positions(positions),
-          starts(starts),
-          size(size) {}
+        : NddiCommandMessage(idFillCoefficientTiles) {
+            assign(coefficients, positions, starts, size);
+        }
 
-        void play(GrpcNddiDisplay* display) {
+        void assign(vector<int> &coefficients, vector<vector<unsigned int> > &positions, vector<vector<unsigned int> > &starts, vector<unsigned int> &size) {
+            this->coefficients = coefficients;
+            this->positions = positions;
+            this->starts = starts;
+            this->size = size;
+        }
+
+        void play(NDimensionalDisplayInterface* display) {
             display->FillCoefficientTiles(coefficients, positions, starts, size);
         }
 
@@ -446,7 +579,7 @@ namespace nddi {
             ar(CEREAL_NVP(coefficients), CEREAL_NVP(positions), CEREAL_NVP(starts), CEREAL_NVP(size));
         }
 
-    private:
+        // Public so that the recording analyzer can read them.
         vector<int> coefficients;
         vector<vector<unsigned int> > positions;
         vector<vector<unsigned int> > starts;
@@ -458,12 +591,17 @@ namespace nddi {
         FillScalerCommandMessage() : NddiCommandMessage(idFillScaler) {}
 
         FillScalerCommandMessage(Scaler scaler, vector<unsigned int> &start, vector<unsigned int> &end)
-        : NddiCommandMessage(idFillScaler),
-          scaler(scaler),
-          start(start),
-          end(end) {}
+        : NddiCommandMessage(idFillScaler) {
+            assign(scaler, start, end);
+        }
 
-        void play(GrpcNddiDisplay* display) {
+        void assign(Scaler scaler, vector<unsigned int> &start, vector<unsigned int> &end) {
+            this->scaler = scaler;
+            this->start = start;
+            this->end = end;
+        }
+
+        void play(NDimensionalDisplayInterface* display) {
             display->FillScaler(scaler, start, end);
         }
 
@@ -472,7 +610,7 @@ namespace nddi {
             ar(CEREAL_NVP(scaler), CEREAL_NVP(start), CEREAL_NVP(end));
         }
 
-    private:
+        // Public so that the recording optimizer can rewrite them.
         Scaler scaler;
         vector<unsigned int> start;
         vector<unsigned int> end;
@@ -483,12 +621,17 @@ namespace nddi {
         FillScalerTilesCommandMessage() : NddiCommandMessage(idFillScalerTiles) {}
 
         FillScalerTilesCommandMessage(vector<uint64_t> &scalers, vector<vector<unsigned int> > &starts, vector<unsigned int> &size)
-        : NddiCommandMessage(idFillScalerTiles),
-          scalers(scalers),
-          starts(starts),
-          size(size) {}
+        : NddiCommandMessage(idFillScalerTiles) {
+            assign(scalers, starts, size);
+        }
 
-        void play(GrpcNddiDisplay* display) {
+        void assign(vector<uint64_t> &scalers, vector<vector<unsigned int> > &starts, vector<unsigned int> &size) {
+            this->scalers = scalers;
+            this->starts = starts;
+            this->size = size;
+        }
+
+        void play(NDimensionalDisplayInterface* display) {
             display->FillScalerTiles(scalers, starts, size);
         }
 
@@ -497,7 +640,7 @@ namespace nddi {
             ar(CEREAL_NVP(scalers), CEREAL_NVP(starts), CEREAL_NVP(size));
         }
 
-    private:
+        // Public so that the recording optimizer can rewrite them.
         vector<uint64_t> scalers;
         vector<vector<unsigned int> > starts;
         vector<unsigned int> size;
@@ -508,12 +651,29 @@ namespace nddi {
         FillScalerTileStackCommandMessage() : NddiCommandMessage(idFillScalerTileStack) {}
 
         FillScalerTileStackCommandMessage(vector<uint64_t> &scalers, vector<unsigned int> &start, vector<unsigned int> &size)
-        : NddiCommandMessage(idFillScalerTileStack),
-          scalers(scalers),
-          start(start),
-          size(size) {}
+        : NddiCommandMessage(idFillScalerTileStack) {
+            assign(scalers, start, size);
+        }
 
-        void play(GrpcNddiDisplay* display) {
+        FillScalerTileStackCommandMessage(vector<uint64_t> &&scalers, vector<unsigned int> &start, vector<unsigned int> &size)
+        : NddiCommandMessage(idFillScalerTileStack) {
+            assign(std::move(scalers), start, size);
+        }
+
+        void assign(vector<uint64_t> &scalers, vector<unsigned int> &start, vector<unsigned int> &size) {
+            this->scalers = scalers;
+            this->start = start;
+            this->size = size;
+        }
+
+        // Takes the caller's scalers, handing back the vector this message held.
+        void assign(vector<uint64_t> &&scalers, vector<unsigned int> &start, vector<unsigned int> &size) {
+            this->scalers.swap(scalers);
+            this->start = start;
+            this->size = size;
+        }
+
+        void play(NDimensionalDisplayInterface* display) {
             display->FillScalerTileStack(scalers, start, size);
         }
 
@@ -522,7 +682,7 @@ namespace nddi {
             ar(CEREAL_NVP(scalers), CEREAL_NVP(start), CEREAL_NVP(size));
         }
 
-    private:
+        // Public so that the recording optimizer can rewrite them.
         vector<uint64_t> scalers;
         vector<unsigned int> start;
         vector<unsigned int> size;
@@ -533,10 +693,15 @@ namespace nddi {
         SetPixelByteSignModeCommandMessage() : NddiCommandMessage(idSetPixelByteSignMode) {}
 
         SetPixelByteSignModeCommandMessage(SignMode mode)
-        : NddiCommandMessage(idSetPixelByteSignMode),
-          mode(mode) {}
+        : NddiCommandMessage(idSetPixelByteSignMode) {
+            assign(mode);
+        }
 
-        void play(GrpcNddiDisplay* display) {
+        void assign(SignMode mode) {
+            this->mode = mode;
+        }
+
+        void play(NDimensionalDisplayInterface* display) {
             display->SetPixelByteSignMode(mode);
         }
 
@@ -554,10 +719,15 @@ namespace nddi {
         SetFullScalerCommandMessage() : NddiCommandMessage(idSetFullScaler) {}
 
         SetFullScalerCommandMessage(uint16_t scaler)
-        : NddiCommandMessage(idSetFullScaler),
-          scaler(scaler) {}
+        : NddiCommandMessage(idSetFullScaler) {
+            assign(scaler);
+        }
 
-        void play(GrpcNddiDisplay* display) {
+        void assign(uint16_t scaler) {
+            this->scaler = scaler;
+        }
+
+        void play(NDimensionalDisplayInterface* display) {
             display->SetFullScaler(scaler);
         }
 
@@ -574,7 +744,7 @@ namespace nddi {
     public:
         GetFullScalerCommandMessage() : NddiCommandMessage(idGetFullScaler) {}
 
-        void play(GrpcNddiDisplay* display) {
+        void play(NDimensionalDisplayInterface* display) {
             display->GetFullScaler();
         }
     };
@@ -593,8 +763,16 @@ namespace nddi {
         LatchCommandMessage() : NddiCommandMessage(idLatch) {}
 
         LatchCommandMessage(uint32_t sub_x, uint32_t sub_y, uint32_t sub_w, uint32_t sub_h)
-        : NddiCommandMessage(idLatch),
-          sub_x(sub_x),sub_y(sub_y), sub_w(sub_w), sub_h(sub_h) {}
+        : NddiCommandMessage(idLatch) {
+            assign(sub_x, sub_y, sub_w, sub_h);
+        }
+
+        void assign(uint32_t sub_x, uint32_t sub_y, uint32_t sub_w, uint32_t sub_h) {
+            this->sub_x = sub_x;
+            this->sub_y = sub_y;
+            this->sub_w = sub_w;
+            this->sub_h = sub_h;
+        }
 
         void play(GrpcNddiDisplay* display) {
             display->Latch(sub_x, sub_y, sub_w, sub_h);
@@ -605,7 +783,7 @@ namespace nddi {
             ar(CEREAL_NVP(sub_x), CEREAL_NVP(sub_y), CEREAL_NVP(sub_w), CEREAL_NVP(sub_h));
         }
 
-    private:
+        // Public so that the in-process dispatcher can latch the server's display directly.
         uint32_t sub_x, sub_y, sub_w, sub_h;
     };
 
@@ -0,0 +1,186 @@
+#ifndef NDDI_TRANSPORT_H
+#define NDDI_TRANSPORT_H
+
+/**
+ * \file NddiTransport.h
+ *
+ * \brief This file embodies the transports used by the GrpcNddiDisplay to reach the display.
+ *
+ * This file embodies the transports used by the GrpcNddiDisplay to reach the display. Without
+ * a transport installed, the GrpcNddiDisplay sends each command to the NDDI Wall Server over gRPC.
+ * When client and display share a process, an InProcessNddiTransport can be installed instead and
+ * the commands are handed over as NddiCommandMessages without any serialization.
+ */
+
+#include "NddiCommands.h"
+#include "nddi/Features.h"
+#include "nddi/NDimensionalDisplayInterface.h"
+
+#include <pthread.h>
+#include <queue>
+
+namespace nddi {
+
+    /**
+     * \brief Abstract transport which carries nDDI commands from a GrpcNddiDisplay to a display.
+     *
+     * Abstract transport which carries nDDI commands from a GrpcNddiDisplay to a display. Commands
+     * are handed over as NddiCommandMessages and the transport takes ownership of them. The queries
+     * are synchronous and are answered only after every previously sent command has been handled.
+     */
+    class NddiTransport {
+    public:
+        virtual ~NddiTransport() {}
+
+        /**
+         * \brief Hands the command to the transport, which then owns the message.
+         *
+         * Hands the command to the transport, which then owns the message.
+         * @param msg The command message to be delivered.
+         */
+        virtual void Send(NddiCommandMessage* msg) = 0;
+
+        virtual unsigned int DisplayWidth() = 0;
+        virtual unsigned int DisplayHeight() = 0;
+        virtual unsigned int NumCoefficientPlanes() = 0;
+        virtual uint16_t GetFullScaler() = 0;
+    };
+
+    /**
+     * \brief Transport which queues commands to a dispatcher running in the same process.
+     *
+     * Transport which queues commands to a dispatcher running in the same process. The client side
+     * calls Send() and the dispatcher (see nddiwall_standalone) loops on Receive(), plays each message
+     * into the display, and then calls Processed(). The messages own their payload, so pixel buffers
+     * are copied once when the message is built, or not at all when the tiler hands them over, and
+     * then only passed along by pointer.
+     */
+    class InProcessNddiTransport : public NddiTransport {
+    public:
+        InProcessNddiTransport()
+        : display_(NULL),
+          sent_(0),
+          processed_(0),
+          closed_(false) {
+            pthread_mutex_init(&queueMutex_, NULL);
+            pthread_cond_init(&queueCondition_, NULL);
+            pthread_cond_init(&processedCondition_, NULL);
+        }
+
+        ~InProcessNddiTransport() {
+            pthread_cond_destroy(&processedCondition_);
+            pthread_cond_destroy(&queueCondition_);
+            pthread_mutex_destroy(&queueMutex_);
+        }
+
+        void Send(NddiCommandMessage* msg) {
+            pthread_mutex_lock(&queueMutex_);
+            queue_.push(msg);
+            sent_++;
+            pthread_cond_signal(&queueCondition_);
+            pthread_mutex_unlock(&queueMutex_);
+        }
+
+        /**
+         * \brief Used by the dispatcher to block until the next command arrives.
+         *
+         * Used by the dispatcher to block until the next command arrives.
+         * @return The next command or NULL once the transport has been closed and drained.
+         */
+        NddiCommandMessage* Receive() {
+            NddiCommandMessage* msg = NULL;
+
+            pthread_mutex_lock(&queueMutex_);
+            while (queue_.empty() && !closed_) {
+                pthread_cond_wait(&queueCondition_, &queueMutex_);
+            }
+            if (!queue_.empty()) {
+                msg = queue_.front();
+                queue_.pop();
+            }
+            pthread_mutex_unlock(&queueMutex_);
+
+            return msg;
+        }
+
+        /**
+         * \brief Used by the dispatcher to report that a received command has been handled.
+         *
+         * Used by the dispatcher to report that a received command has been handled.
+         */
+        void Processed() {
+            pthread_mutex_lock(&queueMutex_);
+            processed_++;
+            pthread_cond_broadcast(&processedCondition_);
+            pthread_mutex_unlock(&queueMutex_);
+        }
+
+        /**
+         * \brief Wakes up the dispatcher and any waiting queries for good.
+         *
+         * Wakes up the dispatcher and any waiting queries for good.
+         */
+        void Close() {
+            pthread_mutex_lock(&queueMutex_);
+            closed_ = true;
+            pthread_cond_broadcast(&queueCondition_);
+            pthread_cond_broadcast(&processedCondition_);
+            pthread_mutex_unlock(&queueMutex_);
+        }
+
+        /**
+         * \brief Blocks until every command sent so far has been handled by the dispatcher.
+         *
+         * Blocks until every command sent so far has been handled by the dispatcher.
+         */
+        void Flush() {
+            pthread_mutex_lock(&queueMutex_);
+            while (processed_ < sent_ && !closed_) {
+                pthread_cond_wait(&processedCondition_, &queueMutex_);
+            }
+            pthread_mutex_unlock(&queueMutex_);
+        }
+
+        /**
+         * \brief Set by the dispatcher once it has initialized the display so that queries can be answered.
+         *
+         * Set by the dispatcher once it has initialized the display so that queries can be answered.
+         * @param display The display the dispatcher plays commands into.
+         */
+        void SetDisplay(NDimensionalDisplayInterface* display) {
+            display_ = display;
+        }
+
+        unsigned int DisplayWidth() {
+            Flush();
+            return display_ ? display_->DisplayWidth() : 0;
+        }
+
+        unsigned int DisplayHeight() {
+            Flush();
+            return display_ ? display_->DisplayHeight() : 0;
+        }
+
+        unsigned int NumCoefficientPlanes() {
+            Flush();
+            return display_ ? display_->NumCoefficientPlanes() : 0;
+        }
+
+        uint16_t GetFullScaler() {
+            Flush();
+            return display_ ? display_->GetFullScaler() : 0;
+        }
+
+    private:
+        NDimensionalDisplayInterface*   display_;
+        std::queue<NddiCommandMessage*> queue_;
+        size_t                          sent_, processed_;
+        bool                            closed_;
+        pthread_mutex_t                 queueMutex_;
+        pthread_cond_t                  queueCondition_;
+        pthread_cond_t                  processedCondition_;
+    };
+
+}
+
+#endif // NDDI_TRANSPORT_H
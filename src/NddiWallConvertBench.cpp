@@ -0,0 +1,220 @@
+#include <iostream>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "PixelConvert.h"
+
+using namespace nddi;
+
+/*
+ * The versions of each kernel, indexed by level. A level without its own version of a kernel is NULL.
+ */
+typedef void (*pixels_kernel_t)(const uint8_t* rgb, Pixel* pixels, size_t count, uint8_t mask);
+typedef void (*signed_kernel_t)(const uint8_t* rgb, int16_t* out, size_t samples);
+typedef void (*planar_kernel_t)(const uint8_t* rgb, int16_t* r, int16_t* g, int16_t* b, size_t count);
+
+pixels_kernel_t pixelsKernels[PIXEL_CONVERT_COUNT];
+signed_kernel_t signedKernels[PIXEL_CONVERT_COUNT];
+planar_kernel_t planarKernels[PIXEL_CONVERT_COUNT];
+
+void showUsage() {
+    std::cout << "Ussage: nddiwall_convert_bench [--width <n>] [--height <n>] [--ms <n>]" << std::endl;
+    std::cout << "        Checks every version of each conversion kernel against the scalar one, then times each for at least n ms." << std::endl;
+}
+
+uint64_t nanos() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+void setupKernels() {
+    memset(pixelsKernels, 0, sizeof(pixelsKernels));
+    memset(signedKernels, 0, sizeof(signedKernels));
+    memset(planarKernels, 0, sizeof(planarKernels));
+
+    pixelsKernels[PIXEL_CONVERT_SCALAR] = rgbToPixelsScalar;
+    signedKernels[PIXEL_CONVERT_SCALAR] = rgbToSignedScalar;
+    planarKernels[PIXEL_CONVERT_SCALAR] = rgbToPlanarScalar;
+#ifdef PIXEL_CONVERT_SIMD_AVAILABLE
+    pixelsKernels[PIXEL_CONVERT_SSSE3] = rgbToPixelsSsse3;
+    pixelsKernels[PIXEL_CONVERT_AVX2] = rgbToPixelsAvx2;
+    signedKernels[PIXEL_CONVERT_SSSE3] = rgbToSignedSse2;
+    signedKernels[PIXEL_CONVERT_AVX2] = rgbToSignedAvx2;
+    planarKernels[PIXEL_CONVERT_SSSE3] = rgbToPlanarSsse3;
+#endif
+}
+
+/*
+ * The longest row the kernels are checked on, which is a few vectors.
+ */
+#define CHECK_PIXELS 200
+
+/*
+ * Compares every version the CPU supports with the scalar one, over every row length up to a few vectors and
+ * every alignment of the RGB24 source within a pixel, so the tails after the vector loops are covered too.
+ */
+bool checkKernels(const std::vector<uint8_t> &rgb) {
+    const size_t maxCount = CHECK_PIXELS;
+    const uint8_t masks[] = { 0xff, 0xf0, 0x80 };
+    std::vector<Pixel> expectedPixels(maxCount), pixels(maxCount);
+    std::vector<int16_t> expectedShorts(maxCount * 3), shorts(maxCount * 3);
+
+    for (int l = PIXEL_CONVERT_SCALAR + 1; l < PIXEL_CONVERT_COUNT; l++) {
+        if (!pixelConvertSupported((PixelConvertLevel)l)) {
+            continue;
+        }
+        for (size_t count = 0; count <= maxCount; count++) {
+            for (size_t offset = 0; offset < 3; offset++) {
+                const uint8_t* source = &rgb[offset];
+
+                for (size_t m = 0; m < sizeof(masks); m++) {
+                    if (pixelsKernels[l]) {
+                        rgbToPixelsScalar(source, &expectedPixels[0], count, masks[m]);
+                        pixelsKernels[l](source, &pixels[0], count, masks[m]);
+                        if (memcmp(&expectedPixels[0], &pixels[0], count * sizeof(Pixel)) != 0) {
+                            std::cout << "rgbToPixels (" << pixelConvertName((PixelConvertLevel)l) << ") differs from scalar for "
+                                      << count << " pixels at offset " << offset << " with mask " << (int)masks[m] << std::endl;
+                            return false;
+                        }
+                    }
+                }
+                if (signedKernels[l]) {
+                    rgbToSignedScalar(source, &expectedShorts[0], count * 3);
+                    signedKernels[l](source, &shorts[0], count * 3);
+                    if (memcmp(&expectedShorts[0], &shorts[0], count * 3 * sizeof(int16_t)) != 0) {
+                        std::cout << "rgbToSigned (" << pixelConvertName((PixelConvertLevel)l) << ") differs from scalar for "
+                                  << count * 3 << " samples at offset " << offset << std::endl;
+                        return false;
+                    }
+                }
+                if (planarKernels[l]) {
+                    rgbToPlanarScalar(source, &expectedShorts[0], &expectedShorts[count], &expectedShorts[2 * count], count);
+                    planarKernels[l](source, &shorts[0], &shorts[count], &shorts[2 * count], count);
+                    if (memcmp(&expectedShorts[0], &shorts[0], count * 3 * sizeof(int16_t)) != 0) {
+                        std::cout << "rgbToPlanar (" << pixelConvertName((PixelConvertLevel)l) << ") differs from scalar for "
+                                  << count << " pixels at offset " << offset << std::endl;
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+void printRate(const char* kernel, const char* level, uint64_t bytes, uint64_t elapsed) {
+    std::cout << kernel << " , " << level << " , " << (double)bytes * 1000.0 / elapsed << std::endl;
+}
+
+int main(int argc, char** argv) {
+    size_t width = 1920, height = 1080;
+    int ms = 200;
+
+    argc--;
+    argv++;
+    while (argc) {
+        if (strcmp(*argv, "--width") == 0 && argc > 1) {
+            width = atoi(argv[1]);
+            argc--;
+            argv++;
+        } else if (strcmp(*argv, "--height") == 0 && argc > 1) {
+            height = atoi(argv[1]);
+            argc--;
+            argv++;
+        } else if (strcmp(*argv, "--ms") == 0 && argc > 1) {
+            ms = atoi(argv[1]);
+            argc--;
+            argv++;
+        } else {
+            showUsage();
+            return -1;
+        }
+        argc--;
+        argv++;
+    }
+
+    if (!width || !height || (ms <= 0)) {
+        showUsage();
+        return -1;
+    }
+
+    // A frame of noise, with room for the checks' longest row to start at any offset within a pixel
+    size_t count = width * height;
+    std::vector<uint8_t> rgb(((count > CHECK_PIXELS) ? count : CHECK_PIXELS) * 3 + 3);
+    srand(1);
+    for (size_t i = 0; i < rgb.size(); i++) {
+        rgb[i] = (uint8_t)rand();
+    }
+
+    setupKernels();
+    if (!checkKernels(rgb)) {
+        return -1;
+    }
+    std::cout << "Every supported version matches the scalar one. The kernels use " << pixelConvertName(pixelConvertLevel()) << "." << std::endl;
+
+    // Every rate is of the RGB24 bytes read. Each kernel is run over the frame until the time is up, so the clock
+    // covers enough rounds to measure even on tiny frames.
+    const uint64_t minNanos = (uint64_t)ms * 1000000ULL;
+    std::vector<Pixel> pixels(count);
+    std::vector<int16_t> shorts(count * 3);
+    uint64_t start, elapsed, rounds;
+    std::cout << "Kernel , Level , MB/s" << std::endl;
+    for (int l = PIXEL_CONVERT_SCALAR; l < PIXEL_CONVERT_COUNT; l++) {
+        const char* level = pixelConvertName((PixelConvertLevel)l);
+
+        if (!pixelConvertSupported((PixelConvertLevel)l)) {
+            continue;
+        }
+        if (pixelsKernels[l]) {
+            start = nanos();
+            rounds = 0;
+            do {
+                pixelsKernels[l](&rgb[0], &pixels[0], count, 0xff);
+                rounds++;
+            } while ((elapsed = nanos() - start) < minNanos);
+            printRate("rgbToPixels", level, count * 3 * rounds, elapsed);
+        }
+        if (signedKernels[l]) {
+            start = nanos();
+            rounds = 0;
+            do {
+                signedKernels[l](&rgb[0], &shorts[0], count * 3);
+                rounds++;
+            } while ((elapsed = nanos() - start) < minNanos);
+            printRate("rgbToSigned", level, count * 3 * rounds, elapsed);
+        }
+        if (planarKernels[l]) {
+            start = nanos();
+            rounds = 0;
+            do {
+                planarKernels[l](&rgb[0], &shorts[0], &shorts[count], &shorts[2 * count], count);
+                rounds++;
+            } while ((elapsed = nanos() - start) < minNanos);
+            printRate("rgbToPlanar", level, count * 3 * rounds, elapsed);
+        }
+    }
+
+    // Tiles are gathered a row at a time with rgbToPixels, so this is only timed at the level the kernels use
+    const size_t tileSize = 16;
+    std::vector<Pixel> tile(tileSize * tileSize);
+    start = nanos();
+    rounds = 0;
+    do {
+        for (size_t j = 0; j < height; j += tileSize) {
+            for (size_t i = 0; i < width; i += tileSize) {
+                gatherTile(&rgb[(j * width + i) * 3], width * 3,
+                           (i + tileSize <= width) ? tileSize : width - i, (j + tileSize <= height) ? tileSize : height - j,
+                           tileSize, tileSize, &tile[0]);
+            }
+        }
+        rounds++;
+    } while ((elapsed = nanos() - start) < minNanos);
+    printRate("gatherTile", pixelConvertName(pixelConvertLevel()), count * 3 * rounds, elapsed);
+
+    return 0;
+}
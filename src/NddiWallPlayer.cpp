@@ -1,24 +1,260 @@
+#include <atomic>
+#include <climits>
 #include <iostream>
 #include <memory>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <stdlib.h>
 #include <string>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
 
 #include <grpc++/grpc++.h>
 
 #include "GrpcNddiDisplay.h"
+#include "HeadlessReplay.h"
 #include "RecorderNddiDisplay.h"
 
 using namespace nddi;
 
+void showUsage() {
+    std::cout << "Ussage: nddiwall_player [--from-frame <n>] [--to-frame <m>] [--pace realtime|asap|x<speed>] [--connections <n>] <record-filename> [<record-filename> ...]" << std::endl;
+    std::cout << "        nddiwall_player --headless [--jobs <n>] <record-filename> [<record-filename> ...]" << std::endl;
+    std::cout << "        nddiwall_player [--compress <none|zlib|lz4|zstd>] [--block <KB>] --convert <v1-record-filename> <v2-record-filename>" << std::endl;
+}
+
+/*
+ * Each recording is played on its own thread into its own display.
+ */
+typedef struct {
+    RecorderNddiDisplay* display;
+    pthread_barrier_t*   barrier;
+    pthread_t            thread;
+} stream_t;
+
+void* playStream(void* arg) {
+    stream_t* stream = (stream_t*)arg;
+    stream->display->Play(stream->barrier);
+    return NULL;
+}
+
+/*
+ * Headless replays share a list of recordings which each worker takes the next recording from.
+ */
+typedef struct {
+    vector<char*>*                files;
+    vector<std::string>*          rows;
+    std::atomic<size_t>*          next;
+    int                           core;
+    pthread_t                     thread;
+} headless_job_t;
+
+void* replayHeadless(void* arg) {
+    headless_job_t* job = (headless_job_t*)arg;
+
+    // Pin the worker so recordings replayed in parallel don't migrate between cores
+    if (job->core >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(job->core, &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+
+    size_t i;
+    while ((i = job->next->fetch_add(1)) < job->files->size()) {
+        HeadlessReplay replay((*job->files)[i]);
+        std::stringstream row;
+        if (!replay.IsOpen()) {
+            std::cerr << replay.Error() << std::endl;
+        } else if (!replay.Run()) {
+            std::cerr << (*job->files)[i] << " has a corrupt record in frame " << replay.Frame() - 1 << std::endl;
+        } else if (!replay.Display()) {
+            std::cerr << (*job->files)[i] << " has no Init command." << std::endl;
+        } else {
+            row << (*job->files)[i] << " , ";
+            replay.OutputCsv(row);
+            std::cerr << "Replayed " << replay.Frame() << " frames of " << (*job->files)[i] << " in "
+                      << replay.Seconds() << " seconds." << std::endl;
+        }
+        (*job->rows)[i] = row.str();
+    }
+
+    return NULL;
+}
+
+/*
+ * Replays each recording into its own headless display, several at once, and prints the
+ * cost model of each as a row of the same CSV the NDDI Wall Server prints.
+ */
+int runHeadless(vector<char*> &files, size_t jobs) {
+    vector<std::string> rows(files.size());
+    std::atomic<size_t> next(0);
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (jobs > files.size()) {
+        jobs = files.size();
+    }
+    vector<headless_job_t> workers(jobs);
+    for (size_t j = 0; j < jobs; j++) {
+        workers[j].files = &files;
+        workers[j].rows = &rows;
+        workers[j].next = &next;
+        workers[j].core = (cores > 1) ? (int)(j % cores) : -1;
+        if (pthread_create(&workers[j].thread, NULL, replayHeadless, &workers[j])) {
+            std::cout << "Error: Failed to start thread." << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (size_t j = 0; j < jobs; j++) {
+        pthread_join(workers[j].thread, NULL);
+    }
+
+    int result = 0;
+    std::cout << "Recording , ";
+    outputCostCsvHeadings(std::cout);
+    std::cout << std::endl;
+    for (size_t i = 0; i < rows.size(); i++) {
+        if (rows[i].empty()) {
+            result = -1;
+        } else {
+            std::cout << rows[i] << std::endl;
+        }
+    }
+
+    return result;
+}
+
 int main(int argc, char** argv) {
-    RecorderNddiDisplay* myDisplay = NULL;
-    if (argc == 2) {
-        myDisplay = new RecorderNddiDisplay(argv[1]);
-        myDisplay->Play();
-        delete(myDisplay);
-    } else {
-        std::cout << "Ussage: nddiwall_player <record-filename>" << std::endl;
+    unsigned int fromFrame = 0;
+    unsigned int toFrame = UINT_MAX;
+    double speed = 0.0;
+    size_t connections = 4;
+    bool headless = false;
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    char* convertFrom = NULL;
+    vector<char*> files;
+    char* convertTo = NULL;
+    nddiwall::Compression compression = nddiwall::COMPRESSION_NONE;
+    size_t blockSize = RECORDING_BLOCK_SIZE;
+
+    argc--;
+    argv++;
+    while (argc) {
+        if (strcmp(*argv, "--from-frame") == 0 && argc > 1) {
+            fromFrame = atoi(argv[1]);
+            argc--;
+            argv++;
+        } else if (strcmp(*argv, "--to-frame") == 0 && argc > 1) {
+            toFrame = atoi(argv[1]);
+            argc--;
+            argv++;
+        } else if (strcmp(*argv, "--pace") == 0 && argc > 1) {
+            if (strcmp(argv[1], "realtime") == 0) {
+                speed = 1.0;
+            } else if (strcmp(argv[1], "asap") == 0) {
+                speed = 0.0;
+            } else if ((argv[1][0] == 'x') && (atof(argv[1] + 1) > 0.0)) {
+                speed = atof(argv[1] + 1);
+            } else {
+                showUsage();
+                return -1;
+            }
+            argc--;
+            argv++;
+        } else if (strcmp(*argv, "--convert") == 0 && argc > 2) {
+            convertFrom = argv[1];
+            convertTo = argv[2];
+            argc -= 2;
+            argv += 2;
+        } else if (strcmp(*argv, "--compress") == 0 && argc > 1) {
+            int i;
+            for (i = nddiwall::Compression_MIN; i <= nddiwall::Compression_MAX; i++) {
+                if (strcmp(argv[1], compressionName((nddiwall::Compression)i)) == 0) {
+                    break;
+                }
+            }
+            if ((i > nddiwall::Compression_MAX) || !compressionSupported((nddiwall::Compression)i)) {
+                std::cout << "Compression " << argv[1] << " isn't supported by this build." << std::endl;
+                return -1;
+            }
+            compression = (nddiwall::Compression)i;
+            argc--;
+            argv++;
+        } else if (strcmp(*argv, "--block") == 0 && argc > 1) {
+            blockSize = atoi(argv[1]) * 1024;
+            argc--;
+            argv++;
+        } else if (strcmp(*argv, "--connections") == 0 && argc > 1) {
+            connections = atoi(argv[1]);
+            argc--;
+            argv++;
+        } else if (strcmp(*argv, "--headless") == 0) {
+            headless = true;
+        } else if (strcmp(*argv, "--jobs") == 0 && argc > 1) {
+            jobs = atoi(argv[1]);
+            argc--;
+            argv++;
+        } else if (!convertTo && (*argv)[0] != '-') {
+            files.push_back(*argv);
+        } else {
+            showUsage();
+            return -1;
+        }
+        argc--;
+        argv++;
+    }
+
+    if ((!convertFrom && files.empty()) || (convertFrom && !files.empty()) || (fromFrame > toFrame) || !blockSize || !connections || (jobs < 1)) {
+        showUsage();
         return -1;
     }
 
+    if (convertTo) {
+        size_t count = CommandPlayer::Convert(convertFrom, convertTo, compression, blockSize);
+        std::cout << "Converted " << count << " commands from " << convertFrom << " to " << convertTo << std::endl;
+        return 0;
+    }
+
+    if (headless) {
+        return runHeadless(files, jobs);
+    }
+
+    // The streams share a pool of connections and are released together once they've each played frame 0
+    GrpcNddiDisplay::SetChannelPoolSize((connections < files.size()) ? connections : files.size());
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, files.size());
+
+    vector<stream_t> streams(files.size());
+    for (size_t i = 0; i < files.size(); i++) {
+        streams[i].display = new RecorderNddiDisplay(files[i], fromFrame, toFrame, speed);
+        streams[i].barrier = &barrier;
+        if (pthread_create(&streams[i].thread, NULL, playStream, &streams[i])) {
+            std::cout << "Error: Failed to start thread." << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    size_t frames = 0;
+    uint64_t start = 0, end = 0;
+    for (size_t i = 0; i < streams.size(); i++) {
+        pthread_join(streams[i].thread, NULL);
+        const playback_stats_t &stats = streams[i].display->PlaybackStats();
+        frames += stats.frames;
+        if (!start || (stats.startNanos < start)) { start = stats.startNanos; }
+        if (stats.endNanos > end) { end = stats.endNanos; }
+    }
+    if (streams.size() > 1) {
+        playback_stats_t aggregate = { frames, start, end };
+        std::cout << "Played " << frames << " frames of " << streams.size() << " recordings at "
+                  << playbackFps(aggregate) << " fps in aggregate." << std::endl;
+    }
+
+    for (size_t i = 0; i < streams.size(); i++) {
+        delete(streams[i].display);
+    }
+    pthread_barrier_destroy(&barrier);
+
     return 0;
 }
@@ -0,0 +1,216 @@
+#include <iostream>
+#include <stdlib.h>
+#include <string>
+#include <string.h>
+#include <vector>
+
+#include "nddi/SimpleNddiDisplay.h"
+
+#include "HeadlessReplay.h"
+#include "NddiCommands.h"
+#include "PayloadCompression.h"
+#include "RecordingFormat.h"
+#include "RecordingOptimizer.h"
+
+using namespace nddi;
+
+void showUsage() {
+    std::cout << "Ussage: nddiwall_recopt [--compress <none|zlib|lz4|zstd>] [--block <KB>] [--no-verify] <record-filename> <optimized-record-filename>" << std::endl;
+    std::cout << "        Older unindexed recordings must first be converted with nddiwall_player --convert." << std::endl;
+}
+
+/*
+ * Rewrites every frame of a recording and reports the commands and bytes of each frame before and after.
+ */
+bool optimize(std::string from, std::string to, Compression mode, size_t blockSize) {
+    RecordingReader reader(from);
+    if (!reader.IsOpen()) {
+        std::cout << reader.Error() << std::endl;
+        return false;
+    }
+    const recording_header_t &header = reader.Header();
+    RecordingOptimizer optimizer(header.displayWidth, header.displayHeight, header.numCoefficientPlanes);
+
+    // The first pass finds the grid the scaler commands are aligned to
+    uint64_t offset = reader.FrameOffset(0);
+    NddiCommandMessage* msg;
+    while (reader.Next(offset, msg)) {
+        optimizer.Measure(msg);
+        deleteCommand(msg);
+    }
+
+    RecordingWriter writer(to, mode, blockSize);
+    if (!writer.IsOpen()) {
+        std::cout << "Unable to open " << to << std::endl;
+        return false;
+    }
+
+    size_t totalBefore = 0, totalAfter = 0;
+    uint64_t bytesBefore = 0, bytesAfter = 0;
+    std::vector<NddiCommandMessage*> frame;
+    for (uint64_t f = 0; f < reader.FrameCount(); f++) {
+        offset = reader.FrameOffset(f);
+        uint64_t end = reader.FrameOffset(f + 1);
+        frame.clear();
+        while ((offset < end) && reader.Next(offset, msg)) {
+            frame.push_back(msg);
+        }
+        if (offset < end) {
+            std::cout << from << " has a corrupt record in frame " << f << std::endl;
+            for (size_t i = 0; i < frame.size(); i++) {
+                deleteCommand(frame[i]);
+            }
+            return false;
+        }
+
+        size_t before = frame.size();
+        uint64_t start = writer.Offset();
+        optimizer.Optimize(frame);
+        for (size_t i = 0; i < frame.size(); i++) {
+            writer.Write(frame[i]);
+            deleteCommand(frame[i]);
+        }
+
+        std::cout << "Frame " << f << ": " << before << " -> " << frame.size() << " commands, "
+                  << end - reader.FrameOffset(f) << " -> " << writer.Offset() - start << " bytes" << std::endl;
+        totalBefore += before;
+        totalAfter += frame.size();
+        bytesBefore += end - reader.FrameOffset(f);
+        bytesAfter += writer.Offset() - start;
+    }
+    writer.Close();
+
+    const optimizer_stats_t &stats = optimizer.Stats();
+    std::cout << "Optimized " << reader.FrameCount() << " frames from " << totalBefore << " to " << totalAfter
+              << " commands and from " << bytesBefore << " to " << bytesAfter << " bytes." << std::endl;
+    std::cout << "  Query commands dropped: " << stats.queries << std::endl;
+    if (optimizer.IsSimulatingScalers()) {
+        std::cout << "  Scaler tiles and planes overwritten before the latch: " << stats.deadScalers << std::endl;
+        std::cout << "  Scaler tiles and planes already holding their value: " << stats.redundantScalers << std::endl;
+    } else {
+        std::cout << "  Scalers weren't simulated because the display is too large." << std::endl;
+    }
+    std::cout << "  Coefficient matrix fills merged: " << stats.mergedFills << std::endl;
+    std::cout << "  Scaler tile commands batched: " << stats.batchedTiles << std::endl;
+    if (mode != nddiwall::COMPRESSION_NONE) {
+        const compression_stats_t &c = writer.Stats();
+        std::cout << "  Compressed to " << c.wireBytes << " bytes (" << (c.wireBytes ? (double)c.rawBytes / c.wireBytes : 0.0) << ":1)" << std::endl;
+    }
+
+    return true;
+}
+
+/*
+ * Renders both recordings headlessly from the given frame and compares the frame buffers at the end of every
+ * frame. Frames after 0 are played the way nddiwall_player --from-frame plays them, straight after frame 0.
+ */
+bool verify(std::string original, std::string optimized, uint64_t from) {
+    HeadlessReplay a(original), b(optimized);
+    if (!a.IsOpen() || !b.IsOpen()) {
+        std::cout << "Unable to verify: " << a.Error() << b.Error() << std::endl;
+        return false;
+    }
+    if (a.FrameCount() != b.FrameCount()) {
+        std::cout << "Verification failed: " << original << " has " << a.FrameCount() << " frames but "
+                  << optimized << " has " << b.FrameCount() << std::endl;
+        return false;
+    }
+    if ((from > 0) && (!a.Seek(from) || !b.Seek(from))) {
+        std::cout << "Verification failed: frame 0 couldn't be played." << std::endl;
+        return false;
+    }
+
+    size_t mismatched = 0, played = 0;
+    while (a.NextFrame() && b.NextFrame()) {
+        played++;
+        if (!a.Display() || !b.Display()) {
+            continue;
+        }
+        size_t pixels = a.Display()->DisplayWidth() * a.Display()->DisplayHeight();
+        Pixel* fa = a.Display()->GetFrameBuffer();
+        Pixel* fb = b.Display()->GetFrameBuffer();
+        if (memcmp(fa, fb, pixels * sizeof(Pixel))) {
+            size_t differing = 0;
+            for (size_t i = 0; i < pixels; i++) {
+                if (fa[i].packed != fb[i].packed) {
+                    differing++;
+                }
+            }
+            std::cout << "Frame " << a.Frame() - 1 << " differs in " << differing << " pixels." << std::endl;
+            mismatched++;
+        }
+    }
+
+    if (mismatched || (a.Frame() != a.FrameCount()) || (b.Frame() != b.FrameCount())) {
+        std::cout << "Verification failed: " << mismatched << " of " << played << " frames differ." << std::endl;
+        return false;
+    }
+    if (from > 0) {
+        std::cout << "Verified that the " << played << " frames from frame " << from << " render identically." << std::endl;
+    } else {
+        std::cout << "Verified that all " << played << " frames render identically." << std::endl;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    char* from = NULL;
+    char* to = NULL;
+    bool verifying = true;
+    nddiwall::Compression compression = nddiwall::COMPRESSION_NONE;
+    size_t blockSize = RECORDING_BLOCK_SIZE;
+
+    argc--;
+    argv++;
+    while (argc) {
+        if (strcmp(*argv, "--compress") == 0 && argc > 1) {
+            int i;
+            for (i = nddiwall::Compression_MIN; i <= nddiwall::Compression_MAX; i++) {
+                if (strcmp(argv[1], compressionName((nddiwall::Compression)i)) == 0) {
+                    break;
+                }
+            }
+            if ((i > nddiwall::Compression_MAX) || !compressionSupported((nddiwall::Compression)i)) {
+                std::cout << "Compression " << argv[1] << " isn't supported by this build." << std::endl;
+                return -1;
+            }
+            compression = (nddiwall::Compression)i;
+            argc--;
+            argv++;
+        } else if (strcmp(*argv, "--block") == 0 && argc > 1) {
+            blockSize = atoi(argv[1]) * 1024;
+            argc--;
+            argv++;
+        } else if (strcmp(*argv, "--no-verify") == 0) {
+            verifying = false;
+        } else if (!from && (*argv)[0] != '-') {
+            from = *argv;
+        } else if (!to && (*argv)[0] != '-') {
+            to = *argv;
+        } else {
+            showUsage();
+            return -1;
+        }
+        argc--;
+        argv++;
+    }
+
+    if (!from || !to || !blockSize || (strcmp(from, to) == 0)) {
+        showUsage();
+        return -1;
+    }
+
+    if (!optimize(from, to, compression, blockSize)) {
+        return -1;
+    }
+    if (verifying) {
+        // Also seek into the middle, which only works if no frame relies on the scalers earlier frames set
+        RecordingReader reader(from);
+        uint64_t seek = reader.IsOpen() ? reader.FrameCount() / 2 : 0;
+        if (!verify(from, to, 0) || ((seek > 1) && !verify(from, to, seek))) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include <iostream>
+#include <stdlib.h>
+#include <string>
+#include <string.h>
+
+#include "HeadlessReplay.h"
+#include "RecordingAnalyzer.h"
+
+using namespace nddi;
+
+void showUsage() {
+    std::cout << "Ussage: nddiwall_recstat [--tile <n>] [--intervals|--totals|--stacks|--heatmap] <record-filename>" << std::endl;
+    std::cout << "        Older unindexed recordings must first be converted with nddiwall_player --convert." << std::endl;
+}
+
+int main(int argc, char** argv) {
+    char* file = NULL;
+    unsigned int tileSize = 8;
+    const char* report = NULL;
+
+    argc--;
+    argv++;
+    while (argc) {
+        if (strcmp(*argv, "--tile") == 0 && argc > 1) {
+            tileSize = atoi(argv[1]);
+            argc--;
+            argv++;
+        } else if (!report && ((strcmp(*argv, "--intervals") == 0) || (strcmp(*argv, "--totals") == 0) ||
+                               (strcmp(*argv, "--stacks") == 0) || (strcmp(*argv, "--heatmap") == 0))) {
+            report = *argv + 2;
+        } else if (!file && (*argv)[0] != '-') {
+            file = *argv;
+        } else {
+            showUsage();
+            return -1;
+        }
+        argc--;
+        argv++;
+    }
+
+    if (!file || !tileSize) {
+        showUsage();
+        return -1;
+    }
+
+    // Latches don't charge the link, so the display is never rendered
+    HeadlessReplay replay(file, false);
+    if (!replay.IsOpen()) {
+        std::cout << replay.Error() << std::endl;
+        return -1;
+    }
+    RecordingAnalyzer analyzer(replay.Header().displayWidth, replay.Header().displayHeight, tileSize);
+    replay.SetObserver(&analyzer);
+    if (!replay.Run()) {
+        std::cout << file << " has a corrupt record in frame " << replay.Frame() - 1 << std::endl;
+        return -1;
+    }
+    analyzer.EndInterval();
+
+    // A single report is printed as plain CSV, otherwise each is titled
+    if (report) {
+        if (strcmp(report, "intervals") == 0) {
+            analyzer.OutputIntervalsCsv(std::cout);
+        } else if (strcmp(report, "totals") == 0) {
+            analyzer.OutputTotalsCsv(std::cout);
+        } else if (strcmp(report, "stacks") == 0) {
+            analyzer.OutputStackHeightsCsv(std::cout);
+        } else {
+            analyzer.OutputHeatmapCsv(std::cout);
+        }
+        return 0;
+    }
+
+    std::cout << "Latch Intervals:" << std::endl;
+    analyzer.OutputIntervalsCsv(std::cout);
+    std::cout << std::endl << "Totals:" << std::endl;
+    analyzer.OutputTotalsCsv(std::cout);
+    std::cout << std::endl << "FillScalerTileStack Heights:" << std::endl;
+    analyzer.OutputStackHeightsCsv(std::cout);
+    std::cout << std::endl << "Coefficient Plane Heatmap (" << tileSize << "x" << tileSize << " tiles):" << std::endl;
+    analyzer.OutputHeatmapCsv(std::cout);
+
+    return 0;
+}
@@ -1,5 +1,7 @@
 #include <iostream>
+#include <map>
 #include <memory>
+#include <stdint.h>
 #include <string>
 #include <unistd.h>
 #include <sys/time.h>
@@ -26,6 +28,16 @@
 #endif
 
 #include "nddiwall.grpc.pb.h"
+#include "CostModelCsv.h"
+#include "PayloadCompression.h"
+#include "SharedMemoryRing.h"
+#include "TiledCoefficients.h"
+#include "WireFormat.h"
+
+#ifdef NDDIWALL_STANDALONE
+#include "GrpcNddiDisplay.h"
+#include "NddiTransport.h"
+#endif
 
 #ifdef DEBUG
 #define DEBUG_MSG(str) do { std::cout << str; } while( false )
@@ -38,6 +50,7 @@ using grpc::ServerBuilder;
 using grpc::ServerContext;
 using grpc::Status;
 using nddiwall::InitializeRequest;
+using nddiwall::InitializeReply;
 using nddiwall::StatusReply;
 using nddiwall::DisplayWidthRequest;
 using nddiwall::DisplayHeightRequest;
@@ -58,6 +71,12 @@ using nddiwall::FillCoefficientTilesRequest;
 using nddiwall::FillScalerRequest;
 using nddiwall::FillScalerTilesRequest;
 using nddiwall::FillScalerTileStackRequest;
+using nddiwall::FillCoefficientTilesV2Request;
+using nddiwall::FillScalerTilesV2Request;
+using nddiwall::FillScalerTileStackV2Request;
+using nddiwall::QuantizedScalers;
+using nddiwall::RegisterScalerQuantizerRequest;
+using nddiwall::RegisterScalerQuantizerReply;
 using nddiwall::SetPixelByteSignModeRequest;
 using nddiwall::GetFullScalerRequest;
 using nddiwall::GetFullScalerReply;
@@ -66,7 +85,17 @@ using nddiwall::UpdateInputVectorRequest;
 using nddiwall::ClearCostModelRequest;
 using nddiwall::LatchRequest;
 using nddiwall::ShutdownRequest;
+using nddiwall::SharedMemoryPayload;
+using nddiwall::RegisterSharedMemoryRequest;
+using nddiwall::RegisterSharedMemoryReply;
+using nddiwall::UnregisterSharedMemoryRequest;
+using nddiwall::CompressedPayload;
+using nddiwall::Compression;
 using nddiwall::NddiWall;
+using nddi::SharedMemoryRing;
+#ifdef NDDIWALL_STANDALONE
+using namespace nddi;
+#endif
 
 /*
  * Globals
@@ -84,13 +113,245 @@ bool alive;
 int totalUpdates = 0;
 timeval startTime, endTime; // Used for timing data
 uint32_t sub_x, sub_y, sub_w, sub_h;
+std::map<uint32_t, std::shared_ptr<SharedMemoryRing> > sharedMemoryRings;
+pthread_mutex_t sharedMemoryMutex = PTHREAD_MUTEX_INITIALIZER;
+uint32_t nextSharedMemoryId = 1;
+long sharedMemoryBytes = 0;
+compression_stats_t decompressionStats[nddiwall::Compression_ARRAYSIZE];
+long compressionUsecs[nddiwall::Compression_ARRAYSIZE];
+pthread_mutex_t compressionMutex = PTHREAD_MUTEX_INITIALIZER;
+std::map<std::string, wire_stats_t> wireStats;
+pthread_mutex_t wireStatsMutex = PTHREAD_MUTEX_INITIALIZER;
+std::map<uint32_t, std::pair<uint32_t, vector<uint32_t> > > scalerQuantizers;   // First plane and divisors
+pthread_mutex_t scalerQuantizerMutex = PTHREAD_MUTEX_INITIALIZER;
+uint32_t nextScalerQuantizerId = 1;
+long quantizedScalerSavings = 0;
+pthread_mutex_t tiledCoefficientMutex = PTHREAD_MUTEX_INITIALIZER;
+long tiledCoefficientSavings = 0;
+long tiledCommandSavings = 0;
+#ifdef NDDIWALL_STANDALONE
+InProcessNddiTransport inProcessTransport;
+pthread_t clientThread;
+int clientArgc;
+// The client's own copy of argv, since glutInit takes its options out of the one main was given
+vector<char*> clientArgv;
+
+// PixelBridgeMain's entry point when it's linked into nddiwall_standalone.
+int pixelBridgeMain(int argc, char *argv[]);
+#endif
+
+
+/*
+ * Command handling shared by the gRPC service and the in-process dispatcher
+ */
+bool initializeDisplay(vector<unsigned int> &fvDimensions,
+                       unsigned int displayWidth, unsigned int displayHeight,
+                       unsigned int numCoefficientPlanes, unsigned int inputVectorSize,
+                       bool fixed8x8Macroblocks, bool useSingleCoeffcientPlane) {
+    if (myDisplay) {
+        return false;
+    }
+
+    // Initialize the NDDI display
+#ifdef USE_GL
+    myDisplay = new GlNddiDisplay(fvDimensions,                    // framevolume dimensional sizes
+                                  displayWidth,                    // display size
+                                  displayHeight,
+                                  numCoefficientPlanes,            // number of coefficient planes on the display
+                                  inputVectorSize,                 // input vector size (x, y, t)
+                                  false,                           // Is not headless
+                                  fixed8x8Macroblocks,             // Use fixed macroblocks
+                                  useSingleCoeffcientPlane);       // Use only one coefficient plane for coefficeints
+#else
+    myDisplay = new SimpleNddiDisplay(fvDimensions,                    // framevolume dimensional sizes
+                                      displayWidth,                    // display size
+                                      displayHeight,
+                                      numCoefficientPlanes,            // number of coefficient planes on the display
+                                      inputVectorSize,                 // input vector size (x, y, t)
+                                      false,                           // Is not headless
+                                      fixed8x8Macroblocks,             // Use fixed macroblocks
+                                      useSingleCoeffcientPlane);       // Use only one coefficient plane for coefficeints
+#endif
+
+    return true;
+}
+
+bool clearCostModel() {
+    if (!myDisplay) {
+        return false;
+    }
+    myDisplay->GetCostModel()->clearCosts();
+    // The savings are taken out of the link cost, so they go with it.
+    pthread_mutex_lock(&scalerQuantizerMutex);
+    quantizedScalerSavings = 0;
+    pthread_mutex_unlock(&scalerQuantizerMutex);
+    pthread_mutex_lock(&tiledCoefficientMutex);
+    tiledCoefficientSavings = 0;
+    tiledCommandSavings = 0;
+    pthread_mutex_unlock(&tiledCoefficientMutex);
+    return true;
+}
+
+void latchDisplay(uint32_t x, uint32_t y, uint32_t w, uint32_t h) {
+    sub_x = x;
+    sub_y = y;
+    sub_w = w;
+    sub_h = h;
+
+    pthread_mutex_lock(&renderMutex);
+    pthread_cond_signal(&renderCondition);
+    pthread_mutex_unlock(&renderMutex);
+}
+
+/*
+ * Returns a pointer to a bulk payload in a client's shared memory ring or NULL if the ring isn't
+ * registered or the payload doesn't lie within it. The ring stays mapped for as long as the caller
+ * holds the reference, even if it's unregistered meanwhile.
+ */
+uint8_t* sharedMemoryPayload(const SharedMemoryPayload &shm, std::shared_ptr<SharedMemoryRing> &ring) {
+    uint8_t* payload = NULL;
+
+    pthread_mutex_lock(&sharedMemoryMutex);
+    std::map<uint32_t, std::shared_ptr<SharedMemoryRing> >::iterator it = sharedMemoryRings.find(shm.id());
+    if (it != sharedMemoryRings.end()) {
+        payload = it->second->At(shm.offset(), shm.length());
+        if (payload) {
+            ring = it->second;
+            sharedMemoryBytes += shm.length();
+        }
+    }
+    pthread_mutex_unlock(&sharedMemoryMutex);
+
+    return payload;
+}
+
+/*
+ * Multiplies two element counts, saturating instead of overflowing since they only bound what a client may send.
+ */
+size_t saturatingProduct(size_t a, size_t b) {
+    return (b && (a > SIZE_MAX / b)) ? SIZE_MAX : a * b;
+}
+
+/*
+ * Returns the number of elements in the region from start to end inclusive, or zero if they don't make one.
+ */
+template <class T>
+size_t regionSize(const T &start, const T &end) {
+    if ((start.size() == 0) || (start.size() != end.size())) {
+        return 0;
+    }
+    size_t n = 1;
+    for (int i = 0; i < start.size(); i++) {
+        if (end[i] < start[i]) {
+            return 0;
+        }
+        n = saturatingProduct(n, (size_t)end[i] - start[i] + 1);
+    }
+    return n;
+}
+
+/*
+ * Decompresses a bulk payload straight into the buffer that's handed to the display and accounts for it. The
+ * length is the client's word, so the payload is refused unless it's a whole number of elements and no more of
+ * them than the command's coordinates call for. Only then is the buffer sized from it.
+ */
+template <class T>
+bool compressedPayload(const CompressedPayload &compressed, size_t elementSize, size_t maxElements, vector<T> &dst) {
+    if ((compressed.length() % elementSize) || (compressed.length() % sizeof(T)) ||
+        (compressed.length() / elementSize > maxElements)) {
+        return false;
+    }
+    dst.resize(compressed.length() / sizeof(T));
+
+    compression_stats_t stats = { 0, 0, 0, 0 };
+    if (!decompressPayload(compressed.compression(), compressed.data(), (uint8_t*)dst.data(), compressed.length(), &stats)) {
+        return false;
+    }
+
+    pthread_mutex_lock(&compressionMutex);
+    compression_stats_t &total = decompressionStats[compressed.compression()];
+    total.messages += stats.messages;
+    total.rawBytes += stats.rawBytes;
+    total.wireBytes += stats.wireBytes;
+    total.usecs += stats.usecs;
+    compressionUsecs[compressed.compression()] += compressed.compressusecs();
+    pthread_mutex_unlock(&compressionMutex);
+
+    return true;
+}
+
+/*
+ * Accounts for the bytes on the wire and the encoding and decoding time of a tile or stack request.
+ */
+void accountWireFormat(const std::string &command, size_t wireBytes, uint32_t encodeNanos, uint64_t decodeNanos) {
+    pthread_mutex_lock(&wireStatsMutex);
+    wire_stats_t &stats = wireStats[command];
+    stats.messages++;
+    stats.wireBytes += wireBytes;
+    stats.encodeNanos += encodeNanos;
+    stats.decodeNanos += decodeNanos;
+    pthread_mutex_unlock(&wireStatsMutex);
+}
+
+/*
+ * Dequantizes a stack of scalers sent as quantized levels and accounts for the link bytes saved. The stack is
+ * multiplied by the quantizer's divisors for the planes from its first plane on. The display charges the link
+ * for full scalers, so the savings are taken back out of the reported link cost.
+ */
+bool quantizedScalers(const QuantizedScalers &quantized, uint32_t plane, vector<uint64_t> &scalers) {
+    vector<uint32_t> divisors;
+    uint32_t first = 0;
+    if (quantized.quantizer()) {
+        pthread_mutex_lock(&scalerQuantizerMutex);
+        std::map<uint32_t, std::pair<uint32_t, vector<uint32_t> > >::iterator it = scalerQuantizers.find(quantized.quantizer());
+        bool found = (it != scalerQuantizers.end()) && (plane >= it->second.first);
+        if (found) {
+            first = plane - it->second.first;
+            divisors = it->second.second;
+        }
+        pthread_mutex_unlock(&scalerQuantizerMutex);
+        if (!found) {
+            return false;
+        }
+    }
+
+    if (!dequantizeScalers((const uint8_t*)quantized.levels().data(), quantized.levels().length(),
+                           quantized.width(), divisors, first, scalers)) {
+        return false;
+    }
+
+    pthread_mutex_lock(&scalerQuantizerMutex);
+    quantizedScalerSavings += scalers.size() * BYTES_PER_SCALER - quantized.levels().length();
+    pthread_mutex_unlock(&scalerQuantizerMutex);
+
+    return true;
+}
+
+/*
+ * Fills the coefficient planes with a tiled coefficient matrix. The display takes one FillCoefficientMatrix
+ * per tile and charges the link for each, so the bytes and commands beyond the single tiled command are
+ * taken back out of the reported link cost.
+ */
+void fillCoefficientMatrixTiled(vector< vector<int> > &coefficientMatrix, vector<unsigned int> &start,
+                                vector<unsigned int> &end, vector<unsigned int> &size) {
+    pthread_mutex_lock(&tiledCoefficientMutex);
+    tiledCoefficientSavings += expandCoefficientMatrixTiled(myDisplay, coefficientMatrix, start, end, size, &tiledCommandSavings);
+    pthread_mutex_unlock(&tiledCoefficientMutex);
+}
+
+void shutdownDisplay() {
+    alive = false;
+    pthread_mutex_lock(&renderMutex);
+    pthread_cond_signal(&renderCondition);
+    pthread_mutex_unlock(&renderMutex);
+}
 
 
 // Logic and data behind the server's behavior.
 class NddiServiceImpl final : public NddiWall::Service {
 
   Status Initialize(ServerContext* context, const InitializeRequest* request,
-                    StatusReply* reply) override {
+                    InitializeReply* reply) override {
     DEBUG_MSG("Server got a request to initialize an NDDI Display." << std::endl);
     if (!myDisplay) {
         inputVectorSize_ = request->inputvectorsize();
@@ -110,30 +371,22 @@ class NddiServiceImpl final : public NddiWall::Service {
         DEBUG_MSG("  - Fixed 8x8 Macroblocks: " << request->fixed8x8macroblocks() << std::endl);
         DEBUG_MSG("  - Use Single Coeffcient Plane: " << request->usesinglecoeffcientplane() << std::endl);
 
-        // Initialize the NDDI display
-#ifdef USE_GL
-        myDisplay = new GlNddiDisplay(fvDimensions,                    // framevolume dimensional sizes
-                                      request->displaywidth(),         // display size
-                                      request->displayheight(),
-                                      request->numcoefficientplanes(), // number of coefficient planes on the display
-                                      request->inputvectorsize(),      // input vector size (x, y, t)
-                                      false,                           // Is not headless
-                                      request->fixed8x8macroblocks(),  // Use fixed macroblocks
-                                      request->usesinglecoeffcientplane()); // Use only one coefficient plane for coefficeints
-#else
-        myDisplay = new SimpleNddiDisplay(fvDimensions,                    // framevolume dimensional sizes
-                                          request->displaywidth(),         // display size
-                                          request->displayheight(),
-                                          request->numcoefficientplanes(), // number of coefficient planes on the display
-                                          request->inputvectorsize(),      // input vector size (x, y, t)
-                                          false,                           // Is not headless
-                                          request->fixed8x8macroblocks(),  // Use fixed macroblocks
-                                          request->usesinglecoeffcientplane()); // Use only one coefficient plane for coefficeints
-#endif
+        initializeDisplay(fvDimensions,
+                          request->displaywidth(), request->displayheight(),
+                          request->numcoefficientplanes(), request->inputvectorsize(),
+                          request->fixed8x8macroblocks(), request->usesinglecoeffcientplane());
 
-        reply->set_status(reply->OK);
+        // Settle on a compression mode. zlib is always available, so fall back to it.
+        Compression compression = request->compression();
+        if (!compressionSupported(compression)) {
+            compression = nddiwall::COMPRESSION_ZLIB;
+        }
+        DEBUG_MSG("  - Compression: " << compressionName(compression) << std::endl);
+
+        reply->set_compression(compression);
+        reply->set_status(StatusReply::OK);
     } else {
-        reply->set_status(reply->NOT_OK);
+        reply->set_status(StatusReply::NOT_OK);
     }
     return Status::OK;
   }
@@ -312,10 +565,29 @@ class NddiServiceImpl final : public NddiWall::Service {
                     StatusReply* reply) override {
       DEBUG_MSG("Server got a request to CopyPixels." << std::endl);
       if (myDisplay) {
+          // The pixels are handed to the display right where they are, either in the client's
+          // shared memory ring or in the request itself. Compressed pixels are decompressed
+          // straight into the buffer handed to the display.
           size_t count = request->pixels().length() / sizeof(Pixel);
+          Pixel* p = (Pixel*)request->pixels().data();
+          vector<Pixel> decompressed;
+          std::shared_ptr<SharedMemoryRing> ring;
+          if (request->has_shm()) {
+              count = request->shm().length() / sizeof(Pixel);
+              p = (Pixel*)sharedMemoryPayload(request->shm(), ring);
+              if (!p) {
+                  reply->set_status(reply->NOT_OK);
+                  return Status::OK;
+              }
+          } else if (request->has_compressed()) {
+              if (!compressedPayload(request->compressed(), sizeof(Pixel), regionSize(request->start(), request->end()), decompressed)) {
+                  reply->set_status(reply->NOT_OK);
+                  return Status::OK;
+              }
+              count = decompressed.size();
+              p = decompressed.data();
+          }
           DEBUG_MSG("  - Pixels: " << count << std::endl);
-          Pixel p[count];
-          memcpy(p, request->pixels().data(), count * sizeof(Pixel));
 
           DEBUG_MSG("  - Start: (");
           vector<unsigned int> start;
@@ -347,13 +619,29 @@ class NddiServiceImpl final : public NddiWall::Service {
   Status CopyPixelTiles(ServerContext* context, const CopyPixelTilesRequest* request,
                         StatusReply* reply) override {
       DEBUG_MSG("Server got a request to CopyPixelTiles." << std::endl);
-      if (myDisplay) {
+      if (myDisplay && (request->size_size() >= 2)) {
+          size_t tile_size = (size_t)request->size(0) * request->size(1);
+          size_t tile_count = request->starts_size() / frameVolumeDimensionality_;
           size_t count = request->pixels().length() / sizeof(Pixel);
+          Pixel* p = (Pixel*)request->pixels().data();
+          vector<Pixel> decompressed;
+          std::shared_ptr<SharedMemoryRing> ring;
+          if (request->has_shm()) {
+              count = request->shm().length() / sizeof(Pixel);
+              p = (Pixel*)sharedMemoryPayload(request->shm(), ring);
+              if (!p) {
+                  reply->set_status(reply->NOT_OK);
+                  return Status::OK;
+              }
+          } else if (request->has_compressed()) {
+              if (!compressedPayload(request->compressed(), sizeof(Pixel), saturatingProduct(tile_size, tile_count), decompressed)) {
+                  reply->set_status(reply->NOT_OK);
+                  return Status::OK;
+              }
+              count = decompressed.size();
+              p = decompressed.data();
+          }
           DEBUG_MSG("  - Pixels: " << count << std::endl);
-          Pixel p[count];
-          memcpy(p, request->pixels().data(), count * sizeof(Pixel));
-          size_t tile_size = request->size(0) * request->size(1);
-          size_t tile_count = request->starts_size() / frameVolumeDimensionality_;
           vector<Pixel*> ps(tile_count, 0);
           for (int i = 0; i < tile_count; i++) {
               ps[i] = p + (i * tile_size);
@@ -463,6 +751,39 @@ class NddiServiceImpl final : public NddiWall::Service {
       return Status::OK;
   }
 
+  Status FillCoefficientMatrixTiled(ServerContext* context, const FillCoefficientMatrixTiledRequest* request,
+                                    StatusReply* reply) override {
+      DEBUG_MSG("Server got a request to FillCoefficientMatrixTiled." << std::endl);
+      if (myDisplay && (request->size_size() == 2)) {
+          DEBUG_MSG("  - Coefficient Matrix (row <-> col):" << std::endl);
+          vector< vector<int> > coefficientMatrix;
+          assert(request->coefficientmatrix_size() == inputVectorSize_ * frameVolumeDimensionality_);
+          coefficientMatrix.resize(frameVolumeDimensionality_);
+          for (int j = 0; j < frameVolumeDimensionality_; j++) {
+              DEBUG_MSG("    ");
+              for (int i = 0; i < inputVectorSize_; i++) {
+                  coefficientMatrix[j].push_back(request->coefficientmatrix(j * inputVectorSize_ + i));
+                  DEBUG_MSG(request->coefficientmatrix(j * inputVectorSize_ + i) << " ");
+              }
+              DEBUG_MSG(std::endl);
+          }
+
+          vector<unsigned int> start(request->start().begin(), request->start().end());
+          vector<unsigned int> end(request->end().begin(), request->end().end());
+          vector<unsigned int> size(request->size().begin(), request->size().end());
+          DEBUG_MSG("  - Start: (" << start[0] << "," << start[1] << ")" << std::endl);
+          DEBUG_MSG("  - End: (" << end[0] << "," << end[1] << ")" << std::endl);
+          DEBUG_MSG("  - Tile Size: " << size[0] << "x" << size[1] << std::endl);
+
+          fillCoefficientMatrixTiled(coefficientMatrix, start, end, size);
+
+          reply->set_status(reply->OK);
+      } else {
+          reply->set_status(reply->NOT_OK);
+      }
+      return Status::OK;
+  }
+
   Status FillCoefficient(ServerContext* context, const FillCoefficientRequest* request,
                          StatusReply* reply) override {
       DEBUG_MSG("Server got a request to FillCoefficient." << std::endl);
@@ -505,6 +826,7 @@ class NddiServiceImpl final : public NddiWall::Service {
                         StatusReply* reply) override {
       DEBUG_MSG("Server got a request to FillCoefficientTiles." << std::endl);
       if (myDisplay) {
+          uint64_t decodeStart = wireNanos();
           size_t tile_count = request->coefficients_size();
           DEBUG_MSG("  - Coefficients: " << request->coefficients_size() << std::endl);
           vector<int> coeffs;
@@ -517,7 +839,7 @@ class NddiServiceImpl final : public NddiWall::Service {
           for (int i = 0; i < tile_count; i++) {
               vector<unsigned int> pos;
               pos.push_back(request->positions(2 * i + 0));
-              pos.push_back(request->positions(2 * i + 0));
+              pos.push_back(request->positions(2 * i + 1));
               positions.push_back(pos);
           }
 
@@ -537,6 +859,9 @@ class NddiServiceImpl final : public NddiWall::Service {
           size.push_back(request->size(1));
           DEBUG_MSG(request->size(0) << "," << request->size(1) << ")" << std::endl);
 
+          uint64_t decodeNanos = wireNanos() - decodeStart;
+          accountWireFormat("FillCoefficientTiles v1", request->ByteSizeLong(), request->encodenanos(), decodeNanos);
+
           myDisplay->FillCoefficientTiles(coeffs, positions, starts, size);
 
           reply->set_status(reply->OK);
@@ -585,12 +910,20 @@ class NddiServiceImpl final : public NddiWall::Service {
                          StatusReply* reply) override {
       DEBUG_MSG("Server got a request to FillScalerTiles." << std::endl);
       if (myDisplay) {
-          size_t tile_count = request->scalers_size();
-          DEBUG_MSG("  - Scalers: " << request->scalers_size() << std::endl);
+          uint64_t decodeStart = wireNanos();
           vector<uint64_t> scalers;
-          for (int i = 0; i < request->scalers_size(); i++) {
-              scalers.push_back(request->scalers(i));
+          if (request->has_compressed()) {
+              if (!compressedPayload(request->compressed(), sizeof(uint64_t), request->starts_size() / frameVolumeDimensionality_, scalers)) {
+                  reply->set_status(reply->NOT_OK);
+                  return Status::OK;
+              }
+          } else {
+              for (int i = 0; i < request->scalers_size(); i++) {
+                  scalers.push_back(request->scalers(i));
+              }
           }
+          size_t tile_count = scalers.size();
+          DEBUG_MSG("  - Scalers: " << scalers.size() << std::endl);
 
           DEBUG_MSG("  - Starts: " << request->starts_size() << std::endl);
           vector < vector<unsigned int> > starts;
@@ -611,6 +944,9 @@ class NddiServiceImpl final : public NddiWall::Service {
           DEBUG_MSG(
                   request->size(0) << "," << request->size(1) << ")" << std::endl);
 
+          uint64_t decodeNanos = wireNanos() - decodeStart;
+          accountWireFormat("FillScalerTiles v1", request->ByteSizeLong(), request->encodenanos(), decodeNanos);
+
           myDisplay->FillScalerTiles(scalers, starts, size);
 
           reply->set_status(reply->OK);
@@ -624,11 +960,27 @@ class NddiServiceImpl final : public NddiWall::Service {
                              StatusReply* reply) override {
       DEBUG_MSG("Server got a request to FillScalerTileStack." << std::endl);
       if (myDisplay) {
+          uint64_t decodeStart = wireNanos();
           vector<uint64_t> scalers;
-          DEBUG_MSG("  - Scalers: " << request->scalers_size() << std::endl);
-          for (int i = 0; i < request->scalers_size(); i++) {
-              scalers.push_back(request->scalers(i));
+          if (request->has_shm()) {
+              std::shared_ptr<SharedMemoryRing> ring;
+              uint64_t* s = (uint64_t*)sharedMemoryPayload(request->shm(), ring);
+              if (!s) {
+                  reply->set_status(reply->NOT_OK);
+                  return Status::OK;
+              }
+              scalers.assign(s, s + request->shm().length() / sizeof(uint64_t));
+          } else if (request->has_compressed()) {
+              if (!compressedPayload(request->compressed(), sizeof(uint64_t), myDisplay->NumCoefficientPlanes(), scalers)) {
+                  reply->set_status(reply->NOT_OK);
+                  return Status::OK;
+              }
+          } else {
+              for (int i = 0; i < request->scalers_size(); i++) {
+                  scalers.push_back(request->scalers(i));
+              }
           }
+          DEBUG_MSG("  - Scalers: " << scalers.size() << std::endl);
 
           DEBUG_MSG("  - Start: (");
           vector<unsigned int> start;
@@ -648,6 +1000,120 @@ class NddiServiceImpl final : public NddiWall::Service {
           }
           DEBUG_MSG(")" << std::endl);
 
+          uint64_t decodeNanos = wireNanos() - decodeStart;
+          accountWireFormat("FillScalerTileStack v1", request->ByteSizeLong(), request->encodenanos(), decodeNanos);
+
+          myDisplay->FillScalerTileStack(scalers, start, size);
+
+          reply->set_status(reply->OK);
+      } else {
+          reply->set_status(reply->NOT_OK);
+      }
+      return Status::OK;
+  }
+
+  Status FillCoefficientTilesV2(ServerContext* context, const FillCoefficientTilesV2Request* request,
+                                StatusReply* reply) override {
+      DEBUG_MSG("Server got a request to FillCoefficientTilesV2." << std::endl);
+      if (myDisplay) {
+          uint64_t decodeStart = wireNanos();
+          const int32_t* c = (const int32_t*)request->coefficients().data();
+          vector<int> coeffs(c, c + request->coefficients().length() / sizeof(int32_t));
+          DEBUG_MSG("  - Coefficients: " << coeffs.size() << std::endl);
+
+          vector< vector<unsigned int> > positions, starts;
+          if (!unpackCoordinates((const uint8_t*)request->positions().data(), request->positions().length(),
+                                 request->positionwidth(), 2, positions) ||
+              !unpackCoordinates((const uint8_t*)request->starts().data(), request->starts().length(),
+                                 request->startwidth(), frameVolumeDimensionality_, starts) ||
+              (positions.size() != coeffs.size()) || (starts.size() != coeffs.size())) {
+              reply->set_status(reply->NOT_OK);
+              return Status::OK;
+          }
+          DEBUG_MSG("  - Positions: " << positions.size() << std::endl);
+          DEBUG_MSG("  - Starts: " << starts.size() << std::endl);
+
+          DEBUG_MSG("  - Size: (" << request->width() << "," << request->height() << ")" << std::endl);
+          vector<unsigned int> size;
+          size.push_back(request->width());
+          size.push_back(request->height());
+
+          uint64_t decodeNanos = wireNanos() - decodeStart;
+          accountWireFormat("FillCoefficientTiles v2", request->ByteSizeLong(), request->encodenanos(), decodeNanos);
+
+          myDisplay->FillCoefficientTiles(coeffs, positions, starts, size);
+
+          reply->set_status(reply->OK);
+      } else {
+          reply->set_status(reply->NOT_OK);
+      }
+      return Status::OK;
+  }
+
+  Status FillScalerTilesV2(ServerContext* context, const FillScalerTilesV2Request* request,
+                           StatusReply* reply) override {
+      DEBUG_MSG("Server got a request to FillScalerTilesV2." << std::endl);
+      if (myDisplay) {
+          uint64_t decodeStart = wireNanos();
+          vector< vector<unsigned int> > starts;
+          if (!unpackCoordinates((const uint8_t*)request->starts().data(), request->starts().length(),
+                                 request->startwidth(), frameVolumeDimensionality_, starts)) {
+              reply->set_status(reply->NOT_OK);
+              return Status::OK;
+          }
+          DEBUG_MSG("  - Starts: " << starts.size() << std::endl);
+
+          vector<uint64_t> scalers;
+          if (!packedScalers(request, starts.size(), scalers) || (starts.size() != scalers.size())) {
+              reply->set_status(reply->NOT_OK);
+              return Status::OK;
+          }
+          DEBUG_MSG("  - Scalers: " << scalers.size() << std::endl);
+
+          DEBUG_MSG("  - Size: (" << request->width() << "," << request->height() << ")" << std::endl);
+          vector<unsigned int> size;
+          size.push_back(request->width());
+          size.push_back(request->height());
+
+          uint64_t decodeNanos = wireNanos() - decodeStart;
+          accountWireFormat("FillScalerTiles v2", request->ByteSizeLong(), request->encodenanos(), decodeNanos);
+
+          myDisplay->FillScalerTiles(scalers, starts, size);
+
+          reply->set_status(reply->OK);
+      } else {
+          reply->set_status(reply->NOT_OK);
+      }
+      return Status::OK;
+  }
+
+  Status FillScalerTileStackV2(ServerContext* context, const FillScalerTileStackV2Request* request,
+                               StatusReply* reply) override {
+      DEBUG_MSG("Server got a request to FillScalerTileStackV2." << std::endl);
+      if (myDisplay) {
+          uint64_t decodeStart = wireNanos();
+          vector<uint64_t> scalers;
+          if (request->has_quantized() ? !quantizedScalers(request->quantized(), request->plane(), scalers)
+                                       : !packedScalers(request, myDisplay->NumCoefficientPlanes(), scalers)) {
+              reply->set_status(reply->NOT_OK);
+              return Status::OK;
+          }
+          DEBUG_MSG("  - Scalers: " << scalers.size() << std::endl);
+
+          DEBUG_MSG("  - Start: (" << request->x() << "," << request->y() << "," << request->plane() << ")" << std::endl);
+          vector<unsigned int> start;
+          start.push_back(request->x());
+          start.push_back(request->y());
+          start.push_back(request->plane());
+
+          DEBUG_MSG("  - Size: (" << request->width() << "," << request->height() << ")" << std::endl);
+          vector<unsigned int> size;
+          size.push_back(request->width());
+          size.push_back(request->height());
+
+          uint64_t decodeNanos = wireNanos() - decodeStart;
+          accountWireFormat("FillScalerTileStack v2", request->ByteSizeLong(), request->encodenanos(), decodeNanos);
+
           myDisplay->FillScalerTileStack(scalers, start, size);
 
           reply->set_status(reply->OK);
@@ -718,8 +1184,7 @@ class NddiServiceImpl final : public NddiWall::Service {
   Status ClearCostModel(ServerContext* context, const ClearCostModelRequest* request,
                         StatusReply* reply) override {
       DEBUG_MSG("Server got a request to clear the cost model." << std::endl);
-      if (myDisplay) {
-          myDisplay->GetCostModel()->clearCosts();
+      if (clearCostModel()) {
           reply->set_status(reply->OK);
       } else {
           reply->set_status(reply->NOT_OK);
@@ -731,14 +1196,7 @@ class NddiServiceImpl final : public NddiWall::Service {
                StatusReply* reply) override {
       DEBUG_MSG("Server got a request to latch." << std::endl);
 
-      sub_x = request->sub_x();
-      sub_y = request->sub_y();
-      sub_w = request->sub_w();
-      sub_h = request->sub_h();
-
-      pthread_mutex_lock(&renderMutex);
-      pthread_cond_signal(&renderCondition);
-      pthread_mutex_unlock(&renderMutex);
+      latchDisplay(request->sub_x(), request->sub_y(), request->sub_w(), request->sub_h());
 
       reply->set_status(reply->OK);
       return Status::OK;
@@ -747,14 +1205,96 @@ class NddiServiceImpl final : public NddiWall::Service {
   Status Shutdown(ServerContext* context, const ShutdownRequest* request,
                    StatusReply* reply) override {
       DEBUG_MSG("Server got a request to shutdown." << std::endl);
-      alive = false;
-      pthread_mutex_lock(&renderMutex);
-      pthread_cond_signal(&renderCondition);
-      pthread_mutex_unlock(&renderMutex);
+      shutdownDisplay();
       reply->set_status(reply->OK);
       return Status::OK;
   }
 
+  Status RegisterSharedMemory(ServerContext* context, const RegisterSharedMemoryRequest* request,
+                              RegisterSharedMemoryReply* reply) override {
+      DEBUG_MSG("Server got a request to register shared memory." << std::endl);
+      DEBUG_MSG("  - Name: " << request->name() << std::endl);
+      DEBUG_MSG("  - Size: " << request->size() << std::endl);
+
+      // This will fail when the client is on another host, and it will just keep sending payloads inline.
+      std::shared_ptr<SharedMemoryRing> ring(new SharedMemoryRing(request->name(), request->size()));
+      if (ring->IsMapped()) {
+          pthread_mutex_lock(&sharedMemoryMutex);
+          uint32_t id = nextSharedMemoryId++;
+          sharedMemoryRings[id] = ring;
+          pthread_mutex_unlock(&sharedMemoryMutex);
+          DEBUG_MSG("  - Id: " << id << std::endl);
+
+          reply->set_id(id);
+          reply->set_status(StatusReply::OK);
+      } else {
+          reply->set_status(StatusReply::NOT_OK);
+      }
+      return Status::OK;
+  }
+
+  Status RegisterScalerQuantizer(ServerContext* context, const RegisterScalerQuantizerRequest* request,
+                                 RegisterScalerQuantizerReply* reply) override {
+      DEBUG_MSG("Server got a request to register a scaler quantizer." << std::endl);
+      DEBUG_MSG("  - Divisors: " << request->divisors_size() << std::endl);
+      DEBUG_MSG("  - First Plane: " << request->firstplane() << std::endl);
+
+      vector<uint32_t> divisors;
+      for (int i = 0; i < request->divisors_size(); i++) {
+          if (!request->divisors(i)) {
+              reply->set_status(StatusReply::NOT_OK);
+              return Status::OK;
+          }
+          divisors.push_back(request->divisors(i));
+      }
+
+      pthread_mutex_lock(&scalerQuantizerMutex);
+      uint32_t id = nextScalerQuantizerId++;
+      scalerQuantizers[id] = std::make_pair(request->firstplane(), divisors);
+      pthread_mutex_unlock(&scalerQuantizerMutex);
+      DEBUG_MSG("  - Id: " << id << std::endl);
+
+      reply->set_id(id);
+      reply->set_status(StatusReply::OK);
+      return Status::OK;
+  }
+
+  Status UnregisterSharedMemory(ServerContext* context, const UnregisterSharedMemoryRequest* request,
+                                StatusReply* reply) override {
+      DEBUG_MSG("Server got a request to unregister shared memory." << std::endl);
+      DEBUG_MSG("  - Id: " << request->id() << std::endl);
+
+      pthread_mutex_lock(&sharedMemoryMutex);
+      // Requests still reading from the ring hold their own reference, and it's unmapped after the last one
+      std::map<uint32_t, std::shared_ptr<SharedMemoryRing> >::iterator it = sharedMemoryRings.find(request->id());
+      if (it != sharedMemoryRings.end()) {
+          sharedMemoryRings.erase(it);
+          reply->set_status(reply->OK);
+      } else {
+          reply->set_status(reply->NOT_OK);
+      }
+      pthread_mutex_unlock(&sharedMemoryMutex);
+      return Status::OK;
+  }
+
+  /*
+   * Unpacks the int16 scalers of a v2 request, decompressing them first if needed. A compressed request may
+   * carry no more than maxScalers of them.
+   */
+  template <class T>
+  bool packedScalers(const T* request, size_t maxScalers, vector<uint64_t> &scalers) {
+      if (request->has_compressed()) {
+          vector<int16_t> packed;
+          if (!compressedPayload(request->compressed(), WIRE_SCALER_SIZE, maxScalers, packed)) {
+              return false;
+          }
+          unpackScalers((const uint8_t*)packed.data(), packed.size() * sizeof(int16_t), scalers);
+      } else {
+          unpackScalers((const uint8_t*)request->scalers().data(), request->scalers().length(), scalers);
+      }
+      return true;
+  }
+
   unsigned int inputVectorSize_, frameVolumeDimensionality_;
 
 };
@@ -778,6 +1318,104 @@ void* runServer(void *) {
   server->Wait();
 }
 
+#ifdef NDDIWALL_STANDALONE
+/*
+ * Plays the commands handed over by the in-process transport into the display. This is the
+ * in-process equivalent of the gRPC service above, minus the protobuf decoding.
+ */
+void* runDispatcher(void *) {
+    NddiCommandMessage* msg;
+
+    while ((msg = inProcessTransport.Receive()) != NULL) {
+        CommandID id = msg->id;
+        switch (id) {
+        case idInit: {
+            InitCommandMessage* init = (InitCommandMessage*)msg;
+            initializeDisplay(init->frameVolumeDimensionalSizes,
+                              init->displayWidth, init->displayHeight,
+                              init->numCoefficientPlanes, init->inputVectorSize,
+                              init->fixed8x8Macroblocks, init->useSingleCoeffcientPlane);
+            inProcessTransport.SetDisplay(myDisplay);
+            delete init;
+        }
+        break;
+        case idClearCostModel:
+            clearCostModel();
+            delete (ClearCostModelCommandMessage*)msg;
+            break;
+        case idLatch: {
+            LatchCommandMessage* latch = (LatchCommandMessage*)msg;
+            latchDisplay(latch->sub_x, latch->sub_y, latch->sub_w, latch->sub_h);
+            delete latch;
+        }
+        break;
+        case idShutdown:
+            shutdownDisplay();
+            delete (ShutdownCommandMessage*)msg;
+            break;
+        case idFillCoefficientMatrixTiled: {
+            FillCoefficientMatrixTiledCommandMessage* fill = (FillCoefficientMatrixTiledCommandMessage*)msg;
+            if (myDisplay) {
+                fillCoefficientMatrixTiled(fill->coefficientMatrix, fill->start, fill->end, fill->size);
+            }
+            delete fill;
+        }
+        break;
+        #define GENERATE_DISPATCH_CASE(m) \
+        case id ## m : \
+            if (myDisplay) { ((m ## CommandMessage*)msg)->play(myDisplay); } \
+            delete (m ## CommandMessage*)msg; \
+            break;
+        GENERATE_DISPATCH_CASE(DisplayWidth)
+        GENERATE_DISPATCH_CASE(DisplayHeight)
+        GENERATE_DISPATCH_CASE(NumCoefficientPlanes)
+        GENERATE_DISPATCH_CASE(PutPixel)
+        GENERATE_DISPATCH_CASE(CopyPixelStrip)
+        GENERATE_DISPATCH_CASE(CopyPixels)
+        GENERATE_DISPATCH_CASE(CopyPixelTiles)
+        GENERATE_DISPATCH_CASE(FillPixel)
+        GENERATE_DISPATCH_CASE(CopyFrameVolume)
+        GENERATE_DISPATCH_CASE(UpdateInputVector)
+        GENERATE_DISPATCH_CASE(PutCoefficientMatrix)
+        GENERATE_DISPATCH_CASE(FillCoefficientMatrix)
+        GENERATE_DISPATCH_CASE(FillCoefficient)
+        GENERATE_DISPATCH_CASE(FillCoefficientTiles)
+        GENERATE_DISPATCH_CASE(FillScaler)
+        GENERATE_DISPATCH_CASE(FillScalerTiles)
+        GENERATE_DISPATCH_CASE(FillScalerTileStack)
+        GENERATE_DISPATCH_CASE(SetPixelByteSignMode)
+        GENERATE_DISPATCH_CASE(SetFullScaler)
+        GENERATE_DISPATCH_CASE(GetFullScaler)
+        case idEOT:
+        default:
+            delete msg;
+            break;
+        }
+        inProcessTransport.Processed();
+
+        if (id == idShutdown) {
+            break;
+        }
+    }
+
+    // Release any queries still waiting on the transport.
+    inProcessTransport.Close();
+
+    return NULL;
+}
+
+void* runClient(void *) {
+    int result = pixelBridgeMain(clientArgc, clientArgv.data());
+
+    // The client never initialized the display (e.g. bad arguments), so nothing will ever shut us down.
+    if (!myDisplay) {
+        exit(result);
+    }
+
+    return NULL;
+}
+#endif
+
 void outputStats() {
 
     CostModel * costModel = myDisplay->GetCostModel();
@@ -799,10 +1437,38 @@ void outputStats() {
     //
     cout << "Transmission Statistics:" << endl;
     // Get total transmission cost
-    long totalCost = costModel->getLinkBytesTransmitted();
+    // Stacks sent as quantized levels cost less on the link than the full scalers the display charged for.
+    // Tiled coefficient matrices cost less on the link than the FillCoefficientMatrix per tile the display charged for.
+    long totalCost = costModel->getLinkBytesTransmitted() - quantizedScalerSavings - tiledCoefficientSavings;
     cout << "  Total Pixel Data Updated (bytes): " << totalUpdates * myDisplay->DisplayWidth() * myDisplay->DisplayHeight() * BYTES_PER_PIXEL <<
     " Total NDDI Cost (bytes): " << totalCost <<
     " Ratio: " << (double)totalCost / (double)totalUpdates / (double)myDisplay->DisplayWidth() / (double)myDisplay->DisplayHeight() / BYTES_PER_PIXEL << endl;
+    cout << "  Bulk Payload Passed Through Shared Memory (bytes): " << sharedMemoryBytes << endl;
+    cout << "  Scaler Bytes Saved By Quantization (bytes): " << quantizedScalerSavings << endl;
+    cout << "  Coefficient Bytes Saved By Tiled Matrices (bytes): " << tiledCoefficientSavings << endl;
+    cout << "  Commands Saved By Tiled Matrices: " << tiledCommandSavings << endl;
+    for (int i = nddiwall::Compression_MIN; i <= nddiwall::Compression_MAX; i++) {
+        compression_stats_t &stats = decompressionStats[i];
+        if (!stats.messages) {
+            continue;
+        }
+        cout << "  Compression (" << compressionName((Compression)i) << "):" <<
+        " Messages: " << stats.messages <<
+        " Raw (bytes): " << stats.rawBytes <<
+        " On Wire (bytes): " << stats.wireBytes <<
+        " Ratio: " << (double)stats.wireBytes / (double)stats.rawBytes <<
+        " Compress (usecs): " << compressionUsecs[i] <<
+        " Decompress (usecs): " << stats.usecs << endl;
+    }
+    for (std::map<std::string, wire_stats_t>::iterator it = wireStats.begin(); it != wireStats.end(); it++) {
+        wire_stats_t &stats = it->second;
+        cout << "  Wire Format (" << it->first << "):" <<
+        " Messages: " << stats.messages <<
+        " On Wire (bytes): " << stats.wireBytes <<
+        " Per Message (bytes): " << (double)stats.wireBytes / (double)stats.messages <<
+        " Encode Per Message (ns): " << (double)stats.encodeNanos / (double)stats.messages <<
+        " Decode Per Message (ns): " << (double)stats.decodeNanos / (double)stats.messages << endl;
+    }
     cout << endl;
 
 
@@ -843,28 +1509,11 @@ void outputStats() {
 
     // Pretty print a heading to stdout, but for headless just spit it to stderr for reference
     cout << "CSV Headings:" << endl;
-    cout << "Frames,Commands Sent,Bytes Transmitted,IV Num Reads,IV Bytes Read,IV Num Writes,IV Bytes Written,CP Num Reads,CP Bytes Read,CP Num Writes,CP Bytes Written,FV Num Reads,FV Bytes Read,FV Num Writes,FV Bytes Written,FV Time,Pixels Mapped,Pixels Blended" << endl;
-
-    cout
-    << totalUpdates << " , "
-    << costModel->getLinkCommandsSent() << " , "
-    << costModel->getLinkBytesTransmitted() << " , "
-    << costModel->getReadAccessCount(INPUT_VECTOR_COMPONENT) << " , "
-    << costModel->getBytesRead(INPUT_VECTOR_COMPONENT) << " , "
-    << costModel->getWriteAccessCount(INPUT_VECTOR_COMPONENT) << " , "
-    << costModel->getBytesWritten(INPUT_VECTOR_COMPONENT) << " , "
-    << costModel->getReadAccessCount(COEFFICIENT_PLANE_COMPONENT) << " , "
-    << costModel->getBytesRead(COEFFICIENT_PLANE_COMPONENT) << " , "
-    << costModel->getWriteAccessCount(COEFFICIENT_PLANE_COMPONENT) << " , "
-    << costModel->getBytesWritten(COEFFICIENT_PLANE_COMPONENT) << " , "
-    << costModel->getReadAccessCount(FRAME_VOLUME_COMPONENT) << " , "
-    << costModel->getBytesRead(FRAME_VOLUME_COMPONENT) << " , "
-    << costModel->getWriteAccessCount(FRAME_VOLUME_COMPONENT) << " , "
-    << costModel->getBytesWritten(FRAME_VOLUME_COMPONENT) << " , "
-    << costModel->getTime(FRAME_VOLUME_COMPONENT) << " , "
-    << costModel->getPixelsMapped() << " , "
-    << costModel->getPixelsBlended() << " , "
-    << endl;
+    outputCostCsvHeadings(cout);
+    cout << endl;
+
+    outputCostCsv(cout, costModel, totalUpdates, quantizedScalerSavings + tiledCoefficientSavings, tiledCommandSavings);
+    cout << endl;
 
     cerr << endl;
 
@@ -900,10 +1549,20 @@ void cleanup() {
 
     if (!clean) {
         outputStats();
+#ifdef NDDIWALL_STANDALONE
+        pthread_join(serverThread, NULL);
+        pthread_join(clientThread, NULL);
+        delete myDisplay;
+        myDisplay = NULL;
+#else
         delete myDisplay;
         myDisplay = NULL;
         server->Shutdown();
         pthread_join(serverThread, NULL);
+        pthread_mutex_lock(&sharedMemoryMutex);
+        sharedMemoryRings.clear();
+        pthread_mutex_unlock(&sharedMemoryMutex);
+#endif
 #ifdef USE_GL
         glutLeaveMainLoop();
 #endif
@@ -1009,7 +1668,17 @@ int main(int argc, char** argv) {
 
   alive = true;
 
+#ifdef NDDIWALL_STANDALONE
+  // Run the PixelBridge client in this process and hand its commands straight to a dispatcher
+  // through the in-process transport instead of standing up the gRPC server.
+  GrpcNddiDisplay::SetTransport(&inProcessTransport);
+  clientArgc = argc;
+  clientArgv.assign(argv, argv + argc + 1);
+  pthread_create(&serverThread, NULL, runDispatcher, NULL);
+  pthread_create(&clientThread, NULL, runClient, NULL);
+#else
   pthread_create(&serverThread, NULL, runServer, NULL);
+#endif
 
   // Wait until the server initializes the NDDI display for a client.
   while (!myDisplay)
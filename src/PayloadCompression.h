@@ -0,0 +1,216 @@
+#ifndef PAYLOAD_COMPRESSION_H
+#define PAYLOAD_COMPRESSION_H
+
+/**
+ * \file PayloadCompression.h
+ *
+ * \brief This file embodies the compression of bulk pixel and scaler payloads sent to the NDDI Wall Server.
+ *
+ * This file embodies the compression of bulk pixel and scaler payloads sent to the NDDI Wall Server.
+ * zlib is always available. LZ4 and zstd are available when built with USE_LZ4 and USE_ZSTD respectively.
+ * The mode is negotiated when the display is initialized, and each message records the mode it was
+ * compressed with so the server can decompress it straight into the buffer handed to the display.
+ */
+
+#include <stdint.h>
+#include <string>
+#include <sys/time.h>
+#include <zlib.h>
+#ifdef USE_LZ4
+#include <lz4.h>
+#endif
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "nddiwall.pb.h"
+
+namespace nddi {
+
+    using nddiwall::Compression;
+
+    /**
+     * \brief Tracks bytes-on-wire versus CPU spent for one compression mode.
+     *
+     * Tracks bytes-on-wire versus CPU spent for one compression mode. The client counts the time
+     * spent compressing and the server counts the time spent decompressing.
+     */
+    typedef struct {
+        long     messages;
+        long     rawBytes;
+        long     wireBytes;
+        long     usecs;
+    } compression_stats_t;
+
+    static inline const char* compressionName(Compression mode) {
+        switch (mode) {
+            case nddiwall::COMPRESSION_ZLIB: return "zlib";
+            case nddiwall::COMPRESSION_LZ4:  return "lz4";
+            case nddiwall::COMPRESSION_ZSTD: return "zstd";
+            default:                         return "none";
+        }
+    }
+
+    /**
+     * \brief Reports whether this build is able to compress and decompress with the given mode.
+     */
+    static inline bool compressionSupported(Compression mode) {
+        switch (mode) {
+            case nddiwall::COMPRESSION_NONE:
+            case nddiwall::COMPRESSION_ZLIB:
+                return true;
+#ifdef USE_LZ4
+            case nddiwall::COMPRESSION_LZ4:
+                return true;
+#endif
+#ifdef USE_ZSTD
+            case nddiwall::COMPRESSION_ZSTD:
+                return true;
+#endif
+            default:
+                return false;
+        }
+    }
+
+    static inline long elapsedMicroseconds(timeval &start) {
+        timeval end;
+        gettimeofday(&end, NULL);
+        return (end.tv_sec - start.tv_sec) * 1000000L + (end.tv_usec - start.tv_usec);
+    }
+
+    /**
+     * \brief Compresses a payload.
+     *
+     * Compresses a payload.
+     * @param mode The compression mode to use.
+     * @param src The raw payload.
+     * @param length The length of the raw payload in bytes.
+     * @param dst Set to the compressed payload.
+     * @param stats If provided, the message is accounted for here.
+     * @return False if the mode isn't supported or the payload didn't shrink, in which case it should
+     *         be sent uncompressed.
+     */
+    static inline bool compressPayload(Compression mode, const uint8_t* src, size_t length,
+                                       std::string &dst, compression_stats_t* stats = NULL) {
+        timeval start;
+        gettimeofday(&start, NULL);
+
+        size_t written = 0;
+        switch (mode) {
+            case nddiwall::COMPRESSION_ZLIB: {
+                uLongf destLen = compressBound(length);
+                dst.resize(destLen);
+                if (compress2((Bytef*)&dst[0], &destLen, (const Bytef*)src, length, Z_BEST_SPEED) != Z_OK) {
+                    return false;
+                }
+                written = destLen;
+                break;
+            }
+#ifdef USE_LZ4
+            case nddiwall::COMPRESSION_LZ4: {
+                dst.resize(LZ4_compressBound(length));
+                int n = LZ4_compress_default((const char*)src, &dst[0], length, dst.size());
+                if (n <= 0) {
+                    return false;
+                }
+                written = n;
+                break;
+            }
+#endif
+#ifdef USE_ZSTD
+            case nddiwall::COMPRESSION_ZSTD: {
+                dst.resize(ZSTD_compressBound(length));
+                size_t n = ZSTD_compress(&dst[0], dst.size(), src, length, 1);
+                if (ZSTD_isError(n)) {
+                    return false;
+                }
+                written = n;
+                break;
+            }
+#endif
+            default:
+                return false;
+        }
+
+        if (written >= length) {
+            return false;
+        }
+        dst.resize(written);
+
+        if (stats) {
+            stats->messages++;
+            stats->rawBytes += length;
+            stats->wireBytes += written;
+            stats->usecs += elapsedMicroseconds(start);
+        }
+
+        return true;
+    }
+
+    /**
+     * \brief Decompresses a payload into a buffer of the exact uncompressed size.
+     *
+     * Decompresses a payload into a buffer of the exact uncompressed size.
+     * @param mode The compression mode the payload was compressed with.
+     * @param src The compressed payload.
+     * @param srcLength The length of the compressed payload in bytes.
+     * @param dst The destination, which is expected to be the buffer handed to the display.
+     * @param length The uncompressed length of the payload in bytes.
+     * @param stats If provided, the message is accounted for here.
+     * @return False if the payload is corrupt or doesn't decompress to exactly length bytes.
+     */
+    static inline bool decompressPayload(Compression mode, const uint8_t* src, size_t srcLength, uint8_t* dst, size_t length,
+                                         compression_stats_t* stats = NULL) {
+        timeval start;
+        gettimeofday(&start, NULL);
+
+        switch (mode) {
+            case nddiwall::COMPRESSION_ZLIB: {
+                uLongf destLen = length;
+                if ((uncompress((Bytef*)dst, &destLen, (const Bytef*)src, srcLength) != Z_OK) ||
+                    (destLen != length)) {
+                    return false;
+                }
+                break;
+            }
+#ifdef USE_LZ4
+            case nddiwall::COMPRESSION_LZ4: {
+                if (LZ4_decompress_safe((const char*)src, (char*)dst, srcLength, length) != (int)length) {
+                    return false;
+                }
+                break;
+            }
+#endif
+#ifdef USE_ZSTD
+            case nddiwall::COMPRESSION_ZSTD: {
+                if (ZSTD_decompress(dst, length, src, srcLength) != length) {
+                    return false;
+                }
+                break;
+            }
+#endif
+            default:
+                return false;
+        }
+
+        if (stats) {
+            stats->messages++;
+            stats->rawBytes += length;
+            stats->wireBytes += srcLength;
+            stats->usecs += elapsedMicroseconds(start);
+        }
+
+        return true;
+    }
+
+    /**
+     * \brief Decompresses a payload held in a string, such as a protobuf bytes field.
+     */
+    static inline bool decompressPayload(Compression mode, const std::string &src, uint8_t* dst, size_t length,
+                                         compression_stats_t* stats = NULL) {
+        return decompressPayload(mode, (const uint8_t*)src.data(), src.size(), dst, length, stats);
+    }
+
+}
+
+#endif // PAYLOAD_COMPRESSION_H
@@ -0,0 +1,112 @@
+#ifndef PAYLOAD_HANDOFF_H
+#define PAYLOAD_HANDOFF_H
+
+/**
+ * \file PayloadHandoff.h
+ *
+ * \brief This file embodies the handing of bulk payloads from a tiler to a display without copying them.
+ *
+ * This file embodies the handing of bulk payloads from a tiler to a display without copying them. The
+ * NDimensionalDisplayInterface takes pixel buffers and scaler vectors by pointer or reference, so a
+ * display which queues the command (the recorder, or the GrpcNddiDisplay with an in-process transport)
+ * has to copy the payload into its message, even though the tiler frees or discards it right after.
+ * Displays which implement PayloadHandoffDisplay accept the payload by rvalue reference instead and
+ * swap it into their message. The caller gets back whatever buffers the message held before, which
+ * for a pooled message have the capacity of an earlier payload, and may reuse them.
+ */
+
+#include <utility>
+#include <vector>
+
+#include "nddi/Features.h"
+#include "nddi/NDimensionalDisplayInterface.h"
+
+namespace nddi {
+
+    /**
+     * \brief Implemented by displays which can take ownership of bulk payloads.
+     *
+     * Implemented by displays which can take ownership of bulk payloads. On return the payload arguments
+     * hold unspecified buffers, possibly with a previous payload's contents, which the caller may reuse.
+     */
+    class PayloadHandoffDisplay {
+    public:
+        virtual ~PayloadHandoffDisplay() {}
+
+        /**
+         * \brief Copies the pixels into the designated region of the frame volume, taking ownership of them.
+         */
+        virtual void CopyPixels(std::vector<Pixel> &&p, std::vector<unsigned int> &start, std::vector<unsigned int> &end) = 0;
+
+        /**
+         * \brief Copies the tiles of pixels into the designated tile regions of the frame volume, taking ownership of them.
+         */
+        virtual void CopyPixelTiles(std::vector< std::vector<Pixel> > &&p, std::vector< std::vector<unsigned int> > &starts,
+                                    std::vector<unsigned int> &size) = 0;
+
+        /**
+         * \brief Fills a stack of tiles in the coefficient planes with the scalers, taking ownership of them.
+         */
+        virtual void FillScalerTileStack(std::vector<uint64_t> &&scalers, std::vector<unsigned int> &start,
+                                         std::vector<unsigned int> &size) = 0;
+    };
+
+    /**
+     * \brief Wraps a display so that bulk payloads are handed over when it supports it and copied otherwise.
+     *
+     * Wraps a display so that bulk payloads are handed over when it supports it and copied otherwise. The
+     * display is checked once when it's attached, so each command only costs a branch.
+     */
+    class PayloadHandoff {
+    public:
+        PayloadHandoff()
+        : display_(NULL),
+          handoff_(NULL) {
+        }
+
+        /**
+         * \brief Attaches the display commands are sent to.
+         */
+        void Attach(NDimensionalDisplayInterface* display) {
+            display_ = display;
+            handoff_ = dynamic_cast<PayloadHandoffDisplay*>(display);
+        }
+
+        void CopyPixels(std::vector<Pixel> &&p, std::vector<unsigned int> &start, std::vector<unsigned int> &end) {
+            if (handoff_) {
+                handoff_->CopyPixels(std::move(p), start, end);
+            } else {
+                display_->CopyPixels(p.data(), start, end);
+            }
+        }
+
+        void CopyPixelTiles(std::vector< std::vector<Pixel> > &&p, std::vector< std::vector<unsigned int> > &starts,
+                            std::vector<unsigned int> &size) {
+            if (handoff_) {
+                handoff_->CopyPixelTiles(std::move(p), starts, size);
+            } else {
+                std::vector<Pixel*> tiles(p.size());
+                for (size_t i = 0; i < p.size(); i++) {
+                    tiles[i] = p[i].data();
+                }
+                display_->CopyPixelTiles(tiles, starts, size);
+            }
+        }
+
+        void FillScalerTileStack(std::vector<uint64_t> &&scalers, std::vector<unsigned int> &start,
+                                 std::vector<unsigned int> &size) {
+            if (handoff_) {
+                handoff_->FillScalerTileStack(std::move(scalers), start, size);
+            } else {
+                display_->FillScalerTileStack(scalers, start, size);
+            }
+        }
+
+    private:
+        NDimensionalDisplayInterface*  display_;
+        PayloadHandoffDisplay*         handoff_;
+    };
+
+}
+
+#endif // PAYLOAD_HANDOFF_H
@@ -4,6 +4,9 @@
 #include <assert.h>
 #include <queue>
 #include <pthread.h>
+#ifdef USE_OMP
+#include <omp.h>
+#endif
 
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/video/tracking.hpp>
@@ -12,14 +15,19 @@
 #include "Configuration.h"
 
 #include "GrpcNddiDisplay.h"
+#include "PayloadCompression.h"
+#include "PayloadHandoff.h"
 #include "RecorderNddiDisplay.h"
 
+#include "DirtyRects.h"
+#include "PixelConvert.h"
 #include "CachedTiler.h"
 #include "DctTiler.h"
 #include "ScaledDctTiler.h"
 #include "MultiDctTiler.h"
 #include "ItTiler.h"
 #include "FlatTiler.h"
+#include "MotionTiler.h"
 #include "FfmpegPlayer.h"
 #include "RandomPlayer.h"
 #include "Rewinder.h"
@@ -32,22 +40,38 @@ typedef enum {
 } rewind_play_t;
 
 // General Globals
+Configuration globalConfiguration = Configuration();
+
+#ifdef NDDIWALL_STANDALONE
+// When linked into nddiwall_standalone, keep the rest of PixelBridge clear of the server's globals.
+namespace pixelbridge {
+#endif
+
 size_t displayWidth = 40, displayHeight = 32;
 const char* fileName = NULL;
-Configuration globalConfiguration = Configuration();
 
 // Helper Objects
 Player*  myPlayer;
 NDimensionalDisplayInterface* myDisplay;
+PayloadHandoff myHandoff;
 Tiler* myTiler;
 Rewinder* myRewinder = NULL;
 
+// In framebuffer mode when sending dirty rectangles, a copy of the frame volume to compare each frame with,
+// and the changed tiles, the rectangles covering them and their pixels
+DirtyRectMerger* myDirtyRects = NULL;
+vector<uint8_t> dirtyFrame, dirtyMask;
+vector<dirty_rect_t> dirtyRects;
+vector<Pixel> dirtyPixels;
+dirty_stats_t dirtyStats = {0, 0, 0, 0};
+
 // Decoder thread
 pthread_t           decoderThread;
 
 // Statistical Instrumentation
 int totalUpdates = 0;
 timeval startTime, endTime; // Used for timing data
+timeval launchTime;         // Used for the time to the first frame, which includes setting up the display
 
 // Stores the current and previously decoded frame
 uint8_t* videoBuffer = NULL;
@@ -127,6 +151,21 @@ void setupDisplay() {
         // Grab the display
         myDisplay = myTiler->GetDisplay();
 
+    // Motion-Tiled
+    } else if (globalConfiguration.tiler == MOTION) {
+
+        // Set up Motion Tiler and initialize Frame Volume and Coefficient Planes
+        myTiler = new MotionTiler(displayWidth, displayHeight,
+                                  globalConfiguration.tileWidth,
+                                  globalConfiguration.tileHeight,
+                                  globalConfiguration.motionSearch,
+                                  globalConfiguration.motionThreshold,
+                                  globalConfiguration.motionSlices,
+                                  globalConfiguration.recordFile);
+
+        // Grab the display
+        myDisplay = myTiler->GetDisplay();
+
     // Simple Framebuffer
     } else {
 
@@ -154,6 +193,7 @@ void setupDisplay() {
                 myDisplay = new GrpcNddiDisplay();
             }
         }
+        myHandoff.Attach(myDisplay);
 
         // Initialize Frame Volume
         nddi::Pixel p;
@@ -184,6 +224,12 @@ void setupDisplay() {
         s.r = s.g = s.b = myDisplay->GetFullScaler();
         myDisplay->FillScaler(s, start, end);
 
+        // Sending dirty rectangles compares each frame with a copy of the frame volume, which starts out white
+        if (globalConfiguration.dirtyRects) {
+            myDirtyRects = new DirtyRectMerger(globalConfiguration.dirtyMergeCost,
+                                               globalConfiguration.tileWidth * globalConfiguration.tileHeight);
+            dirtyFrame.assign(displayWidth * displayHeight * 3, 0xff);
+        }
     }
 
 #ifdef CLEAR_COST_MODEL_AFTER_SETUP
@@ -197,32 +243,74 @@ void setupDisplay() {
 }
 
 
+/**
+ * Updates the display like a simple frame buffer, but only sends the tiles which changed since the last frame.
+ * The changed tiles are merged into a few rectangles, which are each sent with one CopyPixels.
+ */
+void updateDirtyRects(uint8_t* buffer, size_t width) {
+    timeval diffStart, diffEnd;
+    size_t tw = globalConfiguration.tileWidth, th = globalConfiguration.tileHeight;
+
+    gettimeofday(&diffStart, NULL);
+
+    // Find the tiles which changed and merge them
+    changedCells(&dirtyFrame[0], displayWidth, buffer, width, displayWidth, displayHeight, tw, th, dirtyMask);
+    myDirtyRects->Merge(dirtyMask, (displayWidth + tw - 1) / tw, (displayHeight + th - 1) / th, dirtyRects);
+
+    // Send each rectangle, cut short at the edges of the display
+    vector<unsigned int> start(2), end(2);
+    for (size_t k = 0; k < dirtyRects.size(); k++) {
+        start[0] = dirtyRects[k].x0 * tw;
+        start[1] = dirtyRects[k].y0 * th;
+        end[0] = (dirtyRects[k].x1 + 1) * tw - 1;
+        end[1] = (dirtyRects[k].y1 + 1) * th - 1;
+        if (end[0] >= displayWidth) { end[0] = displayWidth - 1; }
+        if (end[1] >= displayHeight) { end[1] = displayHeight - 1; }
+
+        // Transform the rectangle into pixels, keeping the copy of the frame volume up to date
+        size_t w = end[0] - start[0] + 1, h = end[1] - start[1] + 1;
+        dirtyPixels.resize(w * h);
+        for (size_t j = 0; j < h; j++) {
+            uint8_t* row = buffer + 3 * ((start[1] + j) * width + start[0]);
+            memcpy(&dirtyFrame[3 * ((start[1] + j) * displayWidth + start[0])], row, 3 * w);
+            rgbToPixels(row, &dirtyPixels[j * w], w);
+        }
+        dirtyStats.pixels += w * h;
+        myHandoff.CopyPixels(std::move(dirtyPixels), start, end);
+    }
+
+    gettimeofday(&diffEnd, NULL);
+
+    dirtyStats.frames++;
+    dirtyStats.rects += dirtyRects.size();
+    dirtyStats.usecs += (diffEnd.tv_sec - diffStart.tv_sec) * 1000000 + diffEnd.tv_usec - diffStart.tv_usec;
+}
+
+
 void updateDisplay(uint8_t* buffer, size_t width, size_t height) {
 
-    // CACHE, DCT, IT, or FLAT
-    if ( (globalConfiguration.tiler == CACHE) || (globalConfiguration.tiler == DCT) || (globalConfiguration.tiler == IT) || (globalConfiguration.tiler == FLAT) ) {
+    // CACHE, DCT, IT, FLAT, or MOTION
+    if ( (globalConfiguration.tiler == CACHE) || (globalConfiguration.tiler == DCT) || (globalConfiguration.tiler == IT) || (globalConfiguration.tiler == FLAT) ||
+         (globalConfiguration.tiler == MOTION) ) {
         // Update the display with the Tiler
         myTiler->UpdateDisplay(buffer, width, height);
+    // SIMPLE, sending just the rectangles which changed
+    } else if (myDirtyRects) {
+        updateDirtyRects(buffer, width);
     // SIMPLE
     } else {
         // Update the display like a simple Frame Buffer
-        size_t bufferPos = 0;
 
-        // Array of pixels used for framebuffer mode.
-        Pixel* frameBuffer = (Pixel*)malloc(sizeof(Pixel) * displayWidth * displayHeight);
+        // Array of pixels used for framebuffer mode. It's handed to the display, which may hand back an earlier one.
+        static vector<Pixel> frameBuffer;
+        frameBuffer.resize(displayWidth * displayHeight);
 
-        // Transform the buffer into pixels
-        for (int j = 0; j < displayHeight; j++) {
-#ifdef USE_SMALLER_WINDOW
-            // Set the bufferPos to the beginning of the next row
-            bufferPos = j * width * 3;
+        // Transform the buffer into pixels, a row at a time in case the buffer is wider than the display
+#ifdef USE_OMP
+#pragma omp parallel for
 #endif
-            for (int i = 0; i < displayWidth; i++) {
-                frameBuffer[j * displayWidth + i].r = buffer[bufferPos++];
-                frameBuffer[j * displayWidth + i].g = buffer[bufferPos++];
-                frameBuffer[j * displayWidth + i].b = buffer[bufferPos++];
-                frameBuffer[j * displayWidth + i].a = 0xff;
-            }
+        for (int j = 0; j < displayHeight; j++) {
+            rgbToPixels(buffer + j * width * 3, &frameBuffer[j * displayWidth], displayWidth);
         }
 
         // Update the frame volume
@@ -231,10 +319,7 @@ void updateDisplay(uint8_t* buffer, size_t width, size_t height) {
         // Just send the pixels to the single plane
         start.push_back(0); start.push_back(0);
         end.push_back(displayWidth - 1); end.push_back(displayHeight - 1);
-        myDisplay->CopyPixels(frameBuffer, start, end);
-
-        // Free the temporary frame buffer
-        free(frameBuffer);
+        myHandoff.CopyPixels(std::move(frameBuffer), start, end);
     }
     if (globalConfiguration.recordFile.length()) {
         ((RecorderNddiDisplay*)myDisplay)->Latch(globalConfiguration.sub_x,
@@ -247,6 +332,14 @@ void updateDisplay(uint8_t* buffer, size_t width, size_t height) {
                                              globalConfiguration.sub_w,
                                              globalConfiguration.sub_h);
     }
+    if (!totalUpdates) {
+        timeval firstFrameTime;
+        gettimeofday(&firstFrameTime, NULL);
+        cerr << "Time To First Frame (seconds): " << (double)(firstFrameTime.tv_sec * 1000000
+                                                              + firstFrameTime.tv_usec
+                                                              - launchTime.tv_sec * 1000000
+                                                              - launchTime.tv_usec) / 1000000.0 << endl;
+    }
     totalUpdates++;
 
 }
@@ -561,12 +654,17 @@ static bool doing_it = false;
 
 
 void showUsage() {
-    cout << "pixelbridge [--mode <fb|flat|cache|dct|count|flow>] [--ts <n> <n>] [--tc <n>] [--bits <1-8>]" << endl <<
+    cout << "pixelbridge [--mode <fb|flat|cache|dct|it|motion|count|flow>] [--ts <n> <n>] [--tc <n>] [--bits <1-8>]" << endl <<
             "            [--dctscales x:y[,x:y...]] [--dctdelta <n>] [--dctplanes <n>] [--dctbudget <n>] [--dctsnap] [--dcttrim] [--quality <0/1-100>]" << endl <<
-            "            [--start <n>] [--frames <n>] [--rewind <n> <n>] [--verbose] [--csv | -- record <record-filename>] <filename>" << endl <<
-            "            [--subregion <x> <y> <width> <height>] [--scale <n>]" << endl;
+            "            [--start <n>] [--frames <n>] [--rewind <n> <n>] [--verbose] [--csv | -- record <record-filename>] [--recordcompress <none|zlib|lz4|zstd>] [--recordblock <n>] <filename>" << endl <<
+            "            [--subregion <x> <y> <width> <height>] [--scale <n>] [--shm <n>]" << endl <<
+            "            [--compress <none|zlib|lz4|zstd>] [--compressmin <command> <n>] [--wire <1|2>] [--quantize]" << endl <<
+            "            [--fingerprint <legacy|crc32c|xxh64>] [--threads <n>] [--evict <lru|clock|arc>]" << endl <<
+            "            [--search <n>] [--searchsad <n>] [--searchslices <n>] [--psnr] [--scroll <n>]" << endl <<
+            "            [--dirty <n>]" << endl;
     cout << endl;
-    cout << "  --mode  Configure NDDI as a framebuffer (fb), as a flat tile array (flat), as a cached tile (cache), using DCT (dct), or using IT (it).\n" <<
+    cout << "  --mode  Configure NDDI as a framebuffer (fb), as a flat tile array (flat), as a cached tile (cache), using DCT (dct), using IT (it),\n" <<
+            "          or as tiles moved to matching blocks in the frame volume (motion).\n" <<
             "          Optional the mode can be set to count the number of pixels changed (count) or determine optical flow (flow)." << endl;
     cout << "  --ts  Sets the tile size to the width and height provided." << endl;
     cout << "  --tc  Sets the maximum number of tiles in the cache." << endl;
@@ -587,10 +685,45 @@ void showUsage() {
     cout << "  --verbose  Outputs frame-by-frame statistics." << endl;
     cout << "  --csv  Outputs CSV data." << endl;
     cout << "  --record  Records the NDDI commands to the file specified." << endl;
+    cout << "  --recordcompress  Compresses the recording in blocks with the mode specified." << endl;
+    cout << "  --recordblock  Sets the size of each compressed block of the recording in KB. Defaults to 1024." << endl;
     cout << "  --subregion  Used to indicate which subregion of the display this client renders to when it's configured as one of several slaves." << endl;
     cout << "  --scale  The output is scaled by <n> in both directions. n can be 1, 2, 4, 8,..." << endl;
+    cout << "  --shm  Passes pixel and scaler payloads to a local NDDI Wall Server through a shared memory ring of <n> MB." << endl;
+    cout << "  --compress  Requests compression of pixel and scaler payloads sent to the NDDI Wall Server. The server falls back to zlib\n" <<
+            "              if it wasn't built with lz4 or zstd." << endl;
+    cout << "  --compressmin  Sets the minimum payload size in bytes at which a command is compressed. Applies to CopyPixels,\n" <<
+            "                 CopyPixelTiles, FillScalerTiles, and FillScalerTileStack, which all default to 1024." << endl;
+    cout << "  --wire  Selects the wire format for the tile and stack commands. 1 sends repeated varints and 2 sends packed\n" <<
+            "          fixed-width blobs." << endl;
+    cout << "  --quantize  With --wire 2, sends each stack of DCT scalers as int8/int16 levels plus the index of a\n" <<
+            "              quantizer the server multiplies them back by, and narrows IT scalers, which are already levels,\n" <<
+            "              to int8/int16. This is lossless." << endl;
+    cout << "  --fingerprint  Selects how the flat and cache modes fingerprint tiles. legacy is the zlib checksum selected by\n" <<
+            "                 CHECKSUM_CALCULATOR, crc32c needs SSE4.2, and xxh64 is the default." << endl;
+    cout << "  --threads  Sets the number of threads the tilers use. Defaults to OpenMP's default, which is usually one per core." << endl;
+    cout << "  --evict  For cache mode, selects the policy which chooses the tile to evict when the cache is full. Defaults to lru." << endl;
+    cout << "  --search  For motion mode, sets how many pixels in each direction around a tile's source are searched for a match. Defaults to 8." << endl;
+    cout << "  --searchsad  For motion mode, sets the mean absolute difference per channel that's still considered a match. Defaults to 2." << endl;
+    cout << "  --searchslices  For motion mode, sets the number of display-sized slices in the frame volume. Defaults to 4." << endl;
+    cout << "  --psnr  For motion mode, reports the PSNR of what was displayed against the video on exit." << endl;
+    cout << "  --scroll  For flat mode, looks for regions which scrolled horizontally by up to n pixels and shifts them in the frame volume." << endl;
+    cout << "  --dirty  For fb and flat modes, sends the tiles which changed as a few rectangles, merging two rectangles whenever their\n" <<
+            "           bounding box adds no more than n unchanged pixels. In fb mode, --ts sets the size of the tiles compared." << endl;
 }
 
+/*
+ * Checks that the named compression is one this build can do, printing why not if it isn't.
+ */
+bool checkCompression(const string &name) {
+    for (int i = nddiwall::Compression_MIN; i <= nddiwall::Compression_MAX; i++) {
+        if ((name == compressionName((nddiwall::Compression)i)) && compressionSupported((nddiwall::Compression)i)) {
+            return true;
+        }
+    }
+    cerr << "Compression " << name << " isn't supported by this build." << endl;
+    return false;
+}
 
 bool parseArgs(int argc, char *argv[]) {
     argc--;
@@ -610,6 +743,8 @@ bool parseArgs(int argc, char *argv[]) {
                 globalConfiguration.tiler = DCT;
             } else if (strcmp(*argv, "it") == 0) {
                 globalConfiguration.tiler = IT;
+            } else if (strcmp(*argv, "motion") == 0) {
+                globalConfiguration.tiler = MOTION;
             } else if (strcmp(*argv, "count") == 0) {
                 globalConfiguration.tiler = COUNT;
             } else if (strcmp(*argv, "flow") == 0) {
@@ -764,6 +899,18 @@ bool parseArgs(int argc, char *argv[]) {
             globalConfiguration.recordFile = argv[1];
             argc -= 2;
             argv += 2;
+        } else if (strcmp(*argv, "--recordcompress") == 0) {
+            globalConfiguration.recordCompression = argv[1];
+            argc -= 2;
+            argv += 2;
+        } else if (strcmp(*argv, "--recordblock") == 0) {
+            globalConfiguration.recordBlockSize = atoi(argv[1]);
+            if (globalConfiguration.recordBlockSize == 0) {
+                showUsage();
+                return false;
+            }
+            argc -= 2;
+            argv += 2;
         } else if (strcmp(*argv, "--subregion") == 0) {
             globalConfiguration.isSlave = true;
             globalConfiguration.sub_x = atoi(argv[1]);
@@ -776,6 +923,88 @@ bool parseArgs(int argc, char *argv[]) {
             globalConfiguration.scale = atoi(argv[1]);
             argc -= 2;
             argv += 2;
+        } else if (strcmp(*argv, "--shm") == 0) {
+            globalConfiguration.shmSize = atoi(argv[1]);
+            argc -= 2;
+            argv += 2;
+        } else if (strcmp(*argv, "--compress") == 0) {
+            globalConfiguration.compression = argv[1];
+            argc -= 2;
+            argv += 2;
+        } else if (strcmp(*argv, "--wire") == 0) {
+            globalConfiguration.wireFormat = atoi(argv[1]);
+            if ((globalConfiguration.wireFormat < 1) || (globalConfiguration.wireFormat > 2)) {
+                showUsage();
+                return false;
+            }
+            argc -= 2;
+            argv += 2;
+        } else if (strcmp(*argv, "--quantize") == 0) {
+            globalConfiguration.scalerQuantization = true;
+            argc--;
+            argv++;
+        } else if (strcmp(*argv, "--fingerprint") == 0) {
+            globalConfiguration.fingerprint = argv[1];
+            Fingerprint mode = fingerprintByName(globalConfiguration.fingerprint);
+            if (mode == FINGERPRINT_COUNT) {
+                showUsage();
+                return false;
+            }
+            if (!fingerprintSupported(mode)) {
+                cerr << "Warning: The " << fingerprintName(mode) << " fingerprint isn't supported here, so xxh64 will be used." << endl;
+                globalConfiguration.fingerprint = fingerprintName(FINGERPRINT_XXH64);
+            }
+            argc -= 2;
+            argv += 2;
+        } else if (strcmp(*argv, "--threads") == 0) {
+            globalConfiguration.threads = atoi(argv[1]);
+            if (globalConfiguration.threads < 1) {
+                showUsage();
+                return false;
+            }
+            argc -= 2;
+            argv += 2;
+        } else if (strcmp(*argv, "--search") == 0) {
+            globalConfiguration.motionSearch = atoi(argv[1]);
+            argc -= 2;
+            argv += 2;
+        } else if (strcmp(*argv, "--searchsad") == 0) {
+            globalConfiguration.motionThreshold = atoi(argv[1]);
+            argc -= 2;
+            argv += 2;
+        } else if (strcmp(*argv, "--searchslices") == 0) {
+            globalConfiguration.motionSlices = atoi(argv[1]);
+            if (globalConfiguration.motionSlices == 0) {
+                showUsage();
+                return false;
+            }
+            argc -= 2;
+            argv += 2;
+        } else if (strcmp(*argv, "--scroll") == 0) {
+            globalConfiguration.scrollSearch = atoi(argv[1]);
+            argc -= 2;
+            argv += 2;
+        } else if (strcmp(*argv, "--dirty") == 0) {
+            globalConfiguration.dirtyRects = true;
+            globalConfiguration.dirtyMergeCost = atoi(argv[1]);
+            argc -= 2;
+            argv += 2;
+        } else if (strcmp(*argv, "--psnr") == 0) {
+            globalConfiguration.PSNR = true;
+            argc--;
+            argv++;
+        } else if (strcmp(*argv, "--evict") == 0) {
+            globalConfiguration.eviction = argv[1];
+            if (evictionByName(globalConfiguration.eviction) == EVICT_COUNT) {
+                showUsage();
+                return false;
+            }
+            argc -= 2;
+            argv += 2;
+        } else if (strcmp(*argv, "--compressmin") == 0) {
+            globalConfiguration.compressionThresholds.push_back(make_pair(string(argv[1]), (size_t)atoi(argv[2])));
+            argc -= 3;
+            argv += 3;
         } else {
             fileName = *argv;
             argc--;
@@ -783,6 +1012,17 @@ bool parseArgs(int argc, char *argv[]) {
         }
     }
 
+    if (!checkCompression(globalConfiguration.compression) || !checkCompression(globalConfiguration.recordCompression)) {
+        showUsage();
+        return false;
+    }
+
+    if (globalConfiguration.scalerQuantization && (globalConfiguration.wireFormat != 2)) {
+        cerr << "--quantize only applies to the version 2 wire format, so it requires --wire 2." << endl;
+        showUsage();
+        return false;
+    }
+
     if (!fileName) {
         showUsage();
         return false;
@@ -815,11 +1055,19 @@ void* decoderRun(void* none) {
 
 int main(int argc, char *argv[]) {
 
+    gettimeofday(&launchTime, NULL);
+
     // Parse command line arguments
     if (!parseArgs(argc, argv)) {
         return -1;
     }
 
+#ifdef USE_OMP
+    if (globalConfiguration.threads) {
+        omp_set_num_threads(globalConfiguration.threads);
+    }
+#endif
+
     // Initialize ffmpeg and set dimensions
 #ifndef USE_RANDOM_PLAYER
     myPlayer = (Player*)new FfmpegPlayer(fileName);
@@ -868,6 +1116,25 @@ int main(int argc, char *argv[]) {
         }
 
         // Setup the Nddi Display and Tiler if required
+        GrpcNddiDisplay::SetSharedMemorySize(globalConfiguration.shmSize * 1024 * 1024);
+        GrpcNddiDisplay::SetWireFormat(globalConfiguration.wireFormat);
+        GrpcNddiDisplay::SetScalerQuantization(globalConfiguration.scalerQuantization);
+        for (int i = nddiwall::Compression_MIN; i <= nddiwall::Compression_MAX; i++) {
+            if (globalConfiguration.compression == compressionName((nddiwall::Compression)i)) {
+                GrpcNddiDisplay::SetCompression((nddiwall::Compression)i);
+            }
+            if (globalConfiguration.recordCompression == compressionName((nddiwall::Compression)i)) {
+                RecorderNddiDisplay::SetRecordingCompression((nddiwall::Compression)i,
+                                                             globalConfiguration.recordBlockSize * 1024);
+            }
+        }
+        for (size_t i = 0; i < globalConfiguration.compressionThresholds.size(); i++) {
+            for (unsigned int id = idInit; id < idCommandCount; id++) {
+                if (globalConfiguration.compressionThresholds[i].first == CommandNames[id]) {
+                    GrpcNddiDisplay::SetCompressionThreshold((CommandID)id, globalConfiguration.compressionThresholds[i].second);
+                }
+            }
+        }
         setupDisplay();
     }
 
@@ -885,6 +1152,26 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    // Report the frame rate of the whole pipeline, decoding through the tiler's commands
+    gettimeofday(&endTime, NULL);
+    if (totalUpdates) {
+#ifdef USE_OMP
+        cerr << "Tiler Threads: " << omp_get_max_threads() << endl;
+#endif
+        cerr << "Frames Per Second: " << (double)totalUpdates / ((double)(endTime.tv_sec * 1000000
+                                                                          + endTime.tv_usec
+                                                                          - startTime.tv_sec * 1000000
+                                                                          - startTime.tv_usec) / 1000000.0) << endl;
+    }
+    if (myDirtyRects) {
+        if (dirtyStats.frames) {
+            cerr << "Dirty Rectangles Per Frame: " << (double)dirtyStats.rects / (double)dirtyStats.frames
+                 << " Pixel Bytes Per Frame: " << (double)dirtyStats.pixels * sizeof(Pixel) / (double)dirtyStats.frames
+                 << " Usecs Per Frame: " << (double)dirtyStats.usecs / (double)dirtyStats.frames << endl;
+        }
+        delete myDirtyRects;
+    }
+
     if (myPlayer) { delete myPlayer; }
     if (myDisplay) {
         if (globalConfiguration.recordFile.length()) {
@@ -904,3 +1191,11 @@ int main(int argc, char *argv[]) {
 
     return 0;
 }
+
+#ifdef NDDIWALL_STANDALONE
+} // namespace pixelbridge
+
+int pixelBridgeMain(int argc, char *argv[]) {
+    return pixelbridge::main(argc, argv);
+}
+#endif
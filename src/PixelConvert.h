@@ -0,0 +1,331 @@
+#ifndef PIXEL_CONVERT_H
+#define PIXEL_CONVERT_H
+
+/**
+ * \file PixelConvert.h
+ *
+ * \brief This file embodies the conversion of decoded RGB24 frames into the formats the tilers send or transform.
+ *
+ * This file embodies the conversion of decoded RGB24 frames into the formats the tilers send or transform. Each
+ * kernel has a scalar version, which runs anywhere, and versions using SSSE3 and AVX2 where the build targets
+ * x86-64. Packing RGB24 into pixels and splitting it into planes are byte shuffles, which is what PSHUFB does.
+ * Widening bytes to shorts only needs SSE2 (or AVX2 for twice as many at once). The best version the CPU supports
+ * is picked once, the same way the crc32c fingerprint is, so the build doesn't need -mavx2 and still runs on older
+ * CPUs. Every version produces exactly the same output.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define PIXEL_CONVERT_SIMD_AVAILABLE
+#endif
+
+#include "PixelBridgeFeatures.h"
+
+namespace nddi {
+
+    /**
+     * \brief The instruction sets the kernels are implemented with.
+     */
+    typedef enum {
+        PIXEL_CONVERT_SCALAR,
+        PIXEL_CONVERT_SSSE3,
+        PIXEL_CONVERT_AVX2,
+        PIXEL_CONVERT_COUNT
+    } PixelConvertLevel;
+
+    static inline const char* pixelConvertName(PixelConvertLevel level) {
+        switch (level) {
+            case PIXEL_CONVERT_SSSE3: return "ssse3";
+            case PIXEL_CONVERT_AVX2:  return "avx2";
+            default:                  return "scalar";
+        }
+    }
+
+    /**
+     * \brief Reports whether this build and CPU are able to run the kernels at the given level.
+     *
+     * Reports whether this build and CPU are able to run the kernels at the given level. The SIMD kernels also
+     * assume that a Pixel holds its channels in the order r, g, b, a in memory.
+     */
+    static inline bool pixelConvertSupported(PixelConvertLevel level) {
+        switch (level) {
+            case PIXEL_CONVERT_SCALAR:
+                return true;
+#ifdef PIXEL_CONVERT_SIMD_AVAILABLE
+            case PIXEL_CONVERT_SSSE3:
+            case PIXEL_CONVERT_AVX2: {
+                Pixel p;
+                p.packed = 0x04030201;
+                if ((p.r != 1) || (p.g != 2) || (p.b != 3) || (p.a != 4)) {
+                    return false;
+                }
+                __builtin_cpu_init();
+                return (level == PIXEL_CONVERT_SSSE3) ? __builtin_cpu_supports("ssse3") : __builtin_cpu_supports("avx2");
+            }
+#endif
+            default:
+                return false;
+        }
+    }
+
+    /**
+     * \brief Returns the best level this build and CPU support, which the kernels use.
+     */
+    static inline PixelConvertLevel pixelConvertLevel() {
+        static const PixelConvertLevel level = pixelConvertSupported(PIXEL_CONVERT_AVX2)  ? PIXEL_CONVERT_AVX2 :
+                                               pixelConvertSupported(PIXEL_CONVERT_SSSE3) ? PIXEL_CONVERT_SSSE3 :
+                                                                                            PIXEL_CONVERT_SCALAR;
+        return level;
+    }
+
+    /*
+     * RGB24 to pixels, with the channels and the opaque alpha ANDed with a mask.
+     */
+    static inline void rgbToPixelsScalar(const uint8_t* rgb, Pixel* pixels, size_t count, uint8_t mask) {
+        for (size_t i = 0; i < count; i++, rgb += 3) {
+            Pixel p;
+            p.r = rgb[0] & mask;
+            p.g = rgb[1] & mask;
+            p.b = rgb[2] & mask;
+            p.a = 0xff & mask;
+            pixels[i].packed = p.packed;
+        }
+    }
+
+#ifdef PIXEL_CONVERT_SIMD_AVAILABLE
+    /*
+     * Three loads hold sixteen pixels. The four groups of twelve bytes are lined up with PALIGNR and spread out to
+     * four bytes each with PSHUFB, which zeroes the alpha byte for the OR to fill in.
+     */
+    __attribute__((target("ssse3")))
+    static inline void rgbToPixelsSsse3(const uint8_t* rgb, Pixel* pixels, size_t count, uint8_t mask) {
+        const __m128i spread = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+        const __m128i m = _mm_set1_epi8((char)mask);
+        size_t i = 0;
+
+        for (; i + 16 <= count; i += 16, rgb += 48) {
+            __m128i v0 = _mm_loadu_si128((const __m128i*)rgb);
+            __m128i v1 = _mm_loadu_si128((const __m128i*)(rgb + 16));
+            __m128i v2 = _mm_loadu_si128((const __m128i*)(rgb + 32));
+            __m128i p0 = _mm_shuffle_epi8(v0, spread);
+            __m128i p1 = _mm_shuffle_epi8(_mm_alignr_epi8(v1, v0, 12), spread);
+            __m128i p2 = _mm_shuffle_epi8(_mm_alignr_epi8(v2, v1, 8), spread);
+            __m128i p3 = _mm_shuffle_epi8(_mm_srli_si128(v2, 4), spread);
+            _mm_storeu_si128((__m128i*)(pixels + i), _mm_and_si128(_mm_or_si128(p0, alpha), m));
+            _mm_storeu_si128((__m128i*)(pixels + i + 4), _mm_and_si128(_mm_or_si128(p1, alpha), m));
+            _mm_storeu_si128((__m128i*)(pixels + i + 8), _mm_and_si128(_mm_or_si128(p2, alpha), m));
+            _mm_storeu_si128((__m128i*)(pixels + i + 12), _mm_and_si128(_mm_or_si128(p3, alpha), m));
+        }
+        rgbToPixelsScalar(rgb, pixels + i, count - i, mask);
+    }
+
+    /*
+     * VPSHUFB only shuffles within each 128-bit lane, so each lane is loaded with its own twelve bytes. The last
+     * load reads four bytes past the sixteen pixels, which is why two more must follow.
+     */
+    __attribute__((target("avx2")))
+    static inline void rgbToPixelsAvx2(const uint8_t* rgb, Pixel* pixels, size_t count, uint8_t mask) {
+        const __m256i spread = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                                0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m256i alpha = _mm256_set1_epi32((int)0xff000000);
+        const __m256i m = _mm256_set1_epi8((char)mask);
+        size_t i = 0;
+
+        for (; i + 18 <= count; i += 16, rgb += 48) {
+            __m256i v0 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)rgb)),
+                                                 _mm_loadu_si128((const __m128i*)(rgb + 12)), 1);
+            __m256i v1 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(rgb + 24))),
+                                                 _mm_loadu_si128((const __m128i*)(rgb + 36)), 1);
+            __m256i p0 = _mm256_or_si256(_mm256_shuffle_epi8(v0, spread), alpha);
+            __m256i p1 = _mm256_or_si256(_mm256_shuffle_epi8(v1, spread), alpha);
+            _mm256_storeu_si256((__m256i*)(pixels + i), _mm256_and_si256(p0, m));
+            _mm256_storeu_si256((__m256i*)(pixels + i + 8), _mm256_and_si256(p1, m));
+        }
+        rgbToPixelsSsse3(rgb, pixels + i, count - i, mask);
+    }
+#endif
+
+    /**
+     * \brief Converts a row of RGB24 pixels into pixels.
+     *
+     * Converts a row of RGB24 pixels into pixels. The channels and the opaque alpha are ANDed with the mask, which
+     * keeps only the significant bits when the pixels are going to be fingerprinted.
+     * @param rgb The first byte of the row.
+     * @param pixels Receives the pixels.
+     * @param count The number of pixels.
+     * @param mask The mask applied to every channel.
+     */
+    static inline void rgbToPixels(const uint8_t* rgb, Pixel* pixels, size_t count, uint8_t mask = 0xff) {
+        switch (pixelConvertLevel()) {
+#ifdef PIXEL_CONVERT_SIMD_AVAILABLE
+            case PIXEL_CONVERT_AVX2:  rgbToPixelsAvx2(rgb, pixels, count, mask); break;
+            case PIXEL_CONVERT_SSSE3: rgbToPixelsSsse3(rgb, pixels, count, mask); break;
+#endif
+            default:                  rgbToPixelsScalar(rgb, pixels, count, mask); break;
+        }
+    }
+
+    /**
+     * \brief Copies a tile of RGB24 pixels into pixels, padding the part of the tile off the frame.
+     *
+     * Copies a tile of RGB24 pixels into pixels, padding the part of the tile off the frame with opaque black.
+     * Both the tile and its padding are ANDed with the mask.
+     * @param source The first byte of the tile.
+     * @param stride The bytes from one row of the frame to the next.
+     * @param visible_width The number of columns of the tile which are on the frame.
+     * @param visible_height The number of rows of the tile which are on the frame.
+     * @param tile_width The width of the tile.
+     * @param tile_height The height of the tile.
+     * @param pixels Receives the tile's pixels in rows of tile_width.
+     * @param mask The mask applied to every channel.
+     */
+    static inline void gatherTile(const uint8_t* source, size_t stride,
+                                  size_t visible_width, size_t visible_height,
+                                  size_t tile_width, size_t tile_height,
+                                  Pixel* pixels, uint8_t mask = 0xff) {
+        Pixel black;
+        black.packed = 0;
+        black.a = 0xff & mask;
+
+        for (size_t j = 0; j < tile_height; j++, pixels += tile_width) {
+            size_t i = 0;
+            if (j < visible_height) {
+                rgbToPixels(source + j * stride, pixels, visible_width, mask);
+                i = visible_width;
+            }
+            for (; i < tile_width; i++) {
+                pixels[i].packed = black.packed;
+            }
+        }
+    }
+
+    /*
+     * RGB24 to interleaved shorts, which just widens every byte.
+     */
+    static inline void rgbToSignedScalar(const uint8_t* rgb, int16_t* out, size_t samples) {
+        for (size_t i = 0; i < samples; i++) {
+            out[i] = (int16_t)rgb[i];
+        }
+    }
+
+#ifdef PIXEL_CONVERT_SIMD_AVAILABLE
+    static inline void rgbToSignedSse2(const uint8_t* rgb, int16_t* out, size_t samples) {
+        const __m128i zero = _mm_setzero_si128();
+        size_t i = 0;
+
+        for (; i + 16 <= samples; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(rgb + i));
+            _mm_storeu_si128((__m128i*)(out + i), _mm_unpacklo_epi8(v, zero));
+            _mm_storeu_si128((__m128i*)(out + i + 8), _mm_unpackhi_epi8(v, zero));
+        }
+        rgbToSignedScalar(rgb + i, out + i, samples - i);
+    }
+
+    __attribute__((target("avx2")))
+    static inline void rgbToSignedAvx2(const uint8_t* rgb, int16_t* out, size_t samples) {
+        size_t i = 0;
+
+        for (; i + 32 <= samples; i += 32) {
+            __m256i lo = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(rgb + i)));
+            __m256i hi = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(rgb + i + 16)));
+            _mm256_storeu_si256((__m256i*)(out + i), lo);
+            _mm256_storeu_si256((__m256i*)(out + i + 16), hi);
+        }
+        rgbToSignedSse2(rgb + i, out + i, samples - i);
+    }
+#endif
+
+    /**
+     * \brief Widens RGB24 samples into interleaved signed shorts.
+     *
+     * Widens RGB24 samples into interleaved signed shorts, as the DCT tilers transform them.
+     * @param rgb The first byte.
+     * @param out Receives the shorts.
+     * @param samples The number of bytes, which is three per pixel.
+     */
+    static inline void rgbToSigned(const uint8_t* rgb, int16_t* out, size_t samples) {
+        switch (pixelConvertLevel()) {
+#ifdef PIXEL_CONVERT_SIMD_AVAILABLE
+            case PIXEL_CONVERT_AVX2:  rgbToSignedAvx2(rgb, out, samples); break;
+            case PIXEL_CONVERT_SSSE3: rgbToSignedSse2(rgb, out, samples); break;
+#endif
+            default:                  rgbToSignedScalar(rgb, out, samples); break;
+        }
+    }
+
+    /*
+     * RGB24 to a plane of signed shorts per channel.
+     */
+    static inline void rgbToPlanarScalar(const uint8_t* rgb, int16_t* r, int16_t* g, int16_t* b, size_t count) {
+        for (size_t i = 0; i < count; i++, rgb += 3) {
+            r[i] = rgb[0];
+            g[i] = rgb[1];
+            b[i] = rgb[2];
+        }
+    }
+
+#ifdef PIXEL_CONVERT_SIMD_AVAILABLE
+    /*
+     * Each channel of sixteen pixels is gathered from the three loads with a PSHUFB apiece, whose results don't
+     * overlap and are ORed together. The sixteen bytes are then widened to shorts.
+     */
+    __attribute__((target("ssse3")))
+    static inline void rgbToPlanarSsse3(const uint8_t* rgb, int16_t* r, int16_t* g, int16_t* b, size_t count) {
+        const __m128i r0 = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+        const __m128i r1 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1);
+        const __m128i r2 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13);
+        const __m128i g0 = _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+        const __m128i g1 = _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1);
+        const __m128i g2 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14);
+        const __m128i b0 = _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+        const __m128i b1 = _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1);
+        const __m128i b2 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15);
+        const __m128i zero = _mm_setzero_si128();
+        size_t i = 0;
+
+        for (; i + 16 <= count; i += 16, rgb += 48) {
+            __m128i v0 = _mm_loadu_si128((const __m128i*)rgb);
+            __m128i v1 = _mm_loadu_si128((const __m128i*)(rgb + 16));
+            __m128i v2 = _mm_loadu_si128((const __m128i*)(rgb + 32));
+            __m128i vr = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, r0), _mm_shuffle_epi8(v1, r1)), _mm_shuffle_epi8(v2, r2));
+            __m128i vg = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, g0), _mm_shuffle_epi8(v1, g1)), _mm_shuffle_epi8(v2, g2));
+            __m128i vb = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, b0), _mm_shuffle_epi8(v1, b1)), _mm_shuffle_epi8(v2, b2));
+            _mm_storeu_si128((__m128i*)(r + i), _mm_unpacklo_epi8(vr, zero));
+            _mm_storeu_si128((__m128i*)(r + i + 8), _mm_unpackhi_epi8(vr, zero));
+            _mm_storeu_si128((__m128i*)(g + i), _mm_unpacklo_epi8(vg, zero));
+            _mm_storeu_si128((__m128i*)(g + i + 8), _mm_unpackhi_epi8(vg, zero));
+            _mm_storeu_si128((__m128i*)(b + i), _mm_unpacklo_epi8(vb, zero));
+            _mm_storeu_si128((__m128i*)(b + i + 8), _mm_unpackhi_epi8(vb, zero));
+        }
+        rgbToPlanarScalar(rgb, r + i, g + i, b + i, count - i);
+    }
+#endif
+
+    /**
+     * \brief Splits RGB24 pixels into a plane of signed shorts per channel.
+     *
+     * Splits RGB24 pixels into a plane of signed shorts per channel. There's no AVX2 version, since the lanes of
+     * VPSHUFB would need the channels crossed over between them afterwards, so the SSSE3 version is used instead.
+     * @param rgb The first byte of the pixels.
+     * @param r Receives the red channel.
+     * @param g Receives the green channel.
+     * @param b Receives the blue channel.
+     * @param count The number of pixels.
+     */
+    static inline void rgbToPlanar(const uint8_t* rgb, int16_t* r, int16_t* g, int16_t* b, size_t count) {
+        switch (pixelConvertLevel()) {
+#ifdef PIXEL_CONVERT_SIMD_AVAILABLE
+            case PIXEL_CONVERT_AVX2:
+            case PIXEL_CONVERT_SSSE3: rgbToPlanarSsse3(rgb, r, g, b, count); break;
+#endif
+            default:                  rgbToPlanarScalar(rgb, r, g, b, count); break;
+        }
+    }
+
+} // namespace nddi
+
+#endif // PIXEL_CONVERT_H
@@ -10,16 +10,22 @@
  * allows for recording of nDDI commands and then their playback.
  */
 
+#include "CommandPool.h"
 #include "GrpcNddiDisplay.h"
 #include "NddiCommands.h"
+#include "PayloadHandoff.h"
+#include "RecordingFormat.h"
+#include "SpscRing.h"
+#include "TiledCoefficients.h"
 #include "nddi/Features.h"
 #include "nddi/NDimensionalDisplayInterface.h"
 
+#include <climits>
+#include <errno.h>
 #include <fstream>
 #include <pthread.h>
 #include <string.h>
-#include <thread>
-#include <queue>
+#include <time.h>
 #include <unistd.h>
 #include <vector>
 
@@ -31,6 +37,28 @@
 
 namespace nddi {
 
+    /** Number of commands the recorder may queue before the tiler blocks. */
+    #define RECORDER_RING_CAPACITY 1024
+
+    /** Number of commands the player may read ahead of the display. */
+    #define PLAYER_RING_CAPACITY 1024
+
+    /**
+     * \brief Counts the frames a player latched after it was released and when it latched the first and last of them.
+     */
+    typedef struct {
+        size_t   frames;
+        uint64_t startNanos;
+        uint64_t endNanos;
+    } playback_stats_t;
+
+    /**
+     * \brief Returns the frames per second a player latched at.
+     */
+    static inline double playbackFps(const playback_stats_t &stats) {
+        return (stats.endNanos > stats.startNanos) ? stats.frames * 1000000000.0 / (stats.endNanos - stats.startNanos) : 0.0;
+    }
+
 ///\cond
     /**
      * \brief Implements and NDDI display where each interface is a GRPC call to the NDDI Wall Server.
@@ -40,9 +68,10 @@ namespace nddi {
     class CommandRecorder {
     public:
         CommandRecorder(string file)
-        : finished(false),
-          file(file) {
-            streamMutex = PTHREAD_MUTEX_INITIALIZER;
+        : file(file),
+          start(recordingNanos()),
+          streamRing(RECORDER_RING_CAPACITY),
+          pool(RECORDER_RING_CAPACITY) {
             typedef void* (*rptr)(void*);
             if (pthread_create( &streamThread, NULL, pthreadFriendlyRun, this)) {
                 std::cout << "Error: Failed to start thread." << std::endl;
@@ -51,73 +80,79 @@ namespace nddi {
         }
 
         ~CommandRecorder() {
-            finished = true;
+            streamRing.Close();
             pthread_join(streamThread, NULL);
+            pool.Report("Recorder");
         }
 
         void run() {
-            std::ofstream os(file, std::ofstream::out);
-            //cereal::XMLOutputArchive oarchive(os);
-            cereal::BinaryOutputArchive oarchive(os);
-
-            while (!finished || !streamQueue.empty()) {
-                if (!streamQueue.empty()) {
-                    pthread_mutex_lock(&streamMutex);
-                    NddiCommandMessage* msg = streamQueue.front();
-                    streamQueue.pop();
-                    pthread_mutex_unlock(&streamMutex);
-
-                    if (msg) {
-                        CommandID id = msg->id;
-                        switch (id) {
-                        #define GENERATE_REC_CASE(m) \
-                        case id ## m : \
-                            oarchive(CEREAL_NVP(id), cereal::make_nvp("command", *( m ## CommandMessage*)msg)); \
-                            break;
-                        NDDI_COMMAND_LIST(GENERATE_REC_CASE)
-                        case idEOT:
-                        default:
-                            break;
-                        }
-                        delete(msg);
-                    }
-                } else { std::this_thread::yield(); }
+            RecordingWriter writer(file, compression(), blockSize());
+
+            NddiCommandMessage* msg;
+            while (streamRing.Pop(msg)) {
+                if (msg) {
+                    writer.Write(msg);
+                    pool.Release(msg);
+                }
+            }
+            writer.Close();
+            reportCompression(writer.Stats());
+        }
+
+        static Compression& compression() { static Compression mode = nddiwall::COMPRESSION_NONE; return mode; }
+        static size_t& blockSize() { static size_t bytes = RECORDING_BLOCK_SIZE; return bytes; }
+
+        static void reportCompression(const compression_stats_t &stats) {
+            if (stats.messages && stats.wireBytes) {
+                std::cout << "Recording compressed " << stats.messages << " blocks from " << stats.rawBytes
+                          << " to " << stats.wireBytes << " bytes (" << (double)stats.rawBytes / stats.wireBytes
+                          << ":1) in " << stats.usecs / 1000.0 << " ms." << std::endl;
             }
-            oarchive(cereal::make_nvp("id", idEOT));
         }
 
+        // Takes a recycled message from the pool and assigns it the command's arguments.
+        template <class T, class... Args>
+        T* create(Args&&... args) {
+            return pool.Create<T>(std::forward<Args>(args)...);
+        }
+
+        // Stamps the command when it's issued, then blocks while the recording thread is a full ring behind.
         void record(NddiCommandMessage* msg) {
-            pthread_mutex_lock(&streamMutex);
-            streamQueue.push(msg);
-            pthread_mutex_unlock(&streamMutex);
+            msg->timestamp = recordingNanos() - start;
+            streamRing.Push(msg);
         }
 
     private:
-        bool finished;
         string file;
-        pthread_mutex_t streamMutex;
+        uint64_t start;
         pthread_t streamThread;
         static void * pthreadFriendlyRun(void * This) {((CommandRecorder*)This)->run(); return NULL;}
-        std::queue<NddiCommandMessage*> streamQueue;
+        SpscRing<NddiCommandMessage*> streamRing;
+        CommandPool pool;
     };
 
     class CommandPlayer {
     public:
-        CommandPlayer() : finished(true), file("recording") {
-            streamMutex = PTHREAD_MUTEX_INITIALIZER;
-        }
+        CommandPlayer() : file("recording"), streamRing(PLAYER_RING_CAPACITY), pool(PLAYER_RING_CAPACITY) {}
 
-        CommandPlayer(string file)
-        : finished(false),
-          file(file) {
-            streamMutex = PTHREAD_MUTEX_INITIALIZER;
-        }
+        CommandPlayer(string file, unsigned int fromFrame = 0, unsigned int toFrame = UINT_MAX, double speed = 0.0)
+        : file(file),
+          fromFrame(fromFrame),
+          toFrame(toFrame),
+          speed(speed),
+          streamRing(PLAYER_RING_CAPACITY),
+          pool(PLAYER_RING_CAPACITY) {}
 
         ~CommandPlayer() {
             pthread_join(streamThread, NULL);
+            pool.Report("Player");
         }
 
-        void play() {
+        /*
+         * Plays the recording. When a barrier is given, the player waits on it once frame 0 has been
+         * played, so that several players set up their displays first and then start together.
+         */
+        void play(pthread_barrier_t* barrier = NULL) {
             typedef void* (*rptr)(void*);
             if (pthread_create( &streamThread, NULL, pthreadFriendlyRun, this)) {
                 std::cout << "Error: Failed to start thread." << std::endl;
@@ -125,30 +160,60 @@ namespace nddi {
             }
 
             GrpcNddiDisplay* display = NULL;
+            unsigned int frame = 0;
+            bool released = false;
 
-            while (!finished || !streamQueue.empty()) {
-                if (!streamQueue.empty()) {
-                    pthread_mutex_lock(&streamMutex);
-                    NddiCommandMessage* msg = streamQueue.front();
-                    streamQueue.pop();
-                    pthread_mutex_unlock(&streamMutex);
-
-                    if (msg) {
-                        CommandID id = msg->id;
-                        //std::cout << "Popped a " << CommandNames[id] << std::endl;;
-                        switch (id) {
-                        #define GENERATE_PLAY_CASE(m) \
-                        case id ## m : { \
-                            ((m ## CommandMessage*)msg)->play(display); \
-                        } \
+            NddiCommandMessage* msg;
+            while (streamRing.Pop(msg)) {
+                if (msg) {
+                    CommandID id = msg->id;
+                    if (id == idLatch) {
+                        if (frame >= fromFrame) {
+                            pace(msg, frame);
+                        }
+                        frame = ((frame == 0) && (fromFrame > 0)) ? fromFrame : frame + 1;
+                    }
+                    //std::cout << "Popped a " << CommandNames[id] << std::endl;;
+                    switch (id) {
+                    #define GENERATE_PLAY_CASE(m) \
+                    case id ## m : { \
+                        ((m ## CommandMessage*)msg)->play(display); \
+                    } \
+                    break;
+                    NDDI_COMMAND_LIST(GENERATE_PLAY_CASE)
+                    case idEOT:
+                    default:
                         break;
-                        NDDI_COMMAND_LIST(GENERATE_PLAY_CASE)
-                        case idEOT:
-                        default:
-                            break;
+                    }
+                    pool.Release(msg);
+
+                    if (id == idLatch) {
+                        if (released) {
+                            stats.frames++;
+                            stats.endNanos = recordingNanos();
+                        } else {
+                            release(barrier);
+                            released = true;
                         }
                     }
-                } else { std::this_thread::yield(); }
+                }
+            }
+
+            // A recording without a single latch still has to let the others go
+            if (!released) {
+                release(barrier);
+            }
+            std::cout << "Played " << stats.frames << " frames of " << file << " at " << playbackFps(stats)
+                      << " fps." << std::endl;
+
+            if (pacedFrames > 1) {
+                std::cout << "Paced " << pacedFrames << " frames at x" << speed << ": " << missedFrames
+                          << " missed their deadline";
+                if (missedFrames) {
+                    std::cout << ", by " << totalMissNanos / missedFrames / 1000000.0 << " ms on average and "
+                              << worstMissNanos / 1000000.0 << " ms at worst";
+                }
+                std::cout << "." << std::endl;
             }
 
             // If we created a GRPC Display, then wait a second, then latch a final time and destroy it.
@@ -160,45 +225,211 @@ namespace nddi {
         }
 
         void run() {
-            std::ifstream is(file);
-            //cereal::XMLInputArchive iarchive(is);
+            if (RecordingReader::IsIndexed(file)) {
+                runIndexed();
+            } else {
+                runStream();
+            }
+            streamRing.Close();
+        }
+
+        /**
+         * \brief Converts a v1 recording into an indexed v2 recording.
+         *
+         * Converts a v1 recording into an indexed v2 recording.
+         * @param from The v1 recording.
+         * @param to The v2 recording to write.
+         * @param mode If not COMPRESSION_NONE, the records are written in blocks compressed with this mode.
+         * @param blockSize The number of bytes of records gathered into each block.
+         * @return The number of commands converted.
+         */
+        static size_t Convert(string from, string to, Compression mode = nddiwall::COMPRESSION_NONE,
+                              size_t blockSize = RECORDING_BLOCK_SIZE) {
+            std::ifstream is(from, std::ifstream::in | std::ifstream::binary);
             cereal::BinaryInputArchive iarchive(is);
+            RecordingWriter writer(to, mode, blockSize);
 
+            size_t count = 0;
             CommandID id;
             iarchive(id);
             while (id != idEOT) {
-                NddiCommandMessage* msg = NULL;
-                switch (id) {
-                #define GENERATE_READ_CASE(m) \
-                case id ## m : { \
-                    msg = new m ## CommandMessage(); \
-                    iarchive(*( m ## CommandMessage *)msg); \
-                } \
-                break;
-                NDDI_COMMAND_LIST(GENERATE_READ_CASE)
-                case idEOT:
-                default:
+                NddiCommandMessage* msg = readStreamCommand(iarchive, id, NULL);
+                if (!msg) {
                     break;
                 }
+                writer.Write(msg);
+                deleteCommand(msg);
+                count++;
+                iarchive(id);
+            }
+            writer.Close();
+            CommandRecorder::reportCompression(writer.Stats());
+
+            return count;
+        }
+
+        const playback_stats_t& Stats() { return stats; }
+
+    private:
+        void release(pthread_barrier_t* barrier) {
+            if (barrier) {
+                pthread_barrier_wait(barrier);
+            }
+            stats.startNanos = stats.endNanos = recordingNanos();
+
+            // If frame 0 already set the pacing reference, it did so before waiting on the others
+            if (pacedFrames) {
+                paceStart = stats.startNanos;
+            }
+        }
+
+        /*
+         * Sleeps until the latch is due. The first paced latch sets the reference point (moved to when
+         * the player is released, if it waited on a barrier after that), and each later latch is due when as much time has passed since then as passed while recording,
+         * divided by the speed. Latches which are already late are reported instead.
+         */
+        void pace(NddiCommandMessage* msg, unsigned int frame) {
+            if (speed <= 0.0) {
+                return;
+            }
+            if (!msg->timestamp) {
+                if (!pacedFrames) {
+                    std::cout << "Recording has no timestamps, so it's played as fast as possible." << std::endl;
+                    speed = 0.0;
+                }
+                return;
+            }
+
+            uint64_t now = recordingNanos();
+            if (!pacedFrames++) {
+                paceStart = now;
+                paceStamp = msg->timestamp;
+                return;
+            }
+
+            uint64_t deadline = paceStart + (uint64_t)((msg->timestamp - paceStamp) / speed);
+            if (now > deadline) {
+                uint64_t miss = now - deadline;
+                std::cout << "Frame " << frame << " missed its deadline by " << miss / 1000000.0 << " ms" << std::endl;
+                missedFrames++;
+                totalMissNanos += miss;
+                if (miss > worstMissNanos) { worstMissNanos = miss; }
+            } else {
+                timespec ts;
+                ts.tv_sec = deadline / 1000000000ULL;
+                ts.tv_nsec = deadline % 1000000000ULL;
+                while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+            }
+        }
+
+        static NddiCommandMessage* readStreamCommand(cereal::BinaryInputArchive &iarchive, CommandID id, CommandPool* pool) {
+            NddiCommandMessage* msg = NULL;
+            switch (id) {
+            #define GENERATE_READ_CASE(m) \
+            case id ## m : { \
+                msg = pool ? pool->Acquire<m ## CommandMessage>() : new m ## CommandMessage(); \
+                iarchive(*( m ## CommandMessage *)msg); \
+            } \
+            break;
+            NDDI_COMMAND_LIST(GENERATE_READ_CASE)
+            case idEOT:
+            default:
+                break;
+            }
+            return msg;
+        }
+
+        void enqueue(NddiCommandMessage* msg) {
+            streamRing.Push(msg);
+        }
+
+        /*
+         * v1 recordings have no index, so every command is parsed and only those in the requested
+         * frames are queued. The Init command and frame 0, which carries the tiler's setup, are
+         * always played so that the display is configured before the requested frames.
+         */
+        void runStream() {
+            std::ifstream is(file);
+            //cereal::XMLInputArchive iarchive(is);
+            cereal::BinaryInputArchive iarchive(is);
+
+            unsigned int frame = 0;
+            CommandID id;
+            iarchive(id);
+            while ((id != idEOT) && (frame <= toFrame)) {
+                NddiCommandMessage* msg = readStreamCommand(iarchive, id, &pool);
 
                 if (msg) {
-                    pthread_mutex_lock(&streamMutex);
-                    streamQueue.push(msg);
-                    pthread_mutex_unlock(&streamMutex);
+                    if ((id == idInit) || (frame == 0) || (frame >= fromFrame)) {
+                        enqueue(msg);
+                    } else {
+                        pool.Recycle(msg);
+                    }
+                }
+                if (id == idLatch) {
+                    frame++;
                 }
 
                 iarchive(id);
             }
-            finished = true;
         }
 
-    private:
-        bool finished;
+        /*
+         * v2 recordings are mapped and the index is used to jump straight from the end of frame 0
+         * to the first requested frame.
+         */
+        void runIndexed() {
+            RecordingReader reader(file);
+            if (!reader.IsOpen()) {
+                std::cout << "Error: " << reader.Error() << std::endl;
+                return;
+            }
+
+            uint64_t last = (toFrame < reader.FrameCount()) ? toFrame : reader.FrameCount();
+            uint64_t first = (fromFrame > 0) ? fromFrame : 1;
+
+            uint64_t start = recordingNanos();
+            uint64_t bytes = 0;
+            size_t commands = 0;
+
+            uint64_t offset = reader.FrameOffset(0);
+            uint64_t end = reader.FrameOffset(1);
+            for (int pass = 0; pass < 2; pass++) {
+                uint64_t begin = offset;
+                NddiCommandMessage* msg;
+                while ((offset < end) && reader.Next(offset, msg, &pool)) {
+                    enqueue(msg);
+                    commands++;
+                }
+                bytes += offset - begin;
+                offset = reader.FrameOffset(first);
+                end = reader.FrameOffset(last + 1);
+            }
+
+            // The time includes waiting on the play loop, so this is the throughput of the whole playback
+            double seconds = (recordingNanos() - start) / 1000000000.0;
+            std::cout << "Read " << commands << " commands (" << bytes / 1048576.0 << " MB) in " << seconds
+                      << " s, " << bytes / 1048576.0 / seconds << " MB/s." << std::endl;
+            if (reader.IsBlocked() && reader.Stats().wireBytes) {
+                const compression_stats_t &stats = reader.Stats();
+                std::cout << "Decompressed " << stats.messages << " blocks from " << stats.wireBytes << " to "
+                          << stats.rawBytes << " bytes (" << (double)stats.rawBytes / stats.wireBytes << ":1) in "
+                          << stats.usecs / 1000.0 << " ms." << std::endl;
+            }
+        }
+
         string file;
-        pthread_mutex_t streamMutex;
+        unsigned int fromFrame = 0;
+        unsigned int toFrame = UINT_MAX;
+        double speed = 0.0;
+        size_t pacedFrames = 0, missedFrames = 0;
+        uint64_t paceStart = 0, paceStamp = 0;
+        uint64_t totalMissNanos = 0, worstMissNanos = 0;
         pthread_t streamThread;
         static void * pthreadFriendlyRun(void * This) {((CommandPlayer*)This)->run(); return NULL;}
-        std::queue<NddiCommandMessage*> streamQueue;
+        SpscRing<NddiCommandMessage*> streamRing;
+        CommandPool pool;
+        playback_stats_t stats = {0, 0, 0};
     };
 ///\endcond
 
@@ -209,7 +440,7 @@ namespace nddi {
      * A RecorderNddiDisplay can additionally be instantiated with a recording file enabling
      * it to playback the nDDI Commands which are then sent to an nDDI display wall server.
      */
-    class RecorderNddiDisplay : public NDimensionalDisplayInterface {
+    class RecorderNddiDisplay : public NDimensionalDisplayInterface, public PayloadHandoffDisplay, public TiledCoefficientDisplay {
 
     public:
         /**
@@ -315,10 +546,10 @@ namespace nddi {
           fixed8x8Macroblocks_(fixed8x8Macroblocks),
           useSingleCoeffcientPlane_(useSingleCoeffcientPlane) {
             recorder = new CommandRecorder(file);
-            NddiCommandMessage* msg = new InitCommandMessage(frameVolumeDimensionalSizes,
-                                                             displayWidth, displayHeight,
-                                                             numCoefficientPlanes, inputVectorSize,
-                                                             fixed8x8Macroblocks, useSingleCoeffcientPlane);
+            NddiCommandMessage* msg = recorder->create<InitCommandMessage>(frameVolumeDimensionalSizes,
+                                                                           displayWidth, displayHeight,
+                                                                           numCoefficientPlanes, inputVectorSize,
+                                                                           fixed8x8Macroblocks, useSingleCoeffcientPlane);
             recorder->record(msg);
         }
 
@@ -328,9 +559,12 @@ namespace nddi {
          * Constructor for nDDI command playback from recording file. This creates a player, enabling
 	 * the Play() function which will decode the commands and send them to an nDDI display wall server.
 	 * @param file Specifies the path and filename where the commands are read from.
+	 * @param fromFrame The first frame to play. The Init command and frame 0 are always played so the display is set up.
+	 * @param toFrame The last frame to play. Frames are counted by Latch commands starting from 0.
+	 * @param speed Plays frames at this multiple of the speed they were recorded at. Zero plays them as fast as possible.
          */
-        RecorderNddiDisplay(char* file) {
-            player = new CommandPlayer(file);
+        RecorderNddiDisplay(char* file, unsigned int fromFrame = 0, unsigned int toFrame = UINT_MAX, double speed = 0.0) {
+            player = new CommandPlayer(file, fromFrame, toFrame, speed);
         }
 
 	/**
@@ -350,7 +584,7 @@ namespace nddi {
          * @return The width of the display.
          */
         unsigned int DisplayWidth() {
-            NddiCommandMessage* msg = new DisplayWidthCommandMessage();
+            NddiCommandMessage* msg = recorder->create<DisplayWidthCommandMessage>();
             recorder->record(msg);
             return displayWidth_;
         }
@@ -362,7 +596,7 @@ namespace nddi {
          * @return The height of the display.
          */
         unsigned int DisplayHeight() {
-            NddiCommandMessage* msg = new DisplayHeightCommandMessage();
+            NddiCommandMessage* msg = recorder->create<DisplayHeightCommandMessage>();
             recorder->record(msg);
             return displayHeight_;;
         }
@@ -374,7 +608,7 @@ namespace nddi {
          * @return The number of coefficient planes.
          */
         unsigned int NumCoefficientPlanes() {
-            NddiCommandMessage* msg = new NumCoefficientPlanesCommandMessage();
+            NddiCommandMessage* msg = recorder->create<NumCoefficientPlanesCommandMessage>();
             recorder->record(msg);
             return numCoefficientPlanes_;
         }
@@ -388,7 +622,7 @@ namespace nddi {
          * @param location Tuple for the location within the frame volume where the pixel will be copied to.
          */
         void PutPixel(Pixel p, vector<unsigned int> &location) {
-            NddiCommandMessage* msg = new PutPixelCommandMessage(p, location);
+            NddiCommandMessage* msg = recorder->create<PutPixelCommandMessage>(p, location);
             recorder->record(msg);
         }
 
@@ -405,7 +639,7 @@ namespace nddi {
          *            values in this last pixel should be identical to the start pixel.
          */
         void CopyPixelStrip(Pixel* p, vector<unsigned int> &start, vector<unsigned int> &end) {
-            NddiCommandMessage* msg = new CopyPixelStripCommandMessage(p, start, end);
+            NddiCommandMessage* msg = recorder->create<CopyPixelStripCommandMessage>(p, start, end);
             recorder->record(msg);
         }
 
@@ -422,7 +656,18 @@ namespace nddi {
          * @param end Tuple for the last pixel in the frame volume to be filled.
          */
         void CopyPixels(Pixel* p, vector<unsigned int> &start, vector<unsigned int> &end) {
-            NddiCommandMessage* msg = new CopyPixelsCommandMessage(p, start, end);
+            NddiCommandMessage* msg = recorder->create<CopyPixelsCommandMessage>(p, start, end);
+            recorder->record(msg);
+        }
+
+        /**
+         * \brief Copies the pixels into the designated region of the frame volume, taking ownership of them.
+         *
+         * Copies the pixels into the designated region of the frame volume, taking ownership of them. The pixels
+         * are swapped into the recorded command, and the caller gets back the buffer of a recycled command.
+         */
+        void CopyPixels(vector<Pixel> &&p, vector<unsigned int> &start, vector<unsigned int> &end) {
+            NddiCommandMessage* msg = recorder->create<CopyPixelsCommandMessage>(std::move(p), start, end);
             recorder->record(msg);
         }
 
@@ -437,7 +682,18 @@ namespace nddi {
          * @param size Two element tuple for the size of each tile (w, h).
          */
         void CopyPixelTiles(vector<Pixel*> &p, vector<vector<unsigned int> > &starts, vector<unsigned int> &size) {
-            NddiCommandMessage* msg = new CopyPixelTilesCommandMessage(p, starts, size);
+            NddiCommandMessage* msg = recorder->create<CopyPixelTilesCommandMessage>(p, starts, size);
+            recorder->record(msg);
+        }
+
+        /**
+         * \brief Copies the tiles into the designated tile regions of the frame volume, taking ownership of them.
+         *
+         * Copies the tiles into the designated tile regions of the frame volume, taking ownership of them. The tiles
+         * are swapped into the recorded command, and the caller gets back the tiles of a recycled command.
+         */
+        void CopyPixelTiles(vector<vector<Pixel> > &&p, vector<vector<unsigned int> > &starts, vector<unsigned int> &size) {
+            NddiCommandMessage* msg = recorder->create<CopyPixelTilesCommandMessage>(std::move(p), starts, size);
             recorder->record(msg);
         }
 
@@ -452,7 +708,7 @@ namespace nddi {
          * @param end Tuple for the last pixel in the frame volume to be filled.
          */
         void FillPixel(Pixel p, vector<unsigned int> &start, vector<unsigned int> &end) {
-            NddiCommandMessage* msg = new FillPixelCommandMessage(p, start, end);
+            NddiCommandMessage* msg = recorder->create<FillPixelCommandMessage>(p, start, end);
             recorder->record(msg);
         }
 
@@ -466,7 +722,7 @@ namespace nddi {
          * @param dest Tuple for the first starting pixel of the destination region to be filled.
          */
         void CopyFrameVolume(vector<unsigned int> &start, vector<unsigned int> &end, vector<unsigned int> &dest) {
-            NddiCommandMessage* msg = new CopyFrameVolumeCommandMessage(start, end, dest);
+            NddiCommandMessage* msg = recorder->create<CopyFrameVolumeCommandMessage>(start, end, dest);
             recorder->record(msg);
         }
 
@@ -481,7 +737,7 @@ namespace nddi {
          *              vector cannot be changed.
          */
         void UpdateInputVector(vector<int> &input) {
-            NddiCommandMessage* msg = new UpdateInputVectorCommandMessage(input);
+            NddiCommandMessage* msg = recorder->create<UpdateInputVectorCommandMessage>(input);
             recorder->record(msg);
         }
 
@@ -498,7 +754,7 @@ namespace nddi {
          *                 coefficient matrix will be copied.
          */
         void PutCoefficientMatrix(vector< vector<int> > &coefficientMatrix, vector<unsigned int> &location) {
-            NddiCommandMessage* msg = new PutCoefficientMatrixCommandMessage(coefficientMatrix, location);
+            NddiCommandMessage* msg = recorder->create<PutCoefficientMatrixCommandMessage>(coefficientMatrix, location);
             recorder->record(msg);
         }
 
@@ -516,7 +772,23 @@ namespace nddi {
          *            coefficient matrix will be copied to.
          */
         void FillCoefficientMatrix(vector< vector<int> > &coefficientMatrix, vector<unsigned int> &start, vector<unsigned int> &end) {
-            NddiCommandMessage* msg = new FillCoefficientMatrixCommandMessage(coefficientMatrix, start, end);
+            NddiCommandMessage* msg = recorder->create<FillCoefficientMatrixCommandMessage>(coefficientMatrix, start, end);
+            recorder->record(msg);
+        }
+
+        /**
+         * \brief Fills a range of the coefficient planes with a coefficient matrix translated for each tile.
+         *
+         * Fills a range of the coefficient planes with a coefficient matrix translated for each tile.
+	 * Builds a FillCoefficientMatrixTiled command and records it.
+         * @param coefficientMatrix The matrix used for the first tile. Its third row holds the translation terms.
+         * @param start This three-element vector specifies the first location of the range in the coefficient planes.
+         * @param end This three-element vector specifies the last location of the range in the coefficient planes.
+         * @param size This two-element vector specifies the width and height of each tile.
+         */
+        void FillCoefficientMatrixTiled(vector< vector<int> > &coefficientMatrix, vector<unsigned int> &start,
+                                        vector<unsigned int> &end, vector<unsigned int> &size) {
+            NddiCommandMessage* msg = recorder->create<FillCoefficientMatrixTiledCommandMessage>(coefficientMatrix, start, end, size);
             recorder->record(msg);
         }
 
@@ -535,7 +807,7 @@ namespace nddi {
          *            coefficient matrix will be copied to.
          */
         void FillCoefficient(int coefficient, unsigned int row, unsigned int col, vector<unsigned int> &start, vector<unsigned int> &end) {
-            NddiCommandMessage* msg = new FillCoefficientCommandMessage(coefficient, row, col, start, end);
+            NddiCommandMessage* msg = recorder->create<FillCoefficientCommandMessage>(coefficient, row, col, start, end);
             recorder->record(msg);
         }
 
@@ -552,7 +824,7 @@ namespace nddi {
          * @param size Tuple for the size (w, h) of the tile.
          */
         void FillCoefficientTiles(vector<int> &coefficients, vector<vector<unsigned int> > &positions, vector<vector<unsigned int> > &starts, vector<unsigned int> &size) {
-            NddiCommandMessage* msg = new FillCoefficientTilesCommandMessage(coefficients, positions, starts, size);
+            NddiCommandMessage* msg = recorder->create<FillCoefficientTilesCommandMessage>(coefficients, positions, starts, size);
             recorder->record(msg);
         }
 
@@ -568,7 +840,7 @@ namespace nddi {
          *            the scalers will be copied to.
          */
         void FillScaler(Scaler scaler, vector<unsigned int> &start, vector<unsigned int> &end) {
-            NddiCommandMessage* msg = new FillScalerCommandMessage(scaler, start, end);
+            NddiCommandMessage* msg = recorder->create<FillScalerCommandMessage>(scaler, start, end);
             recorder->record(msg);
         }
 
@@ -583,7 +855,7 @@ namespace nddi {
          * @param size Tuple for the size (w, h) of the tile.
          */
         void FillScalerTiles(vector<uint64_t> &scalers, vector<vector<unsigned int> > &starts, vector<unsigned int> &size) {
-            NddiCommandMessage* msg = new FillScalerTilesCommandMessage(scalers, starts, size);
+            NddiCommandMessage* msg = recorder->create<FillScalerTilesCommandMessage>(scalers, starts, size);
             recorder->record(msg);
         }
 
@@ -600,7 +872,18 @@ namespace nddi {
          * @param size Tuple for the size (w, h) of the tile.
          */
         void FillScalerTileStack(vector<uint64_t> &scalers, vector<unsigned int> &start, vector<unsigned int> &size) {
-            NddiCommandMessage* msg = new FillScalerTileStackCommandMessage(scalers, start, size);
+            NddiCommandMessage* msg = recorder->create<FillScalerTileStackCommandMessage>(scalers, start, size);
+            recorder->record(msg);
+        }
+
+        /**
+         * \brief Fills a stack of tiles in the coefficient planes with the scalers, taking ownership of them.
+         *
+         * Fills a stack of tiles in the coefficient planes with the scalers, taking ownership of them. The scalers
+         * are swapped into the recorded command, and the caller gets back the scalers of a recycled command.
+         */
+        void FillScalerTileStack(vector<uint64_t> &&scalers, vector<unsigned int> &start, vector<unsigned int> &size) {
+            NddiCommandMessage* msg = recorder->create<FillScalerTileStackCommandMessage>(std::move(scalers), start, size);
             recorder->record(msg);
         }
 
@@ -615,7 +898,7 @@ namespace nddi {
          * @param mode Can be UNSIGNED_MODE or SIGNED_MODE.
          */
         void SetPixelByteSignMode(SignMode mode) {
-            NddiCommandMessage* msg = new SetPixelByteSignModeCommandMessage(mode);
+            NddiCommandMessage* msg = recorder->create<SetPixelByteSignModeCommandMessage>(mode);
             recorder->record(msg);
         }
 
@@ -631,7 +914,7 @@ namespace nddi {
          */
         void SetFullScaler(uint16_t scaler) {
             fullScaler_ = scaler;
-            NddiCommandMessage* msg = new SetFullScalerCommandMessage(scaler);
+            NddiCommandMessage* msg = recorder->create<SetFullScalerCommandMessage>(scaler);
             recorder->record(msg);
         }
 
@@ -643,7 +926,7 @@ namespace nddi {
          * @return The current fully on scaler value.
          */
         uint16_t GetFullScaler() {
-            NddiCommandMessage* msg = new GetFullScalerCommandMessage();
+            NddiCommandMessage* msg = recorder->create<GetFullScalerCommandMessage>();
             recorder->record(msg);
             return fullScaler_;
         }
@@ -654,7 +937,7 @@ namespace nddi {
 	 * Records a ClearCostModel command.
          */
         void ClearCostModel() {
-            NddiCommandMessage* msg = new ClearCostModelCommandMessage();
+            NddiCommandMessage* msg = recorder->create<ClearCostModelCommandMessage>();
             recorder->record(msg);
         }
 
@@ -668,7 +951,7 @@ namespace nddi {
  	 * @param sub_h The height of the subregion
          */
         void Latch(uint32_t sub_x, uint32_t sub_y, uint32_t sub_w, uint32_t sub_h) {
-            NddiCommandMessage* msg = new LatchCommandMessage(sub_x, sub_y, sub_w, sub_h);
+            NddiCommandMessage* msg = recorder->create<LatchCommandMessage>(sub_x, sub_y, sub_w, sub_h);
             recorder->record(msg);
         }
 
@@ -678,7 +961,7 @@ namespace nddi {
 	 * Records a Shutdown command.
          */
         void Shutdown() {
-            NddiCommandMessage* msg = new ShutdownCommandMessage();
+            NddiCommandMessage* msg = recorder->create<ShutdownCommandMessage>();
             recorder->record(msg);
         }
 
@@ -696,9 +979,35 @@ namespace nddi {
 	 * as a player, this interface is used to start the playback. The player reads the
 	 * recorded commands from the file provided to the constructor. This call returns when
 	 * the last command is played.
+	 * @param barrier If provided, the player waits on this barrier once frame 0 has been played, which
+	 *                lets several players on their own threads set up their displays and then start together.
+	 */
+        void Play(pthread_barrier_t* barrier = NULL) {
+            player->play(barrier);
+        }
+
+	/**
+	 * \brief Returns the number of frames played and how long they took.
+	 *
+	 * Returns the number of frames played and how long they took. Frame 0, which carries the tiler's
+	 * setup, isn't counted, and the time starts when it has been played.
+	 */
+        const playback_stats_t& PlaybackStats() {
+            return player->Stats();
+        }
+
+	/**
+	 * \brief Sets the compression used by every recording started afterwards.
+	 *
+	 * Sets the compression used by every recording started afterwards. When a mode other than COMPRESSION_NONE
+	 * is set, the recorder thread gathers the serialized commands into blocks of the given size and compresses
+	 * each one as it fills. The player's reader thread decompresses them ahead of the play loop.
+	 * @param mode The compression mode. Defaults to COMPRESSION_NONE.
+	 * @param blockSize The number of bytes of serialized commands in each block. Defaults to RECORDING_BLOCK_SIZE.
 	 */
-        void Play() {
-            player->play();
+        static void SetRecordingCompression(Compression mode, size_t blockSize = RECORDING_BLOCK_SIZE) {
+            CommandRecorder::compression() = mode;
+            CommandRecorder::blockSize() = blockSize;
         }
 
     private:
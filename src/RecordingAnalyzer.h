@@ -0,0 +1,270 @@
+#ifndef RECORDING_ANALYZER_H
+#define RECORDING_ANALYZER_H
+
+/**
+ * \file RecordingAnalyzer.h
+ *
+ * \brief This file embodies an analyzer which breaks a recording's link cost down by command.
+ *
+ * This file embodies an analyzer which breaks a recording's link cost down by command. When bandwidth
+ * regresses it's useful to see which commands a recording spends its bytes on, in which frames, how tall
+ * its scaler tile stacks are, and which parts of the coefficient planes it keeps rewriting. The analyzer
+ * observes a HeadlessReplay, so every command is charged exactly what the display's cost model charges
+ * the NDDI Wall Server for it.
+ */
+
+#include <map>
+#include <ostream>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "HeadlessReplay.h"
+#include "NddiCommands.h"
+
+namespace nddi {
+
+    /**
+     * \brief Counts the commands of one type and the link bytes charged for them.
+     */
+    typedef struct {
+        uint64_t  commands;
+        uint64_t  linkBytes;
+    } command_cost_t;
+
+    /**
+     * \brief Tallies the commands, link bytes, stack heights and touched tiles of a recording.
+     *
+     * Tallies the commands, link bytes, stack heights and touched tiles of a recording. Costs are kept for
+     * every latch interval, i.e. the commands up to and including each Latch, and for the whole recording.
+     * The heatmap counts the commands writing coefficients or scalers to each tile of the coefficient
+     * planes, summed over the planes.
+     */
+    class RecordingAnalyzer : public HeadlessReplayObserver {
+    public:
+        /**
+         * \brief Creates an analyzer for a display of the given size.
+         *
+         * Creates an analyzer for a display of the given size.
+         * @param width The width of the display.
+         * @param height The height of the display.
+         * @param tileSize The width and height of each heatmap tile.
+         */
+        RecordingAnalyzer(unsigned int width, unsigned int height, unsigned int tileSize)
+        : width_(width),
+          height_(height),
+          tileSize_(tileSize),
+          tilesWide_((width + tileSize - 1) / tileSize),
+          tilesHigh_((height + tileSize - 1) / tileSize),
+          heatmap_(tilesWide_ * tilesHigh_, 0) {
+            memset(total_, 0, sizeof(total_));
+            memset(current_, 0, sizeof(current_));
+        }
+
+        void Played(NddiCommandMessage* msg, long linkBytes) {
+            current_[msg->id].commands++;
+            current_[msg->id].linkBytes += linkBytes;
+            total_[msg->id].commands++;
+            total_[msg->id].linkBytes += linkBytes;
+
+            switch (msg->id) {
+            case idPutCoefficientMatrix: {
+                PutCoefficientMatrixCommandMessage* m = (PutCoefficientMatrixCommandMessage*)msg;
+                if (m->location.size() >= 2) {
+                    touch(m->location[0], m->location[1], m->location[0] + 1, m->location[1] + 1);
+                }
+            }
+            break;
+            case idFillCoefficientMatrix: {
+                FillCoefficientMatrixCommandMessage* m = (FillCoefficientMatrixCommandMessage*)msg;
+                touchPlanes(m->start, m->end);
+            }
+            break;
+            case idFillCoefficientMatrixTiled: {
+                FillCoefficientMatrixTiledCommandMessage* m = (FillCoefficientMatrixTiledCommandMessage*)msg;
+                touchPlanes(m->start, m->end);
+            }
+            break;
+            case idFillCoefficient: {
+                FillCoefficientCommandMessage* m = (FillCoefficientCommandMessage*)msg;
+                touchPlanes(m->start, m->end);
+            }
+            break;
+            case idFillCoefficientTiles: {
+                FillCoefficientTilesCommandMessage* m = (FillCoefficientTilesCommandMessage*)msg;
+                for (size_t i = 0; i < m->starts.size(); i++) {
+                    touchTile(m->starts[i], m->size);
+                }
+            }
+            break;
+            case idFillScaler: {
+                FillScalerCommandMessage* m = (FillScalerCommandMessage*)msg;
+                touchPlanes(m->start, m->end);
+            }
+            break;
+            case idFillScalerTiles: {
+                FillScalerTilesCommandMessage* m = (FillScalerTilesCommandMessage*)msg;
+                for (size_t i = 0; i < m->starts.size(); i++) {
+                    touchTile(m->starts[i], m->size);
+                }
+            }
+            break;
+            case idFillScalerTileStack: {
+                FillScalerTileStackCommandMessage* m = (FillScalerTileStackCommandMessage*)msg;
+                stack_cost_t &stack = stacks_[m->scalers.size()];
+                stack.stacks++;
+                stack.linkBytes += linkBytes;
+                touchTile(m->start, m->size, m->scalers.size());
+            }
+            break;
+            case idLatch:
+                EndInterval();
+                break;
+            default:
+                break;
+            }
+        }
+
+        /**
+         * \brief Closes the current latch interval. Called for each Latch and once more at the end of the recording.
+         *
+         * Closes the current latch interval. Called for each Latch and once more at the end of the recording,
+         * where commands after the last Latch are kept as a final interval if there are any.
+         */
+        void EndInterval() {
+            for (size_t i = 0; i < idCommandCount; i++) {
+                if (current_[i].commands) {
+                    intervals_.push_back(std::vector<command_cost_t>(current_, current_ + idCommandCount));
+                    memset(current_, 0, sizeof(current_));
+                    return;
+                }
+            }
+        }
+
+        /**
+         * \brief Writes the commands and link bytes of each latch interval, one row per interval.
+         *
+         * Writes the commands and link bytes of each latch interval, one row per interval. Only the
+         * command types the recording uses get columns.
+         */
+        void OutputIntervalsCsv(std::ostream &os) {
+            os << "Interval";
+            for (size_t i = idInit; i < idCommandCount; i++) {
+                if (total_[i].commands) {
+                    os << " , " << CommandNames[i] << " Commands , " << CommandNames[i] << " Link Bytes";
+                }
+            }
+            os << " , Total Commands , Total Link Bytes" << std::endl;
+
+            for (size_t f = 0; f < intervals_.size(); f++) {
+                command_cost_t sum = {0, 0};
+                os << f;
+                for (size_t i = idInit; i < idCommandCount; i++) {
+                    if (total_[i].commands) {
+                        os << " , " << intervals_[f][i].commands << " , " << intervals_[f][i].linkBytes;
+                        sum.commands += intervals_[f][i].commands;
+                        sum.linkBytes += intervals_[f][i].linkBytes;
+                    }
+                }
+                os << " , " << sum.commands << " , " << sum.linkBytes << std::endl;
+            }
+        }
+
+        /**
+         * \brief Writes the commands and link bytes of each command type over the whole recording.
+         */
+        void OutputTotalsCsv(std::ostream &os) {
+            command_cost_t sum = {0, 0};
+            os << "Command , Commands , Link Bytes , Link Bytes Per Command , Share Of Link Bytes" << std::endl;
+            for (size_t i = idInit; i < idCommandCount; i++) {
+                sum.commands += total_[i].commands;
+                sum.linkBytes += total_[i].linkBytes;
+            }
+            for (size_t i = idInit; i < idCommandCount; i++) {
+                if (total_[i].commands) {
+                    os << CommandNames[i] << " , " << total_[i].commands << " , " << total_[i].linkBytes << " , "
+                       << (double)total_[i].linkBytes / total_[i].commands << " , "
+                       << (sum.linkBytes ? (double)total_[i].linkBytes / sum.linkBytes : 0.0) << std::endl;
+                }
+            }
+            os << "Total , " << sum.commands << " , " << sum.linkBytes << " , "
+               << (sum.commands ? (double)sum.linkBytes / sum.commands : 0.0) << " , 1" << std::endl;
+        }
+
+        /**
+         * \brief Writes the histogram of FillScalerTileStack heights.
+         */
+        void OutputStackHeightsCsv(std::ostream &os) {
+            os << "Stack Height , Stacks , Link Bytes" << std::endl;
+            for (std::map<size_t, stack_cost_t>::iterator it = stacks_.begin(); it != stacks_.end(); it++) {
+                os << it->first << " , " << it->second.stacks << " , " << it->second.linkBytes << std::endl;
+            }
+        }
+
+        /**
+         * \brief Writes the heatmap of touched coefficient-plane tiles, one row per row of tiles.
+         */
+        void OutputHeatmapCsv(std::ostream &os) {
+            os << "Tile Row";
+            for (size_t x = 0; x < tilesWide_; x++) {
+                os << " , " << x * tileSize_;
+            }
+            os << std::endl;
+            for (size_t y = 0; y < tilesHigh_; y++) {
+                os << y * tileSize_;
+                for (size_t x = 0; x < tilesWide_; x++) {
+                    os << " , " << heatmap_[y * tilesWide_ + x];
+                }
+                os << std::endl;
+            }
+        }
+
+    private:
+        typedef struct {
+            uint64_t  stacks;
+            uint64_t  linkBytes;
+        } stack_cost_t;
+
+        // Touches the tiles of every plane in the inclusive range from start to end. The recording isn't trusted,
+        // so a range without all three coordinates is ignored.
+        void touchPlanes(std::vector<unsigned int> &start, std::vector<unsigned int> &end) {
+            if ((start.size() < 3) || (end.size() < 3) || (start[2] > end[2])) {
+                return;
+            }
+            touch(start[0], start[1], end[0] + 1, end[1] + 1, (uint64_t)end[2] - start[2] + 1);
+        }
+
+        // Touches the tiles under a tile of the given size whose corner is at start, ignoring malformed ones.
+        void touchTile(std::vector<unsigned int> &start, std::vector<unsigned int> &size, uint64_t planes = 1) {
+            if ((start.size() >= 2) && (size.size() >= 2)) {
+                touch(start[0], start[1], start[0] + size[0], start[1] + size[1], planes);
+            }
+        }
+
+        // Touches the tiles overlapping the region from (x0, y0) up to but not including (x1, y1) once per plane.
+        void touch(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, uint64_t planes = 1) {
+            if (x1 > width_) { x1 = width_; }
+            if (y1 > height_) { y1 = height_; }
+            if ((x0 >= x1) || (y0 >= y1)) {
+                return;
+            }
+            for (size_t ty = y0 / tileSize_; ty <= (y1 - 1) / tileSize_; ty++) {
+                for (size_t tx = x0 / tileSize_; tx <= (x1 - 1) / tileSize_; tx++) {
+                    heatmap_[ty * tilesWide_ + tx] += planes;
+                }
+            }
+        }
+
+        unsigned int                                width_, height_;
+        unsigned int                                tileSize_;
+        size_t                                      tilesWide_, tilesHigh_;
+        std::vector<uint64_t>                       heatmap_;
+        command_cost_t                              total_[idCommandCount];
+        command_cost_t                              current_[idCommandCount];
+        std::vector< std::vector<command_cost_t> >  intervals_;
+        std::map<size_t, stack_cost_t>              stacks_;
+    };
+
+}
+
+#endif // RECORDING_ANALYZER_H
@@ -0,0 +1,674 @@
+#ifndef RECORDING_FORMAT_H
+#define RECORDING_FORMAT_H
+
+/**
+ * \file RecordingFormat.h
+ *
+ * \brief This file embodies the indexed v2 recording format used by the command recorder and player.
+ *
+ * This file embodies the indexed v2 recording format used by the command recorder and player. The v1
+ * format is a bare cereal stream, so reaching any frame means parsing every command before it. A v2
+ * recording starts with a fixed-size header describing the display configuration and the command list
+ * it was recorded with. It's followed by length-prefixed command records and ends with an index holding
+ * the byte offset at which each frame starts, where a frame is every command up to and including a
+ * Latch. The player maps the file and seeks straight to any frame through the index. Recordings made
+ * with timestamps carry the monotonic time each command was issued, which the player uses to pace frames.
+ * Records can also be gathered into fixed-size blocks which are compressed with any of the payload
+ * compression modes, trading CPU on the player's reader thread for less I/O.
+ */
+
+#include <algorithm>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <stdint.h>
+#include <streambuf>
+#include <string>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "CommandPool.h"
+#include "NddiCommands.h"
+#include "PayloadCompression.h"
+
+///\cond
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/vector.hpp>
+///\endcond
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__)
+#error "The v2 recording format is read and written with host-order loads and stores, which must be little-endian."
+#endif
+
+namespace nddi {
+
+    /** Magic bytes at the start of every v2 recording. */
+    #define RECORDING_MAGIC "NDDIREC"
+
+    /** Version of the recording format written by RecordingWriter. */
+    #define RECORDING_VERSION 2
+
+    /** Header flag set when every record prefix is followed by a timestamp. */
+    #define RECORDING_FLAG_TIMESTAMPS 0x1
+
+    /** Header flag set when the records are stored in compressed blocks. */
+    #define RECORDING_FLAG_BLOCKS 0x2
+
+    /** Default number of bytes of records gathered into each compressed block. */
+    #define RECORDING_BLOCK_SIZE (1024 * 1024)
+
+    /** Maximum number of frame volume dimensions carried in the header. */
+    #define RECORDING_MAX_DIMENSIONS 8
+
+    /**
+     * \brief The fixed-size header at the start of a v2 recording.
+     *
+     * The fixed-size header at the start of a v2 recording. The index offset, frame count, and block count
+     * are patched in when the recording is closed, so a recording which was never closed has an index
+     * offset of zero and the player rebuilds its index by scanning the records.
+     */
+    typedef struct {
+        char      magic[8];
+        uint32_t  version;
+        uint32_t  commandCount;
+        uint32_t  commandListHash;
+        uint32_t  flags;
+        uint32_t  displayWidth;
+        uint32_t  displayHeight;
+        uint32_t  numCoefficientPlanes;
+        uint32_t  inputVectorSize;
+        uint32_t  frameVolumeDimensionality;
+        uint32_t  frameVolumeDimensionalSizes[RECORDING_MAX_DIMENSIONS];
+        uint32_t  blockCount;
+        uint64_t  indexOffset;
+        uint64_t  frameCount;
+    } recording_header_t;
+
+    /**
+     * \brief The prefix of every command record in a v2 recording.
+     *
+     * The prefix of every command record in a v2 recording. When the header has RECORDING_FLAG_TIMESTAMPS
+     * set, it's followed by a uint64_t holding the command's timestamp in nanoseconds. Then come length
+     * bytes holding the command serialized with cereal's binary archive.
+     */
+    typedef struct {
+        uint32_t  id;
+        uint32_t  length;
+    } recording_record_t;
+
+    /**
+     * \brief The prefix of every block in a block-compressed v2 recording.
+     *
+     * The prefix of every block in a block-compressed v2 recording. It's followed by storedLength bytes
+     * which decompress to rawLength bytes of whole records. Blocks which didn't shrink are stored raw
+     * with a compression of COMPRESSION_NONE.
+     */
+    typedef struct {
+        uint32_t  compression;
+        uint32_t  rawLength;
+        uint32_t  storedLength;
+        uint32_t  reserved;
+    } recording_block_t;
+
+    /**
+     * \brief An entry in the block index, which follows the frame index in a block-compressed v2 recording.
+     *
+     * An entry in the block index, which follows the frame index in a block-compressed v2 recording. It maps
+     * the offset of the block's first record, as used by the frame index, to the block's offset in the file.
+     */
+    typedef struct {
+        uint64_t  fileOffset;
+        uint64_t  logicalStart;
+    } recording_block_index_t;
+
+    /**
+     * \brief Monotonic timestamp in nanoseconds used to stamp recorded commands.
+     */
+    static inline uint64_t recordingNanos() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+
+    /**
+     * \brief Hashes the names of the commands in NDDI_COMMAND_LIST.
+     *
+     * Hashes the names of the commands in NDDI_COMMAND_LIST. Command IDs are positional, so a
+     * recording can only be played by a build whose command list starts with the same commands.
+     * @param count The number of commands hashed, which defaults to all of them.
+     */
+    static inline uint32_t commandListHash(size_t count = idCommandCount - 1) {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i <= count; i++) {
+            for (size_t j = 0; j <= CommandNames[i].size(); j++) {
+                hash = (hash ^ (uint8_t)CommandNames[i].c_str()[j]) * 16777619u;
+            }
+        }
+        return hash;
+    }
+
+    /**
+     * \brief Serializes a command into the body of a record.
+     *
+     * Serializes a command into the body of a record.
+     * @param msg The command.
+     * @param body Set to the serialized command.
+     * @return False if the command has an unknown ID.
+     */
+    static inline bool encodeCommand(NddiCommandMessage* msg, std::string &body) {
+        std::ostringstream os;
+        {
+            cereal::BinaryOutputArchive oarchive(os);
+            switch (msg->id) {
+            #define GENERATE_ENCODE_CASE(m) \
+            case id ## m : \
+                oarchive(*( m ## CommandMessage*)msg); \
+                break;
+            NDDI_COMMAND_LIST(GENERATE_ENCODE_CASE)
+            case idEOT:
+            default:
+                return false;
+            }
+        }
+        body = os.str();
+        return true;
+    }
+
+    /**
+     * \brief Wraps a region of memory in a read-only stream buffer so cereal can read records in place.
+     */
+    class RecordBuffer : public std::streambuf {
+    public:
+        RecordBuffer(const uint8_t* data, size_t length) {
+            char* p = (char*)data;
+            setg(p, p, p + length);
+        }
+    };
+
+    /**
+     * \brief Deserializes the body of a record into a new command.
+     *
+     * Deserializes the body of a record into a new command.
+     * @param id The ID of the command.
+     * @param body The serialized command.
+     * @param length The length of the serialized command in bytes.
+     * @param pool If provided, the command is deserialized into a message recycled from this pool.
+     * @return The command, or NULL if the ID is unknown or the body is truncated.
+     */
+    static inline NddiCommandMessage* decodeCommand(CommandID id, const uint8_t* body, size_t length,
+                                                    CommandPool* pool = NULL) {
+        RecordBuffer buffer(body, length);
+        std::istream is(&buffer);
+        cereal::BinaryInputArchive iarchive(is);
+
+        NddiCommandMessage* msg = NULL;
+        try {
+            switch (id) {
+            #define GENERATE_DECODE_CASE(m) \
+            case id ## m : { \
+                msg = pool ? pool->Acquire<m ## CommandMessage>() : new m ## CommandMessage(); \
+                iarchive(*( m ## CommandMessage *)msg); \
+            } \
+            break;
+            NDDI_COMMAND_LIST(GENERATE_DECODE_CASE)
+            case idEOT:
+            default:
+                break;
+            }
+        } catch (cereal::Exception &e) {
+            deleteCommand(msg);
+            msg = NULL;
+        }
+        return msg;
+    }
+
+    /**
+     * \brief Writes a v2 recording.
+     *
+     * Writes a v2 recording. Commands are appended as length-prefixed records while the byte offset
+     * at which each frame starts is collected. Close() appends the index and patches the header.
+     * When a compression mode is given, records are gathered into blocks which are compressed as
+     * they fill. Records never span blocks, and frame offsets are then offsets into the concatenated
+     * uncompressed blocks, which the index maps back to the blocks holding them.
+     */
+    class RecordingWriter {
+    public:
+        RecordingWriter(std::string file, Compression mode = nddiwall::COMPRESSION_NONE,
+                        size_t blockSize = RECORDING_BLOCK_SIZE)
+        : os_(file, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc),
+          mode_(mode),
+          blockSize_(blockSize),
+          offset_(sizeof(recording_header_t)),
+          fileOffset_(sizeof(recording_header_t)),
+          blockStart_(sizeof(recording_header_t)),
+          frameStarted_(false),
+          closed_(false) {
+            memset(&header_, 0, sizeof(header_));
+            memset(&stats_, 0, sizeof(stats_));
+            memcpy(header_.magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC));
+            header_.version = RECORDING_VERSION;
+            header_.commandCount = idCommandCount - 1;
+            header_.commandListHash = commandListHash();
+            header_.flags = RECORDING_FLAG_TIMESTAMPS;
+            if (mode_ != nddiwall::COMPRESSION_NONE) {
+                header_.flags |= RECORDING_FLAG_BLOCKS;
+                block_.reserve(blockSize_ * 2);
+            }
+            os_.write((const char*)&header_, sizeof(header_));
+        }
+
+        ~RecordingWriter() {
+            Close();
+        }
+
+        bool IsOpen() { return os_.good(); }
+
+        /**
+         * \brief Returns the sizes of the blocks before and after compression and the time spent compressing them.
+         */
+        const compression_stats_t& Stats() { return stats_; }
+
+        /**
+         * \brief Returns the offset at which the next record will be written, before any block compression.
+         */
+        uint64_t Offset() { return offset_; }
+
+        /**
+         * \brief Appends a command to the recording.
+         *
+         * Appends a command to the recording. The display configuration is taken from the Init
+         * command for the header, and each Latch ends the current frame.
+         * @param msg The command, which remains owned by the caller.
+         */
+        void Write(NddiCommandMessage* msg) {
+            std::string body;
+            if (closed_ || !encodeCommand(msg, body)) {
+                return;
+            }
+
+            if (msg->id == idInit) {
+                InitCommandMessage* init = (InitCommandMessage*)msg;
+                header_.displayWidth = init->displayWidth;
+                header_.displayHeight = init->displayHeight;
+                header_.numCoefficientPlanes = init->numCoefficientPlanes;
+                header_.inputVectorSize = init->inputVectorSize;
+                header_.frameVolumeDimensionality = init->frameVolumeDimensionalSizes.size();
+                for (size_t i = 0; (i < init->frameVolumeDimensionalSizes.size()) && (i < RECORDING_MAX_DIMENSIONS); i++) {
+                    header_.frameVolumeDimensionalSizes[i] = init->frameVolumeDimensionalSizes[i];
+                }
+            }
+
+            if (!frameStarted_) {
+                frames_.push_back(offset_);
+                frameStarted_ = true;
+            }
+
+            recording_record_t record = { msg->id, (uint32_t)body.size() };
+            size_t length = sizeof(record) + sizeof(msg->timestamp) + body.size();
+            if (mode_ == nddiwall::COMPRESSION_NONE) {
+                os_.write((const char*)&record, sizeof(record));
+                os_.write((const char*)&msg->timestamp, sizeof(msg->timestamp));
+                os_.write(body.data(), body.size());
+                fileOffset_ += length;
+            } else {
+                block_.append((const char*)&record, sizeof(record));
+                block_.append((const char*)&msg->timestamp, sizeof(msg->timestamp));
+                block_.append(body);
+            }
+            offset_ += length;
+
+            if (block_.size() >= blockSize_) {
+                flushBlock();
+            }
+
+            if (msg->id == idLatch) {
+                frameStarted_ = false;
+            }
+        }
+
+        /**
+         * \brief Appends the frame index and patches the header. Further writes are ignored.
+         */
+        void Close() {
+            if (closed_) {
+                return;
+            }
+            closed_ = true;
+            flushBlock();
+
+            header_.indexOffset = fileOffset_;
+            header_.frameCount = frames_.size();
+            header_.blockCount = blocks_.size();
+            os_.write((const char*)frames_.data(), frames_.size() * sizeof(uint64_t));
+            os_.write((const char*)blocks_.data(), blocks_.size() * sizeof(recording_block_index_t));
+            os_.seekp(0);
+            os_.write((const char*)&header_, sizeof(header_));
+            os_.close();
+        }
+
+    private:
+        // Compresses the records gathered so far, storing them raw if they don't shrink.
+        void flushBlock() {
+            if (block_.empty()) {
+                return;
+            }
+
+            recording_block_t prefix = { (uint32_t)mode_, (uint32_t)block_.size(), 0, 0 };
+            std::string compressed;
+            const std::string* data = &compressed;
+            if (!compressPayload(mode_, (const uint8_t*)block_.data(), block_.size(), compressed, &stats_)) {
+                prefix.compression = nddiwall::COMPRESSION_NONE;
+                data = &block_;
+                stats_.messages++;
+                stats_.rawBytes += block_.size();
+                stats_.wireBytes += block_.size();
+            }
+            prefix.storedLength = data->size();
+            os_.write((const char*)&prefix, sizeof(prefix));
+            os_.write(data->data(), data->size());
+
+            recording_block_index_t entry = { fileOffset_, blockStart_ };
+            blocks_.push_back(entry);
+            fileOffset_ += sizeof(prefix) + data->size();
+            blockStart_ = offset_;
+            block_.clear();
+        }
+
+        std::ofstream                         os_;
+        recording_header_t                    header_;
+        Compression                           mode_;
+        size_t                                blockSize_;
+        uint64_t                              offset_, fileOffset_, blockStart_;
+        bool                                  frameStarted_;
+        bool                                  closed_;
+        std::string                           block_;
+        compression_stats_t                   stats_;
+        std::vector<uint64_t>                 frames_;
+        std::vector<recording_block_index_t>  blocks_;
+    };
+
+    /**
+     * \brief Reads a v2 recording through a read-only memory mapping.
+     *
+     * Reads a v2 recording through a read-only memory mapping. Records are decoded in place, and the
+     * frame index gives the offset of any frame without touching the records before it. Records in a
+     * block-compressed recording are decoded from the most recently decompressed block instead.
+     */
+    class RecordingReader {
+    public:
+        RecordingReader(std::string file)
+        : base_(NULL),
+          size_(0),
+          end_(0),
+          stampSize_(0),
+          blocked_(false),
+          blockStart_(0),
+          blockEnd_(0),
+          blockData_(NULL) {
+            memset(&stats_, 0, sizeof(stats_));
+            int fd = open(file.c_str(), O_RDONLY);
+            if (fd < 0) {
+                error_ = "Unable to open " + file;
+                return;
+            }
+            struct stat st;
+            if ((fstat(fd, &st) == 0) && (st.st_size >= (off_t)sizeof(recording_header_t))) {
+                void* base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (base != MAP_FAILED) {
+                    base_ = (const uint8_t*)base;
+                    size_ = st.st_size;
+                }
+            }
+            close(fd);
+            if (!base_) {
+                error_ = "Unable to map " + file;
+                return;
+            }
+
+            memcpy(&header_, base_, sizeof(header_));
+            stampSize_ = (header_.flags & RECORDING_FLAG_TIMESTAMPS) ? sizeof(uint64_t) : 0;
+            blocked_ = (header_.flags & RECORDING_FLAG_BLOCKS) != 0;
+            if (memcmp(header_.magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC)) || (header_.version != RECORDING_VERSION)) {
+                error_ = file + " isn't a v2 recording";
+            } else if ((header_.commandCount >= idCommandCount) ||
+                       (header_.commandListHash != commandListHash(header_.commandCount))) {
+                error_ = file + " was recorded with a different command list";
+            } else if (!readIndex()) {
+                error_ = file + " has a corrupt frame index";
+            }
+            if (!error_.empty()) {
+                munmap((void*)base_, size_);
+                base_ = NULL;
+            }
+        }
+
+        ~RecordingReader() {
+            if (base_) {
+                munmap((void*)base_, size_);
+            }
+        }
+
+        /**
+         * \brief Reports whether the given file starts with the v2 magic bytes.
+         */
+        static bool IsIndexed(std::string file) {
+            char magic[sizeof(RECORDING_MAGIC)] = {0};
+            std::ifstream is(file, std::ifstream::in | std::ifstream::binary);
+            is.read(magic, sizeof(magic));
+            return is.good() && !memcmp(magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC));
+        }
+
+        bool IsOpen() { return base_ != NULL; }
+        std::string Error() { return error_; }
+        const recording_header_t& Header() { return header_; }
+        uint64_t FrameCount() { return frames_.size(); }
+        bool IsTimestamped() { return stampSize_ != 0; }
+        bool IsBlocked() { return blocked_; }
+
+        /**
+         * \brief Returns the sizes of the blocks decompressed so far and the time spent decompressing them.
+         */
+        const compression_stats_t& Stats() { return stats_; }
+
+        /**
+         * \brief Returns the offset of the first record of a frame.
+         *
+         * Returns the offset of the first record of a frame.
+         * @param frame The frame number. FrameCount() returns the offset just past the last record.
+         * @return The offset, which can be passed to Next().
+         */
+        uint64_t FrameOffset(uint64_t frame) {
+            return (frame < frames_.size()) ? frames_[frame] : end_;
+        }
+
+        /**
+         * \brief Decodes the record at the given offset.
+         *
+         * Decodes the record at the given offset.
+         * @param offset The offset of the record, which is advanced to the next record.
+         * @param msg Set to the decoded command, which is then owned by the caller. Its timestamp is
+         *            set if the recording has timestamps.
+         * @param pool If provided, the command is decoded into a message recycled from this pool.
+         * @return False once the offset reaches the end of the records or the record is corrupt.
+         */
+        bool Next(uint64_t &offset, NddiCommandMessage* &msg, CommandPool* pool = NULL) {
+            const uint8_t* body;
+            recording_record_t record;
+            uint64_t timestamp;
+            if (!recordAt(offset, record, timestamp, body)) {
+                return false;
+            }
+            msg = decodeCommand((CommandID)record.id, body, record.length, pool);
+            offset += sizeof(record) + stampSize_ + record.length;
+            if (msg) {
+                msg->timestamp = timestamp;
+            }
+            return msg != NULL;
+        }
+
+    private:
+        // Returns a pointer to length bytes at the given offset, decompressing the block holding them if needed.
+        const uint8_t* view(uint64_t offset, uint64_t length) {
+            if ((offset > end_) || (length > end_ - offset)) {
+                return NULL;
+            }
+            if (!blocked_) {
+                return base_ + offset;
+            }
+            if (((offset < blockStart_) || (offset >= blockEnd_)) && !loadBlock(offset)) {
+                return NULL;
+            }
+            if (length > blockEnd_ - offset) {
+                return NULL;
+            }
+            return blockData_ + (offset - blockStart_);
+        }
+
+        bool loadBlock(uint64_t offset) {
+            size_t b = std::upper_bound(blocks_.begin(), blocks_.end(), offset,
+                                        [](uint64_t o, const recording_block_index_t &e) { return o < e.logicalStart; })
+                       - blocks_.begin();
+            if (!b--) {
+                return false;
+            }
+
+            recording_block_t prefix;
+            if (!blockAt(blocks_[b].fileOffset, prefix)) {
+                return false;
+            }
+            const uint8_t* data = base_ + blocks_[b].fileOffset + sizeof(prefix);
+            if (prefix.compression == nddiwall::COMPRESSION_NONE) {
+                if (prefix.storedLength != prefix.rawLength) {
+                    return false;
+                }
+                blockData_ = data;
+            } else {
+                block_.resize(prefix.rawLength);
+                if (!decompressPayload((Compression)prefix.compression, data, prefix.storedLength,
+                                       block_.data(), block_.size(), &stats_)) {
+                    return false;
+                }
+                blockData_ = block_.data();
+            }
+            blockStart_ = blocks_[b].logicalStart;
+            blockEnd_ = blockStart_ + prefix.rawLength;
+            return true;
+        }
+
+        bool blockAt(uint64_t fileOffset, recording_block_t &prefix) {
+            if ((fileOffset > size_) || (sizeof(prefix) > size_ - fileOffset)) {
+                return false;
+            }
+            memcpy(&prefix, base_ + fileOffset, sizeof(prefix));
+            return prefix.storedLength <= size_ - fileOffset - sizeof(prefix);
+        }
+
+        bool recordAt(uint64_t offset, recording_record_t &record, uint64_t &timestamp, const uint8_t* &body) {
+            const uint8_t* p = view(offset, sizeof(record) + stampSize_);
+            if (!p) {
+                return false;
+            }
+            memcpy(&record, p, sizeof(record));
+            if ((record.id == idEOT) || (record.id > header_.commandCount)) {
+                return false;
+            }
+            p = view(offset, sizeof(record) + stampSize_ + record.length);
+            if (!p) {
+                return false;
+            }
+            timestamp = 0;
+            memcpy(&timestamp, p + sizeof(record), stampSize_);
+            body = p + sizeof(record) + stampSize_;
+            return true;
+        }
+
+        bool readIndex() {
+            // A recording which was closed has its index at the end
+            if (header_.indexOffset) {
+                uint64_t available = (header_.indexOffset < size_) ? size_ - header_.indexOffset : 0;
+                if ((header_.indexOffset < sizeof(header_)) || (header_.indexOffset > size_) ||
+                    (header_.frameCount > available / sizeof(uint64_t)) ||
+                    (header_.blockCount > (available - header_.frameCount * sizeof(uint64_t)) / sizeof(recording_block_index_t))) {
+                    return false;
+                }
+                const uint64_t* index = (const uint64_t*)(base_ + header_.indexOffset);
+                frames_.assign(index, index + header_.frameCount);
+                const recording_block_index_t* blocks = (const recording_block_index_t*)(index + header_.frameCount);
+                blocks_.assign(blocks, blocks + header_.blockCount);
+
+                end_ = header_.indexOffset;
+                if (blocked_) {
+                    recording_block_t prefix;
+                    end_ = sizeof(header_);
+                    if (!blocks_.empty()) {
+                        if (!blockAt(blocks_.back().fileOffset, prefix)) {
+                            return false;
+                        }
+                        end_ = blocks_.back().logicalStart + prefix.rawLength;
+                    }
+                }
+                for (size_t i = 0; i < frames_.size(); i++) {
+                    if ((frames_[i] < sizeof(header_)) || (frames_[i] > end_)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            // Otherwise the recorder never finished, so rebuild the index from whole blocks and records
+            end_ = size_;
+            if (blocked_) {
+                uint64_t fileOffset = sizeof(header_);
+                uint64_t logical = sizeof(header_);
+                recording_block_t prefix;
+                while (blockAt(fileOffset, prefix)) {
+                    recording_block_index_t entry = { fileOffset, logical };
+                    blocks_.push_back(entry);
+                    fileOffset += sizeof(prefix) + prefix.storedLength;
+                    logical += prefix.rawLength;
+                }
+                end_ = logical;
+            }
+
+            uint64_t offset = sizeof(header_);
+            bool frameStarted = false;
+            recording_record_t record;
+            uint64_t timestamp;
+            const uint8_t* body;
+            while (recordAt(offset, record, timestamp, body)) {
+                if (!frameStarted) {
+                    frames_.push_back(offset);
+                    frameStarted = true;
+                }
+                if (record.id == idLatch) {
+                    frameStarted = false;
+                }
+                offset += sizeof(record) + stampSize_ + record.length;
+            }
+            end_ = offset;
+            memset(&stats_, 0, sizeof(stats_));
+            return true;
+        }
+
+        const uint8_t*                        base_;
+        size_t                                size_;
+        uint64_t                              end_;
+        size_t                                stampSize_;
+        bool                                  blocked_;
+        recording_header_t                    header_;
+        std::vector<uint64_t>                 frames_;
+        std::vector<recording_block_index_t>  blocks_;
+        uint64_t                              blockStart_, blockEnd_;
+        const uint8_t*                        blockData_;
+        std::vector<uint8_t>                  block_;
+        compression_stats_t                   stats_;
+        std::string                           error_;
+    };
+
+}
+
+#endif // RECORDING_FORMAT_H
@@ -0,0 +1,577 @@
+#ifndef RECORDING_OPTIMIZER_H
+#define RECORDING_OPTIMIZER_H
+
+/**
+ * \file RecordingOptimizer.h
+ *
+ * \brief This file embodies a rewriter which removes redundant commands from the frames of a recording.
+ *
+ * This file embodies a rewriter which removes redundant commands from the frames of a recording. Every
+ * replay pays for whatever redundancy the tiler recorded: query commands whose answers were only used
+ * by the original client, scalers overwritten before the frame is latched, scalers set to the values
+ * they were already set to earlier in the frame, fills of the same coefficient matrix over neighbouring
+ * tiles, and runs of small scaler tile stacks. The optimizer simulates the scalers held by the coefficient
+ * planes so that each rewritten frame leaves the display in exactly the state the original frame did when
+ * it's latched. Nothing is assumed about the scalers a frame starts with, because the player can seek
+ * straight from frame 0 to any frame.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "CommandPool.h"
+#include "NddiCommands.h"
+#include "RecordingFormat.h"
+
+namespace nddi {
+
+    /** Maximum number of scaler cells simulated. Larger displays are rewritten without the scaler passes. */
+    #define OPTIMIZER_MAX_CELLS (64 * 1024 * 1024)
+
+    /** Maximum number of tiles batched into one FillScalerTiles, which keeps each request to the server small. */
+    #define OPTIMIZER_MAX_BATCH 4096
+
+    /**
+     * \brief Counts the commands and parts of commands removed by each optimization.
+     */
+    typedef struct {
+        size_t queries;           // Query commands dropped
+        size_t deadScalers;       // Scaler tiles and planes overwritten before the next latch
+        size_t redundantScalers;  // Scaler tiles and planes set to the values they were set to earlier in the frame
+        size_t mergedFills;       // FillCoefficientMatrix commands merged into their neighbour
+        size_t batchedTiles;      // FillScalerTiles and FillScalerTileStack commands saved by batching them
+    } optimizer_stats_t;
+
+    /**
+     * \brief Rewrites the frames of a recording into equivalent frames with fewer commands and bytes.
+     *
+     * Rewrites the frames of a recording into equivalent frames with fewer commands and bytes. Scalers are
+     * simulated on a grid of cells whose size is the greatest common divisor of every edge written by a
+     * scaler command, which Measure() finds in a first pass over the recording. Every scaler command then
+     * covers whole cells, so tracking one scaler per cell is exact.
+     */
+    class RecordingOptimizer {
+    public:
+        /**
+         * \brief Creates an optimizer for a display of the given size.
+         *
+         * Creates an optimizer for a display of the given size.
+         * @param width The width of the display.
+         * @param height The height of the display.
+         * @param planes The number of coefficient planes.
+         */
+        RecordingOptimizer(unsigned int width, unsigned int height, unsigned int planes)
+        : width_(width),
+          height_(height),
+          planes_(planes),
+          cellWidth_(0),
+          cellHeight_(0),
+          cellsWide_(0),
+          cellsHigh_(0),
+          simulated_(false),
+          generation_(1) {
+            memset(&stats_, 0, sizeof(stats_));
+        }
+
+        const optimizer_stats_t& Stats() { return stats_; }
+
+        /**
+         * \brief Reports whether scalers are simulated. They aren't when the cell grid would be too large.
+         */
+        bool IsSimulatingScalers() { return simulated_; }
+
+        /**
+         * \brief Narrows the cell grid so that the given command covers whole cells. Called for every command before Optimize().
+         */
+        void Measure(NddiCommandMessage* msg) {
+            switch (msg->id) {
+            case idFillScaler: {
+                FillScalerCommandMessage* fill = (FillScalerCommandMessage*)msg;
+                if ((fill->start.size() >= 2) && (fill->end.size() >= 2)) {
+                    measure(fill->start[0], fill->end[0] + 1, fill->start[1], fill->end[1] + 1);
+                }
+            }
+            break;
+            case idFillScalerTiles: {
+                FillScalerTilesCommandMessage* tiles = (FillScalerTilesCommandMessage*)msg;
+                if (tiles->size.size() >= 2) {
+                    for (size_t i = 0; i < tiles->starts.size(); i++) {
+                        if (tiles->starts[i].size() >= 2) {
+                            measure(tiles->starts[i][0], tiles->starts[i][0] + tiles->size[0],
+                                    tiles->starts[i][1], tiles->starts[i][1] + tiles->size[1]);
+                        }
+                    }
+                }
+            }
+            break;
+            case idFillScalerTileStack: {
+                FillScalerTileStackCommandMessage* stack = (FillScalerTileStackCommandMessage*)msg;
+                if ((stack->start.size() >= 2) && (stack->size.size() >= 2)) {
+                    measure(stack->start[0], stack->start[0] + stack->size[0],
+                            stack->start[1], stack->start[1] + stack->size[1]);
+                }
+            }
+            break;
+            default:
+                break;
+            }
+        }
+
+        /**
+         * \brief Rewrites a frame in place.
+         *
+         * Rewrites a frame in place. Commands which are removed or merged into another are deleted.
+         * @param frame The commands of one frame, ending with its Latch. Frames must be passed in order.
+         */
+        void Optimize(std::vector<NddiCommandMessage*> &frame) {
+            if (!cellsWide_) {
+                allocate();
+            }
+            if (simulated_) {
+                forget();
+                removeDeadScalers(frame);
+            }
+            removeRedundant(frame);
+            merge(frame);
+        }
+
+    private:
+        // A box of cells, with exclusive upper bounds.
+        typedef struct {
+            size_t x0, x1, y0, y1, z0, z1;
+        } cells_t;
+
+        static unsigned int gcd(unsigned int a, unsigned int b) {
+            while (b) {
+                unsigned int t = a % b;
+                a = b;
+                b = t;
+            }
+            return a;
+        }
+
+        void measure(unsigned int x0, unsigned int x1, unsigned int y0, unsigned int y1) {
+            // Edges at or beyond the display are clipped, so they don't constrain the grid
+            if (x0 < width_) { cellWidth_ = gcd(cellWidth_, x0); }
+            if (x1 < width_) { cellWidth_ = gcd(cellWidth_, x1); }
+            if (y0 < height_) { cellHeight_ = gcd(cellHeight_, y0); }
+            if (y1 < height_) { cellHeight_ = gcd(cellHeight_, y1); }
+        }
+
+        void allocate() {
+            if (!cellWidth_) { cellWidth_ = width_ ? width_ : 1; }
+            if (!cellHeight_) { cellHeight_ = height_ ? height_ : 1; }
+            cellsWide_ = (width_ + cellWidth_ - 1) / cellWidth_;
+            cellsHigh_ = (height_ + cellHeight_ - 1) / cellHeight_;
+            if (!cellsWide_) { cellsWide_ = 1; }
+
+            uint64_t cells = (uint64_t)cellsWide_ * cellsHigh_ * planes_;
+            if (cells && (cells <= OPTIMIZER_MAX_CELLS)) {
+                scalers_.resize(cells);
+                known_.resize(cells, 0);
+                covered_.resize(cells, 0);
+                simulated_ = true;
+            }
+        }
+
+        // Finds the cells covered by a box of pixels, clipped to the display. Returns false if none are.
+        bool cellsOf(const std::vector<unsigned int> &start, size_t x1, size_t y1, size_t z1, cells_t &c) {
+            if (start.size() < 3) {
+                return false;
+            }
+            if (x1 > width_) { x1 = width_; }
+            if (y1 > height_) { y1 = height_; }
+            if (z1 > planes_) { z1 = planes_; }
+            if ((start[0] >= x1) || (start[1] >= y1) || (start[2] >= z1)) {
+                return false;
+            }
+            c.x0 = start[0] / cellWidth_;
+            c.x1 = (x1 + cellWidth_ - 1) / cellWidth_;
+            c.y0 = start[1] / cellHeight_;
+            c.y1 = (y1 + cellHeight_ - 1) / cellHeight_;
+            c.z0 = start[2];
+            c.z1 = z1;
+            return true;
+        }
+
+        bool tileOf(const std::vector<unsigned int> &start, const std::vector<unsigned int> &size, size_t plane, cells_t &c) {
+            if ((start.size() < 3) || (size.size() < 2)) {
+                return false;
+            }
+            std::vector<unsigned int> s(start);
+            s[2] = plane;
+            return cellsOf(s, (size_t)start[0] + size[0], (size_t)start[1] + size[1], plane + 1, c);
+        }
+
+        size_t index(size_t x, size_t y, size_t z) {
+            return (z * cellsHigh_ + y) * cellsWide_ + x;
+        }
+
+        // Reports whether every cell is overwritten later in the frame, and marks them all as overwritten.
+        bool cover(const cells_t &c) {
+            bool dead = true;
+            for (size_t z = c.z0; z < c.z1; z++) {
+                for (size_t y = c.y0; y < c.y1; y++) {
+                    for (size_t x = c.x0; x < c.x1; x++) {
+                        size_t i = index(x, y, z);
+                        if (!covered_[i]) {
+                            covered_[i] = 1;
+                            touched_.push_back(i);
+                            dead = false;
+                        }
+                    }
+                }
+            }
+            return dead;
+        }
+
+        // Reports whether every cell already holds the scaler, and then sets them all to it.
+        bool set(const cells_t &c, uint64_t scaler) {
+            bool redundant = true;
+            for (size_t z = c.z0; z < c.z1; z++) {
+                for (size_t y = c.y0; y < c.y1; y++) {
+                    for (size_t x = c.x0; x < c.x1; x++) {
+                        size_t i = index(x, y, z);
+                        if ((known_[i] != generation_) || (scalers_[i] != scaler)) {
+                            redundant = false;
+                            scalers_[i] = scaler;
+                            known_[i] = generation_;
+                        }
+                    }
+                }
+            }
+            return redundant;
+        }
+
+        // Forgets every scaler, at the start of each frame and for commands whose effect on them can't be simulated.
+        void forget() {
+            if (++generation_ == 0) {
+                memset(known_.data(), 0, known_.size() * sizeof(uint32_t));
+                generation_ = 1;
+            }
+        }
+
+        // Keeps the planes of a stack between the first and last which weren't flagged.
+        static size_t trimStack(FillScalerTileStackCommandMessage* stack, const std::vector<bool> &flagged) {
+            size_t first = 0;
+            size_t last = flagged.size();
+            while ((first < last) && flagged[first]) { first++; }
+            while ((last > first) && flagged[last - 1]) { last--; }
+            stack->scalers.resize(last);
+            stack->scalers.erase(stack->scalers.begin(), stack->scalers.begin() + first);
+            stack->start[2] += first;
+            return flagged.size() - stack->scalers.size();
+        }
+
+        // Keeps the tiles which weren't flagged.
+        static size_t pruneTiles(FillScalerTilesCommandMessage* tiles, const std::vector<bool> &flagged) {
+            size_t kept = 0;
+            for (size_t i = 0; i < flagged.size(); i++) {
+                if (!flagged[i]) {
+                    tiles->scalers[kept] = tiles->scalers[i];
+                    tiles->starts[kept].swap(tiles->starts[i]);
+                    kept++;
+                }
+            }
+            tiles->scalers.resize(kept);
+            tiles->starts.resize(kept);
+            return flagged.size() - kept;
+        }
+
+        static void drop(std::vector<NddiCommandMessage*> &frame, size_t i) {
+            deleteCommand(frame[i]);
+            frame[i] = NULL;
+        }
+
+        static void compact(std::vector<NddiCommandMessage*> &frame) {
+            size_t kept = 0;
+            for (size_t i = 0; i < frame.size(); i++) {
+                if (frame[i]) {
+                    frame[kept++] = frame[i];
+                }
+            }
+            frame.resize(kept);
+        }
+
+        /*
+         * Walks the frame backwards, dropping scaler writes to cells which a later command in the frame
+         * overwrites. Nothing reads the scalers until the frame is latched, so those writes are never seen.
+         */
+        void removeDeadScalers(std::vector<NddiCommandMessage*> &frame) {
+            cells_t c;
+            for (size_t i = frame.size(); i-- > 0; ) {
+                switch (frame[i]->id) {
+                case idFillScaler: {
+                    FillScalerCommandMessage* fill = (FillScalerCommandMessage*)frame[i];
+                    if ((fill->end.size() >= 3) &&
+                        cellsOf(fill->start, (size_t)fill->end[0] + 1, (size_t)fill->end[1] + 1, (size_t)fill->end[2] + 1, c) &&
+                        cover(c)) {
+                        stats_.deadScalers++;
+                        drop(frame, i);
+                    }
+                }
+                break;
+                case idFillScalerTiles: {
+                    FillScalerTilesCommandMessage* tiles = (FillScalerTilesCommandMessage*)frame[i];
+                    std::vector<bool> dead(tiles->starts.size(), false);
+                    for (size_t t = dead.size(); t-- > 0; ) {
+                        dead[t] = (tiles->starts[t].size() >= 3) && tileOf(tiles->starts[t], tiles->size, tiles->starts[t][2], c) && cover(c);
+                    }
+                    stats_.deadScalers += pruneTiles(tiles, dead);
+                    if (tiles->starts.empty()) {
+                        drop(frame, i);
+                    }
+                }
+                break;
+                case idFillScalerTileStack: {
+                    FillScalerTileStackCommandMessage* stack = (FillScalerTileStackCommandMessage*)frame[i];
+                    if (stack->start.size() < 3) {
+                        break;
+                    }
+                    std::vector<bool> dead(stack->scalers.size(), false);
+                    for (size_t p = 0; p < dead.size(); p++) {
+                        dead[p] = tileOf(stack->start, stack->size, stack->start[2] + p, c) && cover(c);
+                    }
+                    stats_.deadScalers += trimStack(stack, dead);
+                    if (stack->scalers.empty()) {
+                        drop(frame, i);
+                    }
+                }
+                break;
+                default:
+                    break;
+                }
+            }
+            compact(frame);
+
+            for (size_t i = 0; i < touched_.size(); i++) {
+                covered_[touched_[i]] = 0;
+            }
+            touched_.clear();
+        }
+
+        /*
+         * Walks the frame forwards, dropping query commands and scaler writes which don't change the
+         * simulated scalers.
+         */
+        void removeRedundant(std::vector<NddiCommandMessage*> &frame) {
+            cells_t c;
+            for (size_t i = 0; i < frame.size(); i++) {
+                switch (frame[i]->id) {
+                case idInit:
+                    if (simulated_) {
+                        forget();
+                    }
+                    break;
+                case idDisplayWidth:
+                case idDisplayHeight:
+                case idNumCoefficientPlanes:
+                case idGetFullScaler:
+                    stats_.queries++;
+                    drop(frame, i);
+                    break;
+                case idFillScaler: {
+                    if (!simulated_) {
+                        break;
+                    }
+                    FillScalerCommandMessage* fill = (FillScalerCommandMessage*)frame[i];
+                    if ((fill->end.size() < 3) ||
+                        !cellsOf(fill->start, (size_t)fill->end[0] + 1, (size_t)fill->end[1] + 1, (size_t)fill->end[2] + 1, c)) {
+                        forget();
+                    } else if (set(c, fill->scaler.packed)) {
+                        stats_.redundantScalers++;
+                        drop(frame, i);
+                    }
+                }
+                break;
+                case idFillScalerTiles: {
+                    if (!simulated_) {
+                        break;
+                    }
+                    FillScalerTilesCommandMessage* tiles = (FillScalerTilesCommandMessage*)frame[i];
+                    std::vector<bool> redundant(tiles->starts.size(), false);
+                    for (size_t t = 0; t < redundant.size(); t++) {
+                        if ((tiles->starts[t].size() < 3) || !tileOf(tiles->starts[t], tiles->size, tiles->starts[t][2], c)) {
+                            forget();
+                        } else {
+                            redundant[t] = set(c, tiles->scalers[t]);
+                        }
+                    }
+                    stats_.redundantScalers += pruneTiles(tiles, redundant);
+                    if (tiles->starts.empty()) {
+                        drop(frame, i);
+                    }
+                }
+                break;
+                case idFillScalerTileStack: {
+                    if (!simulated_) {
+                        break;
+                    }
+                    FillScalerTileStackCommandMessage* stack = (FillScalerTileStackCommandMessage*)frame[i];
+                    if (stack->start.size() < 3) {
+                        forget();
+                        break;
+                    }
+                    std::vector<bool> redundant(stack->scalers.size(), false);
+                    for (size_t p = 0; p < redundant.size(); p++) {
+                        if (!tileOf(stack->start, stack->size, stack->start[2] + p, c)) {
+                            forget();
+                        } else {
+                            redundant[p] = set(c, stack->scalers[p]);
+                        }
+                    }
+                    stats_.redundantScalers += trimStack(stack, redundant);
+                    if (stack->scalers.empty()) {
+                        drop(frame, i);
+                    }
+                }
+                break;
+                default:
+                    break;
+                }
+            }
+            compact(frame);
+        }
+
+        // Extends the fill a to cover the neighbouring fill b if both fill the same matrix and together form a box.
+        static bool mergeFills(FillCoefficientMatrixCommandMessage* a, FillCoefficientMatrixCommandMessage* b) {
+            if ((a->start.size() != 3) || (a->end.size() != 3) || (b->start.size() != 3) || (b->end.size() != 3) ||
+                (a->coefficientMatrix != b->coefficientMatrix)) {
+                return false;
+            }
+            for (size_t d = 0; d < 3; d++) {
+                bool adjacent = (b->start[d] == a->end[d] + 1);
+                for (size_t o = 0; adjacent && (o < 3); o++) {
+                    if ((o != d) && ((a->start[o] != b->start[o]) || (a->end[o] != b->end[o]))) {
+                        adjacent = false;
+                    }
+                }
+                if (adjacent) {
+                    a->end[d] = b->end[d];
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /*
+         * Bytes cereal's binary archive spends on a record holding a FillScalerTiles with the given number of
+         * tiles or a FillScalerTileStack of the given height. Vectors are written as a 64-bit length followed
+         * by their elements, and coordinates and tile sizes have three and two elements.
+         */
+        static size_t tilesBytes(size_t tiles) {
+            return sizeof(recording_record_t) + sizeof(uint64_t) +
+                   sizeof(uint64_t) + tiles * sizeof(uint64_t) +
+                   sizeof(uint64_t) + tiles * (sizeof(uint64_t) + 3 * sizeof(unsigned int)) +
+                   sizeof(uint64_t) + 2 * sizeof(unsigned int);
+        }
+
+        static size_t stackBytes(size_t height) {
+            return sizeof(recording_record_t) + sizeof(uint64_t) +
+                   sizeof(uint64_t) + height * sizeof(uint64_t) +
+                   sizeof(uint64_t) + 3 * sizeof(unsigned int) +
+                   sizeof(uint64_t) + 2 * sizeof(unsigned int);
+        }
+
+        // Appends a stack's planes to a batch of tiles.
+        static void appendStack(FillScalerTilesCommandMessage* tiles, FillScalerTileStackCommandMessage* stack) {
+            std::vector<unsigned int> start(stack->start);
+            for (size_t p = 0; p < stack->scalers.size(); p++) {
+                tiles->scalers.push_back(stack->scalers[p]);
+                start[2] = stack->start[2] + p;
+                tiles->starts.push_back(start);
+            }
+        }
+
+        /*
+         * Merges neighbouring commands. Fills of the same coefficient matrix over adjacent boxes become one
+         * fill, and consecutive scaler tiles and short scaler tile stacks of the same size become one batch
+         * of tiles whenever that takes fewer bytes. Only consecutive commands are merged, so the order in
+         * which the display applies them is unchanged.
+         */
+        void merge(std::vector<NddiCommandMessage*> &frame) {
+            size_t kept = 0;
+            for (size_t i = 0; i < frame.size(); i++) {
+                NddiCommandMessage* msg = frame[i];
+                NddiCommandMessage* last = kept ? frame[kept - 1] : NULL;
+
+                if (last && (msg->id == idFillCoefficientMatrix) && (last->id == idFillCoefficientMatrix) &&
+                    mergeFills((FillCoefficientMatrixCommandMessage*)last, (FillCoefficientMatrixCommandMessage*)msg)) {
+                    stats_.mergedFills++;
+                    deleteCommand(msg);
+                    // A finished row of tiles may now complete a box with the row before it
+                    while ((kept > 1) && (frame[kept - 2]->id == idFillCoefficientMatrix) &&
+                           mergeFills((FillCoefficientMatrixCommandMessage*)frame[kept - 2],
+                                      (FillCoefficientMatrixCommandMessage*)frame[kept - 1])) {
+                        stats_.mergedFills++;
+                        deleteCommand(frame[--kept]);
+                    }
+                    continue;
+                }
+
+                if (last && (msg->id == idFillScalerTiles) && (last->id == idFillScalerTiles) &&
+                    (((FillScalerTilesCommandMessage*)msg)->size == ((FillScalerTilesCommandMessage*)last)->size) &&
+                    (((FillScalerTilesCommandMessage*)last)->starts.size() + ((FillScalerTilesCommandMessage*)msg)->starts.size() <= OPTIMIZER_MAX_BATCH)) {
+                    FillScalerTilesCommandMessage* tiles = (FillScalerTilesCommandMessage*)last;
+                    FillScalerTilesCommandMessage* next = (FillScalerTilesCommandMessage*)msg;
+                    tiles->scalers.insert(tiles->scalers.end(), next->scalers.begin(), next->scalers.end());
+                    tiles->starts.insert(tiles->starts.end(), next->starts.begin(), next->starts.end());
+                    stats_.batchedTiles++;
+                    deleteCommand(msg);
+                    continue;
+                }
+
+                if (last && (msg->id == idFillScalerTileStack) && (((FillScalerTileStackCommandMessage*)msg)->start.size() == 3)) {
+                    FillScalerTileStackCommandMessage* stack = (FillScalerTileStackCommandMessage*)msg;
+                    size_t height = stack->scalers.size();
+
+                    // Joining a batch costs the tiles' bytes, and saves the stack's record
+                    if ((last->id == idFillScalerTiles) && (((FillScalerTilesCommandMessage*)last)->size == stack->size) &&
+                        (((FillScalerTilesCommandMessage*)last)->starts.size() + height <= OPTIMIZER_MAX_BATCH) &&
+                        (tilesBytes(height) - tilesBytes(0) < stackBytes(height))) {
+                        appendStack((FillScalerTilesCommandMessage*)last, stack);
+                        stats_.batchedTiles++;
+                        deleteCommand(msg);
+                        continue;
+                    }
+
+                    // Two stacks can start a batch when one record of tiles beats both stacks
+                    if (last->id == idFillScalerTileStack) {
+                        FillScalerTileStackCommandMessage* previous = (FillScalerTileStackCommandMessage*)last;
+                        if ((previous->start.size() == 3) && (previous->size == stack->size) &&
+                            (tilesBytes(previous->scalers.size() + height) < stackBytes(previous->scalers.size()) + stackBytes(height))) {
+                            FillScalerTilesCommandMessage* tiles = new FillScalerTilesCommandMessage();
+                            tiles->timestamp = previous->timestamp;
+                            tiles->size = stack->size;
+                            appendStack(tiles, previous);
+                            appendStack(tiles, stack);
+                            frame[kept - 1] = tiles;
+                            stats_.batchedTiles++;
+                            deleteCommand(previous);
+                            deleteCommand(msg);
+                            continue;
+                        }
+                    }
+                }
+
+                frame[kept++] = msg;
+            }
+            frame.resize(kept);
+        }
+
+        unsigned int            width_, height_, planes_;
+        unsigned int            cellWidth_, cellHeight_;
+        size_t                  cellsWide_, cellsHigh_;
+        bool                    simulated_;
+        std::vector<uint64_t>   scalers_;
+        std::vector<uint32_t>   known_;       // Scalers are known when stamped with the current generation
+        uint32_t                generation_;
+        std::vector<uint8_t>    covered_;
+        std::vector<size_t>     touched_;
+        optimizer_stats_t       stats_;
+    };
+
+}
+
+#endif // RECORDING_OPTIMIZER_H
@@ -4,6 +4,7 @@
 #include "PixelBridgeFeatures.h"
 #include "Configuration.h"
 #include "ScaledDctTiler.h"
+#include "PixelConvert.h"
 
 #define PI    3.14159265
 #define PI_8  0.392699081
@@ -97,6 +98,7 @@ ScaledDctTiler::ScaledDctTiler(size_t display_width, size_t display_height, size
             display_ = new GrpcNddiDisplay();
         }
     }
+    handoff_.Attach(display_);
 
     /* Set the full scaler value and the sign mode */
     display_->SetFullScaler(MAX_DCT_COEFF);
@@ -108,6 +110,7 @@ ScaledDctTiler::ScaledDctTiler(size_t display_width, size_t display_height, size
      */
     initZigZag();
     initQuantizationMatrix(quality);
+    registerScalerQuantizer(file);
 
     /* Initialize Input Vector */
     vector<int> iv;
@@ -121,6 +124,51 @@ ScaledDctTiler::ScaledDctTiler(size_t display_width, size_t display_height, size
     InitializeFrameVolume();
 }
 
+/*
+ * Registers a quantizer for the planes of each scale, so that stacks which start part way into a scale's planes
+ * are divided by the right entries of the quantization matrix. Only the GrpcNddiDisplay sends stacks that way.
+ */
+void ScaledDctTiler::registerScalerQuantizer(string file) {
+    if (file.length() || !globalConfiguration.scalerQuantization) {
+        return;
+    }
+
+    for (size_t c = 0; c < globalConfiguration.dctScales.size(); c++) {
+        registerScaleQuantizer(quantizationMatrix_, c);
+    }
+}
+
+/*
+ * Registers the entries of the quantization matrix for the coefficients SelectCoefficientsForScale() keeps for
+ * a scale, in the order they're placed in the scale's planes.
+ */
+void ScaledDctTiler::registerScaleQuantizer(const uint8_t* matrix, size_t c) {
+    scale_config_t config = globalConfiguration.dctScales[c];
+    vector<uint32_t> divisors;
+
+#ifdef SIMPLE_TRUNCATION
+    bool truncated = true;
+#else
+    bool truncated = (config.edge_length == 8);
+#endif
+    if (truncated) {
+        divisors.resize(config.plane_count, 1);
+        for (size_t matPos = 0; matPos < BLOCK_SIZE; matPos++) {
+            if ((size_t)zigZag_[matPos] < config.plane_count) {
+                divisors[zigZag_[matPos]] = matrix[matPos];
+            }
+        }
+    } else {
+        for (size_t y = 0; y < config.edge_length && divisors.size() < config.plane_count; y++) {
+            for (size_t x = 0; x < config.edge_length && divisors.size() < config.plane_count; x++) {
+                divisors.push_back(matrix[y * BLOCK_WIDTH + x]);
+            }
+        }
+    }
+
+    ((GrpcNddiDisplay*)display_)->RegisterScalerQuantizer(divisors, config.first_plane_idx);
+}
+
 /**
  * Initializes the Coefficient Planes for this tiler. The coefficient matrices
  * for each plane will pick a plane from the frame volume.
@@ -227,13 +275,13 @@ void ScaledDctTiler::InitializeCoefficientPlanes() {
  */
 int16_t* ScaledDctTiler::ConvertToSignedPixels(uint8_t* buffer, size_t width, size_t height) {
 
-    int16_t* signedBuf = (int16_t*)calloc(width * height * 3, sizeof(int16_t));
+    int16_t* signedBuf = (int16_t*)malloc(width * height * 3 * sizeof(int16_t));
 
 #ifdef USE_OMP
 #pragma omp parallel for
 #endif
-    for (size_t i = 0; i < (width * height * 3); i++) {
-        signedBuf[i] = (int16_t)buffer[i];
+    for (size_t j = 0; j < height; j++) {
+        rgbToSigned(buffer + j * width * 3, signedBuf + j * width * 3, width * 3);
     }
 
     return signedBuf;
@@ -913,7 +961,7 @@ void ScaledDctTiler::ZeroPlanes(vector< vector< vector<uint64_t> > > &coefficien
  * the display. e.g. Given an 8x8 macroblock, a macroblock location (i, j) of (2, 1) and a factor of
  * 4: the region of the display that will be updated is from (64, 32) to (95, 63) inclusive.
  *
- * @param coefficients The vector (in zig-zag order) of coefficients for the macroblock
+ * @param coefficients The vector (in zig-zag order) of coefficients for the macroblock, which is handed to the display
  * @param i The column component of the macroblock
  * @param j The row component of the macroblock
  * @param c Index into globalConfiguration.dctScales for information about the factor by
@@ -935,7 +983,7 @@ void ScaledDctTiler::FillCoefficients(vector<uint64_t> &coefficients, size_t i,
 
     /* If any any coefficients have changed, send the NDDI command to update them */
     if (start[2] < display_->NumCoefficientPlanes()) {
-        display_->FillScalerTileStack(coefficients, start, size);
+        handoff_.FillScalerTileStack(std::move(coefficients), start, size);
     }
 }
 
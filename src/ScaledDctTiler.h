@@ -55,6 +55,8 @@ private:
 
 protected:
     void InitializeCoefficientPlanes();
+    void registerScalerQuantizer(string file);
+    void registerScaleQuantizer(const uint8_t* matrix, size_t c);
     int16_t* ConvertToSignedPixels(uint8_t* buffer, size_t width, size_t height);
     vector<uint64_t> BuildCoefficients(size_t i, size_t j, int16_t* buffer, size_t width, size_t height, bool adjustPixels);
     void SelectCoefficientsForScale(vector<uint64_t> &coefficients, size_t c);
@@ -0,0 +1,170 @@
+#ifndef SCROLL_DETECTOR_H
+#define SCROLL_DETECTOR_H
+
+/**
+ * \file ScrollDetector.h
+ *
+ * \brief This file embodies the detection of regions of a frame which scrolled since the last frame.
+ *
+ * This file embodies the detection of regions of a frame which scrolled since the last frame. A band of rows
+ * is reduced to one hash per column, both for what's on the display and for the new frame. A ticker that
+ * scrolled d pixels to the left then shows up as a run of columns where the new frame's hash at i equals the
+ * display's hash at i + d. The shifts worth trying are voted on by a sample of the columns which changed, and
+ * the best run for each of the winning shifts is then found by walking the columns once.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+namespace nddi {
+
+    /**
+     * \brief A run of positions which moved by the same amount.
+     */
+    typedef struct {
+        int         shift;      // The new frame at position i shows what was at i + shift
+        size_t      first;      // The first position of the run in the new frame
+        size_t      last;       // The last position of the run in the new frame
+    } scroll_t;
+
+    /**
+     * \brief Hashes each column of a band of RGB24 rows.
+     *
+     * Hashes each column of a band of RGB24 rows. The rows are walked in order so that the buffer is read
+     * sequentially.
+     * @param buffer The first byte of the band.
+     * @param stride The bytes from one row of the buffer to the next.
+     * @param columns The number of columns in the band.
+     * @param rows The number of rows in the band.
+     * @param hashes Receives one hash per column.
+     */
+    static inline void columnHashes(const uint8_t* buffer, size_t stride, size_t columns, size_t rows,
+                                    std::vector<uint64_t> &hashes) {
+        hashes.assign(columns, 14695981039346656037ULL);
+        for (size_t y = 0; y < rows; y++, buffer += stride) {
+            const uint8_t* p = buffer;
+            for (size_t x = 0; x < columns; x++, p += 3) {
+                uint64_t v = (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16);
+                hashes[x] = (hashes[x] ^ v) * 1099511628211ULL;
+            }
+        }
+    }
+
+    /**
+     * \brief Finds the longest run of positions that scrolled by the same amount between two lists of hashes.
+     */
+    class ScrollDetector {
+
+    public:
+        /**
+         * \brief Creates a detector for scrolling by up to max_shift positions.
+         *
+         * Creates a detector for scrolling by up to max_shift positions.
+         * @param max_shift The largest shift in either direction which is looked for.
+         * @param min_run The fewest positions a run must cover to be reported.
+         */
+        ScrollDetector(size_t max_shift, size_t min_run)
+        : max_shift_((int)max_shift),
+          min_run_(min_run ? min_run : 1),
+          votes_(2 * max_shift + 1) {
+        }
+
+        /**
+         * \brief Finds the best run of positions which scrolled.
+         *
+         * Finds the best run of positions which scrolled. The best run is the one with the most positions that
+         * changed, as opposed to positions like a plain background which match whatever the shift. At least a
+         * quarter of the run must have changed.
+         * @param before The hashes of what's on the display.
+         * @param after The hashes of the new frame.
+         * @param scroll Receives the run.
+         * @return Whether a run was found.
+         */
+        bool Find(const std::vector<uint64_t> &before, const std::vector<uint64_t> &after, scroll_t &scroll) {
+            size_t n = after.size();
+            if ((before.size() != n) || (n < min_run_) || (max_shift_ == 0)) {
+                return false;
+            }
+
+            // Vote on the shifts with a sample of the positions which changed
+            std::fill(votes_.begin(), votes_.end(), 0);
+            size_t changed = 0;
+            for (size_t i = 0; i < n; i++) {
+                if (after[i] == before[i]) {
+                    continue;
+                }
+                if ((changed++ % SAMPLE_INTERVAL) != 0) {
+                    continue;
+                }
+                for (int d = -max_shift_; d <= max_shift_; d++) {
+                    if (d && ((int)i + d >= 0) && ((int)i + d < (int)n) && (after[i] == before[i + d])) {
+                        votes_[d + max_shift_]++;
+                    }
+                }
+            }
+            if (changed < min_run_ / 4) {
+                return false;
+            }
+
+            // Walk the runs of the shifts with the most votes
+            bool found = false;
+            size_t best_score = 0;
+            for (size_t c = 0; c < CANDIDATES; c++) {
+                size_t most = 0;
+                int d = 0;
+                for (int k = -max_shift_; k <= max_shift_; k++) {
+                    if (votes_[k + max_shift_] > most) {
+                        most = votes_[k + max_shift_];
+                        d = k;
+                    }
+                }
+                if (!most) {
+                    break;
+                }
+                votes_[d + max_shift_] = 0;
+
+                size_t start = 0, moved = 0;
+                bool in_run = false;
+                for (size_t i = 0; i <= n; i++) {
+                    bool match = (i < n) && ((int)i + d >= 0) && ((int)i + d < (int)n) && (after[i] == before[i + d]);
+                    if (match) {
+                        if (!in_run) {
+                            in_run = true;
+                            start = i;
+                            moved = 0;
+                        }
+                        if (after[i] != before[i]) {
+                            moved++;
+                        }
+                    } else if (in_run) {
+                        in_run = false;
+                        size_t length = i - start;
+                        if ((length >= min_run_) && (moved * 4 >= length) && (moved > best_score)) {
+                            best_score = moved;
+                            scroll.shift = d;
+                            scroll.first = start;
+                            scroll.last = i - 1;
+                            found = true;
+                        }
+                    }
+                }
+            }
+
+            return found;
+        }
+
+    private:
+        // Every SAMPLE_INTERVAL'th changed position votes, and the CANDIDATES shifts with the most votes are walked
+        static const size_t SAMPLE_INTERVAL = 8;
+        static const size_t CANDIDATES = 2;
+
+        int                 max_shift_;
+        size_t              min_run_;
+        std::vector<size_t> votes_;
+    };
+
+} // namespace nddi
+
+#endif // SCROLL_DETECTOR_H
@@ -0,0 +1,195 @@
+#ifndef SHARED_MEMORY_RING_H
+#define SHARED_MEMORY_RING_H
+
+/**
+ * \file SharedMemoryRing.h
+ *
+ * \brief This file embodies a POSIX shared memory ring used to pass bulk payloads to a local NDDI Wall Server.
+ *
+ * This file embodies a POSIX shared memory ring used to pass bulk payloads to a local NDDI Wall Server.
+ * The client creates the ring and writes pixel and scaler payloads into it, then sends only the offset
+ * and length over gRPC. The server maps the same segment read-only and hands pointers into it straight
+ * to the display.
+ */
+
+#include <deque>
+#include <fcntl.h>
+#include <sstream>
+#include <stdint.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace nddi {
+
+    /**
+     * \brief Ring buffer over a POSIX shared memory segment.
+     *
+     * Ring buffer over a POSIX shared memory segment. Space is reserved by the client as payloads are
+     * sent, and each Latch marks everything reserved so far with the latch's sequence number. Once the
+     * server has acknowledged a latch, Release() frees the space used up to and including that latch.
+     */
+    class SharedMemoryRing {
+    public:
+        /**
+         * \brief Creates a new segment of the given size. Used by the client.
+         *
+         * Creates a new segment of the given size. Used by the client. The segment is unlinked
+         * when the ring is destroyed.
+         * @param size The size of the ring in bytes.
+         */
+        SharedMemoryRing(size_t size)
+        : size_(size),
+          owner_(true),
+          base_(NULL),
+          head_(0),
+          tail_(0) {
+            static unsigned int count = 0;
+            std::stringstream ss;
+            ss << "/nddiwall-" << getpid() << "-" << count++;
+            name_ = ss.str();
+
+            int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+            if (fd < 0) {
+                return;
+            }
+            if (ftruncate(fd, size_) == 0) {
+                void* base = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if (base != MAP_FAILED) {
+                    base_ = (uint8_t*)base;
+                }
+            }
+            close(fd);
+            if (!base_) {
+                shm_unlink(name_.c_str());
+            }
+        }
+
+        /**
+         * \brief Maps an existing segment read-only. Used by the server.
+         *
+         * Maps an existing segment read-only. Used by the server. The segment isn't mapped unless it's exactly
+         * the given size, since reading past the end of a shorter segment would raise SIGBUS.
+         * @param name The name of the segment created by the client.
+         * @param size The size of the ring in bytes.
+         */
+        SharedMemoryRing(std::string name, size_t size)
+        : name_(name),
+          size_(size),
+          owner_(false),
+          base_(NULL),
+          head_(0),
+          tail_(0) {
+            int fd = shm_open(name_.c_str(), O_RDONLY, 0);
+            if (fd < 0) {
+                return;
+            }
+            struct stat st;
+            if ((fstat(fd, &st) == 0) && size_ && (st.st_size >= 0) && ((uint64_t)st.st_size == size_)) {
+                void* base = mmap(NULL, size_, PROT_READ, MAP_SHARED, fd, 0);
+                if (base != MAP_FAILED) {
+                    base_ = (uint8_t*)base;
+                }
+            }
+            close(fd);
+        }
+
+        ~SharedMemoryRing() {
+            if (base_) {
+                munmap(base_, size_);
+                if (owner_) {
+                    shm_unlink(name_.c_str());
+                }
+            }
+        }
+
+        bool IsMapped() { return base_ != NULL; }
+        std::string Name() { return name_; }
+        size_t Size() { return size_; }
+
+        /**
+         * \brief Returns a pointer into the segment for the given offset.
+         *
+         * Returns a pointer into the segment for the given offset.
+         * @param offset Offset previously returned by Reserve().
+         * @param length The length of the payload, used to bounds check offsets received by the server.
+         * @return The pointer or NULL if the payload doesn't lie within the segment.
+         */
+        uint8_t* At(uint64_t offset, uint64_t length) {
+            if (!base_ || (offset > size_) || (length > size_ - offset)) {
+                return NULL;
+            }
+            return base_ + offset;
+        }
+
+        /**
+         * \brief Reserves a contiguous region of the ring.
+         *
+         * Reserves a contiguous region of the ring. When the region doesn't fit before the end of the
+         * segment, the remainder is skipped and the region starts back at the beginning.
+         * @param length The number of bytes needed.
+         * @param offset Set to the offset of the reserved region.
+         * @return False if the unreleased payloads leave too little room, in which case the caller
+         *         should send the payload inline.
+         */
+        bool Reserve(uint64_t length, uint64_t &offset) {
+            if (!base_ || !owner_ || !length || (length > size_)) {
+                return false;
+            }
+
+            uint64_t position = head_ % size_;
+            uint64_t skip = (position + length > size_) ? size_ - position : 0;
+            if (head_ + skip + length - tail_ > size_) {
+                return false;
+            }
+
+            offset = (head_ + skip) % size_;
+            head_ += skip + length;
+
+            return true;
+        }
+
+        /**
+         * \brief Marks every region reserved so far as belonging to the latch with the given sequence number.
+         *
+         * Marks every region reserved so far as belonging to the latch with the given sequence number.
+         * @param sequence The sequence number of the latch.
+         */
+        void Latch(uint64_t sequence) {
+            if (latches_.empty() || (latches_.back().head != head_)) {
+                latch_t latch = { sequence, head_ };
+                latches_.push_back(latch);
+            }
+        }
+
+        /**
+         * \brief Frees the regions belonging to latches up to and including the given sequence number.
+         *
+         * Frees the regions belonging to latches up to and including the given sequence number.
+         * @param sequence The sequence number of the last latch acknowledged by the server.
+         */
+        void Release(uint64_t sequence) {
+            while (!latches_.empty() && (latches_.front().sequence <= sequence)) {
+                tail_ = latches_.front().head;
+                latches_.pop_front();
+            }
+        }
+
+    private:
+        typedef struct {
+            uint64_t sequence;
+            uint64_t head;
+        } latch_t;
+
+        std::string          name_;
+        size_t               size_;
+        bool                 owner_;
+        uint8_t*             base_;
+        uint64_t             head_, tail_;
+        std::deque<latch_t>  latches_;
+    };
+
+}
+
+#endif // SHARED_MEMORY_RING_H
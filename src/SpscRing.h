@@ -0,0 +1,215 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+/**
+ * \file SpscRing.h
+ *
+ * \brief This file embodies a bounded single-producer/single-consumer ring used between recorder and player threads.
+ *
+ * This file embodies a bounded single-producer/single-consumer ring used between recorder and player threads.
+ * The producer and consumer only touch their own index in the common case, so neither takes a lock. When the
+ * ring is full or empty, the blocked side spins briefly and then sleeps on a condition variable until the
+ * other side makes room or publishes an item. The fixed capacity provides backpressure, so a producer which
+ * outpaces the consumer is throttled instead of growing memory without bound.
+ */
+
+#include <atomic>
+#include <pthread.h>
+#include <stddef.h>
+#include <vector>
+
+namespace nddi {
+
+    /** Number of times a blocked side polls the ring before sleeping. */
+    #define SPSC_SPIN_COUNT 256
+
+    /**
+     * \brief Bounded single-producer/single-consumer ring.
+     *
+     * Bounded single-producer/single-consumer ring. Exactly one thread may call Push(), TryPush() and
+     * Close(), and exactly one thread may call Pop() and TryPop().
+     */
+    template <class T>
+    class SpscRing {
+    public:
+        /**
+         * \brief Creates a ring holding up to the given number of items.
+         *
+         * Creates a ring holding up to the given number of items.
+         * @param capacity The capacity, which is rounded up to a power of two.
+         */
+        SpscRing(size_t capacity)
+        : head_(0),
+          tail_(0),
+          closed_(false),
+          producerWaiting_(false),
+          consumerWaiting_(false),
+          fullStalls_(0),
+          emptyStalls_(0) {
+            size_t size = 2;
+            while (size < capacity) { size <<= 1; }
+            slots_.resize(size);
+            mask_ = size - 1;
+            pthread_mutex_init(&mutex_, NULL);
+            pthread_cond_init(&notFull_, NULL);
+            pthread_cond_init(&notEmpty_, NULL);
+        }
+
+        ~SpscRing() {
+            pthread_cond_destroy(&notEmpty_);
+            pthread_cond_destroy(&notFull_);
+            pthread_mutex_destroy(&mutex_);
+        }
+
+        /**
+         * \brief Publishes an item, blocking while the ring is full.
+         *
+         * Publishes an item, blocking while the ring is full.
+         * @param item The item.
+         * @return False if the ring was closed, in which case the item wasn't published.
+         */
+        bool Push(const T &item) {
+            size_t tail = tail_.load(std::memory_order_relaxed);
+            if (!waitFor(true, tail)) {
+                return false;
+            }
+            publish(tail, item);
+            return true;
+        }
+
+        /**
+         * \brief Publishes an item if there's room, without blocking.
+         *
+         * Publishes an item if there's room, without blocking.
+         * @param item The item.
+         * @return False if the ring is full or closed, in which case the item wasn't published.
+         */
+        bool TryPush(const T &item) {
+            size_t tail = tail_.load(std::memory_order_relaxed);
+            if (!ready(true, tail) || closed_.load(std::memory_order_acquire)) {
+                return false;
+            }
+            publish(tail, item);
+            return true;
+        }
+
+        /**
+         * \brief Takes the oldest item, blocking while the ring is empty.
+         *
+         * Takes the oldest item, blocking while the ring is empty.
+         * @param item Set to the item.
+         * @return False once the ring has been closed and drained.
+         */
+        bool Pop(T &item) {
+            size_t head = head_.load(std::memory_order_relaxed);
+            if (!waitFor(false, head)) {
+                return false;
+            }
+            take(head, item);
+            return true;
+        }
+
+        /**
+         * \brief Takes the oldest item if there is one, without blocking.
+         *
+         * Takes the oldest item if there is one, without blocking.
+         * @param item Set to the item.
+         * @return False if the ring is empty.
+         */
+        bool TryPop(T &item) {
+            size_t head = head_.load(std::memory_order_relaxed);
+            if (!ready(false, head)) {
+                return false;
+            }
+            take(head, item);
+            return true;
+        }
+
+        /**
+         * \brief Marks the end of the stream, waking both sides.
+         *
+         * Marks the end of the stream, waking both sides. Items already published can still be popped.
+         */
+        void Close() {
+            pthread_mutex_lock(&mutex_);
+            closed_.store(true, std::memory_order_seq_cst);
+            pthread_cond_broadcast(&notEmpty_);
+            pthread_cond_broadcast(&notFull_);
+            pthread_mutex_unlock(&mutex_);
+        }
+
+        /** Number of times the producer had to sleep because the ring was full. */
+        size_t FullStalls() { return fullStalls_; }
+
+        /** Number of times the consumer had to sleep because the ring was empty. */
+        size_t EmptyStalls() { return emptyStalls_; }
+
+    private:
+        void publish(size_t tail, const T &item) {
+            slots_[tail & mask_] = item;
+            tail_.store(tail + 1, std::memory_order_seq_cst);
+            wake(consumerWaiting_, notEmpty_);
+        }
+
+        void take(size_t head, T &item) {
+            item = slots_[head & mask_];
+            head_.store(head + 1, std::memory_order_seq_cst);
+            wake(producerWaiting_, notFull_);
+        }
+
+        // Checks whether the producer can push at tail or the consumer can pop at head.
+        bool ready(bool producer, size_t index) {
+            if (producer) {
+                return index - head_.load(std::memory_order_seq_cst) <= mask_;
+            }
+            return tail_.load(std::memory_order_seq_cst) != index;
+        }
+
+        // Spins and then sleeps until ready. Returns false if the ring was closed first.
+        bool waitFor(bool producer, size_t index) {
+            for (size_t i = 0; i < SPSC_SPIN_COUNT; i++) {
+                if (ready(producer, index)) {
+                    return true;
+                }
+                if (producer && closed_.load(std::memory_order_acquire)) {
+                    return false;
+                }
+            }
+
+            std::atomic<bool> &waiting = producer ? producerWaiting_ : consumerWaiting_;
+            pthread_cond_t &cond = producer ? notFull_ : notEmpty_;
+            pthread_mutex_lock(&mutex_);
+            waiting.store(true, std::memory_order_seq_cst);
+            while (!ready(producer, index) && !closed_.load(std::memory_order_seq_cst)) {
+                if (producer) { fullStalls_++; } else { emptyStalls_++; }
+                pthread_cond_wait(&cond, &mutex_);
+            }
+            waiting.store(false, std::memory_order_relaxed);
+            pthread_mutex_unlock(&mutex_);
+
+            // The consumer drains whatever was published before the ring was closed
+            return producer ? !closed_.load(std::memory_order_acquire) : ready(producer, index);
+        }
+
+        // Wakes the other side if it's sleeping.
+        void wake(std::atomic<bool> &waiting, pthread_cond_t &cond) {
+            if (waiting.load(std::memory_order_seq_cst)) {
+                pthread_mutex_lock(&mutex_);
+                pthread_cond_signal(&cond);
+                pthread_mutex_unlock(&mutex_);
+            }
+        }
+
+        std::vector<T>       slots_;
+        size_t               mask_;
+        std::atomic<size_t>  head_, tail_;
+        std::atomic<bool>    closed_;
+        std::atomic<bool>    producerWaiting_, consumerWaiting_;
+        size_t               fullStalls_, emptyStalls_;
+        pthread_mutex_t      mutex_;
+        pthread_cond_t       notFull_, notEmpty_;
+    };
+
+}
+
+#endif // SPSC_RING_H
@@ -0,0 +1,566 @@
+#ifndef TILE_CACHE_H
+#define TILE_CACHE_H
+
+/**
+ * \file TileCache.h
+ *
+ * \brief This file embodies the cache of tiles which the CachedTiler keeps in the frame volume.
+ *
+ * This file embodies the cache of tiles which the CachedTiler keeps in the frame volume. Every tile of
+ * every frame looks its checksum up in the cache and then either refreshes the tile it finds or gives
+ * its checksum to a tile chosen by the cache's eviction policy. The tiles live in one contiguous array
+ * and an open-addressing hash maps checksums to them. The policies are:
+ *
+ * - lru evicts the least recently used tile. This is the original policy.
+ * - clock sweeps a hand over the tiles, sparing those hit since it last passed. New tiles start out
+ *   unreferenced, so a burst of one-off tiles is evicted before the tiles which keep coming back.
+ * - arc is Megiddo and Modha's Adaptive Replacement Cache. It keeps tiles seen once apart from tiles
+ *   seen again and remembers the checksums recently evicted from each, using them to adapt how much of
+ *   the cache goes to each.
+ *
+ * A policy never evicts a tile which is still on the display while there is another one to evict. Tiles
+ * which may still be on the display are kept off the policy's candidates until they're released, so
+ * choosing a victim never walks past them.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * This struct holds the checksum of a tile as well as the zIndex into the frame volume
+ * when the tile is used in a caching configuration.
+ */
+typedef struct tile_s {
+    unsigned long   checksum;
+    unsigned long   age;
+    size_t          zIndex;
+    struct tile_s  *older, *newer;   // Neighbours in the eviction policy's list from least to most recently used
+    struct tile_s  *before, *after;  // Neighbours in the cache's list of every tile from least to most recently used
+    unsigned char   list;            // Which of the eviction policy's lists the tile is in
+    bool            referenced;      // Whether the tile was hit since the clock's hand last passed it
+    bool            inUse;           // Whether the tile may still be on the display, keeping it off the policy's candidates
+} tile_t;
+
+namespace nddi {
+
+    /**
+     * \brief The policies the tile cache can evict tiles by.
+     */
+    typedef enum {
+        EVICT_LRU,
+        EVICT_CLOCK,
+        EVICT_ARC,
+        EVICT_COUNT
+    } Eviction;
+
+    static inline const char* evictionName(Eviction policy) {
+        switch (policy) {
+            case EVICT_CLOCK: return "clock";
+            case EVICT_ARC:   return "arc";
+            default:          return "lru";
+        }
+    }
+
+    /**
+     * \brief Returns the eviction policy with the given name, or EVICT_COUNT if there isn't one.
+     */
+    static inline Eviction evictionByName(const std::string &name) {
+        for (int i = 0; i < EVICT_COUNT; i++) {
+            if (name == evictionName((Eviction)i)) {
+                return (Eviction)i;
+            }
+        }
+        return EVICT_COUNT;
+    }
+
+    /**
+     * \brief Intrusive doubly linked list of tiles from least to most recently used.
+     */
+    class TileList {
+    public:
+        TileList() : oldest_(NULL), newest_(NULL), size_(0) {}
+
+        tile_t* Oldest() { return oldest_; }
+        size_t Size() { return size_; }
+
+        /** Links the tile in as the most recently used one. */
+        void Link(tile_t* tile) {
+            tile->older = newest_;
+            tile->newer = NULL;
+            if (newest_) {
+                newest_->newer = tile;
+            } else {
+                oldest_ = tile;
+            }
+            newest_ = tile;
+            size_++;
+        }
+
+        void Unlink(tile_t* tile) {
+            if (tile->older) {
+                tile->older->newer = tile->newer;
+            } else {
+                oldest_ = tile->newer;
+            }
+            if (tile->newer) {
+                tile->newer->older = tile->older;
+            } else {
+                newest_ = tile->older;
+            }
+            size_--;
+        }
+
+    private:
+        tile_t*  oldest_;
+        tile_t*  newest_;
+        size_t   size_;
+    };
+
+    /**
+     * \brief Decides which tile of a full cache is given the checksum of a tile that missed.
+     *
+     * Decides which tile of a full cache is given the checksum of a tile that missed. The cache tells the
+     * policy about every tile it adds, hits, and replaces, and asks it for a victim when it's full. Every
+     * one of those tiles may be on the display, so it only becomes a candidate once the cache releases it.
+     * A tile whose inUse flag is clear when it's hit or replaced is a candidate and must stop being one.
+     */
+    class EvictionPolicy {
+    public:
+        virtual ~EvictionPolicy() {}
+
+        /** A tile was added for a checksum that missed while the cache had room. */
+        virtual void Added(tile_t* tile) = 0;
+
+        /** A tile was hit. */
+        virtual void Hit(tile_t* tile) = 0;
+
+        /**
+         * \brief Chooses the tile to give the checksum of a tile that missed.
+         *
+         * Chooses the tile to give the checksum of a tile that missed.
+         * @param checksum The checksum that missed.
+         * @return The victim, or NULL if no tile is a candidate.
+         */
+        virtual tile_t* Victim(unsigned long checksum) = 0;
+
+        /** A tile was given the checksum of a tile that missed. */
+        virtual void Replaced(tile_t* tile, unsigned long oldChecksum) = 0;
+
+        /** A tile is no longer on the display, so it's a candidate from now on. */
+        virtual void Released(tile_t* tile) = 0;
+    };
+
+    /**
+     * \brief Evicts the least recently used tile.
+     */
+    class LruEviction : public EvictionPolicy {
+    public:
+        void Added(tile_t* tile) {}
+        void Hit(tile_t* tile) { if (!tile->inUse) tiles_.Unlink(tile); }
+        // Tiles are released in the order they were last used, so the oldest candidate is the least recently used
+        tile_t* Victim(unsigned long checksum) { return tiles_.Oldest(); }
+        void Replaced(tile_t* tile, unsigned long oldChecksum) { Hit(tile); }
+        void Released(tile_t* tile) { tiles_.Link(tile); }
+
+    private:
+        TileList  tiles_;
+    };
+
+    /**
+     * \brief Evicts the first unreferenced tile the clock's hand comes to, clearing references as it goes.
+     *
+     * Evicts the first unreferenced tile the clock's hand comes to, clearing references as it goes. The
+     * clock holds only the candidates, with the hand at the oldest. A referenced tile the hand passes goes
+     * to the back of the clock, as does a tile when it's released.
+     */
+    class ClockEviction : public EvictionPolicy {
+    public:
+        void Added(tile_t* tile) { tile->referenced = false; }
+        void Hit(tile_t* tile) { withdraw(tile); tile->referenced = true; }
+        void Replaced(tile_t* tile, unsigned long oldChecksum) { withdraw(tile); tile->referenced = false; }
+        void Released(tile_t* tile) { clock_.Link(tile); }
+
+        tile_t* Victim(unsigned long checksum) {
+            // Each pass clears a reference set by a hit, so the sweep costs no more than the hits did
+            for (tile_t* tile = clock_.Oldest(); tile; tile = clock_.Oldest()) {
+                if (!tile->referenced) {
+                    return tile;
+                }
+                tile->referenced = false;
+                clock_.Unlink(tile);
+                clock_.Link(tile);
+            }
+            return NULL;
+        }
+
+    private:
+        void withdraw(tile_t* tile) {
+            if (!tile->inUse) {
+                clock_.Unlink(tile);
+            }
+        }
+
+        TileList  clock_;
+    };
+
+    /**
+     * \brief Adaptive Replacement Cache.
+     *
+     * Adaptive Replacement Cache. T1 holds the tiles seen once since they were cached and T2 the tiles seen
+     * again. B1 and B2 hold the checksums last evicted from T1 and T2. A miss on a checksum in B1 means T1
+     * was too small, so its target size p grows, and a miss on one in B2 shrinks it. Either way the tile
+     * goes into T2. The victim comes from T1 while it's larger than p and from T2 otherwise. Only the
+     * candidates are linked into T1 and T2, but their sizes count every tile in them.
+     */
+    class ArcEviction : public EvictionPolicy {
+    public:
+        ArcEviction(size_t capacity)
+        : capacity_(capacity),
+          p_(0) {
+            size_[0] = size_[1] = 0;
+        }
+
+        void Added(tile_t* tile) {
+            insert(tile, adapt(tile->checksum));
+        }
+
+        void Hit(tile_t* tile) {
+            remove(tile);
+            tile->list = 1;
+            size_[1]++;
+        }
+
+        void Released(tile_t* tile) {
+            t_[tile->list].Link(tile);
+        }
+
+        tile_t* Victim(unsigned long checksum) {
+            ghost_map_t::iterator ghost = ghosts_.find(checksum);
+            int inGhost = (ghost == ghosts_.end()) ? -1 : ghost->second.list;
+            size_t p = adapted(inGhost);
+
+            // Prefer the list ARC's replace step would take from, and the other one if all of its tiles are in use
+            int first = ((size_[0] > 0) && ((size_[0] > p) || ((inGhost == 1) && (size_[0] == p)))) ? 0 : 1;
+            tile_t* tile = t_[first].Oldest();
+            if (!tile) {
+                tile = t_[1 - first].Oldest();
+            }
+            return tile;
+        }
+
+        void Replaced(tile_t* tile, unsigned long oldChecksum) {
+            int list = tile->list;
+            remove(tile);
+            insert(tile, adapt(tile->checksum));
+
+            // Remember the evicted checksum, then keep |T1| + |B1| and |B1| + |B2| within the capacity
+            b_[list].push_back(oldChecksum);
+            ghost_t &g = ghosts_[oldChecksum];
+            g.list = list;
+            g.position = --b_[list].end();
+            if ((size_[0] + b_[0].size() > capacity_) && !b_[0].empty()) {
+                forget(0);
+            }
+            if (b_[0].size() + b_[1].size() > capacity_) {
+                forget(b_[1].empty() ? 0 : 1);
+            }
+        }
+
+    private:
+        typedef struct {
+            int                                 list;
+            std::list<unsigned long>::iterator  position;
+        } ghost_t;
+        typedef std::unordered_map<unsigned long, ghost_t> ghost_map_t;
+
+        // The target size of T1 after a miss on a checksum in the given ghost list, or -1 for neither.
+        size_t adapted(int inGhost) {
+            if (inGhost == 0) {
+                size_t delta = (b_[0].size() >= b_[1].size()) ? 1 : b_[1].size() / b_[0].size();
+                return (p_ + delta < capacity_) ? p_ + delta : capacity_;
+            } else if (inGhost == 1) {
+                size_t delta = (b_[1].size() >= b_[0].size()) ? 1 : b_[0].size() / b_[1].size();
+                return (p_ > delta) ? p_ - delta : 0;
+            }
+            return p_;
+        }
+
+        // Adapts p to a miss on the checksum and drops it from the ghosts. Returns whether it was in them.
+        bool adapt(unsigned long checksum) {
+            ghost_map_t::iterator ghost = ghosts_.find(checksum);
+            if (ghost == ghosts_.end()) {
+                return false;
+            }
+            p_ = adapted(ghost->second.list);
+            b_[ghost->second.list].erase(ghost->second.position);
+            ghosts_.erase(ghost);
+            return true;
+        }
+
+        // Puts the tile in T2 if it was seen before and T1 otherwise. It's linked in once it's released.
+        void insert(tile_t* tile, bool seenBefore) {
+            tile->list = seenBefore ? 1 : 0;
+            size_[tile->list]++;
+        }
+
+        void remove(tile_t* tile) {
+            if (!tile->inUse) {
+                t_[tile->list].Unlink(tile);
+            }
+            size_[tile->list]--;
+        }
+
+        void forget(int list) {
+            ghosts_.erase(b_[list].front());
+            b_[list].pop_front();
+        }
+
+        size_t                     capacity_;
+        size_t                     p_;
+        size_t                     size_[2];
+        TileList                   t_[2];
+        std::list<unsigned long>   b_[2];
+        ghost_map_t                ghosts_;
+    };
+
+    /**
+     * \brief Fixed-capacity cache of tiles keyed by checksum.
+     *
+     * Fixed-capacity cache of tiles keyed by checksum. Tiles are added with consecutive zIndexes until the
+     * cache is full. After that a tile chosen by the eviction policy is reused by replacing its checksum.
+     * Tile pointers stay valid for the life of the cache. Every tile is also kept in a list ordered by when
+     * it was last used, so the tiles which have left the display can be released to the policy in order.
+     */
+    class TileCache {
+    public:
+        /**
+         * \brief Creates a cache holding up to the given number of tiles.
+         *
+         * Creates a cache holding up to the given number of tiles.
+         * @param capacity The maximum number of tiles.
+         * @param eviction The policy which chooses the tiles to reuse once the cache is full.
+         */
+        TileCache(size_t capacity, Eviction eviction = EVICT_LRU)
+        : tiles_(capacity),
+          size_(0),
+          leastRecent_(NULL),
+          mostRecent_(NULL),
+          unreleased_(NULL),
+          evictions_(0) {
+            // Keep the hash at most half full so probe sequences stay short
+            size_t slots = 2;
+            shift_ = 63;
+            while (slots < capacity * 2) {
+                slots <<= 1;
+                shift_--;
+            }
+            slots_.resize(slots, NULL);
+            mask_ = slots - 1;
+
+            switch (eviction) {
+                case EVICT_CLOCK:
+                    policy_.reset(new ClockEviction());
+                    break;
+                case EVICT_ARC:
+                    policy_.reset(new ArcEviction(capacity));
+                    break;
+                default:
+                    policy_.reset(new LruEviction());
+                    break;
+            }
+            eviction_ = eviction;
+        }
+
+        // The hash and the policy's lists point into tiles_, so a copy would share them with the original
+        TileCache(const TileCache&) = delete;
+        TileCache& operator=(const TileCache&) = delete;
+
+        /** Number of tiles in the cache. */
+        size_t Size() { return size_; }
+
+        /** Maximum number of tiles in the cache. */
+        size_t Capacity() { return tiles_.size(); }
+
+        /** The eviction policy. */
+        Eviction Policy() { return eviction_; }
+
+        /** Number of tiles which have been given another checksum. */
+        size_t Evictions() { return evictions_; }
+
+        /**
+         * \brief Finds the tile with the given checksum.
+         *
+         * Finds the tile with the given checksum.
+         * @param checksum The checksum.
+         * @return The tile, or NULL if no tile in the cache has the checksum.
+         */
+        tile_t* Find(unsigned long checksum) {
+            for (size_t i = home(checksum); slots_[i]; i = (i + 1) & mask_) {
+                if (slots_[i]->checksum == checksum) {
+                    return slots_[i];
+                }
+            }
+            return NULL;
+        }
+
+        /**
+         * \brief Adds a tile with the next zIndex. The cache must not be full.
+         *
+         * Adds a tile with the next zIndex. The cache must not be full, and no tile in it may have the
+         * checksum already.
+         * @param checksum The tile's checksum.
+         * @param age The tile's age.
+         * @return The tile.
+         */
+        tile_t* Add(unsigned long checksum, unsigned long age) {
+            tile_t* tile = &tiles_[size_];
+            tile->checksum = checksum;
+            tile->age = age;
+            tile->zIndex = size_++;
+            tile->older = tile->newer = NULL;
+            tile->before = tile->after = NULL;
+            tile->list = 0;
+            tile->referenced = false;
+            tile->inUse = true;
+            index(tile);
+            policy_->Added(tile);
+            use(tile);
+            return tile;
+        }
+
+        /**
+         * \brief Marks a tile as hit.
+         *
+         * Marks a tile as hit.
+         * @param tile The tile.
+         * @param age The tile's new age.
+         */
+        void Touch(tile_t* tile, unsigned long age) {
+            tile->age = age;
+            policy_->Hit(tile);
+            use(tile);
+        }
+
+        /**
+         * \brief Chooses the tile to give the checksum of a tile that missed. The cache must be full.
+         *
+         * Chooses the tile to give the checksum of a tile that missed. The cache must be full.
+         * @param checksum The checksum that missed.
+         * @param inUseAge Tiles at least this old may still be on the display, so they're only chosen if every tile is.
+         * @return The tile to pass to Replace().
+         */
+        tile_t* Victim(unsigned long checksum, unsigned long inUseAge) {
+            // Ages only grow along the list, so the tiles to release are the oldest of those not released yet
+            while (unreleased_ && (unreleased_->age < inUseAge)) {
+                unreleased_->inUse = false;
+                policy_->Released(unreleased_);
+                unreleased_ = unreleased_->after;
+            }
+
+            // If every tile is in use, take the least recently used one
+            tile_t* tile = policy_->Victim(checksum);
+            return tile ? tile : leastRecent_;
+        }
+
+        /**
+         * \brief Reuses a tile for another checksum.
+         *
+         * Reuses a tile for another checksum. No tile in the cache may have the new checksum already.
+         * @param tile The tile.
+         * @param checksum The tile's new checksum.
+         * @param age The tile's new age.
+         */
+        void Replace(tile_t* tile, unsigned long checksum, unsigned long age) {
+            unsigned long oldChecksum = tile->checksum;
+            unindex(tile);
+            tile->checksum = checksum;
+            tile->age = age;
+            index(tile);
+            policy_->Replaced(tile, oldChecksum);
+            use(tile);
+            evictions_++;
+        }
+
+    private:
+        // Fibonacci hashing spreads checksums whose entropy sits in either half across the slots.
+        size_t home(unsigned long checksum) {
+            return (size_t)(((uint64_t)checksum * 0x9e3779b97f4a7c15ULL) >> shift_);
+        }
+
+        void index(tile_t* tile) {
+            size_t i = home(tile->checksum);
+            while (slots_[i]) {
+                i = (i + 1) & mask_;
+            }
+            slots_[i] = tile;
+        }
+
+        // Moves the tile to the most recently used end of the list. It's kept from the policy until it's released.
+        void use(tile_t* tile) {
+            if (tile == unreleased_) {
+                unreleased_ = tile->after;
+            }
+            if (tile->before) {
+                tile->before->after = tile->after;
+            } else if (leastRecent_ == tile) {
+                leastRecent_ = tile->after;
+            }
+            if (tile->after) {
+                tile->after->before = tile->before;
+            } else if (mostRecent_ == tile) {
+                mostRecent_ = tile->before;
+            }
+            tile->before = mostRecent_;
+            tile->after = NULL;
+            if (mostRecent_) {
+                mostRecent_->after = tile;
+            } else {
+                leastRecent_ = tile;
+            }
+            mostRecent_ = tile;
+            tile->inUse = true;
+            if (!unreleased_) {
+                unreleased_ = tile;
+            }
+        }
+
+        // Removes the tile from the hash, shifting later tiles of its probe sequence back into the hole
+        // so lookups never need tombstones.
+        void unindex(tile_t* tile) {
+            size_t i = home(tile->checksum);
+            while (slots_[i] != tile) {
+                i = (i + 1) & mask_;
+            }
+            slots_[i] = NULL;
+            for (size_t j = (i + 1) & mask_; slots_[j]; j = (j + 1) & mask_) {
+                size_t h = home(slots_[j]->checksum);
+                // The tile at j may fill the hole unless its home lies cyclically in (i, j]
+                if ((i <= j) ? ((h <= i) || (h > j)) : ((h <= i) && (h > j))) {
+                    slots_[i] = slots_[j];
+                    slots_[j] = NULL;
+                    i = j;
+                }
+            }
+        }
+
+        std::vector<tile_t>   tiles_;
+        size_t                size_;
+        std::vector<tile_t*>  slots_;
+        size_t                mask_;
+        unsigned int          shift_;
+        tile_t*               leastRecent_;
+        tile_t*               mostRecent_;
+        tile_t*               unreleased_;    // The least recently used tile not released to the policy yet
+        Eviction              eviction_;
+        std::unique_ptr<EvictionPolicy>  policy_;
+        size_t                evictions_;
+    };
+
+}
+
+#endif // TILE_CACHE_H
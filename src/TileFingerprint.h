@@ -0,0 +1,365 @@
+#ifndef TILE_FINGERPRINT_H
+#define TILE_FINGERPRINT_H
+
+/**
+ * \file TileFingerprint.h
+ *
+ * \brief This file embodies the fingerprinting of tiles which the CachedTiler and FlatTiler use to find tiles that match.
+ *
+ * This file embodies the fingerprinting of tiles which the CachedTiler and FlatTiler use to find tiles that match.
+ * Originally each tile was copied into an array of pixels holding only the significant bits of each channel, and
+ * then zlib's crc32 or adler32 was run over that array as selected by CHECKSUM_CALCULATOR. That checksum is still
+ * available as the legacy fingerprint. The crc32c and xxh64 fingerprints instead read the RGB24 rows of the tile
+ * straight from the decoded frame, apply the significant-bits mask eight bytes at a time, and hash them in the same
+ * pass. crc32c uses the SSE4.2 CRC32 instruction and is only available on CPUs which have it. xxh64 is a 64-bit hash
+ * built from the xxHash64 round and avalanche, which runs anywhere and collides far less often than a 32-bit checksum.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <sys/time.h>
+#include <vector>
+#include <zlib.h>
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <nmmintrin.h>
+#define FINGERPRINT_CRC32C_AVAILABLE
+#endif
+
+#include "PixelBridgeFeatures.h"
+#include "PixelConvert.h"
+
+namespace nddi {
+
+    /**
+     * \brief The ways a tile can be fingerprinted.
+     */
+    typedef enum {
+        FINGERPRINT_LEGACY,
+        FINGERPRINT_CRC32C,
+        FINGERPRINT_XXH64,
+        FINGERPRINT_COUNT
+    } Fingerprint;
+
+    static inline const char* fingerprintName(Fingerprint mode) {
+        switch (mode) {
+            case FINGERPRINT_CRC32C: return "crc32c";
+            case FINGERPRINT_XXH64:  return "xxh64";
+            default:                 return "legacy";
+        }
+    }
+
+    /**
+     * \brief Returns the fingerprint with the given name, or FINGERPRINT_COUNT if there isn't one.
+     */
+    static inline Fingerprint fingerprintByName(const std::string &name) {
+        for (int i = 0; i < FINGERPRINT_COUNT; i++) {
+            if (name == fingerprintName((Fingerprint)i)) {
+                return (Fingerprint)i;
+            }
+        }
+        return FINGERPRINT_COUNT;
+    }
+
+    /**
+     * \brief Reports whether this build and CPU are able to compute the given fingerprint.
+     */
+    static inline bool fingerprintSupported(Fingerprint mode) {
+        switch (mode) {
+            case FINGERPRINT_LEGACY:
+            case FINGERPRINT_XXH64:
+                return true;
+            case FINGERPRINT_CRC32C:
+#ifdef FINGERPRINT_CRC32C_AVAILABLE
+                __builtin_cpu_init();
+                return __builtin_cpu_supports("sse4.2");
+#else
+                return false;
+#endif
+            default:
+                return false;
+        }
+    }
+
+    /**
+     * \brief Tracks the frame data hashed versus the time spent hashing it.
+     */
+    typedef struct {
+        long     frames;
+        long     bytes;
+        long     usecs;
+    } fingerprint_stats_t;
+
+    /**
+     * \brief Computes the fingerprint of every tile of a frame.
+     *
+     * Computes the fingerprint of every tile of a frame. The tiles are laid out from the top left of the frame.
+     * Tiles in the last column and row hang off the edge of the display when its dimensions aren't a multiple
+     * of the tile size. When padding, such a tile is fingerprinted as if the pixels off the edge were black,
+     * otherwise just the part of the tile on the display is fingerprinted.
+     */
+    class TileFingerprinter {
+
+    public:
+        /**
+         * \brief Creates a fingerprinter for tiles of the given size on a display of the given size.
+         *
+         * Creates a fingerprinter for tiles of the given size on a display of the given size.
+         * @param mode The fingerprint to compute.
+         * @param bits The number of most significant bits of each channel to fingerprint.
+         * @param tile_width The width of the tiles.
+         * @param tile_height The height of the tiles.
+         * @param display_width The width of the display.
+         * @param display_height The height of the display.
+         * @param pad Whether tiles hanging off the edge of the display are padded with black.
+         */
+        TileFingerprinter(Fingerprint mode, size_t bits,
+                          size_t tile_width, size_t tile_height,
+                          size_t display_width, size_t display_height,
+                          bool pad)
+        : mode_(fingerprintSupported(mode) ? mode : FINGERPRINT_XXH64),
+          tile_width_(tile_width),
+          tile_height_(tile_height),
+          display_width_(display_width),
+          display_height_(display_height),
+          pad_(pad) {
+            mask_ = (uint8_t)(0xff << (8 - bits));
+            mask64_ = 0x0101010101010101ULL * mask_;
+            tile_map_width_ = (display_width + tile_width - 1) / tile_width;
+            tile_map_height_ = (display_height + tile_height - 1) / tile_height;
+            zeros_.resize(3 * tile_width, 0);
+            initScratch(scratch_);
+            memset(&stats_, 0, sizeof(stats_));
+        }
+
+        /** The fingerprint computed, which falls back to xxh64 if the one asked for isn't supported. */
+        Fingerprint Mode() { return mode_; }
+
+        size_t TileMapWidth() { return tile_map_width_; }
+        size_t TileMapHeight() { return tile_map_height_; }
+
+        /** The frame data hashed by FingerprintFrame() and the time spent hashing it. */
+        fingerprint_stats_t& Stats() { return stats_; }
+
+        /**
+         * \brief Fingerprints every tile of a frame.
+         *
+         * Fingerprints every tile of a frame. The fingerprint of the tile i across and j down is stored at
+         * fingerprints[j * TileMapWidth() + i]. When built with OpenMP, the rows of tiles are split between
+         * threads, each with its own scratch space.
+         * @param buffer The RGB24 frame.
+         * @param width The width of the frame, which may be wider than the display.
+         * @param fingerprints Receives the fingerprints.
+         */
+        void FingerprintFrame(const uint8_t* buffer, size_t width, std::vector<unsigned long> &fingerprints) {
+            timeval startTime, endTime;
+
+            gettimeofday(&startTime, NULL);
+            fingerprints.resize(tile_map_width_ * tile_map_height_);
+#ifdef USE_OMP
+#pragma omp parallel
+#endif
+            {
+                scratch_t scratch;
+                initScratch(scratch);
+#ifdef USE_OMP
+#pragma omp for schedule(static)
+#endif
+                for (long j = 0; j < (long)tile_map_height_; j++) {
+                    for (size_t i = 0; i < tile_map_width_; i++) {
+                        fingerprints[j * tile_map_width_ + i] = fingerprintTile(buffer, width, i, j, scratch);
+                    }
+                }
+            }
+            gettimeofday(&endTime, NULL);
+
+            stats_.frames++;
+            stats_.bytes += 3 * display_width_ * display_height_;
+            stats_.usecs += (endTime.tv_sec - startTime.tv_sec) * 1000000 + endTime.tv_usec - startTime.tv_usec;
+        }
+
+        /**
+         * \brief Fingerprints one tile of a frame.
+         *
+         * Fingerprints one tile of a frame.
+         * @param buffer The RGB24 frame.
+         * @param width The width of the frame, which may be wider than the display.
+         * @param i_map The column of the tile.
+         * @param j_map The row of the tile.
+         * @return The fingerprint.
+         */
+        unsigned long FingerprintTile(const uint8_t* buffer, size_t width, size_t i_map, size_t j_map) {
+            return fingerprintTile(buffer, width, i_map, j_map, scratch_);
+        }
+
+    private:
+        // Space for copying a tile's rows, which every thread fingerprinting tiles needs its own of
+        typedef struct {
+            std::vector<uint8_t>  row;
+            std::vector<Pixel>    sigBits;
+        } scratch_t;
+
+        void initScratch(scratch_t &scratch) {
+            scratch.row.resize(3 * tile_width_, 0);
+            scratch.sigBits.resize(tile_width_ * tile_height_);
+        }
+
+        unsigned long fingerprintTile(const uint8_t* buffer, size_t width, size_t i_map, size_t j_map, scratch_t &scratch) {
+            size_t x = i_map * tile_width_, y = j_map * tile_height_;
+            size_t visible_width = (x + tile_width_ <= display_width_) ? tile_width_ : display_width_ - x;
+            size_t visible_height = (y + tile_height_ <= display_height_) ? tile_height_ : display_height_ - y;
+            const uint8_t* source = buffer + 3 * (y * width + x);
+
+            switch (mode_) {
+#ifdef FINGERPRINT_CRC32C_AVAILABLE
+                case FINGERPRINT_CRC32C:
+                    return crc32cTile(source, 3 * width, visible_width, visible_height, scratch);
+#endif
+                case FINGERPRINT_XXH64:
+                    return xxh64Tile(source, 3 * width, visible_width, visible_height, scratch);
+                default:
+                    return legacyTile(source, 3 * width, visible_width, visible_height, scratch);
+            }
+        }
+
+        /*
+         * Returns the bytes of row j of a tile which are fingerprinted, along with how many there are. When padding,
+         * rows are always a full tile wide and the black pixels off the edge of the display are zeroes.
+         */
+        const uint8_t* tileRow(const uint8_t* source, size_t stride,
+                               size_t visible_width, size_t visible_height,
+                               size_t j, size_t &length, scratch_t &scratch) {
+            if (!pad_) {
+                length = 3 * visible_width;
+                return source + j * stride;
+            }
+            length = 3 * tile_width_;
+            if (j >= visible_height) {
+                return &zeros_[0];
+            }
+            if (visible_width < tile_width_) {
+                memcpy(&scratch.row[0], source + j * stride, 3 * visible_width);
+                return &scratch.row[0];
+            }
+            return source + j * stride;
+        }
+
+        size_t tileRows(size_t visible_height) {
+            return pad_ ? tile_height_ : visible_height;
+        }
+
+        /*
+         * The checksum the tilers originally used, selected by CHECKSUM_CALCULATOR. Padding pixels are opaque black.
+         */
+        unsigned long legacyTile(const uint8_t* source, size_t stride, size_t visible_width, size_t visible_height,
+                                 scratch_t &scratch) {
+            size_t tw = pad_ ? tile_width_ : visible_width;
+            size_t th = tileRows(visible_height);
+
+            gatherTile(source, stride, visible_width, visible_height, tw, th, &scratch.sigBits[0], mask_);
+
+            unsigned long checksum;
+#if (CHECKSUM_CALCULATOR == TRIVIAL)
+            checksum  = (unsigned long)scratch.sigBits[0].packed << 32;
+            checksum |= (unsigned long)scratch.sigBits[tw * th - 1].packed;
+#else
+            unsigned long crc = crc32(0L, Z_NULL, 0);
+#if (CHECKSUM_CALCULATOR == CRC)
+            checksum = crc32(crc, (unsigned char*)&scratch.sigBits[0], tw * th * sizeof(Pixel));
+#elif (CHECKSUM_CALCULATOR == ADLER)
+            checksum = adler32(crc, (unsigned char*)&scratch.sigBits[0], tw * th * sizeof(Pixel));
+#endif
+#endif
+            return checksum;
+        }
+
+#ifdef FINGERPRINT_CRC32C_AVAILABLE
+        __attribute__((target("sse4.2")))
+        unsigned long crc32cTile(const uint8_t* source, size_t stride, size_t visible_width, size_t visible_height,
+                                 scratch_t &scratch) {
+            uint64_t crc = 0xffffffff;
+
+            for (size_t j = 0; j < tileRows(visible_height); j++) {
+                size_t length, k = 0;
+                const uint8_t* row = tileRow(source, stride, visible_width, visible_height, j, length, scratch);
+                for (; k + 8 <= length; k += 8) {
+                    uint64_t v;
+                    memcpy(&v, row + k, 8);
+                    crc = _mm_crc32_u64(crc, v & mask64_);
+                }
+                for (; k < length; k++) {
+                    crc = _mm_crc32_u8((uint32_t)crc, row[k] & mask_);
+                }
+            }
+            return (unsigned long)(crc ^ 0xffffffff);
+        }
+#endif
+
+        static inline uint64_t rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+        static inline uint64_t xxh64Round(uint64_t acc, uint64_t v) {
+            acc += v * 14029467366897019727ULL;
+            return rotl64(acc, 31) * 11400714785074694791ULL;
+        }
+
+        static inline uint64_t xxh64Merge(uint64_t h, uint64_t acc) {
+            h ^= xxh64Round(0, acc);
+            return h * 11400714785074694791ULL + 9650029242287828579ULL;
+        }
+
+        /*
+         * Spreads the tile's words round-robin over the four xxHash64 accumulators so consecutive rounds don't wait
+         * on one another. The last few bytes of a row which don't fill a word are zero-extended into one.
+         */
+        unsigned long xxh64Tile(const uint8_t* source, size_t stride, size_t visible_width, size_t visible_height,
+                                scratch_t &scratch) {
+            uint64_t acc[4] = { 11400714785074694791ULL + 14029467366897019727ULL, 14029467366897019727ULL,
+                                0, 0 - 11400714785074694791ULL };
+            size_t lane = 0, total = 0;
+
+            for (size_t j = 0; j < tileRows(visible_height); j++) {
+                size_t length, k = 0;
+                const uint8_t* row = tileRow(source, stride, visible_width, visible_height, j, length, scratch);
+                for (; k + 8 <= length; k += 8) {
+                    uint64_t v;
+                    memcpy(&v, row + k, 8);
+                    acc[lane] = xxh64Round(acc[lane], v & mask64_);
+                    lane = (lane + 1) & 3;
+                }
+                if (k < length) {
+                    uint64_t v = 0;
+                    memcpy(&v, row + k, length - k);
+                    acc[lane] = xxh64Round(acc[lane], v & mask64_);
+                    lane = (lane + 1) & 3;
+                }
+                total += length;
+            }
+
+            uint64_t h = rotl64(acc[0], 1) + rotl64(acc[1], 7) + rotl64(acc[2], 12) + rotl64(acc[3], 18);
+            for (size_t l = 0; l < 4; l++) {
+                h = xxh64Merge(h, acc[l]);
+            }
+            h += total;
+            h ^= h >> 33;
+            h *= 14029467366897019727ULL;
+            h ^= h >> 29;
+            h *= 1609587929392839161ULL;
+            h ^= h >> 32;
+            return (unsigned long)h;
+        }
+
+        Fingerprint          mode_;
+        size_t               tile_width_, tile_height_;
+        size_t               display_width_, display_height_;
+        size_t               tile_map_width_, tile_map_height_;
+        bool                 pad_;
+        uint8_t              mask_;
+        uint64_t             mask64_;
+        std::vector<uint8_t> zeros_;
+        scratch_t            scratch_;
+        fingerprint_stats_t  stats_;
+    };
+
+}
+
+#endif // TILE_FINGERPRINT_H
@@ -0,0 +1,123 @@
+#ifndef TILED_COEFFICIENTS_H
+#define TILED_COEFFICIENTS_H
+
+/**
+ * \file TiledCoefficients.h
+ *
+ * \brief This file embodies the filling of the coefficient planes with one coefficient matrix per tile.
+ *
+ * This file embodies the filling of the coefficient planes with one coefficient matrix per tile. Every
+ * tiler initializes its coefficient planes with the same matrix in each tile, except for the translation
+ * terms which pick the tile's block out of the frame volume. Sending a FillCoefficientMatrix per tile
+ * costs millions of commands at 1080p, so the FillCoefficientMatrixTiled command carries the matrix once
+ * along with the tile size, and the receiving end derives each tile's translation from its position.
+ * Displays which don't implement the command have it expanded into the per-tile FillCoefficientMatrix
+ * commands on the spot.
+ */
+
+#include <vector>
+
+#include "nddi/Features.h"
+#include "nddi/NDimensionalDisplayInterface.h"
+
+namespace nddi {
+
+#ifndef BYTES_PER_COEFF
+    /** Number of link bytes the display charges for each coefficient of a matrix. */
+    #define BYTES_PER_COEFF sizeof(int)
+#endif
+
+    /**
+     * \brief Implemented by displays which can take a tiled coefficient matrix as a single command.
+     */
+    class TiledCoefficientDisplay {
+    public:
+        virtual ~TiledCoefficientDisplay() {}
+
+        /**
+         * \brief Fills a range of the coefficient planes with a coefficient matrix translated for each tile.
+         *
+         * Fills a range of the coefficient planes with a coefficient matrix translated for each tile. The range
+         * is broken into tiles starting at start, where the tiles in the last column and row are clipped to end.
+         * The tile i tiles across and j tiles down gets the coefficientMatrix with -i * size[0] added to
+         * coefficientMatrix[2][0] and -j * size[1] added to coefficientMatrix[2][1].
+         * @param coefficientMatrix The matrix used for the first tile. Its third row holds the translation terms.
+         * @param start This three-element vector specifies the first location of the range in the coefficient planes.
+         * @param end This three-element vector specifies the last location of the range in the coefficient planes.
+         * @param size This two-element vector specifies the width and height of each tile.
+         */
+        virtual void FillCoefficientMatrixTiled(std::vector< std::vector<int> > &coefficientMatrix,
+                                                std::vector<unsigned int> &start, std::vector<unsigned int> &end,
+                                                std::vector<unsigned int> &size) = 0;
+    };
+
+    /**
+     * \brief Expands a tiled coefficient matrix into one FillCoefficientMatrix per tile.
+     *
+     * Expands a tiled coefficient matrix into one FillCoefficientMatrix per tile. The display charges its link
+     * for every one of them, while the tiled command would only have cost the link one FillCoefficientMatrix
+     * plus the tile size. Each FillCoefficientMatrix is charged for its coefficients and its two coordinate
+     * triples, which is worked out here rather than read off the cost model, since other commands may be
+     * charging the same display meanwhile.
+     * @param extraCommands If given, the link commands charged beyond the tiled command are added to it.
+     * @return The link bytes charged beyond what the tiled command would have cost.
+     */
+    static inline long expandCoefficientMatrixTiled(NDimensionalDisplayInterface* display,
+                                                    std::vector< std::vector<int> > &coefficientMatrix,
+                                                    std::vector<unsigned int> &start, std::vector<unsigned int> &end,
+                                                    std::vector<unsigned int> &size, long* extraCommands = NULL) {
+        if ((size.size() < 2) || !size[0] || !size[1] || (coefficientMatrix.size() < 3)) {
+            return 0;
+        }
+
+        std::vector< std::vector<int> > matrix(coefficientMatrix);
+        std::vector<unsigned int> tileStart(start), tileEnd(end);
+        long tileCost = (long)(BYTES_PER_COEFF * coefficientMatrix.size() * coefficientMatrix[0].size() +
+                               CALC_BYTES_FOR_CP_COORD_TRIPLES(2));
+        size_t tiles = 0;
+
+        for (size_t j = 0; start[1] + j * size[1] <= end[1]; j++) {
+            tileStart[1] = start[1] + j * size[1];
+            tileEnd[1] = tileStart[1] + size[1] - 1;
+            if (tileEnd[1] > end[1]) { tileEnd[1] = end[1]; }
+            matrix[2][1] = coefficientMatrix[2][1] - (int)(j * size[1]);
+            for (size_t i = 0; start[0] + i * size[0] <= end[0]; i++) {
+                tileStart[0] = start[0] + i * size[0];
+                tileEnd[0] = tileStart[0] + size[0] - 1;
+                if (tileEnd[0] > end[0]) { tileEnd[0] = end[0]; }
+                matrix[2][0] = coefficientMatrix[2][0] - (int)(i * size[0]);
+                display->FillCoefficientMatrix(matrix, tileStart, tileEnd);
+                tiles++;
+            }
+        }
+
+        if (extraCommands && (tiles > 1)) {
+            *extraCommands += (long)(tiles - 1);
+        }
+        long saved = (long)(tiles - 1) * tileCost - 2 * (long)sizeof(unsigned int);
+        return (tiles > 1) && (saved > 0) ? saved : 0;
+    }
+
+    /**
+     * \brief Sends a tiled coefficient matrix to a display as one command if it supports it, or one per tile otherwise.
+     *
+     * Sends a tiled coefficient matrix to a display as one command if it supports it, or one per tile otherwise.
+     * See TiledCoefficientDisplay::FillCoefficientMatrixTiled() for the parameters.
+     * @param extraCommands If given, the link commands charged beyond the tiled command are added to it.
+     * @return The link bytes charged beyond what the tiled command would have cost, which is 0 unless it was expanded.
+     */
+    static inline long fillCoefficientMatrixTiled(NDimensionalDisplayInterface* display,
+                                                  std::vector< std::vector<int> > &coefficientMatrix,
+                                                  std::vector<unsigned int> &start, std::vector<unsigned int> &end,
+                                                  std::vector<unsigned int> &size, long* extraCommands = NULL) {
+        TiledCoefficientDisplay* tiled = dynamic_cast<TiledCoefficientDisplay*>(display);
+        if (tiled) {
+            tiled->FillCoefficientMatrixTiled(coefficientMatrix, start, end, size);
+            return 0;
+        }
+        return expandCoefficientMatrixTiled(display, coefficientMatrix, start, end, size, extraCommands);
+    }
+
+}
+
+#endif // TILED_COEFFICIENTS_H
@@ -5,7 +5,9 @@
 #include <stdint.h>
 
 #include "GrpcNddiDisplay.h"
+#include "PayloadHandoff.h"
 #include "RecorderNddiDisplay.h"
+#include "TiledCoefficients.h"
 
 /*
  *  Tiler.h
@@ -25,6 +27,8 @@ class Tiler {
 
 public:
 
+    virtual ~Tiler() {}
+
     /**
      * Returns the Display created and initialized by the tiler.
      */
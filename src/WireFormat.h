@@ -0,0 +1,285 @@
+#ifndef WIRE_FORMAT_H
+#define WIRE_FORMAT_H
+
+/**
+ * \file WireFormat.h
+ *
+ * \brief This file embodies the packing and unpacking of the fixed-width v2 wire format.
+ *
+ * This file embodies the packing and unpacking of the fixed-width v2 wire format. The v1 tile and
+ * stack requests carry scalers and coordinates as repeated varints. The v2 requests carry them as
+ * little-endian packed byte blobs instead, which the client writes in bulk and the server decodes
+ * with direct loads. Scalers are packed as three int16 channels and coordinates as uint16 whenever
+ * they all fit, otherwise as uint32. Stacks of quantized coefficients can instead be sent as int8 or
+ * int16 levels which the server multiplies back by a registered table of per-plane divisors.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "nddi/Features.h"
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__)
+#error "The v2 wire format is packed and unpacked with host-order loads and stores, which must be little-endian."
+#endif
+
+namespace nddi {
+
+    /** Number of bytes used by each packed scaler. */
+    #define WIRE_SCALER_SIZE (3 * sizeof(int16_t))
+
+#ifndef BYTES_PER_SCALER
+    /** Number of link bytes the display charges for each full scaler. */
+    #define BYTES_PER_SCALER sizeof(Scaler)
+#endif
+
+    /**
+     * \brief Tracks bytes-on-wire versus encoding and decoding time for one command in one wire format.
+     */
+    typedef struct {
+        long     messages;
+        long     wireBytes;
+        long     encodeNanos;
+        long     decodeNanos;
+    } wire_stats_t;
+
+    /**
+     * \brief Monotonic timestamp in nanoseconds used to time encoding and decoding.
+     */
+    static inline uint64_t wireNanos() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+
+    /**
+     * \brief Packs scalers as three int16 channels each.
+     *
+     * Packs scalers as three int16 channels each. The alpha channel isn't carried, so the scalers
+     * can only be packed if none of them use it.
+     * @param scalers The packed 64-bit scalers.
+     * @param out Set to the packed scalers.
+     * @return False if any scaler uses its alpha channel, in which case the v1 format must be used.
+     */
+    static inline bool packScalers(const std::vector<uint64_t> &scalers, std::string &out) {
+        out.resize(scalers.size() * WIRE_SCALER_SIZE);
+        int16_t* dst = (int16_t*)&out[0];
+        for (size_t i = 0; i < scalers.size(); i++) {
+            Scaler s;
+            s.packed = scalers[i];
+            if (s.a) {
+                return false;
+            }
+            dst[0] = s.r;
+            dst[1] = s.g;
+            dst[2] = s.b;
+            dst += 3;
+        }
+        return true;
+    }
+
+    /**
+     * \brief Unpacks scalers packed by packScalers().
+     *
+     * Unpacks scalers packed by packScalers().
+     * @param data The packed scalers.
+     * @param length The length of the packed scalers in bytes.
+     * @param scalers Filled with the 64-bit scalers.
+     */
+    static inline void unpackScalers(const uint8_t* data, size_t length, std::vector<uint64_t> &scalers) {
+        size_t count = length / WIRE_SCALER_SIZE;
+        const int16_t* src = (const int16_t*)data;
+        scalers.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            Scaler s;
+            s.packed = 0;
+            s.r = src[0];
+            s.g = src[1];
+            s.b = src[2];
+            scalers[i] = s.packed;
+            src += 3;
+        }
+    }
+
+    /**
+     * \brief Quantizes scalers by per-plane divisors and packs them as three int8 or int16 channels each.
+     *
+     * Quantizes scalers by per-plane divisors and packs them as three int8 or int16 channels each. The
+     * DCT tilers send dequantized coefficients, so dividing them by the same quantization matrix gives back
+     * small integers. Only exact divisions are accepted, so dequantizing on the server is lossless.
+     * @param scalers The packed 64-bit scalers of a stack.
+     * @param divisors The divisor for each plane. An empty vector divides by one.
+     * @param first The index of the divisor for the stack's first plane.
+     * @param out Set to the packed quantized scalers.
+     * @param width Set to the width of each packed channel in bytes, either 1 or 2.
+     * @return False if the stack runs past the divisors, any scaler uses its alpha channel, any
+     *         channel isn't a multiple of its divisor, or any level doesn't fit in an int16.
+     */
+    static inline bool quantizeScalers(const std::vector<uint64_t> &scalers, const std::vector<uint32_t> &divisors,
+                                       size_t first, std::string &out, uint32_t &width) {
+        if (!divisors.empty() && ((first > divisors.size()) || (scalers.size() > divisors.size() - first))) {
+            return false;
+        }
+
+        std::vector<int16_t> levels(scalers.size() * 3);
+        int max = 0;
+        for (size_t i = 0; i < scalers.size(); i++) {
+            Scaler s;
+            s.packed = scalers[i];
+            if (s.a) {
+                return false;
+            }
+            int d = divisors.empty() ? 1 : divisors[first + i];
+            int c[3] = { s.r, s.g, s.b };
+            for (size_t k = 0; k < 3; k++) {
+                if (c[k] % d) {
+                    return false;
+                }
+                int level = c[k] / d;
+                if (abs(level) > max) { max = abs(level); }
+                levels[i * 3 + k] = level;
+            }
+        }
+
+        if (max <= 0x7f) {
+            width = sizeof(int8_t);
+            out.resize(levels.size());
+            int8_t* dst = (int8_t*)&out[0];
+            for (size_t i = 0; i < levels.size(); i++) {
+                dst[i] = levels[i];
+            }
+        } else {
+            width = sizeof(int16_t);
+            out.assign((const char*)levels.data(), levels.size() * sizeof(int16_t));
+        }
+
+        return true;
+    }
+
+    /**
+     * \brief Dequantizes scalers packed by quantizeScalers().
+     *
+     * Dequantizes scalers packed by quantizeScalers().
+     * @param data The packed quantized scalers.
+     * @param length The length of the packed quantized scalers in bytes.
+     * @param width The width of each packed channel in bytes, either 1 or 2.
+     * @param divisors The divisor for each plane. An empty vector multiplies by one.
+     * @param first The index of the divisor for the stack's first plane.
+     * @param scalers Filled with the 64-bit scalers.
+     * @return False if the width is invalid or the stack runs past the divisors.
+     */
+    static inline bool dequantizeScalers(const uint8_t* data, size_t length, uint32_t width,
+                                         const std::vector<uint32_t> &divisors, size_t first,
+                                         std::vector<uint64_t> &scalers) {
+        if ((width != sizeof(int8_t)) && (width != sizeof(int16_t))) {
+            return false;
+        }
+        size_t count = length / (width * 3);
+        if (!divisors.empty() && ((first > divisors.size()) || (count > divisors.size() - first))) {
+            return false;
+        }
+
+        scalers.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            int d = divisors.empty() ? 1 : divisors[first + i];
+            Scaler s;
+            s.packed = 0;
+            if (width == sizeof(int8_t)) {
+                const int8_t* src = (const int8_t*)data + i * 3;
+                s.r = src[0] * d;
+                s.g = src[1] * d;
+                s.b = src[2] * d;
+            } else {
+                const int16_t* src = (const int16_t*)data + i * 3;
+                s.r = src[0] * d;
+                s.g = src[1] * d;
+                s.b = src[2] * d;
+            }
+            scalers[i] = s.packed;
+        }
+
+        return true;
+    }
+
+    /**
+     * \brief Packs a list of coordinate tuples using the narrowest width that fits every coordinate.
+     *
+     * Packs a list of coordinate tuples using the narrowest width that fits every coordinate.
+     * @param coordinates The coordinate tuples, which must all have the same dimensionality.
+     * @param out Set to the packed coordinates.
+     * @return The width of each packed coordinate in bytes, either 2 or 4.
+     */
+    static inline uint32_t packCoordinates(const std::vector< std::vector<unsigned int> > &coordinates, std::string &out) {
+        unsigned int max = 0;
+        size_t count = 0;
+        for (size_t i = 0; i < coordinates.size(); i++) {
+            for (size_t j = 0; j < coordinates[i].size(); j++) {
+                if (coordinates[i][j] > max) { max = coordinates[i][j]; }
+            }
+            count += coordinates[i].size();
+        }
+
+        uint32_t width = (max <= 0xffff) ? sizeof(uint16_t) : sizeof(uint32_t);
+        out.resize(count * width);
+        if (width == sizeof(uint16_t)) {
+            uint16_t* dst = (uint16_t*)&out[0];
+            for (size_t i = 0; i < coordinates.size(); i++) {
+                for (size_t j = 0; j < coordinates[i].size(); j++) {
+                    *dst++ = coordinates[i][j];
+                }
+            }
+        } else {
+            uint32_t* dst = (uint32_t*)&out[0];
+            for (size_t i = 0; i < coordinates.size(); i++) {
+                memcpy(dst, coordinates[i].data(), coordinates[i].size() * sizeof(uint32_t));
+                dst += coordinates[i].size();
+            }
+        }
+
+        return width;
+    }
+
+    /**
+     * \brief Unpacks coordinate tuples packed by packCoordinates().
+     *
+     * Unpacks coordinate tuples packed by packCoordinates().
+     * @param data The packed coordinates.
+     * @param length The length of the packed coordinates in bytes.
+     * @param width The width of each packed coordinate in bytes, either 2 or 4.
+     * @param dimensions The dimensionality of each tuple.
+     * @param coordinates Filled with the coordinate tuples.
+     * @return False if the width is invalid or the length isn't a whole number of tuples.
+     */
+    static inline bool unpackCoordinates(const uint8_t* data, size_t length, uint32_t width, size_t dimensions,
+                                         std::vector< std::vector<unsigned int> > &coordinates) {
+        if (((width != sizeof(uint16_t)) && (width != sizeof(uint32_t))) || !dimensions ||
+            (length % (width * dimensions))) {
+            return false;
+        }
+
+        size_t count = length / (width * dimensions);
+        coordinates.resize(count);
+        if (width == sizeof(uint16_t)) {
+            const uint16_t* src = (const uint16_t*)data;
+            for (size_t i = 0; i < count; i++) {
+                coordinates[i].assign(src, src + dimensions);
+                src += dimensions;
+            }
+        } else {
+            const uint32_t* src = (const uint32_t*)data;
+            for (size_t i = 0; i < count; i++) {
+                coordinates[i].assign(src, src + dimensions);
+                src += dimensions;
+            }
+        }
+
+        return true;
+    }
+
+}
+
+#endif // WIRE_FORMAT_H